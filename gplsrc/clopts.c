@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb remove_user() clears the lock wait and wait queue ticket
+ *             of a vanished process. Waiters are signalled after the
+ *             semaphores are released.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686) 
  * 
  * 10Jan22 gwb Fixed a format specifier warning.
@@ -103,6 +107,7 @@ bool recover_users() {
   EndExclusive(GROUP_LOCK_SEM);
   EndExclusive(REC_LOCK_SEM);
   EndExclusive(FILE_TABLE_LOCK);
+  wake_waiters();
 
   return status;
 }
@@ -212,6 +217,7 @@ void kill_user(char* user) {
   EndExclusive(GROUP_LOCK_SEM);
   EndExclusive(REC_LOCK_SEM);
   EndExclusive(FILE_TABLE_LOCK);
+  wake_waiters();
 
   unbind_sysseg();
 }
@@ -281,6 +287,7 @@ void cleanup() {
   EndExclusive(GROUP_LOCK_SEM);
   EndExclusive(REC_LOCK_SEM);
   EndExclusive(FILE_TABLE_LOCK);
+  wake_waiters();
 
   unbind_sysseg();
 }
@@ -329,6 +336,17 @@ Private void remove_user(USER_ENTRY* uptr) {
       sysseg->task_locks[i] = 0;
   }
 
+  /* Leave any lock wait and the record lock wait queue */
+
+  if ((i = uptr->lockwait_index) > 0)
+    (RLPtr(i)->waiters)--;
+  uptr->lockwait_index = 0;
+
+  if (uptr->lockwait_ticket) {
+    uptr->lockwait_ticket = 0;
+    (sysseg->rl_queued)--;
+  }
+
   /* Give away file locks */
 
   for (i = 1; i <= sysseg->used_files; i++) {
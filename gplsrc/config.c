@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added SEQBUF.
+ *
+ * 18Oct26 gwb Added STRCACHE.
+ *
+ * 18Oct26 gwb Added OPSTATS.
+ *
  * 22Feb20 gwb Cleaned up an sprintf() warning.
  *
  * START-HISTORY (OpenQM):
@@ -78,13 +84,16 @@
  *  NUMLOCKS=n       Maximum number of record locks
  *  OBJECTS=n        Limit on loaded object code count (0 = no limit)
  *  OBJMEM=n         Limit on locade object size (kb, 0 = no limit)
+ *  OPSTATS=1        Collect opcode execution statistics
  *  PIDFILE=filepath Replace the default file path containing qnlnxd process id, used by systemctl to check whether ScarletDME is started or not
  *  QMCLIENT=n       QMClient rules (0=all, 1=no call/exec, 2=restricted call)
  *  QMSYS=path       QMSYS directory path
  *  SAFEDIR=1        Use careful update to directory files
+ *  SEQBUF=n         Sequential file buffer size (kb)
  *  SORTMEM=n        Threshold for disk based sort (units of 1kb)
  *  SORTWORK=path    Pathname of sort workfile directory
  *  STARTUP=cmd      Run command on starting QM
+ *  STRCACHE=n       Freed string chunk cache size per process (kb, 0 = none)
  *  TEMPDIR=path     Pathname of temporary directory
  *  TERMINFO=path    Pathname of terminfo directory
  *  TXCHAR=1         Enable ansi/oem character translation (default = 1)
@@ -150,10 +159,12 @@ struct CONFIG* read_config(char* errmsg) {
   pcfg.must_lock = FALSE;         /* MUSTLOCK: Enforce locking rules */
   pcfg.objects = 0;               /* OBJECTS:  Max loaded objects */
   pcfg.objmem = 0;                /* OBJMEM:   Max loaded object size */
+  pcfg.opstats = FALSE;           /* OPSTATS:  Collect opcode statistics */
   pcfg.qmclient_mode = 0;         /* QMCLIENT: Client capabilities */
   pcfg.reccache = 0;              /* RECCACHE: Record cache size */
   pcfg.ringwait = TRUE;           /* RINGWAIT: Wait if ring buffer full */
   pcfg.safedir = FALSE;           /* SAFE_DIR: User careful update to dir files */
+  pcfg.seqbuf = 64;               /* SEQBUF:   Sequential file buffer (kb) */
   pcfg.sh[0] = '\0';              /* SH:       Command to run interactive shell */
   pcfg.sh1[0] = '\0';             /* SH1:      Command to run single shell */
   pcfg.sortmem = 1048576;         /* SORTMEM:  1Mb default switch to disk sort */
@@ -161,6 +172,7 @@ struct CONFIG* read_config(char* errmsg) {
   pcfg.sortworkdir[0] = '\0';     /* SORTWORK: Use QMSYS directory */
   pcfg.tempdir[0] = '\0';         /* TEMPDIR:  Temporary directory */
   pcfg.spooler[0] = '\0';         /* SPOOLER:  Default spooler name */
+  pcfg.strcache = 256;            /* STRCACHE: String chunk cache (kb) */
   pcfg.terminfodir[0] = '\0';     /* TERMINFO: Use default location */
   pcfg.txchar = TRUE;             /* TXCHAR:   Enable ansi/oem translation */
   pcfg.yearbase = 1930;           /* YEARBASE: Two digit year base */
@@ -255,6 +267,8 @@ struct CONFIG* read_config(char* errmsg) {
         pcfg.objects = n;
       else if (sscanf(rec, "OBJMEM=%d", &n) == 1)
         pcfg.objmem = n * 1024L;
+      else if (sscanf(rec, "OPSTATS=%d", &n) == 1)
+        pcfg.opstats = (n != 0);
       else if (sscanf(rec, "PDUMP=%d", &n) == 1)
         cfg->pdump |= n;
       else if (strncmp(rec, "PIDFILE=", 8) == 0) {
@@ -278,6 +292,8 @@ struct CONFIG* read_config(char* errmsg) {
         pcfg.ringwait = (n != 0);
       else if (sscanf(rec, "SAFEDIR=%d", &n) == 1)
         pcfg.safedir = (n != 0);
+      else if (sscanf(rec, "SEQBUF=%d", &n) == 1)
+        pcfg.seqbuf = n;
       else if (strncmp(rec, "SH=", 3) == 0)
         strcpy(pcfg.sh, rec + 3);
       else if (strncmp(rec, "SH1=", 4) == 0)
@@ -292,6 +308,8 @@ struct CONFIG* read_config(char* errmsg) {
         strcpy(pcfg.spooler, rec + 8);
       else if (strncmp(rec, "STARTUP=", 8) == 0)
         strcpy(cfg->startup, rec + 8);
+      else if (sscanf(rec, "STRCACHE=%d", &n) == 1)
+        pcfg.strcache = n;
       else if (strncmp(rec, "TEMPDIR=", 8) == 0)
         strcpy(pcfg.tempdir, rec + 8);
       else if (strncmp(rec, "TERMINFO=", 9) == 0)
@@ -379,6 +397,7 @@ struct CONFIG* read_config(char* errmsg) {
       !rangecheck("LPTRWIDE", pcfg.lptrwide, 10, 1000, errmsg) ||
       !rangecheck("MAXCALL", pcfg.maxcall, 10, 1000000, errmsg) ||
       !rangecheck("RECCACHE", pcfg.reccache, 0, 32, errmsg) ||
+      !rangecheck("SEQBUF", pcfg.seqbuf, 2, 65536, errmsg) ||
       !rangecheck("SORTMRG", pcfg.sortmrg, 2, 10, errmsg) ||
       !rangecheck("MAXIDLEN", cfg->maxidlen, 63, MAX_ID_LEN, errmsg)) {
     goto exit_read_config;
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added SEQBUF.
+ *
+ * 18Oct26 gwb Added STRCACHE.
+ *
+ * 18Oct26 gwb Added OPSTATS.
+ *
  * 13Jan22 gwb Minor reformatting.
  * 
  * 27Feb20 gwb Changed integer declarations to be portable across address
@@ -107,16 +113,19 @@ struct PCFG  {
   bool must_lock;                       /* MUSTLOCK: Enforce locking rules */
   int16_t objects;                      /* OBJECTS:  Max loaded objects */
   int32_t objmem;                       /* OBJMEM:   Object size limit, zero = none */
+  bool opstats;                         /* OPSTATS:  Collect opcode statistics */
   int16_t qmclient_mode;                /* QMCLIENT: 0 = any, 1 = no open/exec, 2 = restricted call */
   int16_t reccache;                     /* RECCACHE: Record cache size */
   bool ringwait;                        /* RINGWAIT: Wait if ring buffer full */
   bool safedir;                         /* SAFEDIR:  Use careful update on dir file write */
+  int32_t seqbuf;                       /* SEQBUF:   Sequential file buffer size (kb) */
   char sh[MAX_SH_CMD_LEN+1];            /* SH:       Command to run interactive shell */
   char sh1[MAX_SH_CMD_LEN+1];           /* SH1:      Command to run single shell */
   int32_t sortmem;                      /* SORTMEM: Limit on in-memory sort size */
   int16_t sortmrg;                      /* SORTMRG: Number of files in merge */
   char sortworkdir[MAX_PATHNAME_LEN+1]; /* SORTWORK */
   char spooler[MAX_PATHNAME_LEN+1];     /* SPOOLER: Non-default spooler */
+  int32_t strcache;                     /* STRCACHE: String chunk cache size (kb) */
   char tempdir[MAX_PATHNAME_LEN+1];     /* TEMPDIR */
   char terminfodir[MAX_PATHNAME_LEN+1]; /* TERMINFO */
   bool txchar;                          /* TXCHAR */
@@ -0,0 +1,376 @@
+/* DECIMAL.C
+ * Exact decimal arithmetic.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb dec_int() applies INTPREC.
+ *
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ * A DECIMAL descriptor holds a 64 bit integer and a count of implied
+ * decimal places. Strings such as "12.34" convert to decimals so that
+ * totals of money amounts are exact and convert back to the same text
+ * without passing through a double. Integer arithmetic that overflows
+ * 32 bits also produces a decimal (with no decimal places) in place of
+ * a float.
+ *
+ * The functions below take operands that are INTEGER, FLOATNUM or
+ * DECIMAL. If either is a float, or an exact result would not fit in 64
+ * bits, the result is a FLOATNUM calculated as before.
+ *
+ * dec_set()          Set descriptor to a decimal value, normalising
+ * dec_to_float()     Convert decimal descriptor to FLOATNUM
+ * dec_to_str()       Format decimal value as a string
+ * dec_add()          Add or subtract
+ * dec_mul()          Multiply
+ * dec_div()          Divide
+ * dec_compare()      Compare
+ * dec_int()          Truncate to integer
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "config.h"
+
+#include <math.h>
+#include <stdint.h>
+
+int64 dec_tens[DEC_MAX_SCALE + 1] = {1LL,
+                                     10LL,
+                                     100LL,
+                                     1000LL,
+                                     10000LL,
+                                     100000LL,
+                                     1000000LL,
+                                     10000000LL,
+                                     100000000LL,
+                                     1000000000LL,
+                                     10000000000LL,
+                                     100000000000LL,
+                                     1000000000000LL,
+                                     10000000000000LL,
+                                     100000000000000LL,
+                                     1000000000000000LL,
+                                     10000000000000000LL,
+                                     100000000000000000LL,
+                                     1000000000000000000LL};
+
+Private bool dec_operand(DESCRIPTOR* p, int64* value, int16_t* scale);
+Private double dec_double(DESCRIPTOR* p);
+Private bool dec_rescale(int64* value, int16_t places);
+Private void dec_float_result(DESCRIPTOR* p, double value);
+
+/* ======================================================================
+   dec_set()  -  Set descriptor to decimal value
+   A value with no decimal places that fits in 32 bits becomes an
+   INTEGER. The descriptor flags are preserved.                           */
+
+void dec_set(DESCRIPTOR* p, int64 value, int16_t scale) {
+  if ((scale == 0) && (value >= INT32_MIN) && (value <= INT32_MAX)) {
+    p->type = INTEGER;
+    p->data.value = (int32_t)value;
+  } else {
+    p->type = DECIMAL;
+    p->data.dec.value = value;
+    p->data.dec.scale = scale;
+  }
+}
+
+/* ======================================================================
+   dec_to_float()  -  Convert DECIMAL descriptor to FLOATNUM              */
+
+void dec_to_float(DESCRIPTOR* p) {
+  dec_float_result(p, dec_double(p));
+}
+
+/* ======================================================================
+   dec_to_str()  -  Format decimal value
+   Values with more than the given number of decimal places are rounded,
+   halves away from zero as ftoa() does, and trailing zeros are removed.
+   Returns the string length.                                             */
+
+int16_t dec_to_str(int64 value, int16_t scale, int16_t precision, char* s) {
+  int64 d;
+  int64 r;
+  u_int64 mag;
+  char digits[24];
+  int16_t n;
+  char* q;
+
+  if (scale > precision) {
+    d = dec_tens[scale - precision];
+    r = value % d;
+    value /= d;
+    if (((r < 0) ? -r : r) >= (d + 1) / 2)
+      value += (r < 0) ? -1 : 1;
+    scale = precision;
+  }
+
+  while ((scale > 0) && ((value % 10) == 0)) {
+    value /= 10;
+    scale--;
+  }
+
+  q = s;
+  if (value < 0) {
+    *(q++) = '-';
+    mag = -(u_int64)value;
+  } else {
+    mag = (u_int64)value;
+  }
+
+  n = 0;
+  do {
+    digits[n++] = (char)('0' + (mag % 10));
+    mag /= 10;
+  } while (mag);
+
+  while (n <= scale)
+    digits[n++] = '0'; /* Leading zero before decimal point */
+
+  while (n--) {
+    if (n == scale - 1)
+      *(q++) = '.';
+    *(q++) = digits[n];
+  }
+
+  *q = '\0';
+  return (int16_t)(q - s);
+}
+
+/* ======================================================================
+   dec_add()  -  Add or subtract: arg2 = arg2 + arg1 or arg2 - arg1       */
+
+void dec_add(DESCRIPTOR* arg1, DESCRIPTOR* arg2, bool subtract) {
+  int64 v1;
+  int64 v2;
+  int64 v;
+  int16_t s1;
+  int16_t s2;
+
+  if (dec_operand(arg1, &v1, &s1) && dec_operand(arg2, &v2, &s2)) {
+    if (subtract) {
+      if (v1 == INT64_MIN)
+        goto use_float;
+      v1 = -v1;
+    }
+
+    if (s1 < s2) {
+      if (!dec_rescale(&v1, s2 - s1))
+        goto use_float;
+      s1 = s2;
+    } else if (s2 < s1) {
+      if (!dec_rescale(&v2, s1 - s2))
+        goto use_float;
+    }
+
+    if (__builtin_add_overflow(v1, v2, &v))
+      goto use_float;
+
+    dec_set(arg2, v, s1);
+    return;
+  }
+
+use_float:
+  if (subtract)
+    dec_float_result(arg2, dec_double(arg2) - dec_double(arg1));
+  else
+    dec_float_result(arg2, dec_double(arg2) + dec_double(arg1));
+}
+
+/* ======================================================================
+   dec_mul()  -  Multiply: arg2 = arg2 * arg1                             */
+
+void dec_mul(DESCRIPTOR* arg1, DESCRIPTOR* arg2) {
+  int64 v1;
+  int64 v2;
+  int64 v;
+  int16_t s1;
+  int16_t s2;
+  int16_t scale;
+
+  if (dec_operand(arg1, &v1, &s1) && dec_operand(arg2, &v2, &s2)) {
+    if (__builtin_mul_overflow(v1, v2, &v))
+      goto use_float;
+
+    scale = s1 + s2;
+    while ((scale > DEC_MAX_SCALE) && ((v % 10) == 0)) {
+      v /= 10;
+      scale--;
+    }
+
+    if (scale > DEC_MAX_SCALE)
+      goto use_float;
+
+    dec_set(arg2, v, scale);
+    return;
+  }
+
+use_float:
+  dec_float_result(arg2, dec_double(arg2) * dec_double(arg1));
+}
+
+/* ======================================================================
+   dec_div()  -  Divide: arg2 = arg2 / arg1
+   The caller has already rejected a zero divisor. The quotient is exact
+   if it can be expressed in DEC_MAX_SCALE places, otherwise a float.    */
+
+void dec_div(DESCRIPTOR* arg1, DESCRIPTOR* arg2) {
+  int64 v1;
+  int64 v2;
+  int16_t s1;
+  int16_t s2;
+
+  if (dec_operand(arg1, &v1, &s1) && dec_operand(arg2, &v2, &s2)) {
+    /* (v2 / 10^s2) / (v1 / 10^s1) = (v2 * 10^s1 / v1) / 10^s2 */
+
+    if (!dec_rescale(&v2, s1))
+      goto use_float;
+
+    if (v1 < 0) { /* Keep divisor positive so the division cannot overflow */
+      if ((v1 == INT64_MIN) || (v2 == INT64_MIN))
+        goto use_float;
+      v1 = -v1;
+      v2 = -v2;
+    }
+
+    while (v2 % v1) {
+      if ((s2 == DEC_MAX_SCALE) || !dec_rescale(&v2, 1))
+        goto use_float;
+      s2++;
+    }
+
+    dec_set(arg2, v2 / v1, s2);
+    return;
+  }
+
+use_float:
+  dec_float_result(arg2, dec_double(arg2) / dec_double(arg1));
+}
+
+/* ======================================================================
+   dec_compare()  -  Compare arg1 with arg2
+   Returns -1, 0 or 1. Comparisons involving a float use FLTDIFF.         */
+
+int dec_compare(DESCRIPTOR* arg1, DESCRIPTOR* arg2) {
+  int64 v1;
+  int64 v2;
+  int16_t s1;
+  int16_t s2;
+  double d1;
+  double d2;
+
+  if (dec_operand(arg1, &v1, &s1) && dec_operand(arg2, &v2, &s2)) {
+    if (s1 < s2) {
+      if (!dec_rescale(&v1, s2 - s1))
+        goto use_float;
+    } else if (s2 < s1) {
+      if (!dec_rescale(&v2, s1 - s2))
+        goto use_float;
+    }
+
+    return (v1 > v2) - (v1 < v2);
+  }
+
+use_float:
+  d1 = dec_double(arg1);
+  d2 = dec_double(arg2);
+  if (fabs(d1 - d2) <= pcfg.fltdiff)
+    return 0;
+  return (d1 > d2) ? 1 : -1;
+}
+
+/* ======================================================================
+   dec_int()  -  Truncate DECIMAL descriptor towards zero
+   INTPREC is applied as for a float, adding half a unit in the INTPREC
+   decimal place away from zero before truncating.                        */
+
+void dec_int(DESCRIPTOR* p) {
+  int64 value;
+  int16_t scale;
+  int64 r;
+
+  value = p->data.dec.value;
+  scale = p->data.dec.scale;
+
+  if (pcfg.intprec && (scale >= pcfg.intprec)) {
+    r = 5 * dec_tens[scale - pcfg.intprec];
+    if (value < 0) {
+      if (value >= INT64_MIN + r)
+        value -= r;
+    } else if (value <= INT64_MAX - r) {
+      value += r;
+    }
+  }
+
+  dec_set(p, value / dec_tens[scale], 0);
+}
+
+/* ====================================================================== */
+
+Private bool dec_operand(DESCRIPTOR* p, int64* value, int16_t* scale) {
+  switch (p->type) {
+    case INTEGER:
+      *value = p->data.value;
+      *scale = 0;
+      return TRUE;
+
+    case DECIMAL:
+      *value = p->data.dec.value;
+      *scale = p->data.dec.scale;
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* ====================================================================== */
+
+Private double dec_double(DESCRIPTOR* p) {
+  switch (p->type) {
+    case INTEGER:
+      return (double)(p->data.value);
+
+    case DECIMAL:
+      return ((double)(p->data.dec.value)) / dec_tens[p->data.dec.scale];
+  }
+
+  return p->data.float_value;
+}
+
+/* ====================================================================== */
+
+Private bool dec_rescale(int64* value, int16_t places) {
+  return !__builtin_mul_overflow(*value, dec_tens[places], value);
+}
+
+/* ====================================================================== */
+
+Private void dec_float_result(DESCRIPTOR* p, double value) {
+  p->type = FLOATNUM;
+  p->data.float_value = value;
+}
+
+/* END-CODE */
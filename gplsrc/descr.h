@@ -21,6 +21,14 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Added SNF_LOCATE numeric shadow flag.
+ *
+ * 18Oct26 gwb Added DECIMAL descriptor type.
+ *
+ * 18Oct26 gwb Added numeric shadow to STRING_CHUNK.
+ *
+ * 18Oct26 gwb SQ_FILE buffer size is now variable.
+ *
  * 09Jan22 gwb Changed STRING_CHUNK to be aligned on a 2 byte boundary.
  *
  * 27Feb20 gwb Changed integer declarations to be portable across address
@@ -64,6 +72,14 @@
  *
  * FLOATNUM     A floating point number.
  *
+ * DECIMAL      An exact decimal number.
+ *              A 64 bit integer value with a count of implied decimal places.
+ *              Created when a string holding a decimal number is converted
+ *              for arithmetic and by integer arithmetic that overflows 32 bits.
+ *              Arithmetic on decimals stays exact while the result fits,
+ *              otherwise it falls back to FLOATNUM. VARTYPE() and the
+ *              debugger report these as FLOATNUM.
+ *
  * SUBR         A pointer to a memory resident QMBasic program.
  *              Created by CALL transforming a character string holding the
  *              name of the subroutine.  This string is still available via
@@ -187,6 +203,12 @@ struct DESCRIPTOR {
     /* FLOATNUM */
     double float_value; /* Value */
 
+    /* DECIMAL */
+    struct {
+      int64 value;   /* Value scaled by 10^scale */
+      int16_t scale; /* Decimal places, 0 to DEC_MAX_SCALE */
+    } dec;
+
     /* SUBR */
     struct {
       void* object;
@@ -271,6 +293,10 @@ struct DESCRIPTOR {
 #define OBJCD 16
 #define OBJCDX 17
 #define PERSISTENT 18
+#define DECIMAL 19 /* Has no subordinate data but is numbered here to
+                    * leave the BASIC visible type codes unchanged.   */
+
+#define DEC_MAX_SCALE 18 /* Maximum decimal places in a DECIMAL */
 
 /* When adding new entry, all places that include a comment containing
    ++ALLTYPES++ must be amended.                                       */
@@ -299,6 +325,12 @@ struct STRING_CHUNK {
   int32_t field;      /* Hint field number and... */
   int32_t offset;     /* ...offset. In SELLIST this is item count */
   int16_t ref_ct;     /* Reference count */
+  u_int16_t num_flags; /* Numeric shadow (SNF_xxx) and... */
+  union {
+    int32_t value;
+    double float_value;
+    int64 dec_value;
+  } num;              /* ...value cached by k_str_to_num() */
   char data[1];
 } ALIGN2; /* Making this struct align on a 2 byte boundary cleared up a warning when 
            * a struct of DH_RECORD was being cast to STRING_CHUNK in dh_ak.c, around
@@ -308,6 +340,22 @@ struct STRING_CHUNK {
 #define STRING_CHUNK_HEADER_SIZE (offsetof(STRING_CHUNK, data))
 #define MAX_STRING_CHUNK_SIZE ((signed int)(16384 - STRING_CHUNK_HEADER_SIZE))
 
+/* Numeric shadow flags. These record the outcome of k_str_to_num() and
+   k_is_num() on an unchanged string so that repeated numeric use of the
+   same string does not parse it again. Any in-place update of a string
+   must clear them, usually via ClearHints().                            */
+
+#define SNF_INT 0x0001        /* num.value is the numeric value */
+#define SNF_FLOAT 0x0002      /* num.float_value is the numeric value */
+#define SNF_NOT_NUM 0x0004    /* Not numeric (k_str_to_num() fails) */
+#define SNF_IS_NUM 0x0008     /* k_is_num() is true */
+#define SNF_NOT_IS_NUM 0x0010 /* k_is_num() is false */
+#define SNF_DECIMAL 0x0020    /* num.dec_value is the numeric value... */
+#define SNF_LOCATE 0x0040     /* Has a LOCATE index (op_locat.c) */
+#define SNF_SCALE_SHIFT 8     /* ...with its scale in the top byte */
+
+#define ClearHints(s) ((s)->field = 0, (s)->num_flags = 0)
+
 /* ------------------ File descriptor FILE_REF ------------------ */
 
 typedef struct SQ_FILE SQ_FILE;
@@ -320,7 +368,8 @@ struct SQ_FILE {
   int64 base;        /* Base address of block */
   char* record_name; /* Record id */
   int16_t record_name_len;
-  int16_t bytes;   /* Bytes in buffer */
+  int32_t bytes;     /* Bytes in buffer */
+  int32_t buff_size; /* Buffer size, always a power of two */
   char* pathname;  /* File pathname */
   int32_t timeout; /* Timeout, -ve if none */
   u_int16_t flags;
@@ -567,6 +616,9 @@ struct OBJDATA /* The object itself */
 #define GetNum(d)                                        \
   if (((d)->type != INTEGER) && ((d)->type != FLOATNUM)) \
   k_get_num(d)
+#define DecToFloat(d)         \
+  if ((d)->type == DECIMAL) \
+  dec_to_float(d)
 #define GetString(d)       \
   if ((d)->type != STRING) \
   k_get_string(d)
@@ -21,6 +21,18 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Added FILE_ENTRY updates_pending.
+ *
+ * 18Oct26 gwb Added FILE_ENTRY record_count_exact.
+ *
+ * 18Oct26 gwb Added dh_select_filter().
+ *
+ * 18Oct26 gwb Added FILE_ENTRY hash chain and FileHash().
+ *
+ * 18Oct26 gwb Added dh_import() and dh_export().
+ *
+ * 18Oct26 gwb Added DHF_BULK_LOAD and dh_resize().
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -68,6 +80,8 @@ struct FILE_ENTRY {
                                  transaction). Applies to owner. */
   u_int32_t device;
   u_int32_t inode;
+  int16_t hash_next; /* Next entry on same hash chain, zero at end.
+                                 Protected by FILE_TABLE_LOCK */
   char pathname[MAX_PATHNAME_LEN + 1]; /* Null terminated */
   struct {
     int32_t modulus; /* Current modulus */
@@ -82,6 +96,12 @@ struct FILE_ENTRY {
   } params;
   struct FILESTATS stats;
   int64 record_count; /* Approximate record count. -ve = not set. */
+  bool record_count_exact; /* record_count confirmed by a full select and
+                              maintained since. Protected by
+                              FILE_TABLE_LOCK                           */
+  int16_t updates_pending; /* Writes and deletes that have updated a group
+                              but not yet adjusted record_count. Protected
+                              by FILE_TABLE_LOCK                        */
   u_int16_t flags;    /* File specific flags (from DH file header
                                  or as appropriate for DIR file) */
 };
@@ -90,6 +110,10 @@ struct FILE_ENTRY {
 #define FPtr(n) \
   (((FILE_ENTRY*)(((char*)sysseg) + sysseg->file_table)) + ((n)-1))
 
+/* Head of file table hash chain n (file number, zero if empty) */
+#define FileHash(n) \
+  (((volatile int16_t*)(((char*)sysseg) + sysseg->file_hash)) + (n))
+
 /* ========================== DH_FILE =========================== */
 
 struct SUBFILE_INFO {
@@ -125,6 +149,7 @@ struct DH_FILE {
 #define FILE_UPDATED 0x00080000 /* Written since opened */
 
 #define DHF_FSYNC 0x01000000 /* fsync pending - see txn.c */
+#define DHF_BULK_LOAD 0x02000000 /* No merges by this process */
                              /* File information */
   int16_t open_count;
   int16_t no_of_subfiles;
@@ -177,6 +202,25 @@ Public int16_t dh_err;
 /* ======================================================================
    User callable routines                                                 */
 
+/* DH_BULK.C */
+#define BULK_HEADER 0x0001    /* Import: first line is a header */
+#define BULK_OVERWRITE 0x0002 /* Import: replace existing records */
+bool dh_import(DH_FILE* dh_file,
+               char* path,
+               char delimiter,
+               int16_t* map,
+               int16_t map_cols,
+               int16_t flags,
+               int32_t* written,
+               int32_t* rejected,
+               int32_t* skipped);
+bool dh_export(DH_FILE* dh_file,
+               char* path,
+               char delimiter,
+               int16_t* map,
+               int16_t map_cols,
+               int32_t* written);
+
 /* DH.CLOSE.C */
 bool dh_close(DH_FILE* dh_file);
 
@@ -206,6 +250,15 @@ STRING_CHUNK* dh_read(DH_FILE* dh_file,
                       int16_t id_len,
                       char* actual_id);
 char* dh_read_contiguous(DH_FILE* dh_file, char id[], int16_t id_len);
+typedef struct DH_MULTI_READ DH_MULTI_READ;
+struct DH_MULTI_READ {
+  char* id;
+  int16_t id_len;
+  int32_t group;      /* Used internally */
+  bool found;         /* Returned... */
+  STRING_CHUNK* data; /* ...record, NULL if not found or null */
+};
+bool dh_read_multi(DH_FILE* dh_file, DH_MULTI_READ* req, int16_t n);
 
 /* DH_SELCT.C */
 bool dh_select(DH_FILE* dh_file, int16_t list_no);
@@ -213,10 +266,12 @@ bool dh_select_group(DH_FILE* dh_file, int16_t list_no);
 void dh_complete_select(int16_t list_no);
 void dh_end_select(int16_t list_no);
 void dh_end_select_file(DH_FILE* dh_file);
+bool dh_select_filter(DH_FILE* dh_file, char* spec);
 
 /* DH_SPLIT.C */
 void dh_split(DH_FILE* dh_file);
 void dh_merge(DH_FILE* dh_file);
+bool dh_resize(DH_FILE* dh_file, int32_t new_modulus);
 
 /* DH_WRITE.C */
 bool dh_write(DH_FILE* dh_file, char id[], int16_t id_len, STRING_CHUNK* rec);
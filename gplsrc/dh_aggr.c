@@ -0,0 +1,651 @@
+/* DH_AGGR.C
+ * Breakpoint accumulation for query processor DET.SUPP reports.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Values are converted before they reach op_add() so that no
+ *             error can be raised with the scan state held.
+ *
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ *  dh_aggregate  Accumulate breakpoint and grand totals for a record list
+ *
+ * A report with DET.SUPP shows only its breakpoint lines and grand totals
+ * but the query processor would still build, accumulate and format every
+ * record in BASIC. When the report is simple enough the query processor
+ * passes its list item table and the ordered record list here instead.
+ * The records are read a batch at a time with dh_read_multi() and each
+ * run of records with the same breakpoint value becomes one summary row.
+ * As with BREAK.ON, a new row starts whenever the value changes so the
+ * list order decides the grouping.
+ *
+ * Values are accumulated by the opcodes that the query processor uses
+ * (op_add(), op_gt() and op_lt()) on the same strings, and breakpoint
+ * values are converted to strings after each step as they are when held
+ * in a dynamic array, so the results are identical. Nothing here may
+ * raise an error as the buffers and target string would be left behind,
+ * so totals are converted to numbers before they are passed to op_add()
+ * and the relational opcodes only ever see strings and numbers.
+ *
+ * The specification is
+ *    F1  List item index of the breakpoint field, zero if none
+ *    F2  Flags: 1 = accumulating, 2 = ABSENT.NULL
+ *    F3  List items, multivalued: type SM detail SM mode SM multivalued
+ *        Type is 1 (id), 2 (field) or 4 (literal) and mode is the report
+ *        mode, both as in the query processor.
+ *    F4 onwards  Record ids
+ *
+ * The result is
+ *    F1  Number of records
+ *    F2  Grand totals, multivalued by list item: value SM count
+ *    F3 onwards  One field per breakpoint:
+ *        breakpoint value VM value SM count VM value SM count...
+ *
+ * A null string is returned if the report must be processed by the query
+ * processor: an unsupported item or mode, a missing record, a float total,
+ * a value that contains marks or a total that cannot be converted.
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "dh_int.h"
+
+void op_add(void);
+void op_gt(void);
+void op_lt(void);
+
+#define AGG_BATCH 256 /* Records per dh_read_multi() call */
+
+/* Item types, as in the query processor */
+
+#define AGG_ID 1
+#define AGG_FIELD 2
+#define AGG_LITERAL 4
+
+/* Report modes, as in the query processor */
+
+#define AGG_MODE_MASK 15
+#define AGG_NO_NULLS 16
+#define AGG_ITEMS 0
+#define AGG_TOTAL 1
+#define AGG_MAX 2
+#define AGG_MIN 3
+#define AGG_AVERAGE 4
+#define AGG_NUMBER 5
+#define AGG_BREAK_SUP 8
+
+/* Specification flags */
+
+#define AGG_ACCUMULATE 0x0001
+#define AGG_ABSENT_NULL 0x0002
+
+typedef struct {
+  int16_t type;
+  int32_t field;
+  int16_t mode;
+  bool no_nulls;
+  bool mv;
+  DESCRIPTOR total; /* Grand total, as ITEM.ACCUM.VALUE */
+  int32_t count;    /* As ITEM.COUNT */
+  DESCRIPTOR local; /* Breakpoint total, always a string */
+  int32_t local_count;
+} AGG_ITEM;
+
+Private AGG_ITEM* agg_items;
+Private int16_t agg_num_items;
+
+Private void agg_item_value(AGG_ITEM* item,
+                            char* id,
+                            int16_t id_len,
+                            char* rec,
+                            int32_t rec_len,
+                            char** s,
+                            int32_t* len);
+Private bool agg_accumulate(AGG_ITEM* item, char* z, int32_t len);
+Private void agg_add(DESCRIPTOR* acc, DESCRIPTOR* z);
+Private bool agg_test(DESCRIPTOR* a, DESCRIPTOR* b, void (*op)(void));
+Private void agg_assign(DESCRIPTOR* tgt, DESCRIPTOR* src);
+Private bool agg_emit(DESCRIPTOR* descr);
+Private void agg_reset_local(AGG_ITEM* item);
+
+/* ====================================================================== */
+
+bool dh_aggregate(DH_FILE* dh_file,
+                  char* spec,
+                  int32_t spec_len,
+                  DESCRIPTOR* result) {
+  bool status = FALSE;
+  char* end;
+  char* fields[3];
+  char* p;
+  char* q;
+  int16_t i;
+  int16_t j;
+  int16_t break_item;
+  int16_t flags;
+  bool need_record = FALSE;
+  DH_MULTI_READ* reqs = NULL;
+  int16_t num_reqs = 0;
+  STRING_CHUNK* str;
+  STRING_CHUNK* rows = NULL;
+  char* rec = NULL;
+  int32_t rec_size = 0;
+  int32_t rec_len;
+  char* brk = NULL;
+  int32_t brk_size = 0;
+  int32_t brk_len = 0;
+  char* s;
+  int32_t len;
+  int32_t num_records = 0;
+  AGG_ITEM* item;
+  DESCRIPTOR descr;
+  char n[16];
+
+  agg_items = NULL;
+  agg_num_items = 0;
+  end = spec + spec_len;
+
+  /* Split off the three leading fields. The remainder is the id list. */
+
+  p = spec;
+  for (i = 0; i < 3; i++) {
+    if ((q = memchr(p, FIELD_MARK, end - p)) == NULL)
+      return FALSE;
+    *q = '\0';
+    fields[i] = p;
+    p = q + 1;
+  }
+
+  break_item = (int16_t)atoi(fields[0]);
+  flags = (int16_t)atoi(fields[1]);
+
+  /* Unpack the list item table */
+
+  agg_num_items = 1;
+  for (q = fields[2]; (q = strchr(q, VALUE_MARK)) != NULL; q++)
+    agg_num_items++;
+  if ((break_item < 0) || (break_item > agg_num_items))
+    return FALSE;
+
+  agg_items = (AGG_ITEM*)k_alloc(152, agg_num_items * sizeof(AGG_ITEM));
+  if (agg_items == NULL)
+    return FALSE;
+
+  for (i = 0; i < agg_num_items; i++) {
+    item = agg_items + i;
+    InitDescr(&(item->total), INTEGER);
+    item->total.data.value = 0;
+    item->count = 0;
+    InitDescr(&(item->local), INTEGER);
+    agg_reset_local(item);
+  }
+
+  for (i = 0, q = fields[2]; i < agg_num_items; i++) {
+    item = agg_items + i;
+    item->type = (int16_t)atoi(q);
+    q = strchr(q, SUBVALUE_MARK);
+    item->field = (q == NULL) ? 0 : atol(++q);
+    q = (q == NULL) ? NULL : strchr(q, SUBVALUE_MARK);
+    item->mode = (q == NULL) ? -1 : (int16_t)atoi(++q);
+    q = (q == NULL) ? NULL : strchr(q, SUBVALUE_MARK);
+    item->mv = (q != NULL) && (atoi(++q) != 0);
+
+    item->no_nulls = (item->mode & AGG_NO_NULLS) != 0;
+    item->mode &= AGG_MODE_MASK;
+
+    if (q == NULL)
+      goto exit_dh_aggregate;
+
+    switch (item->type) {
+      case AGG_ID:
+        need_record = TRUE;
+        break;
+
+      case AGG_FIELD:
+        if (item->field < 1)
+          goto exit_dh_aggregate;
+        need_record = TRUE;
+        break;
+
+      case AGG_LITERAL: /* Counted but never accumulated */
+        if (item->mv || item->no_nulls || (i + 1 == break_item) ||
+            ((item->mode != AGG_ITEMS) && (item->mode != AGG_BREAK_SUP))) {
+          goto exit_dh_aggregate;
+        }
+        break;
+
+      default:
+        goto exit_dh_aggregate;
+    }
+
+    switch (item->mode) {
+      case AGG_ITEMS:
+      case AGG_TOTAL:
+      case AGG_MAX:
+      case AGG_MIN:
+      case AGG_AVERAGE:
+      case AGG_NUMBER:
+      case AGG_BREAK_SUP:
+        break;
+
+      default:
+        goto exit_dh_aggregate;
+    }
+
+    q = strchr(q, VALUE_MARK);
+    if (q != NULL)
+      q++;
+  }
+
+  reqs = (DH_MULTI_READ*)k_alloc(153, AGG_BATCH * sizeof(DH_MULTI_READ));
+  if (reqs == NULL)
+    goto exit_dh_aggregate;
+
+  ts_init(&rows, 1024);
+
+  while (p < end) {
+    /* Collect the next batch of ids */
+
+    num_reqs = 0;
+    while ((p < end) && (num_reqs < AGG_BATCH)) {
+      if ((q = memchr(p, FIELD_MARK, end - p)) == NULL)
+        q = end;
+      if ((q == p) || (q - p > sysseg->maxidlen) ||
+          (find_mark(p, q - p) != NULL) || (memchr(p, '\0', q - p) != NULL)) {
+        goto exit_dh_aggregate_batch; /* Let the query processor decide */
+      }
+      reqs[num_reqs].id = p;
+      reqs[num_reqs].id_len = (int16_t)(q - p);
+      reqs[num_reqs].data = NULL;
+      reqs[num_reqs].found = TRUE;
+      num_reqs++;
+      p = q + 1;
+    }
+
+    if (need_record && !dh_read_multi(dh_file, reqs, num_reqs)) {
+      num_reqs = 0;
+      goto exit_dh_aggregate_batch;
+    }
+
+    for (j = 0; j < num_reqs; j++) {
+      if (!reqs[j].found && !(flags & AGG_ABSENT_NULL))
+        goto exit_dh_aggregate_batch;
+
+      /* Make a contiguous copy of the record */
+
+      rec_len = 0;
+      if ((str = reqs[j].data) != NULL) {
+        if (str->string_len > rec_size) {
+          if (rec != NULL)
+            k_free(rec);
+          rec_size = str->string_len;
+          rec = (char*)k_alloc(154, rec_size);
+          if (rec == NULL)
+            goto exit_dh_aggregate_batch;
+        }
+
+        do {
+          memcpy(rec + rec_len, str->data, str->bytes);
+          rec_len += str->bytes;
+        } while ((str = str->next) != NULL);
+
+        s_free(reqs[j].data);
+        reqs[j].data = NULL;
+      }
+
+      /* Check for a change of breakpoint value. As in the query processor,
+         the row for the previous value is produced before accumulating. */
+
+      if (break_item) {
+        agg_item_value(agg_items + break_item - 1, reqs[j].id, reqs[j].id_len,
+                       rec, rec_len, &s, &len);
+        if (find_mark(s, len) != NULL)
+          goto exit_dh_aggregate_batch;
+
+        if ((num_records == 0) || (len != brk_len) ||
+            (len && memcmp(s, brk, len))) {
+          if (num_records) {
+            ts_copy(brk, brk_len);
+            for (i = 0; i < agg_num_items; i++) {
+              item = agg_items + i;
+              ts_copy_byte(VALUE_MARK);
+              if (!agg_emit(&(item->local)))
+                goto exit_dh_aggregate_batch;
+              ts_printf("%c%d", SUBVALUE_MARK, item->local_count);
+              agg_reset_local(item);
+            }
+            ts_copy_byte(FIELD_MARK);
+          }
+
+          if (len > brk_size) {
+            if (brk != NULL)
+              k_free(brk);
+            brk_size = len;
+            brk = (char*)k_alloc(155, brk_size);
+            if (brk == NULL)
+              goto exit_dh_aggregate_batch;
+          }
+          memcpy(brk, s, len);
+          brk_len = len;
+        }
+      }
+
+      num_records++;
+
+      if (flags & AGG_ACCUMULATE) {
+        for (i = 0; i < agg_num_items; i++) {
+          item = agg_items + i;
+          if (item->type == AGG_LITERAL) {
+            item->count++;
+            item->local_count++;
+          } else {
+            agg_item_value(item, reqs[j].id, reqs[j].id_len, rec, rec_len, &s,
+                           &len);
+            if (!agg_accumulate(item, s, len))
+              goto exit_dh_aggregate_batch;
+          }
+        }
+      }
+    }
+  }
+
+  /* Row for the final breakpoint */
+
+  if (break_item && num_records) {
+    ts_copy(brk, brk_len);
+    for (i = 0; i < agg_num_items; i++) {
+      item = agg_items + i;
+      ts_copy_byte(VALUE_MARK);
+      if (!agg_emit(&(item->local)))
+        goto exit_dh_aggregate_batch;
+      ts_printf("%c%d", SUBVALUE_MARK, item->local_count);
+    }
+  }
+  (void)ts_terminate();
+
+  /* Build the leading fields and attach the breakpoint rows */
+
+  ts_init(&(result->data.str.saddr), 256);
+  sprintf(n, "%d", num_records);
+  ts_copy_c_string(n);
+  ts_copy_byte(FIELD_MARK);
+  for (i = 0; i < agg_num_items; i++) {
+    item = agg_items + i;
+    if (i)
+      ts_copy_byte(VALUE_MARK);
+
+    /* The query processor keeps grand totals as numbers. Only pass back
+       values that survive conversion to a string and back unchanged.   */
+
+    descr = item->total;
+    if ((descr.type == FLOATNUM) ||
+        ((descr.type == DECIMAL) &&
+         (descr.data.dec.scale > process.program.precision))) {
+      (void)ts_terminate();
+      goto exit_dh_aggregate_result;
+    }
+    IncrRefCt(&descr);
+    k_get_string(&descr);
+    status = agg_emit(&descr);
+    Release(&descr);
+    if (!status) {
+      (void)ts_terminate();
+      goto exit_dh_aggregate_result;
+    }
+    ts_printf("%c%d", SUBVALUE_MARK, item->count);
+  }
+  if (rows != NULL)
+    ts_copy_byte(FIELD_MARK);
+  (void)ts_terminate();
+
+  if ((str = result->data.str.saddr) != NULL) {
+    if (rows != NULL) {
+      str->string_len += rows->string_len;
+      while (str->next != NULL)
+        str = str->next;
+      str->next = rows;
+      rows = NULL;
+    }
+  }
+
+  status = TRUE;
+  goto exit_dh_aggregate;
+
+exit_dh_aggregate_batch:
+  (void)ts_terminate();
+  for (j = 0; j < num_reqs; j++) {
+    if (reqs[j].data != NULL)
+      s_free(reqs[j].data);
+  }
+  goto exit_dh_aggregate;
+
+exit_dh_aggregate_result:
+  status = FALSE;
+  if (result->data.str.saddr != NULL) {
+    s_free(result->data.str.saddr);
+    result->data.str.saddr = NULL;
+  }
+
+exit_dh_aggregate:
+  if (rows != NULL)
+    s_free(rows);
+  if (rec != NULL)
+    k_free(rec);
+  if (brk != NULL)
+    k_free(brk);
+  if (reqs != NULL)
+    k_free(reqs);
+
+  for (i = 0; i < agg_num_items; i++) {
+    Release(&(agg_items[i].total));
+    Release(&(agg_items[i].local));
+  }
+  if (agg_items != NULL)
+    k_free(agg_items);
+
+  return status;
+}
+
+/* ======================================================================
+   agg_item_value()  -  Find value of item in record                      */
+
+Private void agg_item_value(AGG_ITEM* item,
+                            char* id,
+                            int16_t id_len,
+                            char* rec,
+                            int32_t rec_len,
+                            char** s,
+                            int32_t* len) {
+  char* p;
+  char* q;
+  char* end;
+  int32_t f;
+
+  if (rec_len == 0) {
+    rec = "";
+  }
+
+  if (item->type == AGG_ID) {
+    *s = id;
+    *len = id_len;
+    return;
+  }
+
+  *s = "";
+  *len = 0;
+
+  p = rec;
+  end = rec + rec_len;
+  for (f = 1; f < item->field; f++) {
+    if ((p = memchr(p, FIELD_MARK, end - p)) == NULL)
+      return;
+    p++;
+  }
+
+  if ((q = memchr(p, FIELD_MARK, end - p)) == NULL)
+    q = end;
+
+  *s = p;
+  *len = q - p;
+}
+
+/* ======================================================================
+   agg_accumulate()  -  Accumulate one item from one record
+   Multivalued items are split at every mark, as REMOVE does. Returns
+   FALSE if a value that NUM() accepts cannot be converted for addition. */
+
+Private bool agg_accumulate(AGG_ITEM* item, char* s, int32_t len) {
+  DESCRIPTOR z;
+  char* q;
+
+  InitDescr(&z, STRING);
+  z.data.str.saddr = NULL;
+
+  do {
+    if (item->mv)
+      q = find_mark(s, len);
+    else
+      q = NULL;
+
+    if (item->mode != AGG_ITEMS) {
+      if (item->no_nulls && (((q == NULL) ? len : (q - s)) == 0))
+        goto next_value;
+
+      Release(&z);
+      k_put_string(s, (q == NULL) ? len : (q - s), &z);
+
+      switch (item->mode) {
+        case AGG_TOTAL:
+        case AGG_AVERAGE:
+          if (k_is_num(&z)) {
+            if (!k_str_to_num(&z)) {
+              Release(&z);
+              return FALSE;
+            }
+            agg_add(&(item->total), &z);
+            agg_add(&(item->local), &z);
+            k_get_string(&(item->local));
+          }
+          break;
+
+        case AGG_MAX:
+          if (agg_test(&z, &(item->total), op_gt))
+            agg_assign(&(item->total), &z);
+          if (agg_test(&z, &(item->local), op_gt))
+            agg_assign(&(item->local), &z);
+          break;
+
+        case AGG_MIN:
+          if ((item->count == 0) || agg_test(&z, &(item->total), op_lt)) {
+            agg_assign(&(item->total), &z);
+          }
+          if ((item->local_count == 0) || agg_test(&z, &(item->local), op_lt)) {
+            agg_assign(&(item->local), &z);
+          }
+          break;
+      }
+    }
+
+    item->count++;
+    item->local_count++;
+
+  next_value:
+    if (q != NULL) {
+      len -= (q - s) + 1;
+      s = q + 1;
+    }
+  } while (q != NULL);
+
+  Release(&z);
+  return TRUE;
+}
+
+/* ======================================================================
+   agg_add()  -  Add z to accumulator                                     */
+
+Private void agg_add(DESCRIPTOR* acc, DESCRIPTOR* z) {
+  *e_stack = *acc;
+  IncrRefCt(e_stack);
+  e_stack++;
+  *e_stack = *z;
+  IncrRefCt(e_stack);
+  e_stack++;
+  op_add();
+
+  Release(acc);
+  *acc = *(--e_stack);
+}
+
+/* ======================================================================
+   agg_test()  -  Apply relational operator to a and b                    */
+
+Private bool agg_test(DESCRIPTOR* a, DESCRIPTOR* b, void (*op)(void)) {
+  *e_stack = *a;
+  IncrRefCt(e_stack);
+  e_stack++;
+  *e_stack = *b;
+  IncrRefCt(e_stack);
+  e_stack++;
+  op();
+
+  return (--e_stack)->data.value != 0;
+}
+
+/* ====================================================================== */
+
+Private void agg_assign(DESCRIPTOR* tgt, DESCRIPTOR* src) {
+  Release(tgt);
+  *tgt = *src;
+  IncrRefCt(tgt);
+}
+
+/* ======================================================================
+   agg_emit()  -  Copy string to result. Fails if it contains marks.      */
+
+Private bool agg_emit(DESCRIPTOR* descr) {
+  STRING_CHUNK* str;
+
+  for (str = descr->data.str.saddr; str != NULL; str = str->next) {
+    if (find_mark(str->data, str->bytes) != NULL)
+      return FALSE;
+  }
+
+  for (str = descr->data.str.saddr; str != NULL; str = str->next) {
+    ts_copy(str->data, str->bytes);
+  }
+
+  return TRUE;
+}
+
+/* ======================================================================
+   agg_reset_local()  -  Start new breakpoint                             */
+
+Private void agg_reset_local(AGG_ITEM* item) {
+  Release(&(item->local));
+  k_put_c_string("0", &(item->local));
+  item->local_count = 0;
+}
+
+/* END-CODE */
@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (Scarlet DME):
+ * 19Oct26 gwb ak_key_counts() now locks the AK one terminal node at a time.
+ *
+ * 18Oct26 gwb Added ak_key_counts() for index-only queries.
+ *
  * 03Sep25 gwb Fix for potential buffer overrun due to an insufficiently sized sprintf() target.
  *             git issue #82
  * 06Feb22 gwb Fixed an uninitialized variable warning in ak_read().
@@ -3793,6 +3797,223 @@ exit_ak_clear:
   return status;
 }
 
+/* ======================================================================
+   ak_key_counts()  -  Return each key of an AK with its record count
+
+   The keys are returned in index order as
+      key VM count FM key VM count...
+   without reading the data records. Returns FALSE if the index cannot be
+   used for this: unknown or disabled index, case insensitive or collated
+   keys, or a key that contains marks or may have been truncated.         */
+
+bool ak_key_counts(DH_FILE *dh_file, DESCRIPTOR *name_descr, DESCRIPTOR *result) {
+  bool status = FALSE;
+  int16_t akno;
+  int16_t subfile;
+  int16_t lock_slot = 0;
+  u_int16_t flags;
+  char *buff = NULL;
+  DH_BIG_NODE *big_buff = NULL;
+  int32_t node_num;
+  int32_t big_node;
+  int16_t used_bytes;
+  int16_t rec_offset;
+  DH_RECORD *rec_ptr;
+  char *p;
+  int32_t data_len;
+  int32_t n;
+  int32_t count;
+  int32_t num_keys = 0;
+  DESCRIPTOR *descr;
+  char s[16];
+  FILE_ENTRY *fptr;
+  bool rj;
+  bool started = FALSE;  /* Have processed at least one key? */
+  u_int32_t upd = 0;     /* File's ak_upd when lock was released, zero on first pass */
+  char last_key[MAX_KEY_LEN];
+  int16_t last_key_len = 0;
+  int16_t child_ct;
+  int16_t ci;
+  char *key;
+  int16_t key_len;
+
+  if ((akno = find_ak_by_name(name_descr, dh_file)) < 0)
+    return FALSE;
+
+  flags = (u_int16_t)(AKData(dh_file, akno, AKD_FLGS)->data.value);
+  if (!(flags & AK_ENABLED) || (flags & AK_NOCASE))
+    return FALSE;
+
+  descr = AKData(dh_file, akno, AKD_MAPNAME);
+  if ((descr->data.str.saddr != NULL) && (descr->data.str.saddr->string_len != 0)) {
+    return FALSE;
+  }
+
+  subfile = AK_BASE_SUBFILE + akno;
+
+  buff = (char *)k_alloc(156, DH_AK_NODE_SIZE);
+  big_buff = (DH_BIG_NODE *)k_alloc(157, DH_AK_NODE_SIZE);
+  if ((buff == NULL) || (big_buff == NULL))
+    goto exit_ak_key_counts;
+
+  fptr = FPtr(dh_file->file_id);
+  rj = (flags & AK_RIGHT) != 0;
+
+  ts_init(&(result->data.str.saddr), DH_AK_NODE_SIZE);
+
+  /* Walk down to the leftmost terminal node and then follow the chain to
+     the right as op_selindx() does. Each AK record holds the field mark
+     delimited list of ids for one key so we need only count the marks.
+
+     The AK is locked for one terminal node at a time so that a large
+     index does not hold up updates. If the AK has been updated while it
+     was unlocked, the node we were about to read may have been split or
+     released so, as akscan() does, we search again from the root for the
+     first key beyond the last one processed.                             */
+
+  do {
+    lock_slot = GetGroupReadLock(dh_file, AKGlock(akno));
+
+    rec_offset = TERM_NODE_HEADER_SIZE;
+    if ((upd != 0) && (fptr->ak_upd == upd)) {
+      if (!dh_read_group(dh_file, subfile, node_num, buff, DH_AK_NODE_SIZE)) {
+        goto exit_ak_key_counts_ts;
+      }
+    } else {
+      node_num = 1;
+      do {
+        if (!dh_read_group(dh_file, subfile, node_num, buff, DH_AK_NODE_SIZE)) {
+          goto exit_ak_key_counts_ts;
+        }
+        if (((DH_INT_NODE *)buff)->node_type == AK_TERM_NODE)
+          break;
+
+        /* Descend into the first child that may hold a key greater than
+           the last one processed.                                       */
+
+        ci = 0;
+        if (started) {
+          child_ct = ((DH_INT_NODE *)buff)->child_count;
+          for (key = (char *)(((DH_INT_NODE *)buff)->keys); ci < child_ct - 1; ci++, key += key_len) {
+            key_len = ((DH_INT_NODE *)buff)->key_len[ci];
+            if (compare(last_key, last_key_len, key, key_len, rj, FALSE) < 0)
+              break;
+          }
+        }
+        node_num = GetAKFwdLink(dh_file, ((DH_INT_NODE *)buff)->child[ci]);
+      } while (1);
+
+      if (started) {
+        /* Skip keys already processed */
+
+        do {
+          used_bytes = ((DH_TERM_NODE *)buff)->used_bytes;
+          while (rec_offset < used_bytes) {
+            rec_ptr = (DH_RECORD *)(buff + rec_offset);
+            if (compare(last_key, last_key_len, rec_ptr->id, rec_ptr->id_len, rj, FALSE) < 0)
+              break;
+            rec_offset += rec_ptr->next;
+          }
+          if (rec_offset < used_bytes)
+            break;
+
+          node_num = GetAKFwdLink(dh_file, ((DH_TERM_NODE *)buff)->right);
+          if (node_num == 0)
+            break;
+
+          if (!dh_read_group(dh_file, subfile, node_num, buff, DH_AK_NODE_SIZE)) {
+            goto exit_ak_key_counts_ts;
+          }
+          rec_offset = TERM_NODE_HEADER_SIZE;
+        } while (1);
+      }
+    }
+
+    used_bytes = ((DH_TERM_NODE *)buff)->used_bytes;
+    while (rec_offset < used_bytes) {
+      rec_ptr = (DH_RECORD *)(buff + rec_offset);
+      if ((rec_ptr->id_len >= MAX_KEY_LEN) ||
+          (find_mark(rec_ptr->id, rec_ptr->id_len) != NULL)) {
+        goto exit_ak_key_counts_ts;
+      }
+
+      count = 0;
+      if (rec_ptr->flags & DH_BIG_REC) {
+        big_node = GetAKFwdLink(dh_file, rec_ptr->data.big_rec);
+        data_len = -1;
+        while (big_node != 0) {
+          if (!dh_read_group(dh_file, subfile, big_node, (char *)big_buff, DH_AK_NODE_SIZE)) {
+            goto exit_ak_key_counts_ts;
+          }
+
+          if (data_len < 0) {
+            data_len = big_buff->data_len;
+            if (data_len)
+              count = 1;
+          }
+
+          n = min(DH_AK_NODE_SIZE - DH_AK_BIG_NODE_SIZE, data_len);
+          for (p = big_buff->data; (p = memchr(p, FIELD_MARK, big_buff->data + n - p)) != NULL; p++) {
+            count++;
+          }
+          data_len -= n;
+
+          big_node = GetAKFwdLink(dh_file, big_buff->next);
+        }
+      } else if ((data_len = rec_ptr->data.data_len) != 0) {
+        count = 1;
+        p = rec_ptr->id + rec_ptr->id_len;
+        n = data_len;
+        while ((p = memchr(p, FIELD_MARK, rec_ptr->id + rec_ptr->id_len + n - p)) != NULL) {
+          count++;
+          p++;
+        }
+      }
+
+      if (count) {
+        if (num_keys++)
+          ts_copy_byte(FIELD_MARK);
+        ts_copy(rec_ptr->id, rec_ptr->id_len);
+        sprintf(s, "%c%d", VALUE_MARK, count);
+        ts_copy_c_string(s);
+      }
+
+      memcpy(last_key, rec_ptr->id, rec_ptr->id_len);
+      last_key_len = rec_ptr->id_len;
+      started = TRUE;
+
+      rec_offset += rec_ptr->next;
+    }
+
+    node_num = GetAKFwdLink(dh_file, ((DH_TERM_NODE *)buff)->right);
+    upd = fptr->ak_upd;
+
+    FreeGroupReadLock(lock_slot);
+    lock_slot = 0;
+  } while (node_num != 0);
+
+  status = TRUE;
+
+exit_ak_key_counts_ts:
+  (void)ts_terminate();
+  if (!status && (result->data.str.saddr != NULL)) {
+    s_free(result->data.str.saddr);
+    result->data.str.saddr = NULL;
+  }
+
+exit_ak_key_counts:
+  if (lock_slot != 0)
+    FreeGroupReadLock(lock_slot);
+
+  if (buff != NULL)
+    k_free(buff);
+
+  if (big_buff != NULL)
+    k_free(big_buff);
+
+  return status;
+}
+
 /* ======================================================================
    find_ak_by_name()  -  Find AK number from its name
    Returns -1 if no such AK                                               */
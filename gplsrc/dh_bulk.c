@@ -0,0 +1,1205 @@
+/* DH_BULK.C
+ * Bulk import and export of delimited text.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb dh_import() waits for a clearfile in progress. Records left
+ *             to dh_write() are no longer counted twice in the write stats.
+ *
+ * 19Oct26 gwb write_group() counts itself in updates_pending until the
+ *             record count has been adjusted.
+ *
+ * 19Oct26 gwb write_group() could overrun the chain buffer when records
+ *             left much of each block unused. Records that do not fit
+ *             are now left to dh_write(). Do not presize a file that has
+ *             resizing disabled.
+ *
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ *  dh_import          Load records from a CSV or other delimited file
+ *  dh_export          Write all records of a file as CSV
+ *
+ * Files follow RFC 4180. Fields may be enclosed in double quotes, in
+ * which case they may contain the delimiter, newlines and doubled quotes.
+ * A trailing carriage return on a line is ignored.
+ *
+ * The column map has one entry per column. Zero marks the record id, a
+ * positive value is a field number and a negative value skips the column
+ * on import. Without a map, the first column is the id and the remaining
+ * columns are fields 1 onwards. On export, the map lists the columns to
+ * write in the same notation.
+ *
+ * The import maps the source file into memory and collects records into
+ * large batches sorted by group. Each group then takes one write lock and
+ * one read and write of its blocks for all of its records in the batch.
+ * The target file is presized from the size of the source file and held
+ * in bulk load mode for the duration. Files with alternate key indices
+ * are written record by record through dh_write().
+ *
+ * The export walks the groups in order under a group read lock and
+ * formats each record straight from the group buffer.
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "dh_int.h"
+
+#include <sys/mman.h>
+
+/* An import batch should span many records per group for the group
+   ordering to pay off. The arena pages are only touched as it fills.  */
+
+#define BULK_ARENA_SIZE (64 * 1048576) /* Import batch data area */
+#define BULK_BATCH_RECORDS 1048576     /* Max records per import batch */
+#define BULK_OUT_SIZE 1048576          /* Export output buffer */
+#define BULK_SCAN_WINDOW 0x40000000    /* Max bytes per find_byte2() call */
+#define BULK_MAX_CHAIN 32              /* Max group chain held in memory */
+
+
+typedef struct BULK_SPAN BULK_SPAN;
+struct BULK_SPAN {
+  char* p;     /* Start of column text... */
+  int64 len;   /* ...and length, including any doubled quotes */
+  bool quoted; /* Contains doubled quotes */
+};
+
+typedef struct BULK_REC BULK_REC;
+struct BULK_REC {
+  int32_t group;  /* Group when parsed, used only for ordering */
+  int32_t offset; /* Offset of id in arena, data follows */
+  int32_t data_len;
+  int16_t id_len;
+};
+
+typedef struct BULK_OUT BULK_OUT;
+struct BULK_OUT {
+  int fu;
+  char* buff;
+  char* p; /* Next free byte */
+  char* end;
+};
+
+Private BULK_SPAN* spans = NULL;
+Private int32_t max_spans = 0;
+Private char* chain = NULL; /* Group chain buffers for import */
+
+Private char* scan_field(char* p, char* end, char delimiter);
+Private char* parse_line(char* p, char* end, char delimiter, int32_t* cols);
+Private int64 dequote(char* tgt, BULK_SPAN* span);
+Private int cmp_rec(const void* a, const void* b);
+Private bool flush_batch(DH_FILE* dh_file,
+                         char* arena,
+                         BULK_REC* recs,
+                         int32_t num_recs,
+                         int16_t flags,
+                         int32_t* written,
+                         int32_t* skipped);
+Private bool write_group(DH_FILE* dh_file,
+                         char* arena,
+                         BULK_REC* recs,
+                         int32_t num_recs,
+                         int16_t flags,
+                         int32_t* written,
+                         int32_t* skipped);
+Private bool write_one(DH_FILE* dh_file,
+                       char* arena,
+                       BULK_REC* rec,
+                       int16_t flags,
+                       int32_t* written,
+                       int32_t* skipped);
+Private bool bulk_break(void);
+Private bool put_field(BULK_OUT* out, char* p, int32_t len, char delimiter);
+Private bool out_bytes(BULK_OUT* out, char* p, int32_t n);
+Private bool out_byte(BULK_OUT* out, char c);
+Private bool out_flush(BULK_OUT* out);
+
+/* ======================================================================
+   dh_import()  -  Load delimited text into a file                        */
+
+bool dh_import(DH_FILE* dh_file,
+               char* path, /* Source file */
+               char delimiter,
+               int16_t* map, /* Column map, may be NULL */
+               int16_t map_cols,
+               int16_t flags, /* BULK_xxx */
+               int32_t* written,
+               int32_t* rejected,
+               int32_t* skipped) {
+  bool status = FALSE;
+  FILE_ENTRY* fptr;
+  int fu = -1;
+  struct stat st;
+  char* base = MAP_FAILED;
+  char* end;
+  char* p;
+  char* q;
+  int64 n;
+  int64 rows;
+  int64 load;
+  int32_t modulus;
+  bool bulk_load = FALSE;
+  int32_t id_col;
+  int32_t nf;
+  int32_t* field_col = NULL;
+  int32_t i;
+  int32_t f;
+  int32_t cols;
+  int64 reqd;
+  char* arena = NULL;
+  int32_t arena_size = BULK_ARENA_SIZE;
+  int32_t arena_used = 0;
+  BULK_REC* recs = NULL;
+  BULK_REC* rec;
+  int32_t num_recs = 0;
+  char* tgt;
+  char* id;
+  int64 id_len;
+  char id_buff[2 * MAX_ID_LEN + 1];
+
+  dh_err = 0;
+  process.os_error = 0;
+  *written = 0;
+  *rejected = 0;
+  *skipped = 0;
+
+  fptr = FPtr(dh_file->file_id);
+
+  while (fptr->file_lock < 0)
+    Sleep(1000); /* Clearfile in progress */
+
+  fu = open(path, O_RDONLY | O_BINARY);
+  if (fu < 0) {
+    dh_err = ER_NOT_FOUND;
+    process.os_error = errno;
+    goto exit_dh_import;
+  }
+
+  if (fstat(fu, &st) != 0) {
+    dh_err = DHE_STAT_ERR;
+    process.os_error = errno;
+    goto exit_dh_import;
+  }
+
+  if (st.st_size == 0) {
+    status = TRUE;
+    goto exit_dh_import;
+  }
+
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fu, 0);
+  if (base == MAP_FAILED) {
+    dh_err = ER_FAILED;
+    process.os_error = errno;
+    goto exit_dh_import;
+  }
+  madvise(base, st.st_size, MADV_SEQUENTIAL);
+  end = base + st.st_size;
+
+  /* Work out which column feeds each field */
+
+  id_col = 0;
+  nf = 0;
+  if (map != NULL) {
+    for (i = 0; i < map_cols; i++) {
+      if (map[i] > nf)
+        nf = map[i];
+    }
+
+    field_col = (int32_t*)k_alloc(131, (nf + 1) * sizeof(int32_t));
+    if (field_col == NULL) {
+      dh_err = ER_MEM;
+      goto exit_dh_import;
+    }
+
+    for (f = 0; f <= nf; f++)
+      field_col[f] = -1;
+    for (i = 0; i < map_cols; i++) {
+      if (map[i] >= 0)
+        field_col[map[i]] = i;
+    }
+
+    id_col = field_col[0];
+    if (id_col < 0) {
+      dh_err = ER_PARAMS;
+      goto exit_dh_import;
+    }
+  }
+
+  arena = (char*)k_alloc(132, arena_size);
+  recs = (BULK_REC*)k_alloc(133, BULK_BATCH_RECORDS * sizeof(BULK_REC));
+  if ((arena == NULL) || (recs == NULL)) {
+    dh_err = ER_MEM;
+    goto exit_dh_import;
+  }
+
+  chain = (char*)k_alloc(140, BULK_MAX_CHAIN * dh_file->group_size);
+
+  /* Presize the file for the data we are about to load. Counting the
+     lines is cheap and lets us allow for the record headers.           */
+
+  rows = 0;
+  for (p = base; p < end; p += n) {
+    n = min(end - p, BULK_SCAN_WINDOW);
+    rows += count_byte(p, (int32_t)n, '\n');
+  }
+
+  load = fptr->params.load_bytes + st.st_size +
+         (rows + 1) * (RECORD_HEADER_SIZE + 2);
+  modulus = (int32_t)((load * 100) / (((int64)dh_file->group_size) *
+                                      fptr->params.split_load)) + 1;
+
+  if ((modulus > fptr->params.modulus) && !(dh_file->flags & DHF_BULK_LOAD) &&
+      !(fptr->flags & DHF_NO_RESIZE)) {
+    dh_file->flags |= DHF_BULK_LOAD;
+    bulk_load = TRUE;
+    if (!dh_resize(dh_file, modulus))
+      goto exit_dh_import;
+  }
+
+  /* Parse and load */
+
+  p = base;
+
+  if (flags & BULK_HEADER) {
+    if ((p = parse_line(p, end, delimiter, &cols)) == NULL)
+      goto no_mem;
+  }
+
+  while (p < end) {
+    if ((p = parse_line(p, end, delimiter, &cols)) == NULL)
+      goto no_mem;
+
+    if ((cols == 1) && (spans[0].len == 0))
+      continue; /* Blank line */
+
+    if (map == NULL)
+      nf = cols - 1;
+
+    /* Validate the id */
+
+    if ((id_col >= cols) || (spans[id_col].len > 2 * MAX_ID_LEN)) {
+      (*rejected)++;
+      continue;
+    }
+
+    if (spans[id_col].quoted) {
+      id = id_buff;
+      id_len = dequote(id_buff, spans + id_col);
+    } else {
+      id = spans[id_col].p;
+      id_len = spans[id_col].len;
+    }
+
+    if ((id_len <= 0) || (id_len > sysseg->maxidlen)) {
+      (*rejected)++;
+      continue;
+    }
+
+    for (q = id; q < id + id_len; q++) {
+      if ((*q == '\0') || IsMark(*q))
+        break;
+    }
+    if (q < id + id_len) {
+      (*rejected)++;
+      continue;
+    }
+
+    /* Make room for the record */
+
+    reqd = id_len + nf;
+    for (i = 0; i < cols; i++)
+      reqd += spans[i].len;
+
+    if ((num_recs == BULK_BATCH_RECORDS) || (arena_used + reqd > arena_size)) {
+      if (!flush_batch(dh_file, arena, recs, num_recs, flags, written, skipped))
+        goto exit_dh_import;
+
+      num_recs = 0;
+      arena_used = 0;
+
+      if (reqd > arena_size) /* Unusually large record */
+      {
+        if (reqd > 0x7FFF0000) {
+          (*rejected)++;
+          continue;
+        }
+
+        k_free(arena);
+        arena_size = (int32_t)reqd;
+        if ((arena = (char*)k_alloc(132, arena_size)) == NULL)
+          goto no_mem;
+      }
+    }
+
+    /* Assemble the record in the arena */
+
+    rec = recs + num_recs;
+    rec->offset = arena_used;
+    rec->id_len = (int16_t)id_len;
+
+    tgt = arena + arena_used;
+    memcpy(tgt, id, id_len);
+    tgt += id_len;
+    q = tgt;
+
+    for (f = 1; f <= nf; f++) {
+      if (f > 1)
+        *(tgt++) = FIELD_MARK;
+      i = (map == NULL) ? f : field_col[f];
+      if ((i >= 0) && (i < cols))
+        tgt += dequote(tgt, spans + i);
+    }
+
+    while ((tgt > q) && (*(tgt - 1) == FIELD_MARK))
+      tgt--; /* Trailing null fields */
+
+    rec->data_len = tgt - q;
+    arena_used = tgt - arena;
+    num_recs++;
+  }
+
+  if (!flush_batch(dh_file, arena, recs, num_recs, flags, written, skipped))
+    goto exit_dh_import;
+
+  status = TRUE;
+  goto exit_dh_import;
+
+no_mem:
+  dh_err = ER_MEM;
+
+exit_dh_import:
+  if (bulk_load) {
+    dh_file->flags &= ~DHF_BULK_LOAD;
+    dh_resize(dh_file, 0); /* Trim if fewer were loaded than estimated */
+  }
+
+  if (base != MAP_FAILED)
+    munmap(base, st.st_size);
+  if (fu >= 0)
+    close(fu);
+
+  k_free_ptr(field_col);
+  k_free_ptr(arena);
+  k_free_ptr(recs);
+  k_free_ptr(chain);
+
+  if (max_spans > 1024) /* Don't hang on to the table for a very wide file */
+  {
+    k_free_ptr(spans);
+    max_spans = 0;
+  }
+
+  return status;
+}
+
+/* ======================================================================
+   dh_export()  -  Write all records as delimited text                    */
+
+bool dh_export(DH_FILE* dh_file,
+               char* path, /* Target file, replaced */
+               char delimiter,
+               int16_t* map, /* Column map, may be NULL */
+               int16_t map_cols,
+               int32_t* written) {
+  bool status = FALSE;
+  FILE_ENTRY* fptr;
+  BULK_OUT out;
+  char* buff = NULL;
+  char* big_buff = NULL;
+  int32_t big_size = 0;
+  char** fld = NULL;
+  int32_t* fld_len = NULL;
+  int32_t nf = 0;
+  int16_t lock_slot = 0;
+  int16_t group_bytes;
+  int16_t used_bytes;
+  int16_t rec_offset;
+  int16_t subfile;
+  int32_t group;
+  int32_t grp;
+  int32_t data_len;
+  int32_t f;
+  int32_t n;
+  int16_t i;
+  DH_RECORD* rec_ptr;
+  STRING_CHUNK* str;
+  STRING_CHUNK* s;
+  char* data;
+  char* p;
+  char* q;
+  bool inhibited = FALSE;
+
+  dh_err = 0;
+  process.os_error = 0;
+  *written = 0;
+
+  fptr = FPtr(dh_file->file_id);
+  group_bytes = (int16_t)(dh_file->group_size);
+
+  out.fu = -1;
+  out.buff = (char*)k_alloc(134, BULK_OUT_SIZE);
+  out.p = out.buff;
+  out.end = out.buff + BULK_OUT_SIZE;
+  buff = (char*)k_alloc(135, group_bytes);
+  if ((out.buff == NULL) || (buff == NULL))
+    goto no_mem;
+
+  if (map != NULL) {
+    for (i = 0; i < map_cols; i++) {
+      if (map[i] > nf)
+        nf = map[i];
+    }
+
+    fld = (char**)k_alloc(136, (nf + 1) * sizeof(char*));
+    fld_len = (int32_t*)k_alloc(137, (nf + 1) * sizeof(int32_t));
+    if ((fld == NULL) || (fld_len == NULL))
+      goto no_mem;
+  }
+
+  out.fu = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, default_access);
+  if (out.fu < 0) {
+    dh_err = ER_FAILED;
+    process.os_error = errno;
+    goto exit_dh_export;
+  }
+
+  /* Hold off split/merge so that each record is seen exactly once */
+
+  StartExclusive(FILE_TABLE_LOCK, 13);
+  (fptr->inhibit_count)++;
+  EndExclusive(FILE_TABLE_LOCK);
+  inhibited = TRUE;
+
+  for (group = 1; group <= fptr->params.modulus; group++) {
+    if (((group & 0xFF) == 0) && bulk_break())
+      goto exit_dh_export;
+
+    StartExclusive(FILE_TABLE_LOCK, 17);
+    lock_slot = GetGroupReadLock(dh_file, group);
+    EndExclusive(FILE_TABLE_LOCK);
+
+    subfile = PRIMARY_SUBFILE;
+    grp = group;
+
+    do {
+      if (!dh_read_group(dh_file, subfile, grp, buff, group_bytes))
+        goto exit_dh_export;
+
+      used_bytes = ((DH_BLOCK*)buff)->used_bytes;
+      rec_offset = offsetof(DH_BLOCK, record);
+      while (rec_offset < used_bytes) {
+        rec_ptr = (DH_RECORD*)(buff + rec_offset);
+
+        if (rec_ptr->flags & DH_BIG_REC) {
+          str = dh_read_record(dh_file, rec_ptr);
+          data_len = (str == NULL) ? 0 : str->string_len;
+          if (data_len > big_size) {
+            k_free_ptr(big_buff);
+            big_size = data_len;
+            if ((big_buff = (char*)k_alloc(138, big_size)) == NULL) {
+              s_free(str);
+              goto no_mem;
+            }
+          }
+
+          for (s = str, p = big_buff; s != NULL; s = s->next) {
+            memcpy(p, s->data, s->bytes);
+            p += s->bytes;
+          }
+          if (str != NULL)
+            s_free(str);
+          data = big_buff;
+        } else {
+          data = rec_ptr->id + rec_ptr->id_len;
+          data_len = rec_ptr->data.data_len;
+        }
+
+        if (map == NULL) {
+          /* Id followed by every field */
+
+          if (!put_field(&out, rec_ptr->id, rec_ptr->id_len, delimiter))
+            goto exit_dh_export;
+
+          p = data;
+          n = data_len;
+          while (n > 0) {
+            q = memchr(p, FIELD_MARK, n);
+            f = (q == NULL) ? n : (q - p);
+            if (!out_byte(&out, delimiter) || !put_field(&out, p, f, delimiter))
+              goto exit_dh_export;
+            if (q == NULL)
+              break;
+            n -= f + 1;
+            p = q + 1;
+          }
+        } else {
+          /* Locate the fields we need, then write the columns */
+
+          p = data;
+          n = data_len;
+          for (f = 1; f <= nf; f++) {
+            fld[f] = p;
+            q = (n > 0) ? memchr(p, FIELD_MARK, n) : NULL;
+            fld_len[f] = (q == NULL) ? n : (q - p);
+            n -= fld_len[f] + 1;
+            if (n < 0)
+              n = 0;
+            p = (q == NULL) ? p + fld_len[f] : q + 1;
+          }
+
+          for (i = 0; i < map_cols; i++) {
+            if ((i > 0) && !out_byte(&out, delimiter))
+              goto exit_dh_export;
+
+            if (map[i] == 0) {
+              if (!put_field(&out, rec_ptr->id, rec_ptr->id_len, delimiter))
+                goto exit_dh_export;
+            } else if (map[i] > 0) {
+              if (!put_field(&out, fld[map[i]], fld_len[map[i]], delimiter))
+                goto exit_dh_export;
+            }
+          }
+        }
+
+        if (!out_byte(&out, '\n'))
+          goto exit_dh_export;
+        (*written)++;
+
+        rec_offset += rec_ptr->next;
+      }
+
+      subfile = OVERFLOW_SUBFILE;
+      grp = GetFwdLink(dh_file, ((DH_BLOCK*)buff)->next);
+    } while (grp != 0);
+
+    FreeGroupReadLock(lock_slot);
+    lock_slot = 0;
+  }
+
+  if (!out_flush(&out))
+    goto exit_dh_export;
+
+  status = TRUE;
+  goto exit_dh_export;
+
+no_mem:
+  dh_err = ER_MEM;
+
+exit_dh_export:
+  if (lock_slot != 0)
+    FreeGroupReadLock(lock_slot);
+
+  if (inhibited) {
+    StartExclusive(FILE_TABLE_LOCK, 13);
+    (fptr->inhibit_count)--;
+    EndExclusive(FILE_TABLE_LOCK);
+  }
+
+  if (out.fu >= 0)
+    close(out.fu);
+
+  k_free_ptr(out.buff);
+  k_free_ptr(buff);
+  k_free_ptr(big_buff);
+  k_free_ptr(fld);
+  k_free_ptr(fld_len);
+
+  return status;
+}
+
+/* ======================================================================
+   scan_field()  -  Find end of an unquoted field                         */
+
+Private char* scan_field(char* p, char* end, char delimiter) {
+  char* q;
+  int64 n;
+
+  while (p < end) {
+    n = min(end - p, BULK_SCAN_WINDOW);
+    if ((q = find_byte2(p, (int32_t)n, delimiter, '\n')) != NULL)
+      return q;
+    p += n;
+  }
+
+  return end;
+}
+
+/* ======================================================================
+   parse_line()  -  Split one line into columns
+   Returns the start of the next line, NULL if the span table could not
+   be extended.                                                           */
+
+Private char* parse_line(char* p, char* end, char delimiter, int32_t* cols) {
+  BULK_SPAN* span;
+  BULK_SPAN* new_spans;
+  char* q;
+  int32_t n = 0;
+
+  do {
+    if (n == max_spans) {
+      new_spans = (BULK_SPAN*)k_alloc(139, (max_spans + 64) * sizeof(BULK_SPAN));
+      if (new_spans == NULL)
+        return NULL;
+      if (spans != NULL) {
+        memcpy(new_spans, spans, max_spans * sizeof(BULK_SPAN));
+        k_free(spans);
+      }
+      spans = new_spans;
+      max_spans += 64;
+    }
+
+    span = spans + n++;
+    span->quoted = FALSE;
+
+    if ((p < end) && (*p == '"')) {
+      /* Quoted field. A doubled quote stands for one quote. */
+
+      span->p = ++p;
+      while (1) {
+        if ((q = memchr(p, '"', end - p)) == NULL) {
+          p = q = end; /* Unterminated */
+          break;
+        }
+
+        if ((q + 1 < end) && (q[1] == '"')) {
+          span->quoted = TRUE;
+          p = q + 2;
+        } else {
+          p = q + 1;
+          break;
+        }
+      }
+      span->len = q - span->p;
+
+      if ((p < end) && (*p != delimiter) && (*p != '\n'))
+        p = scan_field(p, end, delimiter); /* Ignore junk after quote */
+    } else {
+      span->p = p;
+      p = scan_field(p, end, delimiter);
+      span->len = p - span->p;
+      if ((p < end) && (*p == '\n') && (span->len > 0) && (*(p - 1) == '\r'))
+        span->len--;
+    }
+  } while ((p < end) && (*(p++) == delimiter));
+
+  *cols = n;
+  return p;
+}
+
+/* ======================================================================
+   dequote()  -  Copy column text, reducing doubled quotes                */
+
+Private int64 dequote(char* tgt, BULK_SPAN* span) {
+  char* p;
+  char* q;
+  char* end;
+  char* t;
+
+  if (!span->quoted) {
+    memcpy(tgt, span->p, span->len);
+    return span->len;
+  }
+
+  p = span->p;
+  end = p + span->len;
+  t = tgt;
+  while ((q = memchr(p, '"', end - p)) != NULL) {
+    memcpy(t, p, q + 1 - p);
+    t += q + 1 - p;
+    p = min(q + 2, end);
+  }
+
+  memcpy(t, p, end - p);
+  t += end - p;
+
+  return t - tgt;
+}
+
+/* ======================================================================
+   flush_batch()  -  Write a batch of records in group order
+
+   Split and merge are held off while the batch is written so that the
+   group of each record cannot change under us. All records for a group
+   are then applied under a single group lock with one read and one write
+   of each block in the group's chain.                                    */
+
+Private bool flush_batch(DH_FILE* dh_file,
+                         char* arena,
+                         BULK_REC* recs,
+                         int32_t num_recs,
+                         int16_t flags,
+                         int32_t* written,
+                         int32_t* skipped) {
+  bool status = TRUE;
+  FILE_ENTRY* fptr;
+  BULK_REC* rec;
+  int32_t i;
+  int32_t j;
+  bool grouped;
+
+  fptr = FPtr(dh_file->file_id);
+
+  StartExclusive(FILE_TABLE_LOCK, 20);
+  (fptr->inhibit_count)++;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  for (i = 0, rec = recs; i < num_recs; i++, rec++)
+    rec->group = dh_hash_group(fptr, arena + rec->offset, rec->id_len);
+
+  qsort(recs, num_recs, sizeof(BULK_REC), cmp_rec);
+
+  /* AK updates are driven record by record from dh_write() */
+
+  grouped = !(dh_file->flags & DHF_AK) && (chain != NULL);
+
+  for (i = 0; status && (i < num_recs); i = j) {
+    for (j = i + 1; (j < num_recs) && (recs[j].group == recs[i].group); j++) {
+    }
+
+    if (grouped) {
+      status = write_group(dh_file, arena, recs + i, j - i, flags, written,
+                           skipped);
+    } else {
+      while (status && (i < j))
+        status = write_one(dh_file, arena, recs + i++, flags, written, skipped);
+    }
+  }
+
+  StartExclusive(FILE_TABLE_LOCK, 21);
+  (fptr->inhibit_count)--;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  /* Catch up with any splits that were held off */
+
+  if (status && !(fptr->flags & DHF_NO_RESIZE) &&
+      (DHLoad(fptr->params.load_bytes, dh_file->group_size,
+              fptr->params.modulus) > fptr->params.split_load)) {
+    status = dh_resize(dh_file, 0);
+  }
+
+  return status && !bulk_break();
+}
+
+/* ======================================================================
+   write_group()  -  Apply all batch records for one group
+
+   Large records, records whose old version is a large record and any
+   group with an unusually long overflow chain are passed to dh_write()
+   once the group lock has been released.                                 */
+
+Private bool write_group(DH_FILE* dh_file,
+                         char* arena,
+                         BULK_REC* recs,
+                         int32_t num_recs,
+                         int16_t flags,
+                         int32_t* written,
+                         int32_t* skipped) {
+  bool status = FALSE;
+  FILE_ENTRY* fptr;
+  BULK_REC* rec;
+  int32_t group;
+  int16_t group_bytes;
+  int16_t lock_slot;
+  int32_t blk_grp[BULK_MAX_CHAIN];
+  bool dirty[BULK_MAX_CHAIN];
+  int16_t nblk = 0;
+  int16_t b;
+  DH_BLOCK* blk;
+  DH_RECORD* rec_ptr;
+  int16_t subfile;
+  int32_t grp;
+  int32_t ogrp;
+  int16_t rec_offset;
+  int16_t used_bytes;
+  int32_t base_size;
+  int64 bytes = 0;
+  int64 load_change = 0;
+  int32_t new_records = 0;
+  int32_t in_place = 0;
+  int16_t longest_id = 0;
+  char* id;
+  int32_t i;
+  bool found;
+  bool nocase;
+  bool deferring = FALSE;
+
+  fptr = FPtr(dh_file->file_id);
+  group = recs[0].group;
+  group_bytes = (int16_t)(dh_file->group_size);
+  nocase = (fptr->flags & DHF_NOCASE) != 0;
+
+  /* Lock group. Anything that is not a simple record is deferred by
+     setting its group to zero. Deferred records are written by
+     write_one() after the group has been processed so, once a record has
+     been deferred, all later records for the group must be too in order
+     that the last of any duplicate ids still wins.                      */
+
+  StartExclusive(FILE_TABLE_LOCK, 20);
+  lock_slot = GetGroupWriteLock(dh_file, group);
+  fptr->upd_ct++;
+  fptr->updates_pending++;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  for (i = 0, rec = recs; i < num_recs; i++, rec++) {
+    base_size = RECORD_HEADER_SIZE + rec->id_len + rec->data_len;
+    if (deferring || (base_size >= fptr->params.big_rec_size)) {
+      rec->group = 0;
+      deferring = TRUE;
+    } else {
+      bytes += base_size + 3;
+    }
+  }
+
+  /* Read the chain, allowing room for it to grow */
+
+  subfile = PRIMARY_SUBFILE;
+  grp = group;
+  do {
+    if (nblk + (bytes / (group_bytes - BLOCK_HEADER_SIZE)) + 1 >= BULK_MAX_CHAIN) {
+      for (i = 0, rec = recs; i < num_recs; i++, rec++)
+        rec->group = 0;
+      break;
+    }
+
+    blk = (DH_BLOCK*)(chain + nblk * group_bytes);
+    if (!dh_read_group(dh_file, subfile, grp, (char*)blk, group_bytes))
+      goto exit_write_group;
+
+    used_bytes = blk->used_bytes;
+    if ((used_bytes == 0) || (used_bytes > group_bytes)) {
+      log_printf(
+          "DH_IMPORT: Invalid byte count (x%04X) in subfile %d, group %d\nof "
+          "file %s\n",
+          used_bytes, (int)subfile, grp, fptr->pathname);
+      dh_err = DHE_POINTER_ERROR;
+      goto exit_write_group;
+    }
+
+    blk_grp[nblk] = grp;
+    dirty[nblk++] = FALSE;
+
+    subfile = OVERFLOW_SUBFILE;
+    grp = GetFwdLink(dh_file, blk->next);
+  } while (grp != 0);
+
+  for (i = 0, rec = recs; i < num_recs; i++, rec++) {
+    if (rec->group == 0)
+      continue;
+
+    if (deferring) {
+      rec->group = 0;
+      continue;
+    }
+
+    id = arena + rec->offset;
+    base_size = RECORD_HEADER_SIZE + rec->id_len + rec->data_len;
+    base_size += (4 - (base_size & 3)) & 3; /* Round to four byte boundary */
+
+    /* Look for an old record of the same id */
+
+    found = FALSE;
+    for (b = 0; (b < nblk) && !found; b++) {
+      blk = (DH_BLOCK*)(chain + b * group_bytes);
+      rec_offset = BLOCK_HEADER_SIZE;
+      while (rec_offset < blk->used_bytes) {
+        rec_ptr = (DH_RECORD*)(((char*)blk) + rec_offset);
+        if ((rec_ptr->id_len == rec->id_len) &&
+            !(nocase ? MemCompareNoCase(id, rec_ptr->id, rec->id_len)
+                     : memcmp(id, rec_ptr->id, rec->id_len))) {
+          found = TRUE;
+          break;
+        }
+        rec_offset += rec_ptr->next;
+      }
+    }
+
+    if (found) {
+      b--;
+
+      if (!(flags & BULK_OVERWRITE)) {
+        (*skipped)++;
+        continue;
+      }
+
+      if (rec_ptr->flags & DH_BIG_REC) /* Leave dh_write() to release it */
+      {
+        rec->group = 0;
+        deferring = TRUE;
+        continue;
+      }
+
+      load_change -= rec_ptr->next;
+      dirty[b] = TRUE;
+
+      if (rec_ptr->next != base_size) {
+        /* Delete old record */
+
+        used_bytes = blk->used_bytes - rec_ptr->next;
+        memmove(rec_ptr, ((char*)rec_ptr) + rec_ptr->next,
+                blk->used_bytes - (rec_offset + rec_ptr->next));
+        memset(((char*)blk) + used_bytes, '\0', blk->used_bytes - used_bytes);
+        blk->used_bytes = used_bytes;
+        rec_ptr = NULL;
+      }
+    } else {
+      rec_ptr = NULL;
+      new_records++;
+    }
+
+    if (rec_ptr == NULL) {
+      /* Find space for the new record, extending the chain if need be */
+
+      for (b = 0; b < nblk; b++) {
+        blk = (DH_BLOCK*)(chain + b * group_bytes);
+        if (base_size <= group_bytes - blk->used_bytes)
+          break;
+      }
+
+      if (b == nblk) {
+        /* The estimate of the chain length made above assumes full blocks
+          but records of up to big_rec_size may leave much of each block
+          unused. If there is no room to extend the chain here, leave the
+          record to dh_write(), which will count it as new.              */
+
+        if (nblk >= BULK_MAX_CHAIN - 1) {
+          rec->group = 0;
+          deferring = TRUE;
+          new_records--;
+          continue;
+        }
+
+        if ((ogrp = dh_get_overflow(dh_file, FALSE)) == 0)
+          goto exit_write_group;
+
+        ((DH_BLOCK*)(chain + (nblk - 1) * group_bytes))->next =
+            SetFwdLink(dh_file, ogrp);
+        dirty[nblk - 1] = TRUE;
+
+        blk = (DH_BLOCK*)(chain + nblk * group_bytes);
+        memset((char*)blk, '\0', group_bytes);
+        blk->used_bytes = BLOCK_HEADER_SIZE;
+        blk_grp[nblk++] = ogrp;
+      }
+
+      rec_ptr = (DH_RECORD*)(((char*)blk) + blk->used_bytes);
+      blk->used_bytes += (int16_t)base_size;
+      rec_ptr->next = (int16_t)base_size;
+      rec_ptr->id_len = (u_char)(rec->id_len);
+      memcpy(rec_ptr->id, id, rec->id_len);
+      dirty[b] = TRUE;
+    }
+
+    rec_ptr->flags = 0;
+    rec_ptr->data.data_len = rec->data_len;
+    memcpy(rec_ptr->id + rec->id_len, id + rec->id_len, rec->data_len);
+
+    load_change += base_size;
+    if (rec->id_len > longest_id)
+      longest_id = rec->id_len;
+    (*written)++;
+    in_place++;
+  }
+
+  /* Write back, new overflow blocks before the blocks that point to them */
+
+  for (b = nblk - 1; b >= 0; b--) {
+    if (dirty[b] &&
+        !dh_write_group(dh_file, (b == 0) ? PRIMARY_SUBFILE : OVERFLOW_SUBFILE,
+                        blk_grp[b], chain + b * group_bytes, group_bytes)) {
+      goto exit_write_group;
+    }
+  }
+
+  status = TRUE;
+
+exit_write_group:
+  FreeGroupWriteLock(lock_slot);
+
+  dh_file->flags |= FILE_UPDATED;
+
+  StartExclusive(FILE_TABLE_LOCK, 21);
+  if ((load_change >= 0) || (-load_change <= fptr->params.load_bytes)) {
+    fptr->params.load_bytes += load_change;
+  } else {
+    fptr->params.load_bytes = 0;
+  }
+  if (longest_id > fptr->params.longest_id)
+    fptr->params.longest_id = longest_id;
+  if (fptr->record_count >= 0)
+    fptr->record_count += new_records;
+  fptr->updates_pending--;
+  fptr->stats.writes += in_place; /* Deferred records counted by dh_write() */
+  sysseg->global_stats.writes += in_place;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  /* Deferred records */
+
+  for (i = 0, rec = recs; status && (i < num_recs); i++, rec++) {
+    if (rec->group == 0)
+      status = write_one(dh_file, arena, rec, flags, written, skipped);
+  }
+
+  return status;
+}
+
+/* ====================================================================== */
+
+Private int cmp_rec(const void* a, const void* b) {
+  const BULK_REC* r1 = (const BULK_REC*)a;
+  const BULK_REC* r2 = (const BULK_REC*)b;
+
+  /* Records for the same group stay in file order so that the last of
+     any duplicate ids wins.                                             */
+
+  if (r1->group != r2->group)
+    return (r1->group < r2->group) ? -1 : 1;
+  return (r1->offset < r2->offset) ? -1 : (r1->offset > r2->offset);
+}
+
+/* ======================================================================
+   write_one()  -  Write a single record via dh_write()                   */
+
+Private bool write_one(DH_FILE* dh_file,
+                       char* arena,
+                       BULK_REC* rec,
+                       int16_t flags,
+                       int32_t* written,
+                       int32_t* skipped) {
+  STRING_CHUNK* str = NULL;
+  char* id;
+  bool status;
+
+  id = arena + rec->offset;
+
+  if (!(flags & BULK_OVERWRITE) && dh_exists(dh_file, id, rec->id_len)) {
+    (*skipped)++;
+    return TRUE;
+  }
+
+  if (rec->data_len != 0) {
+    ts_init(&str, rec->data_len);
+    ts_copy(id + rec->id_len, rec->data_len);
+    ts_terminate();
+  }
+
+  if ((status = dh_write(dh_file, id, rec->id_len, str)))
+    (*written)++;
+
+  k_deref_string(str);
+  return status;
+}
+
+/* ======================================================================
+   bulk_break()  -  Check for events between batches                      */
+
+Private bool bulk_break() {
+  if ((k_exit_cause == K_QUIT) && !tio_handle_break()) {
+    dh_err = ER_STOPPED;
+    return TRUE;
+  }
+
+  if (my_uptr->events)
+    process_events();
+
+  if (k_exit_cause == K_TERMINATE) {
+    dh_err = ER_STOPPED;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* ======================================================================
+   Output functions for dh_export()                                       */
+
+Private bool put_field(BULK_OUT* out, char* p, int32_t len, char delimiter) {
+  char* q;
+  int32_t n;
+
+  if ((len == 0) || ((find_byte2(p, len, delimiter, '"') == NULL) &&
+                     (find_byte2(p, len, '\n', '\r') == NULL))) {
+    return out_bytes(out, p, len);
+  }
+
+  if (!out_byte(out, '"'))
+    return FALSE;
+
+  while ((q = memchr(p, '"', len)) != NULL) {
+    n = q + 1 - p;
+    if (!out_bytes(out, p, n) || !out_byte(out, '"'))
+      return FALSE;
+    p += n;
+    len -= n;
+  }
+
+  return out_bytes(out, p, len) && out_byte(out, '"');
+}
+
+Private bool out_bytes(BULK_OUT* out, char* p, int32_t n) {
+  int32_t k;
+
+  while (n > 0) {
+    if ((out->p == out->end) && !out_flush(out))
+      return FALSE;
+
+    k = min(n, out->end - out->p);
+    memcpy(out->p, p, k);
+    out->p += k;
+    p += k;
+    n -= k;
+  }
+
+  return TRUE;
+}
+
+Private bool out_byte(BULK_OUT* out, char c) {
+  if ((out->p == out->end) && !out_flush(out))
+    return FALSE;
+
+  *(out->p++) = c;
+  return TRUE;
+}
+
+Private bool out_flush(BULK_OUT* out) {
+  char* p;
+  ssize_t n;
+
+  for (p = out->buff; p < out->p; p += n) {
+    n = write(out->fu, p, out->p - p);
+    if (n < 0) {
+      if (errno == EINTR) {
+        n = 0;
+        continue;
+      }
+      dh_err = ER_FAILED;
+      process.os_error = errno;
+      return FALSE;
+    }
+  }
+
+  out->p = out->buff;
+  return TRUE;
+}
+
+/* END-CODE */
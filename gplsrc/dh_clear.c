@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Mark the file table record count exact after a clear.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -93,6 +95,7 @@ bool dh_clear(DH_FILE* dh_file) {
   fptr->params.load_bytes = 0;
   fptr->params.free_chain = 0;
   fptr->record_count = 0;
+  fptr->record_count_exact = TRUE;
 
   /* Calculate mod_value as next power of two >= new_modulus */
 
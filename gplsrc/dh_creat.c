@@ -21,6 +21,9 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Initialise data groups in batches so that files created with a
+ *             large minimum modulus do not need a write per group.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -44,6 +47,10 @@
 #include "qm.h"
 #include "dh_int.h"
 
+/* Maximum number of empty groups written by each call to Write() */
+
+#define INIT_BATCH_GROUPS 256
+
 /* ====================================================================== */
 
 bool dh_create_file(char path[],
@@ -65,6 +72,8 @@ bool dh_create_file(char path[],
   int header_bytes;
   int group_size_bytes;
   int32_t group;
+  int32_t batch;
+  char* init_buff = NULL;
   double file_size;
 
   dh_err = 0;
@@ -187,14 +196,31 @@ bool dh_create_file(char path[],
     goto exit_dh_create_file;
   }
 
-  /* Initialise data groups */
+  /* Initialise data groups. A file presized for a bulk load may have a
+    very large minimum modulus so write as many empty groups at a time as
+    we can. If there is no memory for the batch buffer, we fall back to
+    one group per write from dh_buffer.                                   */
+
+  batch = (min_modulus < INIT_BATCH_GROUPS) ? min_modulus : INIT_BATCH_GROUPS;
+  if (batch > 1)
+    init_buff = (char*)k_alloc(124, batch * group_size_bytes);
+  if (init_buff == NULL) {
+    init_buff = dh_buffer;
+    batch = 1;
+  }
 
-  memset(dh_buffer, 0, group_size_bytes);
-  ((DH_BLOCK*)(dh_buffer))->used_bytes = BLOCK_HEADER_SIZE;
-  ((DH_BLOCK*)(dh_buffer))->block_type = DHT_DATA;
+  memset(init_buff, 0, batch * group_size_bytes);
+  for (group = 0; group < batch; group++) {
+    ((DH_BLOCK*)(init_buff + group * group_size_bytes))->used_bytes =
+        BLOCK_HEADER_SIZE;
+    ((DH_BLOCK*)(init_buff + group * group_size_bytes))->block_type = DHT_DATA;
+  }
+
+  for (group = 0; group < min_modulus; group += batch) {
+    if (batch > min_modulus - group)
+      batch = min_modulus - group;
 
-  for (group = 1; group <= min_modulus; group++) {
-    if (Write(fu, dh_buffer, group_size_bytes) < 0) {
+    if (Write(fu, init_buff, batch * group_size_bytes) < 0) {
       dh_err = DHE_INIT_DATA_ERROR;
       process.os_error = OSError;
       goto exit_dh_create_file;
@@ -236,6 +262,9 @@ bool dh_create_file(char path[],
   status = TRUE;
 
 exit_dh_create_file:
+  if ((init_buff != NULL) && (init_buff != dh_buffer))
+    k_free(init_buff);
+
   if (status == FALSE) {
     if (ValidFileHandle(fu))
       CloseFile(fu);
@@ -21,6 +21,13 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Count the delete in updates_pending until record_count has
+ *             been adjusted.
+ *
+ * 18Oct26 gwb Record count is no longer exact if it would go negative.
+ *
+ * 18Oct26 gwb Do not merge while the file is in bulk load mode.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -61,6 +68,7 @@ bool dh_delete(DH_FILE* dh_file, /* File descriptor */
   int32_t group;            /* Group number */
   int16_t group_bytes;     /* Group size in bytes */
   int16_t lock_slot = 0;   /* Lock table index */
+  bool update_pending = FALSE;
   DH_BLOCK* buff;            /* Active buffer */
   int16_t subfile;         /* Current subfile */
   int rec_offset;            /* Offset of record in group buffer */
@@ -117,6 +125,8 @@ bool dh_delete(DH_FILE* dh_file, /* File descriptor */
   group = dh_hash_group(fptr, id, id_len);
   lock_slot = GetGroupWriteLock(dh_file, group);
   fptr->upd_ct++;
+  fptr->updates_pending++;
+  update_pending = TRUE;
   EndExclusive(FILE_TABLE_LOCK);
 
   subfile = PRIMARY_SUBFILE;
@@ -339,11 +349,16 @@ exit_dh_delete:
   if (found) {
     if (fptr->record_count >= 0) {
       fptr->record_count -= 1;
-      if (fptr->record_count < 0)
+      if (fptr->record_count < 0) {
         fptr->record_count = 0; /* Survive crashes */
+        fptr->record_count_exact = FALSE;
+      }
     }
   }
 
+  if (update_pending)
+    fptr->updates_pending--;
+
   EndExclusive(FILE_TABLE_LOCK);
 
   if (buff != NULL)
@@ -364,7 +379,8 @@ exit_dh_delete:
       {
         dh_split(dh_file);
       } else if ((load < fptr->params.merge_load) &&
-                 (modulus > fptr->params.min_modulus)) {
+                 (modulus > fptr->params.min_modulus) &&
+                 !(dh_file->flags & DHF_BULK_LOAD)) {
         /* Looks like we need to split but check won't immediately merge */
         load = DHLoad(fptr->params.load_bytes, group_bytes, modulus - 1);
         if (load < fptr->params.split_load) /* Would not immediately split */
@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Record group lock contention statistics.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686) 
  * 
  * 29Feb20 gwb Changed LONG_MAX to INT32_MAX.  When building for a 64 bit 
@@ -598,6 +600,7 @@ int16_t dh_get_group_lock(DH_FILE* dh_file, int32_t group, bool write_lock) {
   bool retry = FALSE;
   // FILE_ENTRY* fptr; variable set but not used.
   int steps = 0;
+  int64 wait_started = 0; /* For contention statistics */
 
   file_id = dh_file->file_id;
   idx = GLockHash(file_id, group);
@@ -625,6 +628,8 @@ again:
 
             sysseg->gl_count++;
             sysseg->gl_scan += steps;
+            if (wait_started)
+              contention_group_time(file_id, wait_started);
             EndExclusive(GROUP_LOCK_SEM);
             return scan_idx;
           }
@@ -685,6 +690,9 @@ again:
 
   GLPtr(idx)->count += 1;
 
+  if (wait_started)
+    contention_group_time(file_id, wait_started);
+
   EndExclusive(GROUP_LOCK_SEM);
 
   sysseg->gl_count++;
@@ -707,6 +715,12 @@ wait_for_lock:
   else
     sysseg->gl_wait++;
 
+  if (sysseg->flags & SSF_CONTENTION) {
+    contention_group_wait(file_id, retry);
+    if (wait_started == 0)
+      wait_started = contention_clock();
+  }
+
   EndExclusive(GROUP_LOCK_SEM);
 
   if (--pause_ct) {
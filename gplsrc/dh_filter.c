@@ -0,0 +1,660 @@
+/* DH_FILTER.C
+ * Record selection filter applied while scanning groups for a select.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ *  dh_filter_compile  Build filter from query processor selection table
+ *  dh_filter_test     Test a record in a group buffer against a filter
+ *  dh_filter_free     Release a filter
+ *
+ * The query processor passes the selection clauses of a query that must
+ * scan the whole file. Simple tests of the record id or a stored field
+ * against literal values are evaluated here, directly against the group
+ * buffer, so that records that cannot be selected never reach the select
+ * list. The query processor still checks every record that survives, so
+ * the filter only needs to be safe: it may pass a record that the query
+ * will later reject but must never drop one the query would accept.
+ *
+ * The specification has one field per selection table entry:
+ *    op
+ *    op VM jump                              AND and OR
+ *    op VM item VM mv VM literal VM literal  Tests
+ * Item is 0 for the record id, n for field n or -1 for a test that cannot
+ * be handled here (I-types, conversions on LIKE, SAID, etc). A test that
+ * cannot be decided is assumed true if all tests are ANDed together and
+ * otherwise causes the record to be passed.
+ *
+ * The comparisons follow the rules of the BASIC operators used by the
+ * query processor. Numeric comparison is only used where both values can
+ * be represented exactly. Anything else is undecided.
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "dh_int.h"
+#include "header.h"
+#include "config.h"
+
+#include <math.h>
+#include <stdint.h>
+
+/* Selection table opcodes, as in the query processor */
+
+#define FOP_WHEN 2
+#define FOP_NO 3
+#define FOP_EQ 4
+#define FOP_NE 8
+#define FOP_LT 12
+#define FOP_LE 16
+#define FOP_GE 20
+#define FOP_GT 24
+#define FOP_LIKE 28
+#define FOP_UNLIKE 32
+#define FOP_SAID 36
+#define FOP_NOT_NULL 40
+#define FOP_BETWEEN 44
+#define FOP_OR 48
+#define FOP_AND 49
+#define FOP_EVERY 0x01
+#define FOP_NO_CASE 0x02
+
+#define FILTER_FALSE 0
+#define FILTER_TRUE 1
+#define FILTER_UNKNOWN 2
+
+#define FN_STRING 0  /* Not numeric */
+#define FN_EXACT 1   /* Numeric, held in value and scale */
+#define FN_INEXACT 2 /* Numeric but would convert to a float */
+
+#define FILTER_WORK_SIZE 1024 /* Longest value tested with LIKE */
+
+typedef struct DH_FILTER_VALUE DH_FILTER_VALUE;
+struct DH_FILTER_VALUE {
+  char* s;
+  int32_t len;
+  int16_t num; /* FN_xxx */
+  int64 value;
+  int16_t scale;
+};
+
+typedef struct DH_FILTER_ELEMENT DH_FILTER_ELEMENT;
+struct DH_FILTER_ELEMENT {
+  int16_t op;
+  int16_t jump;  /* AND and OR: element to jump to */
+  int16_t field; /* 0 = id, -1 = not handled */
+  bool mv;
+  DH_FILTER_VALUE lit2;
+  DH_FILTER_VALUE lit3; /* BETWEEN low bound */
+};
+
+struct DH_FILTER {
+  char* text;   /* Copy of specification holding the literals */
+  bool has_or;  /* Undecided test passes the record */
+  bool nocase;  /* Program was compiled with case insensitive strings */
+  int16_t num_elements;
+  DH_FILTER_ELEMENT element[1];
+};
+
+Private int16_t filter_clause(DH_FILTER* filter,
+                              DH_FILTER_ELEMENT* el,
+                              DH_RECORD* rec_ptr);
+Private int16_t filter_piece(DH_FILTER* filter,
+                             DH_FILTER_ELEMENT* el,
+                             char* p,
+                             int32_t len);
+Private int16_t filter_find(DH_FILTER* filter,
+                            DH_FILTER_ELEMENT* el,
+                            char* p,
+                            int32_t len);
+Private int16_t filter_compare(DH_FILTER* filter,
+                               bool fold,
+                               char* p,
+                               int32_t len,
+                               DH_FILTER_VALUE* lit);
+Private int16_t filter_number(char* p,
+                              int32_t len,
+                              int64* value,
+                              int16_t* scale);
+Private void filter_value(DH_FILTER_VALUE* v, char* s, bool fold);
+
+/* ======================================================================
+   dh_filter_compile()  -  Build filter from specification
+   Returns NULL if there is nothing that the filter can test.             */
+
+DH_FILTER* dh_filter_compile(char* spec) {
+  DH_FILTER* filter;
+  DH_FILTER_ELEMENT* el;
+  int16_t n;
+  int16_t i;
+  int16_t j;
+  char* p;
+  char* q;
+  char* arg[5];
+  bool handled = FALSE;
+  bool fold;
+
+  if (*spec == '\0')
+    return NULL;
+
+  n = 1;
+  for (p = spec; (p = strchr(p, FIELD_MARK)) != NULL; p++)
+    n++;
+
+  filter = (DH_FILTER*)k_alloc(147, sizeof(DH_FILTER) +
+                                        (n - 1) * sizeof(DH_FILTER_ELEMENT));
+  if (filter == NULL)
+    return NULL;
+
+  memset(filter, 0, sizeof(DH_FILTER) + (n - 1) * sizeof(DH_FILTER_ELEMENT));
+  filter->num_elements = n;
+  filter->nocase = (process.program.flags & HDR_NOCASE) != 0;
+
+  filter->text = (char*)k_alloc(148, strlen(spec) + 1);
+  if (filter->text == NULL) {
+    k_free(filter);
+    return NULL;
+  }
+  strcpy(filter->text, spec);
+
+  p = filter->text;
+  for (i = 0; i < n; i++) {
+    el = filter->element + i;
+
+    /* Split this element into its values */
+
+    if ((q = strchr(p, FIELD_MARK)) != NULL)
+      *(q++) = '\0';
+
+    for (j = 0; j < 5; j++) {
+      arg[j] = p;
+      if ((p = strchr(p, VALUE_MARK)) != NULL)
+        *(p++) = '\0';
+      else
+        p = arg[j] + strlen(arg[j]);
+    }
+    p = q;
+
+    el->op = atoi(arg[0]);
+    switch (el->op) {
+      case FOP_WHEN:
+      case FOP_NO:
+        break;
+
+      case FOP_OR:
+        filter->has_or = TRUE;
+        /* **** FALL THROUGH **** */
+
+      case FOP_AND:
+        el->jump = atoi(arg[1]) - 1; /* Table is indexed from one */
+        if (el->jump <= i)
+          goto invalid;
+        break;
+
+      default:
+        if ((el->op < FOP_EQ) || (el->op >= FOP_OR))
+          goto invalid;
+
+        el->field = atoi(arg[1]);
+        el->mv = atoi(arg[2]) != 0;
+        if ((el->op & 0xFC) == FOP_SAID)
+          el->field = -1;
+        if (el->field >= 0)
+          handled = TRUE;
+
+        fold = (el->op & FOP_NO_CASE) != 0;
+        filter_value(&(el->lit2), arg[3], fold);
+        filter_value(&(el->lit3), arg[4], fold);
+
+        if (((el->op & 0xFC) == FOP_LIKE) || ((el->op & 0xFC) == FOP_UNLIKE)) {
+          if (el->lit2.len > 256) /* As MATCHES */
+            el->field = -1;
+        }
+        break;
+    }
+
+    if (p == NULL)
+      break;
+  }
+
+  if (handled)
+    return filter;
+
+invalid:
+  dh_filter_free(filter);
+  return NULL;
+}
+
+/* ======================================================================
+   dh_filter_test()  -  Test record against filter
+   Mirrors the evaluation of the selection table by the query processor.
+   Returns FALSE if the record can be dropped.                            */
+
+bool dh_filter_test(DH_FILTER* filter, DH_RECORD* rec_ptr) {
+  DH_FILTER_ELEMENT* el;
+  int16_t i;
+  int16_t result;
+  bool inverse;
+  bool truth = TRUE;
+
+  i = 0;
+  while (i < filter->num_elements) {
+    inverse = FALSE;
+    while ((i < filter->num_elements) &&
+           ((filter->element[i].op == FOP_NO) ||
+            (filter->element[i].op == FOP_WHEN))) {
+      if (filter->element[i].op == FOP_NO)
+        inverse = TRUE;
+      i++;
+    }
+
+    if (i >= filter->num_elements)
+      break;
+
+    el = filter->element + i;
+    result = (el->field < 0) ? FILTER_UNKNOWN : filter_clause(filter, el, rec_ptr);
+    if (result == FILTER_UNKNOWN) {
+      if (filter->has_or)
+        return TRUE;
+      truth = TRUE; /* One of a list of ANDed tests */
+    } else {
+      truth = (result == FILTER_TRUE) != inverse;
+    }
+
+    i++;
+    while (i < filter->num_elements) {
+      el = filter->element + i;
+      if (el->op == FOP_AND)
+        i = (truth) ? (i + 1) : el->jump;
+      else if (el->op == FOP_OR)
+        i = (truth) ? el->jump : (i + 1);
+      else
+        break;
+    }
+  }
+
+  return truth;
+}
+
+/* ======================================================================
+   dh_filter_free()  -  Release filter                                    */
+
+void dh_filter_free(DH_FILTER* filter) {
+  if (filter != NULL) {
+    if (filter->text != NULL)
+      k_free(filter->text);
+    k_free(filter);
+  }
+}
+
+/* ======================================================================
+   filter_clause()  -  Evaluate one test for a record                     */
+
+Private int16_t filter_clause(DH_FILTER* filter,
+                              DH_FILTER_ELEMENT* el,
+                              DH_RECORD* rec_ptr) {
+  char* p;
+  char* q;
+  char* end;
+  int32_t len;
+  int32_t n;
+  int16_t result;
+  int16_t piece;
+
+  /* Find the item */
+
+  if (el->field == 0) {
+    p = rec_ptr->id;
+    len = rec_ptr->id_len;
+  } else {
+    if (rec_ptr->flags & DH_BIG_REC)
+      return FILTER_UNKNOWN; /* Data is not in the group buffer */
+
+    p = rec_ptr->id + rec_ptr->id_len;
+    end = p + rec_ptr->data.data_len;
+    for (n = el->field; --n > 0;) {
+      if ((p = memchr(p, FIELD_MARK, end - p)) == NULL)
+        break;
+      p++;
+    }
+
+    if (p == NULL) {
+      p = end;
+      len = 0;
+    } else {
+      q = memchr(p, FIELD_MARK, end - p);
+      len = ((q == NULL) ? end : q) - p;
+    }
+  }
+
+  /* A single valued item is tested as a whole. Multivalued items are tested
+     value by value, any value for a normal test, all values for EVERY. An
+     equality test on a multivalued item is a FIND.                        */
+
+  if (!(el->op & FOP_EVERY) && !el->mv)
+    return filter_piece(filter, el, p, len);
+
+  if ((el->op & ~FOP_NO_CASE) == FOP_EQ)
+    return filter_find(filter, el, p, len);
+
+  result = (el->op & FOP_EVERY) ? FILTER_TRUE : FILTER_FALSE;
+  do {
+    if ((q = find_mark(p, len)) == NULL)
+      n = len;
+    else
+      n = q - p;
+
+    piece = filter_piece(filter, el, p, n);
+    if (piece == FILTER_UNKNOWN)
+      result = FILTER_UNKNOWN;
+    else if ((piece == FILTER_TRUE) != ((el->op & FOP_EVERY) != 0))
+      return piece; /* Decided */
+
+    p += n + 1;
+    len -= n + 1;
+  } while (q != NULL);
+
+  return result;
+}
+
+/* ======================================================================
+   filter_piece()  -  Evaluate test for a single value                    */
+
+Private int16_t filter_piece(DH_FILTER* filter,
+                             DH_FILTER_ELEMENT* el,
+                             char* p,
+                             int32_t len) {
+  char work[FILTER_WORK_SIZE + 1];
+  bool fold;
+  int16_t c;
+  int16_t c3;
+  int32_t i;
+
+  fold = (el->op & FOP_NO_CASE) != 0;
+
+  switch (el->op & 0xFC) {
+    case FOP_NOT_NULL:
+      return (len != 0) ? FILTER_TRUE : FILTER_FALSE;
+
+    case FOP_LIKE:
+    case FOP_UNLIKE:
+      if (len > FILTER_WORK_SIZE)
+        return FILTER_UNKNOWN;
+
+      for (i = 0; i < len; i++)
+        work[i] = (fold) ? UpperCase(p[i]) : p[i];
+      work[len] = '\0';
+
+      if (match_template(work, el->lit2.s, 0, -1) == ((el->op & 0xFC) == FOP_LIKE))
+        return FILTER_TRUE;
+      return FILTER_FALSE;
+
+    case FOP_BETWEEN:
+      c = filter_compare(filter, fold, p, len, &(el->lit2));
+      c3 = filter_compare(filter, fold, p, len, &(el->lit3));
+      if ((c == FILTER_UNKNOWN) || (c3 == FILTER_UNKNOWN))
+        return FILTER_UNKNOWN;
+      return ((c3 >= 0) && (c <= 0)) ? FILTER_TRUE : FILTER_FALSE;
+  }
+
+  c = filter_compare(filter, fold, p, len, &(el->lit2));
+  if (c == FILTER_UNKNOWN)
+    return FILTER_UNKNOWN;
+
+  switch (el->op & 0xFC) {
+    case FOP_EQ:
+      return (c == 0) ? FILTER_TRUE : FILTER_FALSE;
+    case FOP_NE:
+      return (c != 0) ? FILTER_TRUE : FILTER_FALSE;
+    case FOP_LT:
+      return (c < 0) ? FILTER_TRUE : FILTER_FALSE;
+    case FOP_LE:
+      return (c <= 0) ? FILTER_TRUE : FILTER_FALSE;
+    case FOP_GE:
+      return (c >= 0) ? FILTER_TRUE : FILTER_FALSE;
+    case FOP_GT:
+      return (c > 0) ? FILTER_TRUE : FILTER_FALSE;
+  }
+
+  return FILTER_UNKNOWN;
+}
+
+/* ======================================================================
+   filter_find()  -  Equality test on multivalued item
+   As FIND, looks for an exact match with any field, value or subvalue. A
+   null item matches a null literal.                                      */
+
+Private int16_t filter_find(DH_FILTER* filter,
+                            DH_FILTER_ELEMENT* el,
+                            char* p,
+                            int32_t len) {
+  char* end;
+  char* lit;
+  int32_t n;
+  bool fold;
+  char c;
+
+  if (len == 0)
+    return (el->lit2.len == 0) ? FILTER_TRUE : FILTER_FALSE;
+
+  fold = (el->op & FOP_NO_CASE) || filter->nocase;
+  end = p + len;
+  do {
+    lit = el->lit2.s;
+    for (n = el->lit2.len; (p < end) && !IsDelim(*p); p++) {
+      if (n < 0)
+        continue; /* Already failed, skip to delimiter */
+
+      c = (fold) ? UpperCase(*p) : *p;
+      if ((n == 0) || (c != ((fold) ? UpperCase(*lit) : *lit)))
+        n = -1;
+      else {
+        lit++;
+        n--;
+      }
+    }
+
+    if (n == 0)
+      return FILTER_TRUE;
+  } while (p++ < end);
+
+  return FILTER_FALSE;
+}
+
+/* ======================================================================
+   filter_compare()  -  Compare value with literal
+   Returns -1, 0 or 1 as for the BASIC relational operators or
+   FILTER_UNKNOWN if the result cannot be determined exactly.             */
+
+Private int16_t filter_compare(DH_FILTER* filter,
+                               bool fold,
+                               char* p,
+                               int32_t len,
+                               DH_FILTER_VALUE* lit) {
+  int64 v;
+  int64 lv;
+  int16_t s;
+  int16_t num;
+  int32_t i;
+  int32_t n;
+  char c;
+  int diff;
+  double d;
+
+  if (len == 0)
+    return (lit->len == 0) ? 0 : -1;
+  if (lit->len == 0)
+    return 1;
+
+  /* Two numeric strings are compared by value. A literal that was a number
+     rather than a string also converts values with spaces, etc, and uses a
+     float comparison so values that are very nearly equal are undecided.  */
+
+  if (lit->num != FN_STRING) {
+    num = filter_number(p, len, &v, &s);
+    if (num == FN_INEXACT)
+      return FILTER_UNKNOWN;
+
+    if (num == FN_STRING) {
+      for (i = 0; i < len; i++) {
+        c = p[i];
+        if (!(((c >= '0') && (c <= '9')) || (c == ' ') || (c == '+') ||
+              (c == '-') || (c == '.') || IsMark(c))) {
+          break;
+        }
+      }
+      if (i == len)
+        return FILTER_UNKNOWN;
+    } else {
+      if (lit->num == FN_INEXACT)
+        return FILTER_UNKNOWN;
+
+      lv = lit->value;
+      if (s < lit->scale) {
+        if (__builtin_mul_overflow(v, dec_tens[lit->scale - s], &v))
+          return FILTER_UNKNOWN;
+        d = ((double)v) / dec_tens[lit->scale];
+      } else {
+        if (__builtin_mul_overflow(lv, dec_tens[s - lit->scale], &lv))
+          return FILTER_UNKNOWN;
+        d = ((double)v) / dec_tens[s];
+      }
+
+      if (v == lv)
+        return 0;
+
+      if (fabs(d - ((double)(lit->value)) / dec_tens[lit->scale]) <= pcfg.fltdiff)
+        return FILTER_UNKNOWN;
+
+      return (v > lv) ? 1 : -1;
+    }
+  }
+
+  /* String comparison. The literal has already been converted to upper
+     case for a NO.CASE test.                                             */
+
+  n = min(len, lit->len);
+  for (i = 0; i < n; i++) {
+    c = (fold) ? UpperCase(p[i]) : p[i];
+    if (filter->nocase)
+      diff = (signed char)(UpperCase(c) - UpperCase(lit->s[i]));
+    else
+      diff = ((u_char)c) - ((u_char)lit->s[i]);
+
+    if (diff != 0)
+      return (diff > 0) ? 1 : -1;
+  }
+
+  return (len > lit->len) - (len < lit->len);
+}
+
+/* ======================================================================
+   filter_number()  -  Examine string as k_is_num() and k_str_to_num()    */
+
+Private int16_t filter_number(char* p,
+                              int32_t len,
+                              int64* value,
+                              int16_t* scale) {
+  int16_t digits = 0; /* Digits before decimal point */
+  bool sign = FALSE;
+  bool negative = FALSE;
+  bool dp = FALSE;
+  bool digit_seen = FALSE;
+  bool exact = TRUE;
+  int64 v = 0;
+  int16_t s = 0;
+  char c;
+
+  while (len-- > 0) {
+    c = *(p++);
+    if ((c >= '0') && (c <= '9')) {
+      digit_seen = TRUE;
+      if (!dp) {
+        if (++digits > 15)
+          return FN_STRING;
+      }
+
+      if (exact) {
+        if ((dp && (s >= DEC_MAX_SCALE)) || (v > (INT64_MAX - 9) / 10))
+          exact = FALSE;
+        else {
+          v = (v * 10) + (c - '0');
+          if (dp)
+            s++;
+        }
+      }
+    } else {
+      switch (c) {
+        case '+':
+        case '-':
+          if (digits || sign)
+            return FN_STRING;
+          sign = TRUE;
+          negative = (c == '-');
+          break;
+
+        case '.':
+          if (dp)
+            return FN_STRING;
+          dp = TRUE;
+          digits++; /* Assume a zero before the decimal point */
+          break;
+
+        default:
+          return FN_STRING;
+      }
+    }
+  }
+
+  if (!digit_seen)
+    return FN_STRING;
+
+  if (!exact)
+    return FN_INEXACT;
+
+  *value = (negative) ? -v : v;
+  *scale = s;
+  return FN_EXACT;
+}
+
+/* ======================================================================
+   filter_value()  -  Set up literal value                                */
+
+Private void filter_value(DH_FILTER_VALUE* v, char* s, bool fold) {
+  char* p;
+
+  if (fold) {
+    for (p = s; *p != '\0'; p++)
+      *p = UpperCase(*p);
+  }
+
+  v->s = s;
+  v->len = strlen(s);
+  v->num = (v->len) ? filter_number(s, v->len, &(v->value), &(v->scale))
+                    : FN_STRING;
+}
+
+/* END-CODE */
@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added ak_key_counts().
+ *
+ * 18Oct26 gwb Added DH_FILTER.C.
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -98,6 +102,7 @@ int32_t dh_hash_group(FILE_ENTRY* dh_file, char* id, int16_t id_len);
 
 /* DH_AK.C */
 bool ak_clear(DH_FILE* dh_file, int16_t subfile);
+bool ak_key_counts(DH_FILE* dh_file, DESCRIPTOR* name_descr, DESCRIPTOR* result);
 
 /* DH_CLEAR.C */
 bool dh_clear(DH_FILE* dh_file);
@@ -148,6 +153,12 @@ void dh_set_subfile(DH_FILE* dh_file, int16_t subfile, OSFILE fu);
 int64 dh_filesize(DH_FILE* dh_file, int16_t subfile);
 bool SetFileSize(OSFILE fu, int64 bytes);
 
+/* DH_FILTER.C */
+typedef struct DH_FILTER DH_FILTER;
+DH_FILTER* dh_filter_compile(char* spec);
+bool dh_filter_test(DH_FILTER* filter, DH_RECORD* rec_ptr);
+void dh_filter_free(DH_FILTER* filter);
+
 /* DH_OPEN.C */
 int16_t get_file_entry(char* filename,
                        u_int32_t device,
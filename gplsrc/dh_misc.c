@@ -21,6 +21,19 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb fcontrol mode 9 (import) rejects files with a trigger, read
+ *             only files and files locked by another user.
+ *
+ * 18Oct26 gwb Added fcontrol mode 14 (index key counts).
+ *
+ * 18Oct26 gwb Added fcontrol modes 12 (record count) and 13 (aggregate).
+ *
+ * 18Oct26 gwb Added fcontrol mode 11 (select filter).
+ *
+ * 18Oct26 gwb Added fcontrol modes 9 (import) and 10 (export).
+ *
+ * 18Oct26 gwb Added fcontrol modes 7 (single pass resize) and 8 (bulk load).
+ *
  * 10Jan22 gwb Fixed some format specifier warnings.
  *
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -52,6 +65,14 @@
 #include "dh_int.h"
 #include "keys.h"
 
+#define BULK_MAX_COLS 1024
+
+Private int16_t bulk_qualifier(char* q,
+                               char** path,
+                               char* delimiter,
+                               int16_t* map,
+                               int16_t* flags);
+
 /* ======================================================================
    op_fcontrol()  -  Miscellaneous file control functions                 */
 
@@ -78,6 +99,27 @@ void op_fcontrol() {
     4   Set file as non-transactional
     5   Force resize
     6   Set/clear DHF_NO_RESIZE flag                New setting
+    7   Resize in one pass                          Modulus, 0 = by load
+    8   Set/clear DHF_BULK_LOAD flag (this process) New setting
+    9   Import delimited file                       See below
+   10   Export delimited file                       See below
+   11   Filter records for next select of file      See dh_filter.c
+   12   Exact record count, -1 if not known
+   13   Accumulate DET.SUPP report                  See dh_aggr.c
+   14   Record counts for each key of an index      Index name
+
+  The import and export qualifier is
+     F1  Pathname of delimited file
+     F2  Delimiter, default comma
+     F3  Column map, multivalued. 0 = id, n = field n, null = skip
+     F4  Flags (BULK_xxx in dh.h)
+  Import returns records written, rejected and skipped as fields 1 to 3.
+  Export returns the number of records written.
+  The select filter returns true if the filter will be applied.
+  The aggregate returns a null string if the report must be processed by
+  the caller.
+  The index key counts are returned in key order as key VM count FM...
+  or a null string if the index cannot be used for this (see ak_key_counts).
  */
 
   DESCRIPTOR* descr;
@@ -90,6 +132,16 @@ void op_fcontrol() {
   int32_t load;
   FILE_ENTRY* fptr;
   int16_t header_lock;
+  char qualifier[MAX_PATHNAME_LEN + 8 * BULK_MAX_COLS + 32];
+  char* path;
+  char* spec;
+  char delimiter;
+  int16_t map[BULK_MAX_COLS];
+  int16_t map_cols;
+  int16_t flags;
+  int32_t written;
+  int32_t rejected;
+  int32_t skipped;
   /* u_char ftype; variable assigned but not used */
   /* bool dynamic; variable assigned but not used */
 
@@ -230,6 +282,127 @@ void op_fcontrol() {
         FreeGroupWriteLock(header_lock);
       }
       break;
+
+    case FC_RESIZE: /* Split/merge to given modulus in one pass */
+      if (fvar->type == DYNAMIC_FILE) {
+        GetInt(descr);
+        modulus = fptr->params.modulus;
+        if (dh_resize(dh_file, descr->data.value)) {
+          result.data.value = (fptr->params.modulus != modulus);
+        } else if (dh_err) {
+          process.status = dh_err;
+        }
+      }
+      break;
+
+    case FC_BULK_LOAD: /* Set/clear DHF_BULK_LOAD flag */
+      if (fvar->type == DYNAMIC_FILE) {
+        GetInt(descr);
+        if (descr->data.value)
+          dh_file->flags |= DHF_BULK_LOAD;
+        else
+          dh_file->flags &= ~DHF_BULK_LOAD;
+      }
+      break;
+
+    case FC_IMPORT: /* Load records from delimited file */
+    case FC_EXPORT: /* Write records to delimited file */
+      if (fvar->type != DYNAMIC_FILE) {
+        process.status = ER_NDYN;
+        break;
+      }
+
+      if (k_get_c_string(descr, qualifier, sizeof(qualifier) - 1) < 0) {
+        process.status = ER_LENGTH;
+        break;
+      }
+
+      map_cols = bulk_qualifier(qualifier, &path, &delimiter, map, &flags);
+
+      if (action == FC_IMPORT) {
+        /* dh_import() bypasses triggers and record locks */
+
+        if (dh_file->trigger_name != NULL) {
+          process.status = ER_TRIGGER;
+          break;
+        }
+
+        if (fvar->flags & FV_RDONLY) {
+          process.status = ER_RDONLY;
+          log_permissions_error(fvar);
+          break;
+        }
+
+        if ((fptr->file_lock > 0) && (fptr->file_lock != process.user_no)) {
+          process.status = ER_LCK;
+          break;
+        }
+
+        if (!dh_import(dh_file, path, delimiter, (map_cols) ? map : NULL,
+                       map_cols, flags, &written, &rejected, &skipped)) {
+          process.status = dh_err;
+        }
+
+        sprintf(qualifier, "%d%c%d%c%d", written, FIELD_MARK, rejected,
+                FIELD_MARK, skipped);
+        k_put_c_string(qualifier, &result);
+      } else {
+        if (!dh_export(dh_file, path, delimiter, (map_cols) ? map : NULL,
+                       map_cols, &written)) {
+          process.status = dh_err;
+        }
+
+        result.data.value = written;
+      }
+      break;
+
+    case FC_SELECT_FILTER: /* Filter for next select of file */
+      if (fvar->type == DYNAMIC_FILE) {
+        k_get_string(descr);
+        spec = alloc_c_string(descr);
+        result.data.value = dh_select_filter(dh_file, spec);
+        k_free(spec);
+      }
+      break;
+
+    case FC_RECORD_COUNT: /* Exact record count */
+      result.data.value = -1;
+      if (fvar->type == DYNAMIC_FILE) {
+        StartExclusive(FILE_TABLE_LOCK, 82);
+        if (fptr->record_count_exact && (fptr->record_count >= 0) &&
+            (fptr->record_count <= INT_MAX)) {
+          result.data.value = (int32_t)(fptr->record_count);
+        }
+        EndExclusive(FILE_TABLE_LOCK);
+      }
+      break;
+
+    case FC_AGGREGATE: /* Accumulate DET.SUPP report */
+      InitDescr(&result, STRING);
+      result.data.str.saddr = NULL;
+      if ((fvar->type == DYNAMIC_FILE) &&
+          !(dh_file->trigger_modes & TRG_READ) &&
+          !(process.txn_id && !(fvar->flags & FV_NON_TXN))) {
+        k_get_string(descr);
+        spec = alloc_c_string(descr);
+        (void)dh_aggregate(dh_file, spec,
+                           (descr->data.str.saddr == NULL)
+                               ? 0
+                               : descr->data.str.saddr->string_len,
+                           &result);
+        k_free(spec);
+      }
+      break;
+
+    case FC_AK_COUNTS: /* Record counts for each key of an index */
+      InitDescr(&result, STRING);
+      result.data.str.saddr = NULL;
+      if ((fvar->type == DYNAMIC_FILE) &&
+          !(dh_file->trigger_modes & TRG_READ) &&
+          !(process.txn_id && !(fvar->flags & FV_NON_TXN))) {
+        (void)ak_key_counts(dh_file, descr, &result);
+      }
+      break;
   }
 
 exit_op_fcontrol:
@@ -240,6 +413,46 @@ exit_op_fcontrol:
   *(e_stack++) = result; /* Move result descriptor to stack */
 }
 
+/* ======================================================================
+   bulk_qualifier()  -  Unpack FCONTROL import/export qualifier
+   Returns number of entries in column map.                               */
+
+Private int16_t bulk_qualifier(char* q,
+                               char** path,
+                               char* delimiter,
+                               int16_t* map,
+                               int16_t* flags) {
+  char* fields[4];
+  char* p;
+  int16_t i;
+  int16_t n = 0;
+
+  for (i = 0; i < 4; i++) {
+    fields[i] = q;
+    if ((p = strchr(q, FIELD_MARK)) != NULL) {
+      *p = '\0';
+      q = p + 1;
+    } else {
+      q += strlen(q);
+    }
+  }
+
+  *path = fields[0];
+  *delimiter = (fields[1][0] != '\0') ? fields[1][0] : ',';
+  *flags = (int16_t)atoi(fields[3]);
+
+  if (*(q = fields[2]) != '\0') {
+    do {
+      map[n++] = ((*q == '\0') || (*q == VALUE_MARK)) ? -1 : (int16_t)atoi(q);
+      if ((p = strchr(q, VALUE_MARK)) == NULL)
+        break;
+      q = p + 1;
+    } while (n < BULK_MAX_COLS);
+  }
+
+  return n;
+}
+
 /* ======================================================================
    op_grpstat()  -  Return information about a file group                 */
 
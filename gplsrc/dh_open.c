@@ -21,6 +21,11 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Clear lock contention statistics when a file table entry is
+ *             reused for a different file, preferring cells without them.
+ *
+ * 18Oct26 gwb get_file_entry() finds files via the file table hash index.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 22Feb20 gwb Replaced a pair of sprintf() with snprintf() in dh_open().
@@ -60,6 +65,11 @@
 #include "qm.h"
 #include "dh_int.h"
 #include "header.h"
+#include "locks.h"
+
+Private volatile int16_t* file_hash_chain(char* filename,
+                                          u_int32_t device,
+                                          u_int32_t inode);
 
 /* ====================================================================== */
 
@@ -462,7 +472,11 @@ int32_t dh_modulus(DH_FILE* dh_file) {
 }
 
 /* ======================================================================
-   Find and reserve a new file table entry                                */
+   Find and reserve a new file table entry
+
+   Entries are chained from the file table hash index by device and inode
+   (pathname if both are zero). A free entry stays on its chain until it
+   is reused so that reopening a recently closed file finds its old cell. */
 
 int16_t get_file_entry(char* filename,
                          u_int32_t device,
@@ -472,6 +486,8 @@ int16_t get_file_entry(char* filename,
   bool found;
   FILE_ENTRY* fptr;
   int16_t file_id;
+  volatile int16_t* chain;
+  bool same_file;
 
   dh_err = 0;
 
@@ -479,31 +495,33 @@ int16_t get_file_entry(char* filename,
   found = FALSE;
   StartExclusive(FILE_TABLE_LOCK, 10);
 
-  for (file_id = 1; file_id <= sysseg->used_files; file_id++) {
+  for (file_id = *file_hash_chain(filename, device, inode); file_id != 0;
+       file_id = fptr->hash_next) {
     fptr = FPtr(file_id);
+    if ((device == 0) && (inode == 0)) /* Compare by name */
+    {
+      if (strcmp((char*)(fptr->pathname), filename) != 0)
+        continue;
+    } else {
+      if ((fptr->inode != inode) || (fptr->device != device))
+        continue;
+    }
+
     if (fptr->ref_ct == 0) {
       if (free_table_entry == 0)
         free_table_entry = file_id;
-    } else {
-      if ((device == 0) && (inode == 0)) /* Compare by name */
-      {
-        if (strcmp((char*)(fptr->pathname), filename) != 0)
-          continue;
-      } else {
-        if ((fptr->inode != inode) || (fptr->device != device))
-          continue;
-      }
+      continue;
+    }
 
-      /* Found a match */
+    /* Found a match */
 
-      if (fptr->ref_ct < 0) /* File already open for exclusive access */
-      {
-        dh_err = DHE_EXCLUSIVE;
-        goto exit_get_file_entry;
-      }
-      found = TRUE;
-      break;
+    if (fptr->ref_ct < 0) /* File already open for exclusive access */
+    {
+      dh_err = DHE_EXCLUSIVE;
+      goto exit_get_file_entry;
     }
+    found = TRUE;
+    break;
   }
 
   if (found) {
@@ -511,6 +529,25 @@ int16_t get_file_entry(char* filename,
     if (my_uptr != NULL)
       (*UFMPtr(my_uptr, file_id))++; /* 0505 */
   } else {
+    same_file = (free_table_entry != 0);
+    if (free_table_entry == 0) {
+      /* While collecting lock contention statistics, prefer a cell that
+        has none so that those for recently closed files are kept.     */
+
+      for (file_id = 1; file_id <= sysseg->used_files; file_id++) {
+        if (FPtr(file_id)->ref_ct == 0) {
+          if (free_table_entry == 0)
+            free_table_entry = file_id;
+          if (!(sysseg->flags & SSF_CONTENTION) ||
+              ((CPtr(file_id)->gl_waits == 0) &&
+               (CPtr(file_id)->rl_waits == 0))) {
+            free_table_entry = file_id;
+            break;
+          }
+        }
+      }
+    }
+
     if (free_table_entry == 0) /* No spare cells */
     {
       if (sysseg->used_files == sysseg->numfiles) {
@@ -521,10 +558,30 @@ int16_t get_file_entry(char* filename,
       free_table_entry = ++(sysseg->used_files);
     }
 
+    /* A free cell found on the hash chain was last used for this same
+      file so its lock contention statistics are kept.                   */
+
+    if (!same_file)
+      contention_clear(free_table_entry);
+
     file_id = free_table_entry;
     fptr = FPtr(free_table_entry);
+
+    /* Remove a previously used cell from its hash chain */
+
+    if (fptr->pathname[0] != '\0') {
+      chain = file_hash_chain((char*)(fptr->pathname), fptr->device, fptr->inode);
+      while (*chain != file_id)
+        chain = &(FPtr(*chain)->hash_next);
+      *chain = fptr->hash_next;
+    }
+
     memset((char*)fptr, 0, sizeof(FILE_ENTRY));
 
+    chain = file_hash_chain(filename, device, inode);
+    fptr->hash_next = *chain;
+    *chain = file_id;
+
     fptr->ref_ct = 1;
     if (my_uptr != NULL)
       (*UFMPtr(my_uptr, file_id))++; /* 0505 */
@@ -574,4 +631,23 @@ exit_get_file_entry:
   return file_id;
 }
 
+/* ======================================================================
+   file_hash_chain()  -  Return head of file table hash chain             */
+
+Private volatile int16_t* file_hash_chain(char* filename,
+                                          u_int32_t device,
+                                          u_int32_t inode) {
+  u_int32_t h = 2166136261u; /* FNV-1a */
+
+  if ((device == 0) && (inode == 0)) {
+    while (*filename != '\0')
+      h = (h ^ (u_char)*(filename++)) * 16777619u;
+  } else {
+    h = (h ^ device) * 16777619u;
+    h = (h ^ inode) * 16777619u;
+  }
+
+  return FileHash(h & (sysseg->file_hash_size - 1));
+}
+
 /* END-CODE */
@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added dh_read_multi().
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686) 
  * 
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -59,6 +61,8 @@ Private void copy(char* data,
                   int16_t bytes,
                   STRING_CHUNK** head,
                   STRING_CHUNK** tail);
+Private bool read_multi_group(DH_FILE* dh_file, DH_MULTI_READ** req, int16_t n);
+Private int cmp_multi_read(const void* a, const void* b);
 
 /* ====================================================================== */
 
@@ -181,6 +185,172 @@ exit_dh_read:
   return head;
 }
 
+/* ======================================================================
+   dh_read_multi()  -  Read several records
+   The requests are sorted by group and the block chain of each group is
+   read once for all requests that hash to it. Split and merge are held
+   off meanwhile so that the group of each record cannot change.
+   Returns FALSE if an error other than record not found occurs.          */
+
+bool dh_read_multi(DH_FILE* dh_file, DH_MULTI_READ* req, int16_t n) {
+  bool status = TRUE;
+  FILE_ENTRY* fptr;
+  DH_MULTI_READ** order;
+  int16_t i;
+  int16_t j;
+
+  for (i = 0; i < n; i++) {
+    req[i].found = FALSE;
+    req[i].data = NULL;
+  }
+
+  if (n == 1) {
+    req->data = dh_read(dh_file, req->id, req->id_len, NULL);
+    req->found = (dh_err == 0);
+    return (dh_err == 0) || (dh_err == DHE_RECORD_NOT_FOUND);
+  }
+
+  dh_err = 0;
+  process.os_error = 0;
+
+  order = (DH_MULTI_READ**)k_alloc(142, n * sizeof(DH_MULTI_READ*));
+  if (order == NULL) {
+    dh_err = DHE_NO_MEM;
+    return FALSE;
+  }
+
+  fptr = FPtr(dh_file->file_id);
+  while (fptr->file_lock < 0)
+    Sleep(1000); /* Clearfile in progress */
+
+  StartExclusive(FILE_TABLE_LOCK, 79);
+  (fptr->inhibit_count)++;
+  for (i = 0; i < n; i++) {
+    order[i] = req + i;
+    req[i].group = dh_hash_group(fptr, req[i].id, req[i].id_len);
+  }
+  fptr->stats.reads += n;
+  sysseg->global_stats.reads += n;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  qsort(order, n, sizeof(DH_MULTI_READ*), cmp_multi_read);
+
+  for (i = 0; status && (i < n); i = j) {
+    for (j = i + 1; (j < n) && (order[j]->group == order[i]->group); j++) {
+    }
+
+    status = read_multi_group(dh_file, order + i, j - i);
+  }
+
+  StartExclusive(FILE_TABLE_LOCK, 80);
+  (fptr->inhibit_count)--;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  k_free(order);
+
+  if (!status) {
+    for (i = 0; i < n; i++) {
+      if (req[i].data != NULL) {
+        s_free(req[i].data);
+        req[i].data = NULL;
+      }
+      req[i].found = FALSE;
+    }
+  }
+
+  return status;
+}
+
+/* ======================================================================
+   read_multi_group()  -  Find all requests for one group                 */
+
+Private bool read_multi_group(DH_FILE* dh_file, DH_MULTI_READ** req, int16_t n) {
+  bool status = TRUE;
+  int16_t group_bytes;
+  int16_t lock_slot;
+  DH_BLOCK* buff;
+  DH_RECORD* rec_ptr;
+  FILE_ENTRY* fptr;
+  int16_t subfile;
+  int16_t rec_offset;
+  int16_t used_bytes;
+  int32_t grp;
+  int16_t remaining;
+  int16_t i;
+  DH_MULTI_READ* r;
+
+  buff = (DH_BLOCK*)(&dh_buffer);
+  fptr = FPtr(dh_file->file_id);
+  group_bytes = (int16_t)(dh_file->group_size);
+
+  grp = req[0]->group;
+  StartExclusive(FILE_TABLE_LOCK, 81);
+  lock_slot = GetGroupReadLock(dh_file, grp);
+  EndExclusive(FILE_TABLE_LOCK);
+
+  subfile = PRIMARY_SUBFILE;
+  remaining = n;
+
+  do {
+    if (!dh_read_group(dh_file, subfile, grp, (char*)buff, group_bytes)) {
+      status = FALSE;
+      break;
+    }
+
+    used_bytes = buff->used_bytes;
+    if ((used_bytes == 0) || (used_bytes > group_bytes)) {
+      log_printf(
+          "DH_READ_MULTI: Invalid byte count (x%04X) in subfile %d, group "
+          "%d\nof file %s\n",
+          used_bytes, (int)subfile, grp, fptr->pathname);
+      dh_err = DHE_POINTER_ERROR;
+      status = FALSE;
+      break;
+    }
+
+    rec_offset = offsetof(DH_BLOCK, record);
+    while (rec_offset < used_bytes) {
+      rec_ptr = (DH_RECORD*)(((char*)buff) + rec_offset);
+
+      for (i = 0; i < n; i++) {
+        r = req[i];
+        if (!r->found && (r->id_len == rec_ptr->id_len) &&
+            ((fptr->flags & DHF_NOCASE)
+                 ? !MemCompareNoCase(r->id, rec_ptr->id, r->id_len)
+                 : !memcmp(r->id, rec_ptr->id, r->id_len))) {
+          r->found = TRUE;
+          r->data = dh_read_record(dh_file, rec_ptr);
+          remaining--;
+        }
+      }
+
+      if (remaining == 0)
+        goto exit_read_multi_group;
+
+      rec_offset += rec_ptr->next;
+    }
+
+    /* Move to next group buffer */
+
+    subfile = OVERFLOW_SUBFILE;
+    grp = GetFwdLink(dh_file, buff->next);
+  } while (grp != 0);
+
+exit_read_multi_group:
+  FreeGroupReadLock(lock_slot);
+
+  return status;
+}
+
+/* ====================================================================== */
+
+Private int cmp_multi_read(const void* a, const void* b) {
+  int32_t ga = (*((DH_MULTI_READ**)a))->group;
+  int32_t gb = (*((DH_MULTI_READ**)b))->group;
+
+  return (ga > gb) - (ga < gb);
+}
+
 /* ====================================================================== */
 
 STRING_CHUNK* dh_read_record(DH_FILE* dh_file, DH_RECORD* rec_ptr) {
@@ -21,6 +21,16 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb The record count is only marked exact if no write or delete
+ *             is still to adjust it.
+ *
+ * 18Oct26 gwb Mark the file table record count exact after a full select.
+ *
+ * 18Oct26 gwb Added dh_select_filter() to drop records that cannot satisfy
+ *             a query while scanning the groups.
+ *
+ * 18Oct26 gwb In-place string updates clear the cached numeric value.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -41,6 +51,7 @@
  *
  * dh_select()         Set up select list operation
  * dh_readkey()        Get next key
+ * dh_select_filter()  Set filter for next select of a file
  *
  * END-DESCRIPTION
  *
@@ -54,6 +65,38 @@
 Private int64 rec_ct[HIGH_SELECT + 1];
 Private int64 load_bytes[HIGH_SELECT + 1];
 Private u_int32_t upd_ct[HIGH_SELECT + 1];
+Private DH_FILTER* select_filter[HIGH_SELECT + 1];
+
+/* Filter set by dh_select_filter(), waiting for the select to start */
+
+Private DH_FILTER* pending_filter = NULL;
+Private DH_FILE* pending_file = NULL;
+
+Private void end_select_filter(int16_t list_no);
+
+/* ======================================================================
+   Set filter for next select of given file
+   Returns TRUE if the filter can be applied.                             */
+
+bool dh_select_filter(DH_FILE* dh_file, char* spec) {
+  dh_filter_free(pending_filter);
+  pending_filter = NULL;
+  pending_file = NULL;
+
+  /* Records must be tested as the query processor will see them */
+
+  if ((dh_file->flags & DHF_TRIGGER) && (dh_file->trigger_modes & TRG_READ))
+    return FALSE;
+
+  if (process.txn_id != 0)
+    return FALSE;
+
+  if ((pending_filter = dh_filter_compile(spec)) == NULL)
+    return FALSE;
+
+  pending_file = dh_file;
+  return TRUE;
+}
 
 /* ======================================================================
    Start select on given file                                             */
@@ -76,6 +119,15 @@ bool dh_select(DH_FILE* dh_file, /* File descriptor */
   select_ftype[list_no] = SEL_DH;
   select_file[list_no] = dh_file;
 
+  end_select_filter(list_no);
+  if (pending_file == dh_file) {
+    select_filter[list_no] = pending_filter;
+    pending_filter = NULL;
+  }
+  dh_filter_free(pending_filter); /* Set for some other file */
+  pending_filter = NULL;
+  pending_file = NULL;
+
   fptr = FPtr(dh_file->file_id);
 
   StartExclusive(FILE_TABLE_LOCK, 12);
@@ -201,15 +253,19 @@ void dh_complete_select(int16_t list_no) {
         while (rec_offset < used_bytes) {
           rec_ptr = (DH_RECORD*)(((char*)buff) + rec_offset);
 
-          /* Add this record to the list */
+          /* Add this record to the list unless the filter rejects it */
 
-          if (head == NULL)
-            ts_init(&head, 256); /* 0370 */
+          if ((select_filter[list_no] == NULL) ||
+              dh_filter_test(select_filter[list_no], rec_ptr)) {
+            if (head == NULL)
+              ts_init(&head, 256); /* 0370 */
 
-          if (record_count != 0)
-            ts_copy_byte(FIELD_MARK);
+            if (record_count != 0)
+              ts_copy_byte(FIELD_MARK);
 
-          ts_copy(rec_ptr->id, rec_ptr->id_len);
+            ts_copy(rec_ptr->id, rec_ptr->id_len);
+            record_count++;
+          }
 
           /* Maintain the record counts. These two variables are not
               necessarily equal. Record_count is a count of items in the
@@ -218,9 +274,9 @@ void dh_complete_select(int16_t list_no) {
               did a few READNEXT operations (which call dh-select_group),
               and then decided to do a READLIST for the rest. Many of the
               standard QM command do something of this sort when they
-              query the user about use of an active list.                  */
+              query the user about use of an active list. A filtered
+              select lists fewer records than rec_ct counts.               */
 
-          record_count++;
           rec_ct[list_no]++;
           load_bytes[list_no] += rec_ptr->next;
           rec_offset += rec_ptr->next;
@@ -250,19 +306,26 @@ void dh_complete_select(int16_t list_no) {
         }
         str->next = head;
         list_descr->data.str.saddr->string_len += head->string_len;
+        list_descr->data.str.saddr->num_flags = 0;
       }
 
       count_descr->data.value = record_count;
 
-      /* We can use the accumulated record count to update the file header */
+      /* We can use the accumulated record count to update the file header.
+         A write or delete that updated its group before the select started
+         may still be to adjust record_count so the count is only exact if
+         there are none outstanding.                                      */
 
+      StartExclusive(FILE_TABLE_LOCK, 85);
       if ((upd_ct[list_no] == fptr->upd_ct)  /* File has not changed... */
           && !(dh_file->flags & DHF_RDONLY)) /* ...and is not read-only */
       {
         dh_file->flags |= FILE_UPDATED;
         fptr->record_count = rec_ct[list_no];
+        fptr->record_count_exact = (fptr->updates_pending == 0);
         fptr->params.load_bytes = load_bytes[list_no];
       }
+      EndExclusive(FILE_TABLE_LOCK);
     }
 
   exit_dh_complete_select:
@@ -276,6 +339,7 @@ void dh_complete_select(int16_t list_no) {
     select_ftype[list_no] = SEL_NONE;
     select_file[list_no] = NULL;
     select_group[list_no] = 0;
+    end_select_filter(list_no);
   }
 }
 
@@ -294,6 +358,7 @@ void dh_end_select(int16_t list_no) {
     select_ftype[list_no] = SEL_NONE;
     select_group[list_no] = 0;
     select_file[list_no] = NULL;
+    end_select_filter(list_no);
   }
 }
 
@@ -318,9 +383,16 @@ void dh_end_select_file(DH_FILE* dh_file) {
         select_ftype[i] = SEL_NONE;
         select_file[i] = NULL;
         select_group[i] = 0;
+        end_select_filter(i);
       }
     }
   }
+
+  if (pending_file == dh_file) {
+    dh_filter_free(pending_filter);
+    pending_filter = NULL;
+    pending_file = NULL;
+  }
 }
 
 /* ====================================================================== */
@@ -374,15 +446,19 @@ bool dh_select_group(DH_FILE* dh_file, /* File descriptor */
       while (rec_offset < used_bytes) {
         rec_ptr = (DH_RECORD*)(((char*)buff) + rec_offset);
 
-        /* Add this record to the list */
+        /* Add this record to the list unless the filter rejects it */
 
-        if (head == NULL)
-          ts_init(&head, 256);
-        else
-          ts_copy_byte(FIELD_MARK);
+        if ((select_filter[list_no] == NULL) ||
+            dh_filter_test(select_filter[list_no], rec_ptr)) {
+          if (head == NULL)
+            ts_init(&head, 256);
+          else
+            ts_copy_byte(FIELD_MARK);
+
+          ts_copy(rec_ptr->id, rec_ptr->id_len);
+          record_count++;
+        }
 
-        ts_copy(rec_ptr->id, rec_ptr->id_len);
-        record_count++;
         rec_ct[list_no]++;
 
         rec_offset += rec_ptr->next;
@@ -431,6 +507,7 @@ bool dh_select_group(DH_FILE* dh_file, /* File descriptor */
     {
       dh_file->flags |= FILE_UPDATED;
       fptr->record_count = rec_ct[list_no];
+      fptr->record_count_exact = (fptr->updates_pending == 0);
       fptr->params.load_bytes = load_bytes[list_no];
     }
 
@@ -440,10 +517,18 @@ bool dh_select_group(DH_FILE* dh_file, /* File descriptor */
     select_ftype[list_no] = SEL_NONE;
     select_group[list_no] = 0;
     select_file[list_no] = NULL;
+    end_select_filter(list_no);
   }
 
 exit_dh_select_group:
   return status;
 }
 
+/* ====================================================================== */
+
+Private void end_select_filter(int16_t list_no) {
+  dh_filter_free(select_filter[list_no]);
+  select_filter[list_no] = NULL;
+}
+
 /* END-CODE */
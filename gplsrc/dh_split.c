@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Split the group rehashing out of dh_split() and dh_merge() and
+ *             added dh_resize() to take a file to a new modulus in a single
+ *             sequential pass.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686) 
  * 
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -34,6 +38,9 @@
  *
  * START-DESCRIPTION:
  *
+ *  dh_split           Split one group (called from write/delete)
+ *  dh_merge           Merge one group (called from write/delete)
+ *  dh_resize          Split or merge to a given modulus in one pass
  *
  * END-DESCRIPTION
  *
@@ -43,6 +50,21 @@
 #include "qm.h"
 #include "dh_int.h"
 
+Private bool split_group(DH_FILE* dh_file,
+                         int32_t group,
+                         int32_t new_group,
+                         DH_BLOCK* src_buff,
+                         DH_BLOCK* tgt_buff[2]);
+Private bool merge_group(DH_FILE* dh_file,
+                         int32_t src_group,
+                         int32_t tgt_group,
+                         DH_BLOCK* src_buff,
+                         DH_BLOCK* tgt_buff);
+
+/* Number of groups processed by dh_resize() between header updates */
+
+#define RESIZE_FLUSH_INTERVAL 1024
+
 /* ====================================================================== */
 
 void dh_split(DH_FILE* dh_file) {
@@ -51,18 +73,10 @@ void dh_split(DH_FILE* dh_file) {
   int32_t load;
   int16_t group_bytes;
 
-  /* Record being processed... */
-  char id[MAX_ID_LEN + 1];
-
   /* Group to split... */
   DH_BLOCK* src_buff = NULL; /* Source buffer */
   int16_t src_group_lock = 0;
-  int32_t group;    /* Group number */
-  int16_t subfile; /* File part and... */
-  int32_t sgrp;     /* ...position in source group */
-  int16_t used_bytes;
-  int16_t rec_offset;
-  DH_RECORD* rec_ptr;
+  int32_t group; /* Group number */
 
   /* Group to be created... */
   int16_t new_group_lock = 0;
@@ -71,12 +85,7 @@ void dh_split(DH_FILE* dh_file) {
   /* Target groups... */
   int16_t tgt; /* Index to following items */
   DH_BLOCK* tgt_buff[2] = {NULL, NULL};
-  int16_t tgt_subfile[2];
-  int32_t tgt_group[2];
-  int16_t reqd_bytes;
-  int16_t space;
   u_int32_t file_size;
-  int32_t next_tgt_group;
 
   fptr = FPtr(dh_file->file_id);
   group_bytes = (int16_t)(dh_file->group_size);
@@ -147,103 +156,11 @@ void dh_split(DH_FILE* dh_file) {
     if ((tgt_buff[tgt] = (DH_BLOCK*)k_alloc(13, group_bytes)) == NULL) {
       goto exit_dh_split;
     }
-
-    tgt_buff[tgt]->next = 0;
-    tgt_buff[tgt]->used_bytes = BLOCK_HEADER_SIZE;
-    tgt_buff[tgt]->block_type = DHT_DATA;
   }
   dh_err = 0;
 
-  /* Process source group */
-
-  subfile = PRIMARY_SUBFILE;
-  sgrp = group;
-
-  tgt_subfile[0] = PRIMARY_SUBFILE;
-  tgt_group[0] = group;
-
-  tgt_subfile[1] = PRIMARY_SUBFILE;
-  tgt_group[1] = new_group;
-
-  do {
-    /* Read group */
-
-    if (!dh_read_group(dh_file, subfile, sgrp, (char*)src_buff, group_bytes)) {
-      goto exit_dh_split;
-    }
-
-    /* Scan group buffer for records */
-
-    used_bytes = src_buff->used_bytes;
-    if ((used_bytes == 0) || (used_bytes > group_bytes)) {
-      log_printf(
-          "DH_SPLIT: Invalid byte count (x%04X) in subfile %d, group %d\nof "
-          "file %s\n",
-          used_bytes, (int)subfile, sgrp, fptr->pathname);
-      dh_err = DHE_POINTER_ERROR;
-      goto exit_dh_split;
-    }
-
-    rec_offset = offsetof(DH_BLOCK, record);
-    while (rec_offset < used_bytes) {
-      rec_ptr = (DH_RECORD*)(((char*)src_buff) + rec_offset);
-
-      memcpy(id, rec_ptr->id, rec_ptr->id_len);
-
-      /* Write record to appropriate new group buffer */
-
-      tgt = (dh_hash_group(fptr, id, rec_ptr->id_len) == new_group) ? 1 : 0;
-
-      reqd_bytes = rec_ptr->next;
-      space = group_bytes - tgt_buff[tgt]->used_bytes;
-      if (reqd_bytes > space) /* Flush buffer and make an overflow block */
-      {
-        next_tgt_group = dh_get_overflow(dh_file, FALSE);
-
-        if (next_tgt_group == 0) {
-          /* Cannot allocate overflow block */
-          goto exit_dh_split;
-        }
-
-        tgt_buff[tgt]->next = SetFwdLink(dh_file, next_tgt_group);
-
-        if (!dh_write_group(dh_file, tgt_subfile[tgt], tgt_group[tgt],
-                            (char*)tgt_buff[tgt], group_bytes)) {
-          goto exit_dh_split;
-        }
-
-        tgt_subfile[tgt] = OVERFLOW_SUBFILE;
-        tgt_group[tgt] = next_tgt_group;
-        memset((char*)(tgt_buff[tgt]), '\0', group_bytes);
-        tgt_buff[tgt]->used_bytes = BLOCK_HEADER_SIZE;
-        tgt_buff[tgt]->block_type = DHT_DATA;
-      }
-
-      memcpy(((char*)(tgt_buff[tgt])) + tgt_buff[tgt]->used_bytes,
-             (char*)rec_ptr, reqd_bytes);
-      tgt_buff[tgt]->used_bytes += reqd_bytes;
-      rec_offset += rec_ptr->next;
-    }
-
-    /* If this was an overflow block, give it away */
-
-    if (subfile == OVERFLOW_SUBFILE) {
-      dh_free_overflow(dh_file, sgrp);
-    }
-
-    /* Move to next group buffer */
-
-    subfile = OVERFLOW_SUBFILE;
-    sgrp = GetFwdLink(dh_file, src_buff->next);
-  } while (sgrp != 0);
-
-  /* All done. Flush both output buffers */
-
-  for (tgt = 0; tgt < 2; tgt++) {
-    if (!dh_write_group(dh_file, tgt_subfile[tgt], tgt_group[tgt],
-                        (char*)tgt_buff[tgt], group_bytes)) {
-      goto exit_dh_split;
-    }
+  if (!split_group(dh_file, group, new_group, src_buff, tgt_buff)) {
+    goto exit_dh_split;
   }
 
   /* Update file header */
@@ -278,25 +195,16 @@ void dh_merge(DH_FILE* dh_file) {
   int32_t modulus;
   int32_t load;
   int16_t group_bytes;
-  int16_t rec_bytes;
 
   /* Source group... */
   int32_t src_group;
   int16_t src_lock = 0;
   DH_BLOCK* src_buff = NULL;
-  int16_t src_subfile;
-  int32_t sgrp;
-  int16_t src_used_bytes;
-  int16_t src_rec_offset;
-  DH_RECORD* src_rec_ptr;
 
   /* Target group... */
   int32_t tgt_group;
   int16_t tgt_lock = 0;
   DH_BLOCK* tgt_buff = NULL;
-  int16_t tgt_subfile;
-  int32_t tgrp;
-  int32_t next_tgt_group;
   int32_t n;
 
   fptr = FPtr(dh_file->file_id);
@@ -366,6 +274,372 @@ void dh_merge(DH_FILE* dh_file) {
     goto exit_dh_merge;
   dh_err = 0;
 
+  if (!merge_group(dh_file, src_group, tgt_group, src_buff, tgt_buff)) {
+    goto exit_dh_merge;
+  }
+
+  /* Update file header */
+
+  dh_file->flags |= FILE_UPDATED;
+  dh_flush_header(dh_file);
+
+exit_dh_merge:
+  if (src_lock != 0)
+    FreeGroupWriteLock(src_lock);
+  if (tgt_lock != 0)
+    FreeGroupWriteLock(tgt_lock);
+
+  /* Decrement the inhibit count now that we have finished */
+
+  StartExclusive(FILE_TABLE_LOCK, 35);
+  (fptr->inhibit_count)--;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  if (src_buff != NULL)
+    k_free(src_buff);
+  if (tgt_buff != NULL)
+    k_free(tgt_buff);
+}
+
+/* ======================================================================
+   dh_resize()  -  Split or merge to a given modulus
+
+   A target modulus of zero takes the file to the modulus implied by its
+   current load and split/merge settings, as repeated calls to dh_split()
+   and dh_merge() would, but without repeating the buffer allocation and
+   header update for every group. Linear hashing always splits the lowest
+   unsplit group into a new group at the end of the primary subfile so the
+   whole operation is a single sequential pass over the file.
+
+   Other users may continue to access the file. Each step takes the same
+   group locks as dh_split() and dh_merge() and the inhibit count is held
+   for the duration so that no other process starts a split or merge.
+
+   Returns FALSE if the file is already held off by an active select or
+   another split/merge, or on error (dh_err set).                         */
+
+bool dh_resize(DH_FILE* dh_file, int32_t new_modulus) {
+  bool status = FALSE;
+  FILE_ENTRY* fptr;
+  int32_t modulus;
+  int32_t load;
+  int16_t group_bytes;
+  u_int32_t file_size;
+  int32_t group;
+  int32_t new_group;
+  int16_t lock1;
+  int16_t lock2;
+  DH_BLOCK* src_buff = NULL;
+  DH_BLOCK* tgt_buff[2] = {NULL, NULL};
+  int16_t tgt;
+  bool split;
+  bool ok;
+  int32_t n;
+  int32_t steps = 0;
+
+  dh_err = 0;
+
+  fptr = FPtr(dh_file->file_id);
+  group_bytes = (int16_t)(dh_file->group_size);
+
+  StartExclusive(FILE_TABLE_LOCK, 76);
+  if (fptr->inhibit_count != 0) {
+    EndExclusive(FILE_TABLE_LOCK);
+    return FALSE;
+  }
+  (fptr->inhibit_count)++;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  dh_err = DHE_NO_MEM;
+  if ((src_buff = (DH_BLOCK*)k_alloc(12, group_bytes)) == NULL)
+    goto exit_dh_resize;
+
+  for (tgt = 0; tgt < 2; tgt++) {
+    if ((tgt_buff[tgt] = (DH_BLOCK*)k_alloc(13, group_bytes)) == NULL) {
+      goto exit_dh_resize;
+    }
+  }
+  dh_err = 0;
+
+  do {
+    StartExclusive(FILE_TABLE_LOCK, 77);
+
+    modulus = fptr->params.modulus;
+    if (new_modulus > 0) {
+      /* Never merge below the minimum modulus */
+
+      n = (new_modulus > fptr->params.min_modulus) ? new_modulus
+                                                   : fptr->params.min_modulus;
+      if (modulus < n) {
+        split = TRUE;
+      } else if (modulus > n) {
+        split = FALSE;
+      } else {
+        EndExclusive(FILE_TABLE_LOCK);
+        break;
+      }
+    } else {
+      load = DHLoad(fptr->params.load_bytes, group_bytes, modulus);
+      if ((load > fptr->params.split_load) ||
+          (modulus < fptr->params.min_modulus)) {
+        split = TRUE;
+      } else if ((load < fptr->params.merge_load) &&
+                 (modulus > fptr->params.min_modulus) &&
+                 (DHLoad(fptr->params.load_bytes, group_bytes, modulus - 1) <
+                  fptr->params.split_load)) {
+        split = FALSE;
+      } else {
+        EndExclusive(FILE_TABLE_LOCK);
+        break;
+      }
+    }
+
+    if (split) {
+      if (dh_file->file_version < 2) {
+        /* Check that we are not about to go over 2Gb */
+
+        file_size = DHHeaderSize(dh_file->file_version, group_bytes);
+        file_size += (u_int32_t)(modulus + 1) * group_bytes;
+        if (file_size > (u_int32_t)0x80000000L) {
+          EndExclusive(FILE_TABLE_LOCK);
+          break;
+        }
+      }
+
+      /* As dh_split(), lock the new group before releasing the file table */
+
+      new_group = ++(fptr->params.modulus);
+      if (new_group > fptr->params.mod_value)
+        fptr->params.mod_value <<= 1;
+      group = (new_group - 1) - (fptr->params.mod_value >> 1) + 1;
+
+      lock1 = GetGroupWriteLock(dh_file, new_group);
+      fptr->stats.splits++;
+      sysseg->global_stats.splits++;
+      EndExclusive(FILE_TABLE_LOCK);
+
+      lock2 = GetGroupWriteLock(dh_file, group);
+      ok = split_group(dh_file, group, new_group, src_buff, tgt_buff);
+    } else {
+      /* As dh_merge(), adjust the parameters before releasing the file
+        table lock.                                                     */
+
+      group = modulus;
+      new_group = (group - 1) - (fptr->params.mod_value >> 1) + 1;
+
+      lock1 = GetGroupWriteLock(dh_file, new_group);
+      lock2 = GetGroupWriteLock(dh_file, group);
+      fptr->stats.merges++;
+      sysseg->global_stats.merges++;
+
+      n = fptr->params.mod_value >> 1;
+      if ((--(fptr->params.modulus)) == n)
+        fptr->params.mod_value = n;
+
+      EndExclusive(FILE_TABLE_LOCK);
+
+      ok = merge_group(dh_file, group, new_group, src_buff, tgt_buff[0]);
+    }
+
+    FreeGroupWriteLock(lock2);
+    FreeGroupWriteLock(lock1);
+
+    if (!ok)
+      goto exit_dh_resize;
+
+    /* Keep the on-disk modulus reasonably current without rewriting the
+      header for every group.                                            */
+
+    if ((++steps % RESIZE_FLUSH_INTERVAL) == 0) {
+      dh_file->flags |= FILE_UPDATED;
+      dh_flush_header(dh_file);
+    }
+  } while (1);
+
+  status = TRUE;
+
+exit_dh_resize:
+  if (steps != 0) {
+    dh_file->flags |= FILE_UPDATED;
+    dh_flush_header(dh_file);
+  }
+
+  StartExclusive(FILE_TABLE_LOCK, 78);
+  (fptr->inhibit_count)--;
+  EndExclusive(FILE_TABLE_LOCK);
+
+  if (src_buff != NULL)
+    k_free(src_buff);
+  if (tgt_buff[0] != NULL)
+    k_free(tgt_buff[0]);
+  if (tgt_buff[1] != NULL)
+    k_free(tgt_buff[1]);
+
+  return status;
+}
+
+/* ======================================================================
+   split_group()  -  Rehash group into itself and new_group
+   Caller holds write locks on both groups.                               */
+
+Private bool split_group(DH_FILE* dh_file,
+                         int32_t group,
+                         int32_t new_group,
+                         DH_BLOCK* src_buff,
+                         DH_BLOCK* tgt_buff[2]) {
+  FILE_ENTRY* fptr;
+  int16_t group_bytes;
+
+  /* Record being processed... */
+  char id[MAX_ID_LEN + 1];
+
+  /* Group to split... */
+  int16_t subfile; /* File part and... */
+  int32_t sgrp;    /* ...position in source group */
+  int16_t used_bytes;
+  int16_t rec_offset;
+  DH_RECORD* rec_ptr;
+
+  /* Target groups... */
+  int16_t tgt; /* Index to following items */
+  int16_t tgt_subfile[2];
+  int32_t tgt_group[2];
+  int16_t reqd_bytes;
+  int16_t space;
+  int32_t next_tgt_group;
+
+  fptr = FPtr(dh_file->file_id);
+  group_bytes = (int16_t)(dh_file->group_size);
+
+  for (tgt = 0; tgt < 2; tgt++) {
+    tgt_buff[tgt]->next = 0;
+    tgt_buff[tgt]->used_bytes = BLOCK_HEADER_SIZE;
+    tgt_buff[tgt]->block_type = DHT_DATA;
+  }
+
+  /* Process source group */
+
+  subfile = PRIMARY_SUBFILE;
+  sgrp = group;
+
+  tgt_subfile[0] = PRIMARY_SUBFILE;
+  tgt_group[0] = group;
+
+  tgt_subfile[1] = PRIMARY_SUBFILE;
+  tgt_group[1] = new_group;
+
+  do {
+    /* Read group */
+
+    if (!dh_read_group(dh_file, subfile, sgrp, (char*)src_buff, group_bytes)) {
+      return FALSE;
+    }
+
+    /* Scan group buffer for records */
+
+    used_bytes = src_buff->used_bytes;
+    if ((used_bytes == 0) || (used_bytes > group_bytes)) {
+      log_printf(
+          "DH_SPLIT: Invalid byte count (x%04X) in subfile %d, group %d\nof "
+          "file %s\n",
+          used_bytes, (int)subfile, sgrp, fptr->pathname);
+      dh_err = DHE_POINTER_ERROR;
+      return FALSE;
+    }
+
+    rec_offset = offsetof(DH_BLOCK, record);
+    while (rec_offset < used_bytes) {
+      rec_ptr = (DH_RECORD*)(((char*)src_buff) + rec_offset);
+
+      memcpy(id, rec_ptr->id, rec_ptr->id_len);
+
+      /* Write record to appropriate new group buffer */
+
+      tgt = (dh_hash_group(fptr, id, rec_ptr->id_len) == new_group) ? 1 : 0;
+
+      reqd_bytes = rec_ptr->next;
+      space = group_bytes - tgt_buff[tgt]->used_bytes;
+      if (reqd_bytes > space) /* Flush buffer and make an overflow block */
+      {
+        next_tgt_group = dh_get_overflow(dh_file, FALSE);
+
+        if (next_tgt_group == 0) {
+          /* Cannot allocate overflow block */
+          return FALSE;
+        }
+
+        tgt_buff[tgt]->next = SetFwdLink(dh_file, next_tgt_group);
+
+        if (!dh_write_group(dh_file, tgt_subfile[tgt], tgt_group[tgt],
+                            (char*)tgt_buff[tgt], group_bytes)) {
+          return FALSE;
+        }
+
+        tgt_subfile[tgt] = OVERFLOW_SUBFILE;
+        tgt_group[tgt] = next_tgt_group;
+        memset((char*)(tgt_buff[tgt]), '\0', group_bytes);
+        tgt_buff[tgt]->used_bytes = BLOCK_HEADER_SIZE;
+        tgt_buff[tgt]->block_type = DHT_DATA;
+      }
+
+      memcpy(((char*)(tgt_buff[tgt])) + tgt_buff[tgt]->used_bytes,
+             (char*)rec_ptr, reqd_bytes);
+      tgt_buff[tgt]->used_bytes += reqd_bytes;
+      rec_offset += rec_ptr->next;
+    }
+
+    /* If this was an overflow block, give it away */
+
+    if (subfile == OVERFLOW_SUBFILE) {
+      dh_free_overflow(dh_file, sgrp);
+    }
+
+    /* Move to next group buffer */
+
+    subfile = OVERFLOW_SUBFILE;
+    sgrp = GetFwdLink(dh_file, src_buff->next);
+  } while (sgrp != 0);
+
+  /* All done. Flush both output buffers */
+
+  for (tgt = 0; tgt < 2; tgt++) {
+    if (!dh_write_group(dh_file, tgt_subfile[tgt], tgt_group[tgt],
+                        (char*)tgt_buff[tgt], group_bytes)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* ======================================================================
+   merge_group()  -  Append src_group to tgt_group and release src_group
+   Caller holds write locks on both groups.                               */
+
+Private bool merge_group(DH_FILE* dh_file,
+                         int32_t src_group,
+                         int32_t tgt_group,
+                         DH_BLOCK* src_buff,
+                         DH_BLOCK* tgt_buff) {
+  FILE_ENTRY* fptr;
+  int16_t group_bytes;
+  int16_t rec_bytes;
+
+  /* Source group... */
+  int16_t src_subfile;
+  int32_t sgrp;
+  int16_t src_used_bytes;
+  int16_t src_rec_offset;
+  DH_RECORD* src_rec_ptr;
+
+  /* Target group... */
+  int16_t tgt_subfile;
+  int32_t tgrp;
+  int32_t next_tgt_group;
+
+  fptr = FPtr(dh_file->file_id);
+  group_bytes = (int16_t)(dh_file->group_size);
+
   /* Find end of target group */
 
   tgt_subfile = PRIMARY_SUBFILE;
@@ -373,7 +647,7 @@ void dh_merge(DH_FILE* dh_file) {
   while (1) {
     if (!dh_read_group(dh_file, tgt_subfile, tgrp, (char*)tgt_buff,
                        group_bytes)) {
-      goto exit_dh_merge;
+      return FALSE;
     }
 
     if (tgt_buff->next == 0)
@@ -390,7 +664,7 @@ void dh_merge(DH_FILE* dh_file) {
   while (sgrp != 0) {
     if (!dh_read_group(dh_file, src_subfile, sgrp, (char*)src_buff,
                        group_bytes)) {
-      goto exit_dh_merge;
+      return FALSE;
     }
 
     /* Copy records to target group */
@@ -402,7 +676,7 @@ void dh_merge(DH_FILE* dh_file) {
           "file %s\n",
           src_used_bytes, (int)src_subfile, sgrp, fptr->pathname);
       dh_err = DHE_POINTER_ERROR;
-      goto exit_dh_merge;
+      return FALSE;
     }
 
     src_rec_offset = offsetof(DH_BLOCK, record);
@@ -415,14 +689,14 @@ void dh_merge(DH_FILE* dh_file) {
         next_tgt_group = dh_get_overflow(dh_file, FALSE);
         if (next_tgt_group == 0) {
           /* Cannot allocate overflow block */
-          goto exit_dh_merge;
+          return FALSE;
         }
 
         tgt_buff->next = SetFwdLink(dh_file, next_tgt_group);
 
         if (!dh_write_group(dh_file, tgt_subfile, tgrp, (char*)tgt_buff,
                             group_bytes)) {
-          goto exit_dh_merge;
+          return FALSE;
         }
 
         tgt_subfile = OVERFLOW_SUBFILE;
@@ -454,7 +728,7 @@ void dh_merge(DH_FILE* dh_file) {
 
   if (!dh_write_group(dh_file, tgt_subfile, tgrp, (char*)tgt_buff,
                       group_bytes)) {
-    goto exit_dh_merge;
+    return FALSE;
   }
 
   /* Clear and write back the released primary group to mark it as free space */
@@ -462,30 +736,10 @@ void dh_merge(DH_FILE* dh_file) {
   memset((char*)src_buff, 0, group_bytes);
   if (!dh_write_group(dh_file, PRIMARY_SUBFILE, src_group, (char*)src_buff,
                       group_bytes)) {
-    goto exit_dh_merge;
+    return FALSE;
   }
 
-  /* Update file header */
-
-  dh_file->flags |= FILE_UPDATED;
-  dh_flush_header(dh_file);
-
-exit_dh_merge:
-  if (src_lock != 0)
-    FreeGroupWriteLock(src_lock);
-  if (tgt_lock != 0)
-    FreeGroupWriteLock(tgt_lock);
-
-  /* Decrement the inhibit count now that we have finished */
-
-  StartExclusive(FILE_TABLE_LOCK, 35);
-  (fptr->inhibit_count)--;
-  EndExclusive(FILE_TABLE_LOCK);
-
-  if (src_buff != NULL)
-    k_free(src_buff);
-  if (tgt_buff != NULL)
-    k_free(tgt_buff);
+  return TRUE;
 }
 
 /* END-CODE */
@@ -21,6 +21,11 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Count the write in updates_pending until record_count has
+ *             been adjusted.
+ *
+ * 18Oct26 gwb Do not merge while the file is in bulk load mode.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686) 
  * 
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -101,6 +106,7 @@ bool dh_write(DH_FILE* dh_file,       /* File descriptor */
   STRING_CHUNK* rec; /* Data as written to file (possibly encrypted) */
   char u_id[MAX_ID_LEN];
   bool found = FALSE;
+  bool update_pending = FALSE;
 
   dh_err = 0;
   process.os_error = 0;
@@ -171,6 +177,8 @@ bool dh_write(DH_FILE* dh_file,       /* File descriptor */
   group = dh_hash_group(fptr, id, id_len);
   lock_slot = GetGroupWriteLock(dh_file, group);
   fptr->upd_ct++;
+  fptr->updates_pending++;
+  update_pending = TRUE;
   EndExclusive(FILE_TABLE_LOCK);
 
   /* Now search for old record of same id */
@@ -469,20 +477,23 @@ exit_dh_write:
 
   /* Adjust load value and record count */
 
-  if (dh_err == 0) {
+  if (update_pending) {
     StartExclusive(FILE_TABLE_LOCK, 21);
-    if ((load_change >= 0) ||
-        ((int64)(-load_change) <= fptr->params.load_bytes)) {
-      fptr->params.load_bytes += load_change;
-    } else {
-      fptr->params.load_bytes = 0;
-    }
-    if (id_len > fptr->params.longest_id)
-      fptr->params.longest_id = id_len;
+    if (dh_err == 0) {
+      if ((load_change >= 0) ||
+          ((int64)(-load_change) <= fptr->params.load_bytes)) {
+        fptr->params.load_bytes += load_change;
+      } else {
+        fptr->params.load_bytes = 0;
+      }
+      if (id_len > fptr->params.longest_id)
+        fptr->params.longest_id = id_len;
 
-    if (!found && fptr->record_count >= 0)
-      fptr->record_count += 1;
+      if (!found && fptr->record_count >= 0)
+        fptr->record_count += 1;
+    }
 
+    fptr->updates_pending--;
     EndExclusive(FILE_TABLE_LOCK);
   }
 
@@ -504,7 +515,8 @@ exit_dh_write:
       {
         dh_split(dh_file);
       } else if ((load < fptr->params.merge_load) &&
-                 (modulus > fptr->params.min_modulus)) {
+                 (modulus > fptr->params.min_modulus) &&
+                 !(dh_file->flags & DHF_BULK_LOAD)) {
         /* Looks like we need to merge but check won't immediately split */
         load = DHLoad(fptr->params.load_bytes, group_bytes, modulus - 1);
         if (load < fptr->params.split_load) /* Would not immediately split */
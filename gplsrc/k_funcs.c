@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added DECIMAL type. k_str_to_num() converts decimal strings
+ *             and integers too large for 32 bits to exact decimals.
+ *
+ * 18Oct26 gwb k_str_to_num() and k_is_num() keep their result in the string
+ *             so that later uses of an unchanged string do not parse it.
+ *
  * 29Feb20 gwb Changed LONG_MAX to INT32_MAX.  When building for a 64 bit 
  *             platform, the LONG_MAX constant overflows the size of the
  *             int32_t variable type.  This change needed to be made across
@@ -299,6 +305,10 @@ void k_get_bool(DESCRIPTOR* p) {
       result = (p->data.float_value != 0.0);
       break;
 
+    case DECIMAL:
+      result = (p->data.dec.value != 0);
+      break;
+
     case STRING:
     case SELLIST:
       if ((str = p->data.str.saddr) == NULL)
@@ -437,6 +447,10 @@ void k_get_float(DESCRIPTOR* p) {
     case FLOATNUM:
       break;
 
+    case DECIMAL:
+      dec_to_float(p);
+      break;
+
     case STRING:
     case SELLIST:
       if (!k_str_to_num(p))
@@ -444,7 +458,8 @@ void k_get_float(DESCRIPTOR* p) {
       if (p->type == INTEGER) {
         InitDescr(p, FLOATNUM);
         p->data.float_value = (double)(p->data.value);
-      }
+      } else
+        DecToFloat(p);
       break;
 
     case UNASSIGNED:
@@ -478,6 +493,10 @@ void k_get_int(DESCRIPTOR* p) {
     case INTEGER:
       break;
 
+    case DECIMAL:
+      dec_to_float(p);
+      /* **** FALL THROUGH **** */
+
     case FLOATNUM:
       if (fabs(p->data.float_value) > INT32_MAX) {
         k_error(sysmsg(1220));
@@ -499,6 +518,7 @@ void k_get_int(DESCRIPTOR* p) {
     case SELLIST:
       if (!k_str_to_num(p))
         k_non_numeric_zero(descr, p);
+      DecToFloat(p);
       if (p->type == FLOATNUM) {
         if (fabs(p->data.float_value) > INT32_MAX) {
           k_error(sysmsg(1220));
@@ -535,6 +555,10 @@ void k_get_int32(DESCRIPTOR* p) {
     case INTEGER:
       break;
 
+    case DECIMAL:
+      dec_to_float(p);
+      /* **** FALL THROUGH **** */
+
     case FLOATNUM:
       if (pcfg.intprec) {
         if (p->data.float_value < 0) {
@@ -552,6 +576,7 @@ void k_get_int32(DESCRIPTOR* p) {
     case SELLIST:
       if (!k_str_to_num(p))
         k_non_numeric_zero(descr, p);
+      DecToFloat(p);
       if (p->type == FLOATNUM) {
         InitDescr(p, INTEGER);
         p->data.value = (int32_t)p->data.float_value;
@@ -584,6 +609,7 @@ void k_get_num(DESCRIPTOR* p) {
   {
     case INTEGER: /* Nothing to do for these types */
     case FLOATNUM:
+    case DECIMAL:
       break;
 
     case STRING:
@@ -617,6 +643,7 @@ void k_get_string(DESCRIPTOR* p) {
   {
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
       k_num_to_str(p);
       break;
 
@@ -657,6 +684,7 @@ void k_get_value(DESCRIPTOR* p) {
   {
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
     case SUBR:
     case STRING:
     case FILE_REF:
@@ -691,6 +719,7 @@ void k_incr_refct(DESCRIPTOR* p) {
     case ADDR:
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
     case PMATRIX:
     case OBJCD:
     case OBJCDX:
@@ -746,6 +775,7 @@ void k_incr_refct(DESCRIPTOR* p) {
 
 bool k_is_num(DESCRIPTOR* p) {
   bool status = FALSE;
+  STRING_CHUNK* first_chunk;
   STRING_CHUNK* str_hdr;
   register char c;
   int16_t i;
@@ -755,10 +785,16 @@ bool k_is_num(DESCRIPTOR* p) {
   char* q;
   bool digit_seen = FALSE;
 
-  str_hdr = p->data.str.saddr;
-  if (str_hdr == NULL)
-    goto is_numeric;
+  first_chunk = p->data.str.saddr;
+  if (first_chunk == NULL)
+    return TRUE;
+
+  if (first_chunk->num_flags & SNF_IS_NUM)
+    return TRUE;
+  if (first_chunk->num_flags & SNF_NOT_IS_NUM)
+    return FALSE;
 
+  str_hdr = first_chunk;
   do {
     for (i = str_hdr->bytes, q = str_hdr->data; i > 0; i--) {
       c = *(q++);
@@ -795,10 +831,10 @@ bool k_is_num(DESCRIPTOR* p) {
   if (!digit_seen)
     goto non_numeric;
 
-is_numeric:
   status = TRUE;
 
 non_numeric:
+  first_chunk->num_flags |= (status) ? SNF_IS_NUM : SNF_NOT_IS_NUM;
   return status;
 }
 
@@ -1126,6 +1162,11 @@ void k_num_to_str(DESCRIPTOR* p) {
           *(q + 1) = '\0';
       }
       break;
+
+    case DECIMAL:
+      dec_to_str(p->data.dec.value, p->data.dec.scale,
+                 process.program.precision, s);
+      break;
   }
 
   s_len = strlen(s);
@@ -1212,6 +1253,7 @@ void k_release(DESCRIPTOR* p) {
     case ADDR:
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
     case OBJCD:
       break;
 
@@ -1317,7 +1359,7 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
   bool status = FALSE;
   STRING_CHUNK* str_chnk;
   STRING_CHUNK* first_chunk;
-  register char c;
+  register char c = '\0';
   int16_t i;
   bool negative;    /* Negative value? */
   int16_t digits; /* Digits before decimal point */
@@ -1326,6 +1368,8 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
   int32_t value;
   double float_value;
   double dplace;
+  int64 dec_value; /* Exact value of float... */
+  bool exact;      /* ...if this is still TRUE */
   char* q;
   u_char reuse_flag;
   bool num_array;
@@ -1337,12 +1381,46 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
   value = 0;
   negative = FALSE;
   floating = FALSE;
+  exact = TRUE;
   trailing_space = FALSE;
 
   reuse_flag = p->flags & DF_REUSE; /* Preserve reuse flag */
 
   first_chunk = p->data.str.saddr; /* Remember start of chain for later */
   if (first_chunk != NULL) {
+    /* Use the result of an earlier conversion of this string if we have one */
+
+    switch (first_chunk->num_flags & (SNF_INT | SNF_FLOAT | SNF_DECIMAL | SNF_NOT_NUM)) {
+      case SNF_INT:
+        value = first_chunk->num.value;
+        k_deref_string(first_chunk);
+        InitDescr(p, INTEGER);
+        p->data.value = value;
+        p->flags |= reuse_flag;
+        return TRUE;
+
+      case SNF_FLOAT:
+        float_value = first_chunk->num.float_value;
+        k_deref_string(first_chunk);
+        InitDescr(p, FLOATNUM);
+        p->data.float_value = float_value;
+        p->flags |= reuse_flag;
+        return TRUE;
+
+      case SNF_DECIMAL:
+        dec_value = first_chunk->num.dec_value;
+        dp = first_chunk->num_flags >> SNF_SCALE_SHIFT;
+        k_deref_string(first_chunk);
+        InitDescr(p, DECIMAL);
+        p->data.dec.value = dec_value;
+        p->data.dec.scale = dp;
+        p->flags |= reuse_flag;
+        return TRUE;
+
+      case SNF_NOT_NUM:
+        return FALSE;
+    }
+
     digits = 0;
     str_chnk = first_chunk;
     do {
@@ -1354,6 +1432,15 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
             goto non_numeric;
 
           if (floating) {
+            /* Also collect the digits as a decimal while they fit */
+
+            if (exact) {
+              if ((dp >= DEC_MAX_SCALE) || (dec_value > (INT64_MAX - 9) / 10))
+                exact = FALSE;
+              else
+                dec_value = (dec_value * 10) + (c - '0');
+            }
+
             if (dp >= 0) /* We have seen decimal point */
             {
               if (dplace != 0.0) {
@@ -1373,6 +1460,7 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
               /* Must convert to float */
               floating = TRUE;
               float_value = ((double)value * 10) + c;
+              dec_value = ((int64)value * 10) + c;
               dp = -1; /* -ve implies not seen decimal point */
             } else {
               value = temp;
@@ -1389,6 +1477,7 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
           value = 0;
           negative = FALSE;
           floating = FALSE;
+          exact = TRUE;
           trailing_space = FALSE;
         } else if (c == ' ') {
           /* Leading and trailing spaces are ignored but embedded
@@ -1421,6 +1510,7 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
               } else {
                 floating = TRUE;
                 float_value = (double)value;
+                dec_value = value;
               }
 
               dp = 0;
@@ -1445,23 +1535,57 @@ bool k_str_to_num(DESCRIPTOR* p) /* Returns FALSE if cannot convert */
     if ((digits | dp) == 0)
       goto non_numeric;
 
+    if (negative) {
+      if (floating) {
+        float_value = -float_value;
+        dec_value = -dec_value;
+      } else
+        value = -value;
+    }
+
+    if (dp < 0)
+      dp = 0;
+
+    /* Remember the value in the string for next time */
+
+    if (floating && exact) {
+      first_chunk->num.dec_value = dec_value;
+      first_chunk->num_flags |= SNF_DECIMAL | (dp << SNF_SCALE_SHIFT);
+    } else if (floating) {
+      first_chunk->num.float_value = float_value;
+      first_chunk->num_flags |= SNF_FLOAT;
+    } else {
+      first_chunk->num.value = value;
+      first_chunk->num_flags |= SNF_INT;
+    }
+
     /* Release string chunks */
 
     k_deref_string(first_chunk); /* 0160  Moved to after non-numeric test */
   }
 
-  if (floating) {
+  if (floating && exact) {
+    InitDescr(p, DECIMAL);
+    p->data.dec.value = dec_value;
+    p->data.dec.scale = dp;
+  } else if (floating) {
     InitDescr(p, FLOATNUM);
-    p->data.float_value = (negative) ? -float_value : float_value;
+    p->data.float_value = float_value;
   } else {
     InitDescr(p, INTEGER);
-    p->data.value = (negative) ? -value : value;
+    p->data.value = value;
   }
 
   p->flags |= reuse_flag;
-  status = TRUE;
+  return TRUE;
 
 non_numeric:
+  /* A mark may make this a numeric array elsewhere so only remember
+    failures caused by other characters.                               */
+
+  if ((first_chunk != NULL) && !IsMark(c))
+    first_chunk->num_flags |= SNF_NOT_NUM;
+
   return status;
 }
 
@@ -1591,6 +1715,9 @@ u_int32_t GetUnsignedInt(DESCRIPTOR* descr) {
     case FLOATNUM:
       return (u_int32_t)(q->data.float_value);
 
+    case DECIMAL:
+      return (u_int32_t)(q->data.dec.value / dec_tens[q->data.dec.scale]);
+
     case STRING:
       ivalue = 0;
       str = q->data.str.saddr;
@@ -21,6 +21,15 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Clear lock wait ticket and wake flag of a reused user slot.
+ *
+ * 18Oct26 gwb Clear lock wait queue ticket on abort.
+ *
+ * 18Oct26 gwb Added OPSTATS instrumented dispatch loop, counting executions and
+ *             cycles per opcode.
+ *
+ * 18Oct26 gwb EVT_HSM_DUMP also returns folded stack samples as HS<user>.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686)
  *  
  * 09Jan22 gwb Added a 64 bit target check to fatal_signal_handler() in order
@@ -142,6 +151,13 @@
 
 #include <sys/wait.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define OpcodeClock() __rdtsc()
+#else
+#define OpcodeClock() opcode_clock()
+#endif
+
 Private void init_program(void);
 
 jmp_buf k_exit;
@@ -171,10 +187,30 @@ void (*dispatch[])(void) = {
 };
 #undef _opc_
 
+/* Build opcode name table */
+
+#define _opc_(code, key, name, func, format, stack_use) name,
+char* opcode_name[] = {
+#include "opcodes.h"
+};
+#undef _opc_
+
+/* Opcode statistics, collected when OPSTATS is set. Cycles are taken from
+   the processor time stamp counter where available and are inclusive of
+   any recursive code run by the opcode (I-types, triggers, etc).         */
+
+Private u_int64 opcode_count[NUM_OPCODES];
+Private u_int64 opcode_cycles[NUM_OPCODES];
+Private u_int64 opcode_flushed_count[NUM_OPCODES];  /* Already merged... */
+Private u_int64 opcode_flushed_cycles[NUM_OPCODES]; /* ...into sysseg */
+
 Private void kill_process(void);
 Private void unwind_stack(void);
 Private void k_release_vars(void);
 Private void dump_status(void);
+#if !defined(__x86_64__) && !defined(__i386__)
+Private u_int64 opcode_clock(void);
+#endif
 
 typedef void (*signal_handler)();
 void fatal_signal_handler(int signum);
@@ -257,6 +293,8 @@ bool init_kernel() {
     my_uptr->events = 0;
     my_uptr->flags = 0;
     my_uptr->lockwait_index = 0;
+    my_uptr->lockwait_ticket = 0;
+    my_uptr->lockwait_wake = 0;
     my_uptr->ttyname[0] = '\0';
 
     /* Ensure file map table is all zero */
@@ -422,7 +460,7 @@ void kernel() {
 
     switch (k_exit_cause) {
       case K_ABORT:
-        if (my_uptr->lockwait_index)
+        if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
           clear_lockwait();
         collation = primary_collation; /* Clear down use of AK collation map */
         txn_abort();
@@ -526,6 +564,9 @@ Private void kill_process() {
 
   como_close(); /* Close any como file and free buffer */
 
+  if (pcfg.opstats)
+    opcode_stats_flush();
+
   StartExclusive(SHORT_CODE, 22);
 
   /* Release licence */
@@ -547,13 +588,30 @@ void k_run_program() /* Returns FALSE if aborts */
   recursion_depth++;
 
   do {
-    while (!k_exit_cause) {
-      dispatch[*(op_pc = pc++)]();
+    if (pcfg.opstats) {
+      /* Instrumented loop. Prefixed opcodes are counted against the
+        secondary opcode.                                               */
+
+      u_int16_t opcode;
+      u_int64 t;
+
+      while (!k_exit_cause) {
+        t = OpcodeClock();
+        if ((opcode = *(op_pc = pc++)) == PREFIX_OPCODE)
+          opcode = 256 + *(pc++);
+        dispatch[opcode]();
+        opcode_count[opcode]++;
+        opcode_cycles[opcode] += OpcodeClock() - t;
+      }
+    } else {
+      while (!k_exit_cause) {
+        dispatch[*(op_pc = pc++)]();
+      }
     }
 
     switch (k_exit_cause) {
       case K_CHAIN_PROC:
-        if (my_uptr->lockwait_index)
+        if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
           clear_lockwait();
 
         if (recursion_depth) {
@@ -573,7 +631,7 @@ void k_run_program() /* Returns FALSE if aborts */
         break;
 
       case K_STOP:
-        if (my_uptr->lockwait_index)
+        if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
           clear_lockwait();
 
         /* Cast off all programs down to but not including one with
@@ -606,7 +664,7 @@ void k_run_program() /* Returns FALSE if aborts */
         break;
 
       case K_CHAIN:
-        if (my_uptr->lockwait_index)
+        if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
           clear_lockwait();
 
         if (recursion_depth) {
@@ -628,7 +686,7 @@ void k_run_program() /* Returns FALSE if aborts */
       case K_ABORT:
       case K_LOGOUT:
       case K_TERMINATE:
-        if (my_uptr->lockwait_index)
+        if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
           clear_lockwait();
         Element(process.syscom, SYSCOM_ITYPE_MODE)->data.value = 0;
         longjmp(k_exit, k_exit_cause);
@@ -672,6 +730,59 @@ exit_run_program:
   return;
 }
 
+/* ======================================================================
+   opcode_stats_flush()  -  Merge opcode statistics into shared memory    */
+
+void opcode_stats_flush() {
+  int i;
+
+  StartExclusive(SHORT_CODE, 79);
+  for (i = 0; i < NUM_OPCODES; i++) {
+    sysseg->opcode_count[i] += opcode_count[i] - opcode_flushed_count[i];
+    sysseg->opcode_cycles[i] += opcode_cycles[i] - opcode_flushed_cycles[i];
+  }
+  EndExclusive(SHORT_CODE);
+
+  memcpy(opcode_flushed_count, opcode_count, sizeof(opcode_count));
+  memcpy(opcode_flushed_cycles, opcode_cycles, sizeof(opcode_cycles));
+}
+
+/* ======================================================================
+   opcode_stats()  -  Return opcode statistics for this process
+   One field per executed opcode: name VM executions VM cycles           */
+
+STRING_CHUNK* opcode_stats() {
+  STRING_CHUNK* str;
+  int i;
+
+  str = NULL;
+  ts_init(&str, 1024);
+  for (i = 0; i < NUM_OPCODES; i++) {
+    if (opcode_count[i]) {
+      if (str != NULL)
+        ts_copy_byte(FIELD_MARK);
+      ts_printf("%s%c%llu%c%llu", opcode_name[i], VALUE_MARK,
+                (unsigned long long)opcode_count[i], VALUE_MARK,
+                (unsigned long long)opcode_cycles[i]);
+    }
+  }
+  ts_terminate();
+
+  return str;
+}
+
+#if !defined(__x86_64__) && !defined(__i386__)
+/* ======================================================================
+   opcode_clock()  -  Monotonic nanoseconds where there is no TSC         */
+
+Private u_int64 opcode_clock() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((u_int64)ts.tv_sec) * 1000000000) + ts.tv_nsec;
+}
+#endif
+
 /* ======================================================================
    op_prefix()  -  Secondary dispatch                                     */
 
@@ -1096,7 +1207,7 @@ void process_events() {
 
   if (events & EVT_HSM_ON) /* Enable HSM in this process */
   {
-    hsm_on();
+    hsm_on(TRUE);
   }
 
   if (events & EVT_HSM_DUMP) /* Return HSM data */
@@ -1105,7 +1216,12 @@ void process_events() {
     if ((ipc_descr->type == FILE_REF) &&
         ((fvar = ipc_descr->data.fvar) != NULL) &&
         ((dh_file = fvar->access.dh.dh_file) != NULL)) {
-      str = hsm_dump();
+      str = hsm_dump(HSM_DUMP_SAMPLES);
+      sprintf(id, "HS%d", (int)process.user_no);
+      dh_write(dh_file, id, strlen(id), str);
+      s_free(str);
+
+      str = hsm_dump(HSM_DUMP_PROGRAMS);
       sprintf(id, "H%d", (int)process.user_no);
       dh_write(dh_file, id, strlen(id), str);
       s_free(str);
@@ -167,6 +167,19 @@
 #define K_SETUID             54
 #define K_SETGID             55
 #define K_RUNEXE             56
+#define K_CONTENTION         57
+#define K_MERGE_LIST       1001
+
+/* K_MERGE_LIST modes */
+#define MERGE_UNION           1
+#define MERGE_INTERSECTION    2
+#define MERGE_DIFFERENCE      3
+
+/* K_CONTENTION modes */
+#define CONTENTION_REPORT     0
+#define CONTENTION_RESET      1
+#define CONTENTION_ON         2
+#define CONTENTION_OFF        3
 
 /* PTERM() function action keys */
 #define PT_BREAK              1
@@ -340,6 +353,14 @@
 #define FC_NON_TXN               4    /* Set open file as non-transactional */
 #define FC_SPLIT_MERGE           5    /* Force split/merge */
 #define FC_NO_RESIZE             6    /* Set DHF_NO_RESIZE flag */
+#define FC_RESIZE                7    /* Resize to given modulus in one pass */
+#define FC_BULK_LOAD             8    /* Set/clear DHF_BULK_LOAD flag */
+#define FC_IMPORT                9    /* Load records from delimited file */
+#define FC_EXPORT               10    /* Write records to delimited file */
+#define FC_SELECT_FILTER        11    /* Filter for next select of file */
+#define FC_RECORD_COUNT         12    /* Exact record count, -1 if unknown */
+#define FC_AGGREGATE            13    /* Accumulate DET.SUPP report */
+#define FC_AK_COUNTS            14    /* Record counts for each index key */
 
 
 /* END-CODE */
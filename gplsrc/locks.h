@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Local lock table is now a hash table with per file chains.
+ *
+ * 18Oct26 gwb Added lock contention table.
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -79,17 +83,29 @@ struct RLOCK_ENTRY {
    The table is maintained by lock_record() and unlock_record() in
    op_lock.c. There is an event (EVT_REBUILD_LLT) that is raised by the
    UNLOCK command to rebuild the local lock table if a lock is released
-   in another process by an administrator.                                */
+   in another process by an administrator.
+   Entries are held in a hash table keyed by file number and record id,
+   doubling in size as the number of locks grows, and are also linked
+   into a chain for each file so that releasing all locks on a file takes
+   time proportional to the number of locks on that file.                 */
 
 typedef struct LLT_ENTRY LLT_ENTRY;
 struct LLT_ENTRY {
-  LLT_ENTRY* next;    /* Next local lock table entry */
-  int16_t fno;        /* File table index */
-  int16_t id_len;     /* Length of record id */
-  int32_t fvar_index; /* Links lock to specific instance of file */
-  char id[1];         /* The record id */
+  LLT_ENTRY* next;      /* Next entry on same hash chain */
+  LLT_ENTRY* file_next; /* Next entry for same file... */
+  LLT_ENTRY* file_prev; /* ...and previous entry */
+  int32_t id_hash;      /* Record's hash value */
+  int16_t fno;          /* File table index */
+  int16_t id_len;       /* Length of record id */
+  int32_t fvar_index;   /* Links lock to specific instance of file */
+  char id[1];           /* The record id */
 };
-Public LLT_ENTRY* llt_head init(NULL);
+Public LLT_ENTRY** llt_hash init(NULL);  /* Hash table... */
+Public int32_t llt_hash_size init(0);    /* ...size (power of two)... */
+Public int32_t llt_count init(0);        /* ...and number of entries */
+Public LLT_ENTRY** llt_files init(NULL); /* File chains, by file number */
+
+#define LLTHash(f, h) ((((u_int32_t)(h)) ^ (f)) & (llt_hash_size - 1))
 
 /* ==================== GROUP LOCKS ==================== */
 
@@ -129,7 +145,57 @@ struct GLOCK_ENTRY {
 
 #define AKRlock(akno, key) ((((int32_t)akno) << 16) | key | 0x20000000L)
 
+/* ================== LOCK CONTENTION ================== */
+
+/* Per file lock contention statistics, one entry for each file table entry.
+   Collected only while SSF_CONTENTION is set (LIST.CONTENTION ON). Group
+   lock counters are protected by GROUP_LOCK_SEM, record lock counters by
+   REC_LOCK_SEM. Wait times are in microseconds. Histogram bucket n counts
+   waits of 2^n to 2^(n+1)-1 uS, the last bucket counting all longer waits.
+   The hot record slots hold the most waited for records, keyed by id hash.
+   When all slots are in use, the least waited for record is replaced and
+   its count inherited so counts may be overstated for recent arrivals.   */
+
+#define CONTENTION_BUCKETS 24
+#define CONTENTION_HOT 8     /* Hot record slots per file */
+#define CONTENTION_ID_LEN 32 /* Record id bytes kept for reporting */
+
+struct CONTENTION_RECORD {
+  int32_t id_hash;  /* Record's hash value */
+  u_int32_t waits;  /* Number of waits for this record */
+  int16_t id_len;   /* Length of id[], zero if slot is free */
+  char id[CONTENTION_ID_LEN];
+};
+
+typedef volatile struct CONTENTION_ENTRY CONTENTION_ENTRY;
+struct CONTENTION_ENTRY {
+  u_int32_t gl_waits;    /* Group locks blocked on first attempt */
+  u_int32_t gl_retries;  /* Group locks blocked on subsequent attempt */
+  u_int32_t gl_wait_max; /* Longest group lock wait */
+  u_int64 gl_wait_time;  /* Total group lock wait time */
+  u_int32_t gl_hist[CONTENTION_BUCKETS];
+  u_int32_t rl_waits;    /* Record lock waits */
+  u_int32_t rl_wait_max; /* Longest record lock wait */
+  u_int64 rl_wait_time;  /* Total record lock wait time */
+  u_int32_t rl_hist[CONTENTION_BUCKETS];
+  struct CONTENTION_RECORD hot[CONTENTION_HOT];
+};
+
+#define CPtr(n) \
+  (((CONTENTION_ENTRY*)(((char*)sysseg) + sysseg->contention_table)) + ((n)-1))
+
 void clear_waiters(int16_t idx);
 void clear_lockwait(void);
+void wake_waiters(void);
+
+int64 contention_clock(void);
+void contention_group_wait(int16_t file_id, bool retry);
+void contention_group_time(int16_t file_id, int64 started);
+void contention_record_wait(int16_t file_id, int32_t hash_value, char* id, int16_t id_len);
+void contention_record_time(int16_t file_id, int64 started);
+void contention_clear(int16_t file_id);
+void contention_reset(void);
+u_int32_t contention_percentile(volatile u_int32_t* hist, int pct);
+void contention_report(STRING_CHUNK** str);
 
 /* END-CODE */
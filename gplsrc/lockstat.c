@@ -0,0 +1,307 @@
+/* LOCKSTAT.C
+ * Lock contention statistics.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ * Per file group and record lock contention statistics, held in the
+ * contention table of the shared segment (see locks.h). Collection is
+ * controlled by the SSF_CONTENTION flag, set by LIST.CONTENTION ON. The
+ * lock routines only call the recording functions below when a lock has
+ * actually blocked and the flag is set, so there is no cost on the normal
+ * uncontended path.
+ *
+ *    contention_clock
+ *    contention_group_wait
+ *    contention_group_time
+ *    contention_record_wait
+ *    contention_record_time
+ *    contention_clear
+ *    contention_reset
+ *    contention_percentile
+ *    contention_report
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "locks.h"
+
+#include <time.h>
+
+Private void contention_time(volatile u_int32_t* hist,
+                             volatile u_int32_t* wait_max,
+                             volatile u_int64* wait_time,
+                             int64 started);
+Private void report_times(volatile u_int32_t* hist, u_int64 wait_time,
+                          u_int32_t wait_max);
+
+/* ======================================================================
+   contention_clock()  -  Monotonic time in microseconds                  */
+
+int64 contention_clock() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((int64)ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* ======================================================================
+   contention_group_wait()  -  Count a blocked group lock attempt
+   Must be called with GROUP_LOCK_SEM held.                               */
+
+void contention_group_wait(int16_t file_id, bool retry) {
+  CONTENTION_ENTRY* cptr;
+
+  cptr = CPtr(file_id);
+  if (retry)
+    (cptr->gl_retries)++;
+  else
+    (cptr->gl_waits)++;
+}
+
+/* ======================================================================
+   contention_group_time()  -  Record time spent waiting for a group lock
+   Must be called with GROUP_LOCK_SEM held.                               */
+
+void contention_group_time(int16_t file_id, int64 started) {
+  CONTENTION_ENTRY* cptr;
+
+  cptr = CPtr(file_id);
+  contention_time(cptr->gl_hist, &(cptr->gl_wait_max), &(cptr->gl_wait_time),
+                  started);
+}
+
+/* ======================================================================
+   contention_record_wait()  -  Count a record lock wait
+   Must be called with REC_LOCK_SEM held.                                 */
+
+void contention_record_wait(int16_t file_id,
+                            int32_t hash_value,
+                            char* id,
+                            int16_t id_len) {
+  CONTENTION_ENTRY* cptr;
+  struct CONTENTION_RECORD* hot;
+  struct CONTENTION_RECORD* least;
+  int i;
+
+  cptr = CPtr(file_id);
+  (cptr->rl_waits)++;
+
+  least = NULL;
+  for (i = 0, hot = (struct CONTENTION_RECORD*)(cptr->hot); i < CONTENTION_HOT;
+       i++, hot++) {
+    if (hot->id_len == 0) { /* Free slot - Record not present */
+      least = hot;
+      least->waits = 0;
+      break;
+    }
+
+    if (hot->id_hash == hash_value) {
+      (hot->waits)++;
+      return;
+    }
+
+    if ((least == NULL) || (hot->waits < least->waits))
+      least = hot;
+  }
+
+  /* Take a free slot or replace the least waited for record */
+
+  least->id_hash = hash_value;
+  (least->waits)++;
+  least->id_len = min(id_len, CONTENTION_ID_LEN);
+  memcpy(least->id, id, least->id_len);
+}
+
+/* ======================================================================
+   contention_record_time()  -  Record time spent waiting for a record lock
+   Must be called with REC_LOCK_SEM held.                                 */
+
+void contention_record_time(int16_t file_id, int64 started) {
+  CONTENTION_ENTRY* cptr;
+
+  cptr = CPtr(file_id);
+  contention_time(cptr->rl_hist, &(cptr->rl_wait_max), &(cptr->rl_wait_time),
+                  started);
+}
+
+/* ======================================================================
+   contention_clear()  -  Clear statistics for a reused file table entry
+   Must be called with FILE_TABLE_LOCK held.                              */
+
+void contention_clear(int16_t file_id) {
+  memset((char*)CPtr(file_id), 0, sizeof(CONTENTION_ENTRY));
+}
+
+/* ======================================================================
+   contention_reset()  -  Clear all contention statistics                 */
+
+void contention_reset() {
+  StartExclusive(REC_LOCK_SEM, 83);
+  StartExclusive(GROUP_LOCK_SEM, 84);
+
+  memset((char*)CPtr(1), 0, sysseg->numfiles * sizeof(CONTENTION_ENTRY));
+  sysseg->contention_reset = qmtime();
+
+  EndExclusive(GROUP_LOCK_SEM);
+  EndExclusive(REC_LOCK_SEM);
+}
+
+/* ======================================================================
+   contention_percentile()  -  Estimate wait time percentile
+   Returns the upper bound of the histogram bucket holding the pct'th
+   percentile in microseconds, zero if there have been no waits.          */
+
+u_int32_t contention_percentile(volatile u_int32_t* hist, int pct) {
+  u_int64 total = 0;
+  u_int64 target;
+  int i;
+
+  for (i = 0; i < CONTENTION_BUCKETS; i++)
+    total += hist[i];
+  if (total == 0)
+    return 0;
+
+  target = ((total * pct) + 99) / 100;
+  for (i = 0, total = 0; i < CONTENTION_BUCKETS - 1; i++) {
+    total += hist[i];
+    if (total >= target)
+      break;
+  }
+
+  return ((u_int32_t)2 << i) - 1;
+}
+
+/* ======================================================================
+   contention_report()  -  Build KERNEL(K$CONTENTION, 0) report
+
+   F1  Collecting? VM Time of last reset (qmtime() form)
+   F2+ One field for each file with any waits:
+       V1  Pathname
+       V2  Group lock waits
+       V3  Group lock retries
+       V4  Group lock wait time (uS)
+       V5  Longest group lock wait (uS)
+       V6  Group lock wait 50th percentile (uS)
+       V7  ...90th percentile
+       V8  ...99th percentile
+       V9  Record lock waits
+       V10 Record lock wait time (uS)
+       V11 Longest record lock wait (uS)
+       V12 Record lock wait 50th percentile (uS)
+       V13 ...90th percentile
+       V14 ...99th percentile
+       V15 Hot record ids, most waited for first, subvalue mark delimited
+       V16 Corresponding wait counts                                      */
+
+void contention_report(STRING_CHUNK** str) {
+  int16_t file_id;
+  CONTENTION_ENTRY* cptr;
+  struct CONTENTION_RECORD* hot[CONTENTION_HOT];
+  struct CONTENTION_RECORD* p;
+  int16_t num_hot;
+  int16_t i;
+  int16_t j;
+
+  ts_init(str, 1024);
+  ts_printf("%d\xfd%d", (sysseg->flags & SSF_CONTENTION) != 0,
+            sysseg->contention_reset);
+
+  for (file_id = 1; file_id <= sysseg->used_files; file_id++) {
+    cptr = CPtr(file_id);
+    if ((cptr->gl_waits == 0) && (cptr->rl_waits == 0))
+      continue;
+
+    ts_copy_byte(FIELD_MARK);
+    ts_copy_c_string((char*)(FPtr(file_id)->pathname));
+    ts_printf("\xfd%u\xfd%u", cptr->gl_waits, cptr->gl_retries);
+    report_times(cptr->gl_hist, cptr->gl_wait_time, cptr->gl_wait_max);
+    ts_printf("\xfd%u", cptr->rl_waits);
+    report_times(cptr->rl_hist, cptr->rl_wait_time, cptr->rl_wait_max);
+
+    /* Hot records, most waited for first (insertion sort) */
+
+    num_hot = 0;
+    for (i = 0; i < CONTENTION_HOT; i++) {
+      p = (struct CONTENTION_RECORD*)&(cptr->hot[i]);
+      if (p->id_len == 0)
+        break;
+      for (j = num_hot++; (j > 0) && (hot[j - 1]->waits < p->waits); j--)
+        hot[j] = hot[j - 1];
+      hot[j] = p;
+    }
+
+    ts_copy_byte(VALUE_MARK);
+    for (i = 0; i < num_hot; i++) {
+      if (i)
+        ts_copy_byte(SUBVALUE_MARK);
+      ts_copy(hot[i]->id, hot[i]->id_len);
+    }
+
+    ts_copy_byte(VALUE_MARK);
+    for (i = 0; i < num_hot; i++) {
+      if (i)
+        ts_copy_byte(SUBVALUE_MARK);
+      ts_printf("%u", hot[i]->waits);
+    }
+  }
+
+  (void)ts_terminate();
+}
+
+/* ======================================================================
+   contention_time()  -  Add a wait to a histogram and totals             */
+
+Private void contention_time(volatile u_int32_t* hist,
+                             volatile u_int32_t* wait_max,
+                             volatile u_int64* wait_time,
+                             int64 started) {
+  int64 n;
+  int i;
+
+  n = contention_clock() - started;
+  if (n < 0)
+    n = 0;
+
+  *wait_time += n;
+  if (n > *wait_max)
+    *wait_max = (u_int32_t)min(n, 0xFFFFFFFF);
+
+  for (i = 0; (n >>= 1) && (i < CONTENTION_BUCKETS - 1); i++) {
+  }
+  hist[i]++;
+}
+
+/* ====================================================================== */
+
+Private void report_times(volatile u_int32_t* hist, u_int64 wait_time,
+                          u_int32_t wait_max) {
+  ts_printf("\xfd%llu\xfd%u\xfd%u\xfd%u\xfd%u", (unsigned long long)wait_time,
+            wait_max, contention_percentile(hist, 50),
+            contention_percentile(hist, 90), contention_percentile(hist, 99));
+}
+
+/* END-CODE */
@@ -0,0 +1,316 @@
+/* MSCAN.C
+ * Mark scanning functions for dynamic arrays.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added find_byte2() for the CSV parser.
+ *
+ * 18Oct26 gwb New module.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ * The dynamic array opcodes spend much of their time looking for the
+ * next mark character. These functions scan a block of memory for marks
+ * using SSE2 or AVX2 instructions where the processor supports them,
+ * falling back to a simple byte loop elsewhere. The implementation is
+ * chosen on first use.
+ *
+ * find_delim()     Find next field, value or subvalue mark
+ * find_mark()      Find next mark character (text mark to item mark)
+ * count_byte()     Count occurrences of a character
+ * find_byte2()     Find next occurrence of either of two characters
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MSCAN_SIMD
+
+/* The kernel is normally built without optimisation, which leaves each
+   intrinsic as a separate call. Optimise these few functions regardless. */
+
+#if defined(__clang__)
+#define SIMD_FUNCTION(isa) __attribute__((target(isa)))
+#else
+#define SIMD_FUNCTION(isa) __attribute__((target(isa), optimize("O2")))
+#endif
+#endif
+
+/* The marks are the top five byte values so, viewed as signed chars,
+   each class of mark is a contiguous range of negative values.       */
+
+#define DELIM_LO ((char)SUBVALUE_MARK)
+#define DELIM_HI ((char)FIELD_MARK)
+#define MARK_LO ((char)TEXT_MARK)
+#define MARK_HI ((char)ITEM_MARK)
+
+Private char* select_scan_range(char* p, int32_t len, char lo, char hi);
+Private int32_t select_count_byte(char* p, int32_t len, char c);
+Private char* select_scan_either(char* p, int32_t len, char a, char b);
+
+Private char* (*scan_range)(char* p, int32_t len, char lo, char hi) = select_scan_range;
+Private int32_t (*count_bytes)(char* p, int32_t len, char c) = select_count_byte;
+Private char* (*scan_either)(char* p, int32_t len, char a, char b) = select_scan_either;
+
+/* ====================================================================== */
+
+char* find_delim(char* p, int32_t len) {
+  return scan_range(p, len, DELIM_LO, DELIM_HI);
+}
+
+/* ====================================================================== */
+
+char* find_mark(char* p, int32_t len) {
+  return scan_range(p, len, MARK_LO, MARK_HI);
+}
+
+/* ====================================================================== */
+
+int32_t count_byte(char* p, int32_t len, char c) {
+  return count_bytes(p, len, c);
+}
+
+/* ====================================================================== */
+
+char* find_byte2(char* p, int32_t len, char a, char b) {
+  return scan_either(p, len, a, b);
+}
+
+/* ======================================================================
+   Portable versions                                                      */
+
+Private char* scan_range_scalar(char* p, int32_t len, char lo, char hi) {
+  signed char c;
+
+  while (len-- > 0) {
+    c = (signed char)*p;
+    if ((c >= (signed char)lo) && (c <= (signed char)hi))
+      return p;
+    p++;
+  }
+
+  return NULL;
+}
+
+Private int32_t count_byte_scalar(char* p, int32_t len, char c) {
+  int32_t n = 0;
+  char* q;
+
+  while ((len > 0) && ((q = (char*)memchr(p, c, len)) != NULL)) {
+    n++;
+    len -= (q - p) + 1;
+    p = q + 1;
+  }
+
+  return n;
+}
+
+Private char* scan_either_scalar(char* p, int32_t len, char a, char b) {
+  while (len-- > 0) {
+    if ((*p == a) || (*p == b))
+      return p;
+    p++;
+  }
+
+  return NULL;
+}
+
+#ifdef MSCAN_SIMD
+
+/* ======================================================================
+   SSE2 versions - 16 bytes per step                                      */
+
+SIMD_FUNCTION("sse2")
+Private char* scan_range_sse2(char* p, int32_t len, char lo, char hi) {
+  __m128i vlo = _mm_set1_epi8((char)(lo - 1));
+  __m128i vhi = _mm_set1_epi8((char)(hi + 1));
+  __m128i x;
+  int m;
+
+  while (len >= 16) {
+    x = _mm_loadu_si128((__m128i*)p);
+    m = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpgt_epi8(x, vlo), _mm_cmplt_epi8(x, vhi)));
+    if (m)
+      return p + __builtin_ctz(m);
+    p += 16;
+    len -= 16;
+  }
+
+  return scan_range_scalar(p, len, lo, hi);
+}
+
+/* Counting accumulates per-byte totals for up to 255 steps and then
+   sums them with a SAD against zero.                                    */
+
+SIMD_FUNCTION("sse2")
+Private int32_t count_byte_sse2(char* p, int32_t len, char c) {
+  __m128i vc = _mm_set1_epi8(c);
+  __m128i zero = _mm_setzero_si128();
+  __m128i acc;
+  __m128i sum = _mm_setzero_si128();
+  int16_t i;
+
+  while (len >= 16) {
+    acc = _mm_setzero_si128();
+    for (i = 0; (i < 255) && (len >= 16); i++) {
+      acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*)p), vc));
+      p += 16;
+      len -= 16;
+    }
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(acc, zero));
+  }
+
+  return (int32_t)(_mm_cvtsi128_si32(sum) +
+                   _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum))) +
+         count_byte_scalar(p, len, c);
+}
+
+SIMD_FUNCTION("sse2")
+Private char* scan_either_sse2(char* p, int32_t len, char a, char b) {
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  __m128i x;
+  int m;
+
+  while (len >= 16) {
+    x = _mm_loadu_si128((__m128i*)p);
+    m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+    if (m)
+      return p + __builtin_ctz(m);
+    p += 16;
+    len -= 16;
+  }
+
+  return scan_either_scalar(p, len, a, b);
+}
+
+/* ======================================================================
+   AVX2 versions - 32 bytes per step                                      */
+
+SIMD_FUNCTION("avx2")
+Private char* scan_range_avx2(char* p, int32_t len, char lo, char hi) {
+  __m256i vlo = _mm256_set1_epi8((char)(lo - 1));
+  __m256i vhi = _mm256_set1_epi8((char)(hi + 1));
+  __m256i x;
+  u_int32_t m;
+
+  while (len >= 32) {
+    x = _mm256_loadu_si256((__m256i*)p);
+    m = (u_int32_t)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpgt_epi8(x, vlo), _mm256_cmpgt_epi8(vhi, x)));
+    if (m)
+      return p + __builtin_ctz(m);
+    p += 32;
+    len -= 32;
+  }
+
+  return scan_range_sse2(p, len, lo, hi);
+}
+
+SIMD_FUNCTION("avx2")
+Private int32_t count_byte_avx2(char* p, int32_t len, char c) {
+  __m256i vc = _mm256_set1_epi8(c);
+  __m256i zero = _mm256_setzero_si256();
+  __m256i acc;
+  __m256i sum = _mm256_setzero_si256();
+  __m128i s;
+  int16_t i;
+
+  while (len >= 32) {
+    acc = _mm256_setzero_si256();
+    for (i = 0; (i < 255) && (len >= 32); i++) {
+      acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i*)p), vc));
+      p += 32;
+      len -= 32;
+    }
+    sum = _mm256_add_epi64(sum, _mm256_sad_epu8(acc, zero));
+  }
+
+  s = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  return (int32_t)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s))) +
+         count_byte_sse2(p, len, c);
+}
+
+SIMD_FUNCTION("avx2")
+Private char* scan_either_avx2(char* p, int32_t len, char a, char b) {
+  __m256i va = _mm256_set1_epi8(a);
+  __m256i vb = _mm256_set1_epi8(b);
+  __m256i x;
+  u_int32_t m;
+
+  while (len >= 32) {
+    x = _mm256_loadu_si256((__m256i*)p);
+    m = (u_int32_t)_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+    if (m)
+      return p + __builtin_ctz(m);
+    p += 32;
+    len -= 32;
+  }
+
+  return scan_either_sse2(p, len, a, b);
+}
+
+#endif
+
+/* ======================================================================
+   select_mscan()  -  Choose implementation for this processor            */
+
+Private void select_mscan() {
+  scan_range = scan_range_scalar;
+  count_bytes = count_byte_scalar;
+  scan_either = scan_either_scalar;
+
+#ifdef MSCAN_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    scan_range = scan_range_avx2;
+    count_bytes = count_byte_avx2;
+    scan_either = scan_either_avx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    scan_range = scan_range_sse2;
+    count_bytes = count_byte_sse2;
+    scan_either = scan_either_sse2;
+  }
+#endif
+}
+
+Private char* select_scan_range(char* p, int32_t len, char lo, char hi) {
+  select_mscan();
+  return scan_range(p, len, lo, hi);
+}
+
+Private int32_t select_count_byte(char* p, int32_t len, char c) {
+  select_mscan();
+  return count_bytes(p, len, c);
+}
+
+Private char* select_scan_either(char* p, int32_t len, char a, char b) {
+  select_mscan();
+  return scan_either(p, len, a, b);
+}
+
+/* END-CODE */
@@ -21,6 +21,28 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Catalogue search results are not cached if the VOC or a
+ *             catalogue changed during the search. Watches use absolute
+ *             paths and are rebuilt for the new account on LOGTO.
+ *
+ * 19Oct26 gwb Objects are mapped from a snapshot copy of the catalogue file
+ *             in TEMPDIR that is never changed once written, rather than
+ *             from the catalogue file itself.
+ *
+ * 19Oct26 gwb Loaded objects carry a pointer to the name map index built
+ *             for CLASS modules by op_objmap(), released on unload.
+ *
+ * 18Oct26 gwb Larger objects are now mapped from the catalogue file so that
+ *             the code pages are shared between processes. Loaded objects
+ *             are found by a hash table rather than by scanning the LRU
+ *             chain.
+ *             Catalogue search results, including failures, are cached and
+ *             invalidated by inotify events on the VOC and catalogues.
+ *
+ * 18Oct26 gwb Replaced the per-program clock() timing of the hot spot monitor
+ *             with a SIGPROF sampling profiler recording line, opcode and
+ *             call stack.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -51,32 +73,107 @@
 #include "header.h"
 #include "config.h"
 #include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
 
 Private int32_t object_total = 0;  /* Total bytes loaded */
 Private int16_t object_items = 0; /* Number of objects loaded */
 
 /* Object code is on an LRU chain with the most recently used item at the
-   head.                                                                  */
+   head and is also linked into a hash table keyed on the program name.
+
+   Objects of OBJECT_MAP_MIN bytes or more are mapped with a private (copy
+   on write) mapping rather than read into allocated memory. The operating
+   system then shares the code pages between all processes that have the
+   same version of the program loaded and only the page holding the object
+   header, which we update, is copied. The OBJECT structure sits at the end
+   of an anonymous page placed immediately before the mapping so that the
+   code still follows it in memory.
+
+   A catalogue file may be rewritten in place by tools other than
+   dir_write() and a mapping of it would then mix old and new code or fault
+   beyond a truncated end of file. The mapping is therefore made from a
+   snapshot of the catalogue file in the TEMPDIR directory. There is one
+   snapshot for each catalogue file, named by a hash of its pathname, and
+   its first page records the device, inode, size and modification time of
+   the file that it was copied from. A snapshot is never changed once
+   written. If it does not match the catalogue file, a new copy is written
+   and renamed over it, leaving any process that has the old one mapped
+   unaffected. Only a snapshot owned by this user or by the owner of the
+   catalogue file, and not writable by others, is used.                  */
 
 typedef struct OBJECT OBJECT;
 struct OBJECT {
   OBJECT* next; /* LRU chain */
   OBJECT* prev;
-  u_int64 cp_time; /* Processor time */
+  OBJECT* hash_next; /* Hash chain */
+  int32_t samples; /* HSM samples with this as the current program */
   int32_t calls;
   u_int16_t flags;
 #define OBJ_INVALID 0x0001 /* Invalidated object */
 #define OBJ_GLOBAL 0x0002  /* Loaded from global catalogue */
+#define OBJ_MAPPED 0x0004  /* Mapped from object file snapshot */
   u_int16_t pad;
+  void* name_index; /* Class name map index (see objprog.c) */
   struct OBJECT_HEADER code; /* Object code */
 };
 #define OBJHDRSIZE (offsetof(OBJECT, code))
 
+#define OBJECT_HASH_SIZE 256  /* Must be power of two */
+#define OBJECT_MAP_MIN 8192   /* Smallest object to map */
+
 Private OBJECT* object_head = NULL;
 Private OBJECT* object_tail = NULL;
+Private OBJECT* object_hash[OBJECT_HASH_SIZE];
 Private int32_t next_id = 1;
+Private long page_size = 0;
+
+/* Snapshot file header, occupying the first page of the file */
+
+typedef struct OBJECT_SNAPSHOT OBJECT_SNAPSHOT;
+struct OBJECT_SNAPSHOT {
+  u_int32_t magic;
+#define SNAPSHOT_MAGIC 0x514D4F53
+  int32_t bytes;  /* Object size */
+  dev_t dev;      /* Catalogue file identity... */
+  ino_t ino;
+  off_t size;     /* ...size... */
+  struct timespec mtime; /* ...and modification time */
+};
+
+/* Catalogue lookup cache. Records where each name not prefixed by a path
+   was found (or that it was not found) so that reloading a discarded
+   object or repeatedly failing to find one does not repeat the VOC and
+   directory searches. An inotify descriptor watching the VOC and the
+   private and global catalogue directories is polled before each use and
+   any change to these discards the entire cache. The generation count is
+   advanced each time the cache is discarded so that a search result is not
+   added if anything changed while the search was in progress.            */
+
+typedef struct CATREF CATREF;
+struct CATREF {
+  CATREF* next;
+  int16_t where;
+#define CAT_NOT_FOUND 0
+#define CAT_LOCAL 1
+#define CAT_PRIVATE 2
+#define CAT_GLOBAL 3
+  char* path; /* Follows name */
+  char name[1];
+};
 
-Private OBJECT* hsm_old_obj = NULL;
+#define CATREF_WATCH_MASK                                                     \
+  (IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |          \
+   IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+Private CATREF* catref_hash[OBJECT_HASH_SIZE];
+Private int catref_fd = -2; /* inotify fd, -1 if unavailable, -2 to open */
+#define CATREF_WATCHES 3
+Private int catref_wd[CATREF_WATCHES];
+Private int catref_nwd = -1; /* Watches in use, -1 to add, -2 if unavailable */
+Private u_int32_t catref_gen = 0;
 
 u_int16_t SwapShort(u_int16_t value) {
   int16_t newValue = 0;
@@ -105,6 +202,16 @@ u_int32_t SwapLong(u_int32_t value) {
 #define Reverse4(a) a = SwapLong(a)
 
 Private bool discard(void);
+Private void remove_object(OBJECT* obj);
+Private OBJECT* map_object(int fu, int32_t bytes, char* path);
+Private int open_snapshot(int fu, struct stat* st, int32_t bytes, char* path);
+Private bool snapshot_valid(int snap_fu, struct stat* st, int32_t bytes);
+Private u_int32_t object_hash_value(char* name);
+Private bool catref_valid(void);
+Private bool catref_watch(void);
+Private void catref_unwatch(void);
+Private void catref_clear(void);
+Private void catref_add(char* name, int16_t where, char* path);
 Private void hsm_log(OBJECT* obj);
 
 /* ======================================================================
@@ -121,10 +228,17 @@ void* load_object(char* name, bool abort_on_error) {
   char mapped_name[MAX_PATHNAME_LEN + 1];
   DESCRIPTOR pathname_descr;
   u_int16_t flags;
+  u_int32_t hash;
+  CATREF* ref;
+  int16_t where;
+  char* path;
+  bool cacheable;
+  u_int32_t cache_gen;
 
-  /* Search object chain to see if already loaded */
+  /* Search object hash chain to see if already loaded */
 
-  for (obj = object_head; obj != NULL; obj = obj->next) {
+  hash = object_hash_value(name);
+  for (obj = object_hash[hash]; obj != NULL; obj = obj->hash_next) {
     if ((!(obj->flags & OBJ_INVALID)) &&
         (strcmp(name, obj->code.ext_hdr.prog.program_name) == 0)) {
       /* Move item to head of lru chain */
@@ -167,9 +281,40 @@ void* load_object(char* name, bool abort_on_error) {
         return NULL;
     }
     is_runfile = TRUE;
+    path = name;
     goto found;
   }
 
+  /* Check for a cached search result */
+
+  cacheable = catref_valid();
+  if (cacheable) {
+    for (ref = catref_hash[hash]; ref != NULL; ref = ref->next) {
+      if (!strcmp(ref->name, name))
+        break;
+    }
+
+    if (ref != NULL) {
+      if (ref->where == CAT_NOT_FOUND) {
+        if (abort_on_error)
+          k_error(sysmsg(1125), name);
+        return NULL;
+      }
+
+      obj_fu = dio_open(ref->path, DIO_READ);
+      if (ValidFileHandle(obj_fu)) {
+        if (ref->where == CAT_GLOBAL)
+          flags |= OBJ_GLOBAL;
+        path = ref->path;
+        goto found;
+      }
+
+      catref_clear(); /* Out of date - Search again */
+    }
+  }
+
+  cache_gen = catref_gen;
+
   (void)map_t1_id(name, strlen(name), mapped_name);
 
   if (strchr("*$!_", name[0]) == NULL) {
@@ -192,8 +337,10 @@ void* load_object(char* name, bool abort_on_error) {
     k_release(&pathname_descr);
     if (obj_path[0] != '\0') {
       obj_fu = dio_open(obj_path, DIO_READ);
-      if (ValidFileHandle(obj_fu))
-        goto found;
+      if (ValidFileHandle(obj_fu)) {
+        where = CAT_LOCAL;
+        goto search_found;
+      }
 
       if (abort_on_error)
         k_error(sysmsg(1124), name);
@@ -210,8 +357,10 @@ void* load_object(char* name, bool abort_on_error) {
        return NULL;
     }
     obj_fu = dio_open(obj_path, DIO_READ);
-    if (ValidFileHandle(obj_fu))
-      goto found;
+    if (ValidFileHandle(obj_fu)) {
+      where = CAT_PRIVATE;
+      goto search_found;
+    }
   }
   /* converted to snprintf() -gwb 22Feb20 */
   if (snprintf(obj_path, MAX_PATHNAME_LEN + 1, "%s%cgcat%c%s", sysseg->sysdir, 
@@ -223,14 +372,23 @@ void* load_object(char* name, bool abort_on_error) {
   obj_fu = dio_open(obj_path, DIO_READ);
   if (ValidFileHandle(obj_fu)) {
     flags |= OBJ_GLOBAL;
-    goto found;
+    where = CAT_GLOBAL;
+    goto search_found;
   }
 
+  if (cacheable && catref_valid() && (catref_gen == cache_gen))
+    catref_add(name, CAT_NOT_FOUND, "");
+
   if (abort_on_error)
     k_error(sysmsg(1125), name); /* TODO: Magic numbers are bad, mmkay? */
   else
     return NULL;
 
+search_found:
+  if (cacheable && catref_valid() && (catref_gen == cache_gen))
+    catref_add(name, where, obj_path);
+  path = obj_path;
+
 found:
   /* Object found  - read header */
 
@@ -267,19 +425,30 @@ found:
 
   /* Load program into memory */
 
+  obj = NULL;
+  if (!convert && (object_bytes >= OBJECT_MAP_MIN)) {
+    obj = map_object(obj_fu, object_bytes, path);
+  }
+
+  if (obj == NULL) {
+    obj = (OBJECT*)k_alloc(22, OBJHDRSIZE + object_bytes);
+
+    Seek(obj_fu, 0, SEEK_SET);
+    if (Read(obj_fu, (char*)(&(obj->code)), object_bytes) < 0) {
+      k_free(obj);
+      k_error(sysmsg(1128), name); /* TODO: Magic numbers are bad, mmkay? */
+    }
+  } else {
+    flags |= OBJ_MAPPED;
+  }
+
   object_items++;
   object_total += object_bytes;
-  obj = (OBJECT*)k_alloc(22, OBJHDRSIZE + object_bytes);
 
-  obj->cp_time = 0;
+  obj->samples = 0;
   obj->calls = (hsm) ? 1 : 0;
   obj->flags = flags;
-
-  Seek(obj_fu, 0, SEEK_SET);
-  if (Read(obj_fu, (char*)(&(obj->code)), object_bytes) < 0) {
-    k_free(obj);
-    k_error(sysmsg(1128), name); /* TODO: Magic numbers are bad, mmkay? */
-  }
+  obj->name_index = NULL;
 
   if (convert) {
     convert_object_header(&(obj->code));
@@ -302,10 +471,15 @@ found:
 
   if (object_head != NULL)
     object_head->prev = obj;
+  else
+    object_tail = obj;
   obj->next = object_head;
   obj->prev = NULL;
   object_head = obj;
 
+  obj->hash_next = object_hash[hash];
+  object_hash[hash] = obj;
+
   CloseFile(obj_fu);
   return (void*)(&(obj->code));
 }
@@ -358,6 +532,13 @@ bool is_global(void* obj_hdr) {
   return (((OBJECT*)(((char*)obj_hdr) - OBJHDRSIZE))->flags & OBJ_GLOBAL) != 0;
 }
 
+/* ======================================================================
+   object_name_index() - Address of class name map index pointer          */
+
+void** object_name_index(void* obj_hdr) {
+  return &(((OBJECT*)(((char*)obj_hdr) - OBJHDRSIZE))->name_index);
+}
+
 /* ======================================================================
    unload_object  -  Unload object from cache                             */
 
@@ -365,31 +546,7 @@ void unload_object(void* obj_hdr) {
   OBJECT* obj;
 
   obj = (OBJECT*)(((char*)obj_hdr) - OBJHDRSIZE);
-
-  if (hsm)
-    hsm_log(obj);
-  if (obj == hsm_old_obj)
-    hsm_old_obj = NULL;
-
-  /* Forward link */
-
-  if (obj->next != NULL)
-    obj->next->prev = obj->prev;
-  if (obj->prev == NULL)
-    object_head = obj->next;
-
-  /* Backward link */
-
-  if (obj->prev != NULL)
-    obj->prev->next = obj->next;
-  if (obj->next == NULL)
-    object_tail = obj->prev;
-
-  /* Give away memory */
-
-  object_items--;
-  object_total -= ((OBJECT_HEADER*)obj_hdr)->object_size;
-  k_free(obj);
+  remove_object(obj);
 }
 
 /* ======================================================================
@@ -403,28 +560,7 @@ void unload_all() {
     next_object = obj->next;
 
     if (obj->code.ext_hdr.prog.refs == 0) {
-      if (hsm)
-        hsm_log(obj);
-      if (obj == hsm_old_obj)
-        hsm_old_obj = NULL;
-
-      /* Forward link */
-
-      if (obj->next != NULL)
-        obj->next->prev = obj->prev;
-      if (obj->prev == NULL)
-        object_head = obj->next;
-
-      /* Backward link */
-
-      if (obj->prev != NULL)
-        obj->prev->next = obj->next;
-      if (obj->next == NULL)
-        object_tail = obj->prev;
-
-      object_items--;
-      object_total -= obj->code.object_size;
-      k_free(obj);
+      remove_object(obj);
     }
   }
 }
@@ -441,6 +577,8 @@ void invalidate_object() {
   OBJECT* obj;
   OBJECT* next_object;
 
+  invalidate_catalogue_cache(); /* VOC and private catalogue may change */
+
   for (obj = object_head; obj != NULL; obj = next_object) {
     next_object = obj->next;
 
@@ -476,34 +614,401 @@ Private bool discard() {
     prev_object = obj->prev;
 
     if (obj->code.ext_hdr.prog.refs == 0) {
-      if (hsm)
-        hsm_log(obj);
-      if (obj == hsm_old_obj)
-        hsm_old_obj = NULL;
+      remove_object(obj);
+      return TRUE;
+    }
+  }
 
-      /* Forward link */
+  return FALSE; /* Nothing to discard */
+}
 
-      if (obj->next != NULL)
-        obj->next->prev = obj->prev;
-      if (obj->prev == NULL)
-        object_head = obj->next;
+/* ======================================================================
+   remove_object()  -  Remove object from cache and release its memory    */
 
-      /* Backward link */
+Private void remove_object(OBJECT* obj) {
+  OBJECT** p;
 
-      if (obj->prev != NULL)
-        obj->prev->next = obj->next;
-      if (obj->next == NULL)
-        object_tail = obj->prev;
+  if (hsm || obj->samples || obj->calls)
+    hsm_log(obj);
 
-      object_items--;
-      object_total -= obj->code.object_size;
-      k_free(obj);
+  /* Forward link */
 
-      return TRUE;
+  if (obj->next != NULL)
+    obj->next->prev = obj->prev;
+  if (obj->prev == NULL)
+    object_head = obj->next;
+
+  /* Backward link */
+
+  if (obj->prev != NULL)
+    obj->prev->next = obj->next;
+  if (obj->next == NULL)
+    object_tail = obj->prev;
+
+  /* Hash chain. The name is set when the object is loaded and is not
+    changed so we will find it on the chain that it was added to.     */
+
+  p = &(object_hash[object_hash_value(obj->code.ext_hdr.prog.program_name)]);
+  while (*p != NULL) {
+    if (*p == obj) {
+      *p = obj->hash_next;
+      break;
     }
+    p = &((*p)->hash_next);
   }
 
-  return FALSE; /* Nothing to discard */
+  /* Give away memory */
+
+  object_items--;
+  object_total -= obj->code.object_size;
+
+  if (obj->name_index != NULL)
+    k_free(obj->name_index);
+
+  if (obj->flags & OBJ_MAPPED) {
+    munmap(((char*)obj) + OBJHDRSIZE - page_size,
+           page_size + obj->code.object_size);
+  } else {
+    k_free(obj);
+  }
+}
+
+/* ======================================================================
+   map_object()  -  Map object file into memory
+   Returns NULL if the object cannot be mapped. The caller will then
+   read it instead.                                                       */
+
+Private OBJECT* map_object(int fu, int32_t bytes, char* path) {
+  struct stat st;
+  char* base;
+  OBJECT* obj;
+  int snap_fu;
+
+  if (page_size == 0) {
+    page_size = sysconf(_SC_PAGESIZE);
+    if ((page_size <= 0) || (page_size < (long)OBJHDRSIZE) ||
+        (page_size < (long)sizeof(OBJECT_SNAPSHOT))) {
+      page_size = -1; /* Never try again */
+    }
+  }
+
+  if (page_size < 0)
+    return NULL;
+
+  if (fstat(fu, &st) || (st.st_size < bytes))
+    return NULL;
+
+  snap_fu = open_snapshot(fu, &st, bytes, path);
+  if (snap_fu < 0)
+    return NULL;
+
+  /* Reserve space for the OBJECT structure and the code, then replace
+    the code part with the snapshot mapping.                             */
+
+  base = (char*)mmap(NULL, page_size + bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    close(snap_fu);
+    return NULL;
+  }
+
+  if (mmap(base + page_size, bytes, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_FIXED, snap_fu, page_size) == MAP_FAILED) {
+    munmap(base, page_size + bytes);
+    close(snap_fu);
+    return NULL;
+  }
+
+  close(snap_fu);
+
+  obj = (OBJECT*)(base + page_size - OBJHDRSIZE);
+  return obj;
+}
+
+/* ======================================================================
+   open_snapshot()  -  Open snapshot of catalogue file, creating it if
+   necessary. Returns the file descriptor or -1 on failure.              */
+
+Private int open_snapshot(int fu, struct stat* st, int32_t bytes, char* path) {
+  char full_path[PATH_MAX + 1];
+  char snap_path[MAX_PATHNAME_LEN + 1];
+  char tmp_path[MAX_PATHNAME_LEN + 1];
+  u_int64_t h;
+  char* p;
+  int snap_fu;
+  char* buff = NULL;
+  OBJECT_SNAPSHOT* hdr;
+  int32_t offset;
+  int32_t n;
+  struct stat st2;
+
+  /* Name the snapshot from the absolute pathname (FNV-1a hash) */
+
+  if (realpath(path, full_path) == NULL)
+    return -1;
+
+  h = 0xCBF29CE484222325ULL;
+  for (p = full_path; *p != '\0'; p++) {
+    h ^= (u_char)*p;
+    h *= 0x100000001B3ULL;
+  }
+
+  if (snprintf(snap_path, sizeof(snap_path), "%s%cqmobj.%016llx",
+               pcfg.tempdir, DS, (unsigned long long)h) >=
+      (int)sizeof(snap_path)) {
+    return -1;
+  }
+
+  snap_fu = open(snap_path, O_RDONLY | O_CLOEXEC);
+  if (snap_fu >= 0) {
+    if (snapshot_valid(snap_fu, st, bytes))
+      return snap_fu;
+    close(snap_fu);
+  }
+
+  /* Write a new snapshot and rename it into place */
+
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%d", snap_path,
+               (int)getpid()) >= (int)sizeof(tmp_path)) {
+    return -1;
+  }
+
+  (void)unlink(tmp_path); /* Left by a process that died */
+  snap_fu = open(tmp_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (snap_fu < 0)
+    return -1;
+
+  buff = (char*)k_alloc(162, page_size);
+  if (buff == NULL)
+    goto snapshot_failed;
+
+  memset(buff, 0, page_size);
+  hdr = (OBJECT_SNAPSHOT*)buff;
+  hdr->magic = SNAPSHOT_MAGIC;
+  hdr->bytes = bytes;
+  hdr->dev = st->st_dev;
+  hdr->ino = st->st_ino;
+  hdr->size = st->st_size;
+  hdr->mtime = st->st_mtim;
+  if (write(snap_fu, buff, page_size) != page_size)
+    goto snapshot_failed;
+
+  for (offset = 0; offset < bytes; offset += n) {
+    n = min(bytes - offset, (int32_t)page_size);
+    if ((pread(fu, buff, n, offset) != n) || (write(snap_fu, buff, n) != n))
+      goto snapshot_failed;
+  }
+
+  /* Discard the copy if the catalogue file changed while we read it */
+
+  if (fstat(fu, &st2) || (st2.st_size != st->st_size) ||
+      (st2.st_mtim.tv_sec != st->st_mtim.tv_sec) ||
+      (st2.st_mtim.tv_nsec != st->st_mtim.tv_nsec)) {
+    goto snapshot_failed;
+  }
+
+  if (rename(tmp_path, snap_path))
+    goto snapshot_failed;
+
+  k_free(buff);
+  return snap_fu;
+
+snapshot_failed:
+  if (buff != NULL)
+    k_free(buff);
+  close(snap_fu);
+  (void)unlink(tmp_path);
+  return -1;
+}
+
+/* ======================================================================
+   snapshot_valid()  -  Does snapshot match the catalogue file?           */
+
+Private bool snapshot_valid(int snap_fu, struct stat* st, int32_t bytes) {
+  struct stat snap_st;
+  OBJECT_SNAPSHOT hdr;
+
+  if (fstat(snap_fu, &snap_st) || !S_ISREG(snap_st.st_mode) ||
+      (snap_st.st_mode & (S_IWGRP | S_IWOTH)) ||
+      ((snap_st.st_uid != geteuid()) && (snap_st.st_uid != st->st_uid)) ||
+      (snap_st.st_size < page_size + bytes)) {
+    return FALSE;
+  }
+
+  if (pread(snap_fu, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+    return FALSE;
+
+  return (hdr.magic == SNAPSHOT_MAGIC) && (hdr.bytes == bytes) &&
+         (hdr.dev == st->st_dev) && (hdr.ino == st->st_ino) &&
+         (hdr.size == st->st_size) &&
+         (hdr.mtime.tv_sec == st->st_mtim.tv_sec) &&
+         (hdr.mtime.tv_nsec == st->st_mtim.tv_nsec);
+}
+
+/* ======================================================================
+   object_hash_value()  -  Hash program name for object lookup           */
+
+Private u_int32_t object_hash_value(char* name) {
+  u_int32_t h = 0;
+
+  while (*name != '\0') {
+    h = (h * 31) + (u_char)(*(name++));
+  }
+
+  return (h ^ (h >> 8)) & (OBJECT_HASH_SIZE - 1);
+}
+
+/* ======================================================================
+   invalidate_catalogue_cache()  -  Discard catalogue lookup cache and
+   watches, for example because the account has changed. The watches are
+   added again relative to the new account on next use.                   */
+
+void invalidate_catalogue_cache() {
+  catref_clear();
+  catref_unwatch();
+}
+
+/* ======================================================================
+   catref_valid()  -  Prepare catalogue lookup cache for use
+   Returns FALSE if the cache cannot be used.                             */
+
+Private bool catref_valid() {
+  char buff[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool changed = FALSE;
+
+  if (catref_fd == -2) {
+    catref_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (catref_fd < 0)
+      catref_fd = -1;
+  }
+
+  if (catref_fd < 0)
+    return FALSE;
+
+  if (catref_nwd == -1) {
+    if (!catref_watch()) {
+      catref_unwatch();
+      catref_nwd = -2; /* Don't retry until account changes */
+    }
+  }
+
+  if (catref_nwd < 0)
+    return FALSE;
+
+  /* Discard cache if anything has changed */
+
+  while (read(catref_fd, buff, sizeof(buff)) > 0)
+    changed = TRUE;
+
+  if (changed)
+    catref_clear();
+
+  return TRUE;
+}
+
+/* ======================================================================
+   catref_watch()  -  Add watches for current account
+   Paths are made absolute so that the watches follow the account, not
+   the current directory. If the private catalogue does not exist, watch
+   its parent so that we see it being created.                            */
+
+Private bool catref_watch() {
+  char cwd[MAX_PATHNAME_LEN + 1];
+  char path[MAX_PATHNAME_LEN + 1];
+  char* p;
+  int wd;
+
+  catref_nwd = 0;
+
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    return FALSE;
+
+  if (snprintf(path, sizeof(path), "%s%cgcat", sysseg->sysdir, DS) >=
+      (int)sizeof(path))
+    return FALSE;
+  if ((wd = inotify_add_watch(catref_fd, path, CATREF_WATCH_MASK)) < 0)
+    return FALSE;
+  catref_wd[catref_nwd++] = wd;
+
+  if (snprintf(path, sizeof(path), "%s%cVOC", cwd, DS) >= (int)sizeof(path))
+    return FALSE;
+  if ((wd = inotify_add_watch(catref_fd, path, CATREF_WATCH_MASK)) < 0)
+    return FALSE;
+  catref_wd[catref_nwd++] = wd;
+
+  if (private_catalogue[0] == DS) {
+    if (strlen(private_catalogue) >= sizeof(path))
+      return FALSE;
+    strcpy(path, private_catalogue);
+  } else if (snprintf(path, sizeof(path), "%s%c%s", cwd, DS,
+                      private_catalogue) >= (int)sizeof(path)) {
+    return FALSE;
+  }
+
+  if ((wd = inotify_add_watch(catref_fd, path, CATREF_WATCH_MASK)) < 0) {
+    p = strrchr(path, DS);
+    if (p == path)
+      path[1] = '\0';
+    else
+      *p = '\0';
+
+    if ((wd = inotify_add_watch(catref_fd, path, CATREF_WATCH_MASK)) < 0)
+      return FALSE;
+  }
+  catref_wd[catref_nwd++] = wd;
+
+  return TRUE;
+}
+
+/* ======================================================================
+   catref_unwatch()  -  Remove watches                                    */
+
+Private void catref_unwatch() {
+  while (catref_nwd > 0)
+    (void)inotify_rm_watch(catref_fd, catref_wd[--catref_nwd]);
+  catref_nwd = -1;
+}
+
+/* ======================================================================
+   catref_clear()  -  Discard catalogue lookup cache                      */
+
+Private void catref_clear() {
+  int i;
+  CATREF* ref;
+  CATREF* next_ref;
+
+  for (i = 0; i < OBJECT_HASH_SIZE; i++) {
+    for (ref = catref_hash[i]; ref != NULL; ref = next_ref) {
+      next_ref = ref->next;
+      k_free(ref);
+    }
+    catref_hash[i] = NULL;
+  }
+
+  catref_gen++;
+}
+
+/* ======================================================================
+   catref_add()  -  Add catalogue lookup cache entry                      */
+
+Private void catref_add(char* name, int16_t where, char* path) {
+  CATREF* ref;
+  int name_len;
+  u_int32_t hash;
+
+  name_len = strlen(name);
+  ref = (CATREF*)k_alloc(128, sizeof(CATREF) + name_len + strlen(path) + 1);
+  if (ref == NULL)
+    return;
+
+  ref->where = where;
+  strcpy(ref->name, name);
+  ref->path = ref->name + name_len + 1;
+  strcpy(ref->path, path);
+
+  hash = object_hash_value(name);
+  ref->next = catref_hash[hash];
+  catref_hash[hash] = ref;
 }
 
 /* ======================================================================
@@ -529,18 +1034,76 @@ void convert_object_header(OBJECT_HEADER* obj) {
 
 /* ======================================================================
    ==========              Hot Spot Monitor (HSM)              ==========
-   ====================================================================== */
+   ======================================================================
+
+   The HSM is a sampling profiler. While it is enabled, a SIGPROF interval
+   timer interrupts the process every HSM_INTERVAL microseconds of processor
+   time and the signal handler records the current program, offset and
+   opcode and, unless only the leaf is wanted, the offsets of the calling
+   programs. The handler does nothing more than copy these into a ring
+   buffer. The ring is drained in normal context on program entry and
+   exit, before any object is unloaded and when the data is reported, at
+   which point the offsets are mapped to line numbers and the samples are
+   aggregated in a hash table keyed on the folded call stack and opcode.
+
+   Processor time per program is derived from the sample counts scaled by
+   the process CPU time elapsed since the monitor was started.           */
+
+#define HSM_INTERVAL 1000   /* Sampling interval (uS of processor time) */
+#define HSM_RING_SIZE 4096  /* Samples held awaiting aggregation */
+#define HSM_MAX_FRAMES 16   /* Deepest call stack recorded */
+#define HSM_HASH_SIZE 1024  /* Aggregation hash table buckets */
+
+/* Per-program data for objects that have been unloaded */
 
 typedef struct HSM HSM;
 struct HSM {
   HSM* next;
-  u_int64 cp_time;
+  int32_t samples;
   int32_t calls;
   char name[1];
 };
 
 Private HSM* hsm_head = NULL;
-Private u_int64 last_cp = 0;
+
+/* Raw samples, written only by the signal handler */
+
+typedef struct HSM_SAMPLE HSM_SAMPLE;
+struct HSM_SAMPLE {
+  int16_t opcode;
+  int16_t frames;    /* Entries used in frame[] */
+  bool truncated;    /* Stack deeper than HSM_MAX_FRAMES */
+  struct {
+    u_char* c_base;
+    int32_t offset;
+  } frame[HSM_MAX_FRAMES]; /* frame[0] is the current program */
+};
+
+Private HSM_SAMPLE* hsm_ring = NULL;
+Private volatile int32_t hsm_ring_head = 0; /* Next slot for handler */
+Private volatile int32_t hsm_ring_tail = 0; /* Next slot to drain */
+Private volatile int32_t hsm_lost = 0;      /* Samples lost, ring full */
+Private bool hsm_stacks = FALSE;            /* Record callers? */
+
+/* Aggregated samples */
+
+typedef struct HSM_STACK HSM_STACK;
+struct HSM_STACK {
+  HSM_STACK* next;
+  u_int32_t hash;
+  int32_t count;
+  int16_t opcode;
+  char key[1]; /* Folded stack: "PROG:line;PROG:line" with leaf last */
+};
+
+Private HSM_STACK** hsm_table = NULL;
+Private int32_t hsm_samples = 0; /* Total samples aggregated */
+Private clock_t hsm_start_cp;    /* clock() when monitor started */
+Private clock_t hsm_stop_cp;     /* clock() when monitor stopped */
+
+Private void hsm_sample(int signum);
+Private void hsm_drain(void);
+Private void hsm_clear(void);
 
 /* ======================================================================
    hsm_log()  -  Update hot spot monitor data from OBJECT structure       */
@@ -549,13 +1112,13 @@ Private void hsm_log(OBJECT* obj) {
   HSM* p;
   int bytes;
 
-  hsm_enter(); /* Force update of OBJECT cp_time */
+  hsm_drain(); /* Resolve any samples that refer to this object */
 
   for (p = hsm_head; p != NULL; p = p->next) {
     if (!strcmp(obj->code.ext_hdr.prog.program_name, (char*)(p->name))) {
       /* Found it */
 
-      p->cp_time += obj->cp_time;
+      p->samples += obj->samples;
       p->calls += obj->calls;
       goto exit_hsm_log;
     }
@@ -569,83 +1132,324 @@ Private void hsm_log(OBJECT* obj) {
   hsm_head = p;
 
   strcpy((char*)(p->name), obj->code.ext_hdr.prog.program_name);
-  p->cp_time = obj->cp_time;
+  p->samples = obj->samples;
   p->calls = obj->calls;
 
 exit_hsm_log:
-  obj->cp_time = 0;
+  obj->samples = 0;
   obj->calls = 0;
 }
 
 /* ======================================================================
    hsm_on()  -  Start monitoring, clearing cached data                    */
 
-void hsm_on() {
-  HSM* p;
-  HSM* q;
+void hsm_on(bool stacks) {
   OBJECT* obj;
+  struct sigaction sa;
+  struct itimerval timer;
+
+  hsm_off();
 
   for (obj = object_head; obj != NULL; obj = obj->next) {
     obj->calls = 0;
-    obj->cp_time = 0;
+    obj->samples = 0;
   }
 
-  for (p = hsm_head; p != NULL; p = q) {
-    q = p->next;
-    k_free(p);
+  hsm_clear();
+
+  if (hsm_ring == NULL) {
+    hsm_ring = (HSM_SAMPLE*)k_alloc(125, HSM_RING_SIZE * sizeof(HSM_SAMPLE));
+    if (hsm_ring == NULL)
+      return;
+  }
+
+  if (hsm_table == NULL) {
+    hsm_table = (HSM_STACK**)k_alloc(126, HSM_HASH_SIZE * sizeof(HSM_STACK*));
+    if (hsm_table == NULL)
+      return;
+    memset(hsm_table, 0, HSM_HASH_SIZE * sizeof(HSM_STACK*));
   }
-  hsm_head = NULL;
 
-  last_cp = (((u_int64)clock()) * 1000000L) / CLOCKS_PER_SEC;
+  hsm_ring_head = 0;
+  hsm_ring_tail = 0;
+  hsm_lost = 0;
+  hsm_stacks = stacks;
+  hsm_start_cp = clock();
 
   hsm = TRUE;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = hsm_sample;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = HSM_INTERVAL;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, NULL);
 }
 
 /* ======================================================================
-   hsm_enter() - Enter a new program (or just force an update)            */
+   hsm_off()  -  Stop monitoring, retaining data for reporting            */
+
+void hsm_off() {
+  struct itimerval timer;
+
+  if (hsm) {
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+
+    hsm_drain();
+    hsm_stop_cp = clock();
+    hsm = FALSE;
+  }
+}
+
+/* ======================================================================
+   hsm_enter() - Enter or leave a program                                 */
 
 void hsm_enter() {
-  u_int64 cp;
-  OBJECT* new_obj;
+  if (hsm_ring_tail != hsm_ring_head)
+    hsm_drain();
+}
 
-  if (c_base != NULL) {
-    new_obj = (OBJECT*)(c_base - OBJHDRSIZE);
+/* ======================================================================
+   hsm_sample()  -  SIGPROF handler
+
+   This runs asynchronously to the kernel and must not allocate memory or
+   follow anything other than the PROGRAM chain. Addresses are resolved
+   later by hsm_drain().                                                  */
+
+Private void hsm_sample(int signum) {
+  HSM_SAMPLE* s;
+  struct PROGRAM* prg;
+  int32_t head;
+  int16_t n;
+  u_char* p;
+
+  p = op_pc;
+  if ((c_base == NULL) || (p == NULL) || (hsm_ring == NULL))
+    return;
+
+  head = hsm_ring_head;
+  if (((head + 1) % HSM_RING_SIZE) == hsm_ring_tail) {
+    hsm_lost++;
+    return;
+  }
+
+  s = hsm_ring + head;
+  s->opcode = *p;
+  if (s->opcode == PREFIX_OPCODE)
+    s->opcode = 256 + *(p + 1);
 
-    cp = (((u_int64)clock()) * 1000000L) / CLOCKS_PER_SEC;
+  s->frame[0].c_base = c_base;
+  s->frame[0].offset = p - c_base;
+  n = 1;
 
-    if (hsm_old_obj != NULL)
-      hsm_old_obj->cp_time += cp - last_cp;
+  prg = NULL;
+  if (hsm_stacks) {
+    for (prg = process.program.prev; prg != NULL; prg = prg->prev) {
+      if (prg->saved_c_base == NULL)
+        break;
 
-    if (new_obj->code.id != 0)
-      hsm_old_obj = new_obj; /* It's a real program */
+      if (n == HSM_MAX_FRAMES)
+        break;
 
-    last_cp = cp;
+      s->frame[n].c_base = prg->saved_c_base;
+      s->frame[n].offset = prg->saved_pc_offset - 1; /* In CALL opcode */
+      n++;
+    }
   }
+
+  s->frames = n;
+  s->truncated = (prg != NULL) && (n == HSM_MAX_FRAMES);
+
+  hsm_ring_head = (head + 1) % HSM_RING_SIZE;
 }
 
 /* ======================================================================
-   hsm_dump()  -  Return HSM data                                         */
+   hsm_drain()  -  Aggregate samples from the ring buffer                 */
+
+Private void hsm_drain() {
+  HSM_SAMPLE* s;
+  HSM_STACK* p;
+  OBJECT* obj;
+  OBJECT* last_obj = NULL;
+  u_char* last_c_base = NULL;
+  char key[HSM_MAX_FRAMES * (MAX_PROGRAM_NAME_LEN + 13) + 4];
+  char* q;
+  int16_t i;
+  int line;
+  u_int32_t h;
+  int bytes;
+
+  while (hsm_ring_tail != hsm_ring_head) {
+    s = hsm_ring + hsm_ring_tail;
+
+    /* Build folded stack, outermost caller first */
+
+    q = key;
+    if (s->truncated) {
+      strcpy(q, "...;");
+      q += 4;
+    }
+
+    for (i = s->frames - 1; i >= 0; i--) {
+      /* Find object. The handler may have caught a c_base for code that
+        is not in the object cache (recursives, I-types) or a pointer from
+        a partially updated PROGRAM structure so only trust addresses we
+        recognise.                                                         */
+
+      if (s->frame[i].c_base != last_c_base) {
+        last_c_base = s->frame[i].c_base;
+        for (obj = object_head; obj != NULL; obj = obj->next) {
+          if ((u_char*)&(obj->code) == last_c_base)
+            break;
+        }
+        last_obj = obj;
+      }
 
-STRING_CHUNK* hsm_dump() {
+      if (last_obj == NULL) {
+        *(q++) = '?';
+      } else {
+        q += sprintf(q, "%s", last_obj->code.ext_hdr.prog.program_name);
+
+        if ((s->frame[i].offset >= 0) &&
+            (s->frame[i].offset < last_obj->code.object_size)) {
+          line = k_line_no(s->frame[i].offset, last_c_base);
+          if (line >= 0)
+            q += sprintf(q, ":%d", line);
+        }
+
+        if (i == 0)
+          (last_obj->samples)++;
+      }
+
+      if (i)
+        *(q++) = ';';
+    }
+    *q = '\0';
+
+    /* Add to hash table */
+
+    h = 2166136261u; /* FNV-1a */
+    for (q = key; *q != '\0'; q++)
+      h = (h ^ (u_char)*q) * 16777619u;
+    h ^= s->opcode;
+
+    for (p = hsm_table[h % HSM_HASH_SIZE]; p != NULL; p = p->next) {
+      if ((p->hash == h) && (p->opcode == s->opcode) && !strcmp(p->key, key))
+        break;
+    }
+
+    if (p == NULL) {
+      bytes = sizeof(HSM_STACK) + strlen(key);
+      p = (HSM_STACK*)k_alloc(127, bytes);
+      if (p != NULL) {
+        p->hash = h;
+        p->count = 0;
+        p->opcode = s->opcode;
+        strcpy(p->key, key);
+        p->next = hsm_table[h % HSM_HASH_SIZE];
+        hsm_table[h % HSM_HASH_SIZE] = p;
+      }
+    }
+
+    if (p != NULL)
+      (p->count)++;
+    hsm_samples++;
+
+    hsm_ring_tail = (hsm_ring_tail + 1) % HSM_RING_SIZE;
+  }
+}
+
+/* ======================================================================
+   hsm_clear()  -  Discard accumulated data                               */
+
+Private void hsm_clear() {
   HSM* p;
+  HSM* q;
+  HSM_STACK* sp;
+  HSM_STACK* sq;
+  int i;
+
+  for (p = hsm_head; p != NULL; p = q) {
+    q = p->next;
+    k_free(p);
+  }
+  hsm_head = NULL;
+
+  if (hsm_table != NULL) {
+    for (i = 0; i < HSM_HASH_SIZE; i++) {
+      for (sp = hsm_table[i]; sp != NULL; sp = sq) {
+        sq = sp->next;
+        k_free(sp);
+      }
+      hsm_table[i] = NULL;
+    }
+  }
+
+  hsm_samples = 0;
+}
+
+/* ======================================================================
+   hsm_dump()  -  Return HSM data
+
+   Mode HSM_DUMP_PROGRAMS returns one field per program:
+      name VM calls VM processor time (mS)
+   Mode HSM_DUMP_SAMPLES returns one field per distinct stack and opcode:
+      folded stack VM opcode name VM sample count
+   The final field of the sample data is
+      "*" VM samples lost VM sampling interval (uS)                        */
+
+STRING_CHUNK* hsm_dump(int mode) {
+  HSM* p;
+  HSM_STACK* sp;
   OBJECT* obj;
   STRING_CHUNK* str;
+  double us_per_sample;
+  int i;
 
-  /* Update cache for all active programs */
+  /* Update cache for all active programs. These may still hold samples
+    if the monitor has been stopped.                                       */
 
-  if (hsm) {
-    for (obj = object_head; obj != NULL; obj = obj->next) {
+  for (obj = object_head; obj != NULL; obj = obj->next) {
+    if (hsm || obj->samples || obj->calls)
       hsm_log(obj);
-    }
   }
 
   str = NULL;
   ts_init(&str, 256);
 
-  for (p = hsm_head; p != NULL; p = p->next) {
-    if (str != NULL)
-      ts_copy_byte(FIELD_MARK);
-    ts_printf("%s\xfd%d\xfd%lld", p->name, p->calls, p->cp_time / 1000);
+  if (mode == HSM_DUMP_SAMPLES) {
+    if (hsm_table != NULL) {
+      for (i = 0; i < HSM_HASH_SIZE; i++) {
+        for (sp = hsm_table[i]; sp != NULL; sp = sp->next) {
+          ts_printf("%s\xfd%s\xfd%d\xfe", sp->key,
+                    opcode_name[sp->opcode], sp->count);
+        }
+      }
+      ts_printf("*\xfd%d\xfd%d", hsm_lost, HSM_INTERVAL);
+    }
+  } else {
+    /* Scale sample counts by the processor time actually used rather than
+      trusting the timer interval.                                         */
+
+    us_per_sample = 0.0;
+    if (hsm_samples) {
+      us_per_sample = (((double)(((hsm) ? clock() : hsm_stop_cp) -
+                                 hsm_start_cp)) * 1000000.0) /
+                      CLOCKS_PER_SEC / hsm_samples;
+    }
+
+    for (p = hsm_head; p != NULL; p = p->next) {
+      if (str != NULL)
+        ts_copy_byte(FIELD_MARK);
+      ts_printf("%s\xfd%d\xfd%lld", p->name, p->calls,
+                (long long)((p->samples * us_per_sample) / 1000));
+    }
   }
 
   ts_terminate();
@@ -21,6 +21,15 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb build_name_index() returns NULL if it cannot allocate the
+ *             index. find_name() then searches the name map.
+ *
+ * 19Oct26 gwb op_objmap() builds a hashed index of the class name map,
+ *             shared by all instances of the class. op_objref() keeps an
+ *             inline cache of the name map entry resolved at each call
+ *             site so that repeated property and method references to the
+ *             same class skip the name search.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -63,6 +72,43 @@
 #include "header.h"
 #include "stdarg.h"
 
+/* Name map index. Built by op_objmap() for each loaded CLASS module and
+   attached to its OBJECT structure (see object_name_index()). An open
+   addressed hash table of pointers into the name map.                    */
+
+typedef struct NAME_INDEX NAME_INDEX;
+struct NAME_INDEX {
+  u_int16_t mask;            /* Table size - 1, size is a power of two */
+  OBJECT_NAME_MAP* entry[1]; /* NULL if unused */
+};
+
+/* Inline cache of names resolved by op_objref(), direct mapped on the
+   address of the OBJREF opcode. An entry is only used if it is for the
+   same call site, class (by object id, which is never reused) and mode
+   and the name matches, so the name may be computed at run time.
+   Only names found in the object's own name map are cached as the result
+   of searching inherited objects can change.                             */
+
+#define OBJREF_CACHE_SIZE 256 /* Must be power of two */
+#define ObjrefCacheHash(p) \
+  ((((u_int32_t)(intptr_t)(p)) ^ (((u_int32_t)(intptr_t)(p)) >> 8)) & \
+   (OBJREF_CACHE_SIZE - 1))
+
+Private struct {
+  u_char* pc;             /* Address of OBJREF opcode */
+  int32_t class_id;       /* Object id of class module */
+  int16_t mode;           /* 0 = SET, 1 = GET */
+  OBJECT_NAME_MAP* entry; /* Resolved name map entry */
+} objref_cache[OBJREF_CACHE_SIZE];
+
+Private NAME_INDEX* build_name_index(OBJECT_NAME_MAP* name_map);
+Private u_int32_t name_hash(char* name);
+Private OBJECT_NAME_MAP* find_name(OBJDATA* objdata, char* name);
+Private bool bind_name_map_entry(int16_t mode,
+                                 OBJDATA* objdata,
+                                 OBJECT_NAME_MAP* p,
+                                 char* name,
+                                 bool dismiss_obj);
 
 Private bool find_name_map_entry(int16_t mode,
                                  OBJDATA* objdata,
@@ -297,6 +343,7 @@ void op_objinfo() {
 void op_objmap() {
   OBJDATA* objdata;
   u_int16_t name_map_len;
+  void** name_index;
   objdata = process.program.objdata;
 
   name_map_len = *pc | (((u_int16_t)*(pc + 1)) << 8);
@@ -304,6 +351,15 @@ void op_objmap() {
 
   objdata->name_map = (name_map_len != 0) ? ((OBJECT_NAME_MAP*)pc) : NULL;
   pc += name_map_len;
+
+  /* The name map is part of the object code so the index is built when
+     the first instance of the class is created and shared by the rest.  */
+
+  if (objdata->name_map != NULL) {
+    name_index = object_name_index(objdata->objprog);
+    if (*name_index == NULL)
+      *name_index = build_name_index(objdata->name_map);
+  }
 }
 
 /* ======================================================================
@@ -325,7 +381,13 @@ void op_objref() {
   DESCRIPTOR* descr;
   char name[64 + 1];
   OBJDATA* objdata;
+  u_char* site;
+  int32_t class_id;
+  OBJECT_NAME_MAP* p;
+  bool found;
+  int16_t i;
 
+  site = pc - 1;
   mode = *(pc++);
 
   /* Get name */
@@ -344,9 +406,30 @@ void op_objref() {
     k_error("Invalid object reference");
   objdata = descr->data.objdata;
 
-  /* Scan name table */
+  /* Try the inline cache, then the object's own name map, updating the
+     cache if found there. Otherwise, scan the inheritance chain.         */
+
+  class_id = ((OBJECT_HEADER*)(objdata->objprog))->id;
+  i = ObjrefCacheHash(site);
+  p = objref_cache[i].entry;
+  if ((objref_cache[i].pc != site) || (objref_cache[i].class_id != class_id) ||
+      (objref_cache[i].mode != mode) || (objdata->name_map == NULL) ||
+      strcmp(p->name, name)) {
+    p = find_name(objdata, name);
+    if (p != NULL) {
+      objref_cache[i].pc = site;
+      objref_cache[i].class_id = class_id;
+      objref_cache[i].mode = mode;
+      objref_cache[i].entry = p;
+    }
+  }
+
+  if (p != NULL)
+    found = bind_name_map_entry(mode, objdata, p, name, TRUE);
+  else
+    found = find_name_map_entry(mode, objdata, name, TRUE);
 
-  if (!find_name_map_entry(mode, objdata, name, TRUE)) {
+  if (!found) {
     /* If there is an UNDEFINED handler, set up an OBJCDX descriptor to
        reference this.                                                  */
 
@@ -385,59 +468,15 @@ Private bool find_name_map_entry(int16_t mode,
   OBJDATA* scanobj;
   OBJDATA* nextobj;
   OBJECT_NAME_MAP* p;
-  int16_t var;
-  int16_t key;
-  u_char arg_ct;
-  DESCRIPTOR* var_descr;
 
   scanobj = objdata;
   nextobj = objdata->inherits;
 
   do {
-    for (p = scanobj->name_map; p != NULL; p = NextNameMapEntry(p)) {
-      if (!strcmp(p->name, name)) /* Found it */
-      {
-        var = PublicVar(p);
-
-        if (mode == 0) /* PUT / Method subroutine */
-        {
-          key = SetKey(p);
-          arg_ct = p->set_arg_ct;
-        } else /* GET / Method function */
-        {
-          key = GetKey(p);
-          arg_ct = p->get_arg_ct;
-        }
-
-        if (key == 0) /* Bind to public variable */
-        {
-          if (var == 0)
-            k_error("Illegal reference to property (%s).", name);
-
-          if (var < 0) {
-            if (mode == 0)
-              return FALSE; /* Hide read-only if PUT */
-            var = -var;
-          }
-
-          var_descr = Element(scanobj->obj_vars, var);
-          if (dismiss_obj)
-            k_dismiss();
-          InitDescr(e_stack, ADDR);
-          (e_stack++)->data.d_addr = var_descr;
-        } else /* Create OBJCODE reference */
-        {
-          if (dismiss_obj)
-            k_dismiss();
-          InitDescr(e_stack, OBJCD);
-          e_stack->data.objcode.objdata = scanobj;
-          e_stack->data.objcode.key = key;
-          e_stack->data.objcode.arg_ct = arg_ct;
-          e_stack++;
-        }
-
-        return TRUE;
-      }
+    p = find_name(scanobj, name);
+    if (p != NULL) /* Found it */
+    {
+      return bind_name_map_entry(mode, scanobj, p, name, dismiss_obj);
     }
 
     /* If this object has an inheritance chain, scan that before going
@@ -456,6 +495,146 @@ Private bool find_name_map_entry(int16_t mode,
   } while (1);
 }
 
+/* ======================================================================
+   find_name()  -  Find name in an object's own name map                  */
+
+Private OBJECT_NAME_MAP* find_name(OBJDATA* objdata, char* name) {
+  NAME_INDEX* index;
+  OBJECT_NAME_MAP* p;
+  u_int32_t i;
+
+  if (objdata->name_map == NULL)
+    return NULL;
+
+  index = (NAME_INDEX*)(*object_name_index(objdata->objprog));
+  if (index == NULL) {
+    for (p = objdata->name_map; p != NULL; p = NextNameMapEntry(p)) {
+      if (!strcmp(p->name, name))
+        return p;
+    }
+    return NULL;
+  }
+
+  for (i = name_hash(name) & index->mask; (p = index->entry[i]) != NULL;
+       i = (i + 1) & index->mask) {
+    if (!strcmp(p->name, name))
+      return p;
+  }
+
+  return NULL;
+}
+
+/* ======================================================================
+   bind_name_map_entry()  -  Push reference to a found name map entry
+   Returns FALSE if the entry is a read-only property referenced by SET.  */
+
+Private bool bind_name_map_entry(int16_t mode,
+                                 OBJDATA* objdata,
+                                 OBJECT_NAME_MAP* p,
+                                 char* name,
+                                 bool dismiss_obj) {
+  int16_t var;
+  int16_t key;
+  u_char arg_ct;
+  DESCRIPTOR* var_descr;
+
+  var = PublicVar(p);
+
+  if (mode == 0) /* PUT / Method subroutine */
+  {
+    key = SetKey(p);
+    arg_ct = p->set_arg_ct;
+  } else /* GET / Method function */
+  {
+    key = GetKey(p);
+    arg_ct = p->get_arg_ct;
+  }
+
+  if (key == 0) /* Bind to public variable */
+  {
+    if (var == 0)
+      k_error("Illegal reference to property (%s).", name);
+
+    if (var < 0) {
+      if (mode == 0)
+        return FALSE; /* Hide read-only if PUT */
+      var = -var;
+    }
+
+    var_descr = Element(objdata->obj_vars, var);
+    if (dismiss_obj)
+      k_dismiss();
+    InitDescr(e_stack, ADDR);
+    (e_stack++)->data.d_addr = var_descr;
+  } else /* Create OBJCODE reference */
+  {
+    if (dismiss_obj)
+      k_dismiss();
+    InitDescr(e_stack, OBJCD);
+    e_stack->data.objcode.objdata = objdata;
+    e_stack->data.objcode.key = key;
+    e_stack->data.objcode.arg_ct = arg_ct;
+    e_stack++;
+  }
+
+  return TRUE;
+}
+
+/* ======================================================================
+   build_name_index()  -  Build hashed index of a name map
+   Returns NULL if memory is short. find_name() then searches the map.    */
+
+Private NAME_INDEX* build_name_index(OBJECT_NAME_MAP* name_map) {
+  NAME_INDEX* index;
+  OBJECT_NAME_MAP* p;
+  OBJECT_NAME_MAP* q;
+  int32_t n;
+  int32_t size;
+  u_int32_t i;
+
+  /* Size the table to be no more than half full */
+
+  for (n = 0, p = name_map; p != NULL; p = NextNameMapEntry(p))
+    n++;
+  for (size = 8; size < n * 2; size <<= 1) {
+  }
+
+  index = (NAME_INDEX*)k_alloc(
+      160, offsetof(NAME_INDEX, entry) + (size * sizeof(OBJECT_NAME_MAP*)));
+  if (index == NULL)
+    return NULL;
+
+  index->mask = size - 1;
+  memset(index->entry, 0, size * sizeof(OBJECT_NAME_MAP*));
+
+  /* Insert in name map order, keeping the first of any duplicate names
+     as that is the one that a sequential search would find.             */
+
+  for (p = name_map; p != NULL; p = NextNameMapEntry(p)) {
+    for (i = name_hash(p->name) & index->mask; (q = index->entry[i]) != NULL;
+         i = (i + 1) & index->mask) {
+      if (!strcmp(q->name, p->name))
+        break;
+    }
+    if (q == NULL)
+      index->entry[i] = p;
+  }
+
+  return index;
+}
+
+/* ====================================================================== */
+
+Private u_int32_t name_hash(char* name) {
+  u_int32_t h = 0;
+
+  while (*name != '\0') {
+    h = (h * 31) + (u_char)(*(name++));
+  }
+
+  return h ^ (h >> 8);
+}
+
 /* ======================================================================
    find_undefined_name_handler()                                          */
 
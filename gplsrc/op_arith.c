@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added DECIMAL type. Add, subtract, multiply and divide are
+ *             exact for decimals and integer overflow gives a decimal in
+ *             place of a float. Other operations convert decimals to float.
+ *
  * 06Feb22 gwb Changed comparisions of LONG_MIN to INT32_MIN in op_dec().
  *             The comparision to LONG_MIN would always be true due to the
  *             fact that LONG_MIN is out of range for the int32_t data type.
@@ -127,6 +131,15 @@ void op_abs() {
       descr->data.float_value = fabs(descr->data.float_value);
       break;
 
+    case DECIMAL:
+      if (descr->data.dec.value == INT64_MIN) {
+        dec_to_float(descr);
+        descr->data.float_value = fabs(descr->data.float_value);
+      } else if (descr->data.dec.value < 0) {
+        descr->data.dec.value = -descr->data.dec.value;
+      }
+      break;
+
     default:
       k_num_array1(op_abs);
       break;
@@ -199,10 +212,8 @@ void op_add() {
                  for overflow of the result.                               */
               && ((arg1->data.value ^ new_int) < 0)) /* Overflow */
           {
-            /* Convert descriptor to a FLOATNUM */
-            arg2->type = FLOATNUM;
-            arg2->data.float_value =
-                (double)(arg1->data.value) + arg2->data.value;
+            /* Convert descriptor to a DECIMAL */
+            dec_set(arg2, (int64)(arg1->data.value) + arg2->data.value, 0);
           } else /* no overflow */
           {
             arg2->data.value = new_int;
@@ -213,6 +224,10 @@ void op_add() {
           arg2->data.float_value += arg1->data.value;
           break;
 
+        case DECIMAL: /* arg1 is INTEGER, arg2 is DECIMAL */
+          dec_add(arg1, arg2, FALSE);
+          break;
+
         case STRING: /* arg1 is INTEGER, arg2 is numeric array */
           k_num_array2(op_add, 0);
           break;
@@ -231,12 +246,23 @@ void op_add() {
           arg2->data.float_value += arg1->data.float_value;
           break;
 
+        case DECIMAL: /* arg1 is FLOATNUM, arg2 is DECIMAL */
+          dec_add(arg1, arg2, FALSE);
+          break;
+
         case STRING: /* arg1 is FLOATNUM, arg2 is numeric array */
           k_num_array2(op_add, 0);
           break;
       }
       break;
 
+    case DECIMAL:
+      if (arg2->type == STRING) /* arg2 is numeric array */
+        k_num_array2(op_add, 0);
+      else
+        dec_add(arg1, arg2, FALSE);
+      break;
+
     case STRING: /* Arg 1 is numeric array */
       k_num_array2(op_add, 0);
       break;
@@ -339,6 +365,7 @@ void op_dec() {
  */
 
   DESCRIPTOR* arg;
+  DESCRIPTOR one;
 
   arg = e_stack - 1;
   while (arg->type == ADDR)
@@ -349,11 +376,14 @@ void op_dec() {
   if (arg->type == INTEGER) {
     if (arg->data.value > INT32_MIN) {
       arg->data.value--;
-    } else /* Must convert to float */
+    } else /* Must convert to decimal */
     {
-      arg->type = FLOATNUM;
-      arg->data.float_value = ((double)INT32_MIN) - 1;
+      dec_set(arg, ((int64)INT32_MIN) - 1, 0);
     }
+  } else if (arg->type == DECIMAL) {
+    InitDescr(&one, INTEGER);
+    one.data.value = 1;
+    dec_add(&one, arg, TRUE);
   } else {
     arg->data.float_value -= 1.0;
   }
@@ -415,6 +445,10 @@ void op_div() {
           arg2->data.float_value /= arg1->data.value;
           break;
 
+        case DECIMAL: /* Arg1 is integer, arg2 is decimal */
+          dec_div(arg1, arg2);
+          break;
+
         case STRING: /* Arg1 is integer, arg2 is numeric array */
           k_num_array2(op_div, 1);
           break;
@@ -436,12 +470,26 @@ void op_div() {
           arg2->data.float_value /= arg1->data.float_value;
           break;
 
+        case DECIMAL: /* Arg1 is float, arg2 is decimal */
+          dec_div(arg1, arg2);
+          break;
+
         case STRING: /* Arg1 is float, arg2 is numeric array */
           k_num_array2(op_div, 1);
           break;
       }
       break;
 
+    case DECIMAL:
+      if (arg2->type == STRING) { /* Arg2 is numeric array */
+        k_num_array2(op_div, 1);
+      } else {
+        if (arg1->data.dec.value == 0)
+          goto div_zero;
+        dec_div(arg1, arg2);
+      }
+      break;
+
     case STRING: /* Arg1 is numeric array */
       k_num_array2(op_div, 1);
       break;
@@ -510,10 +558,12 @@ void op_iadd() {
   process.numeric_array_allowed = TRUE;
   arg1 = e_stack - 1;
   GetNum(arg1);
+  DecToFloat(arg1);
 
   process.numeric_array_allowed = TRUE;
   arg2 = e_stack - 2;
   GetNum(arg2);
+  DecToFloat(arg2);
   process.numeric_array_allowed = FALSE; /* 0506 */
 
   /* Add values, placing result in arg2 */
@@ -599,10 +649,12 @@ void op_idiv() {
   process.numeric_array_allowed = TRUE;
   arg1 = e_stack - 1;
   GetNum(arg1);
+  DecToFloat(arg1);
 
   process.numeric_array_allowed = TRUE;
   arg2 = e_stack - 2;
   GetNum(arg2);
+  DecToFloat(arg2);
   process.numeric_array_allowed = FALSE; /* 0506 */
 
   /* Divide arg2 by arg1, placing result in arg2 */
@@ -684,6 +736,7 @@ void op_inc() {
  */
 
   DESCRIPTOR* arg;
+  DESCRIPTOR one;
 
   arg = e_stack - 1;
   while (arg->type == ADDR)
@@ -694,11 +747,14 @@ void op_inc() {
   if (arg->type == INTEGER) {
     if (arg->data.value < INT32_MAX) {
       arg->data.value++;
-    } else { /* Must convert to float */
-      arg->type = FLOATNUM;
-      arg->data.float_value = ((double)INT32_MAX) + 1;
+    } else { /* Must convert to decimal */
+      dec_set(arg, ((int64)INT32_MAX) + 1, 0);
       // this appears to force an overflow error via k_get_int().
     }
+  } else if (arg->type == DECIMAL) {
+    InitDescr(&one, INTEGER);
+    one.data.value = 1;
+    dec_add(&one, arg, FALSE);
   } else {
     arg->data.float_value += 1.0;
   }
@@ -742,6 +798,9 @@ void op_int() {
       f = floor(fabs(descr->data.float_value));
       descr->data.float_value = (descr->data.float_value < 0) ? -f : f;
       break;
+    case DECIMAL:
+      dec_int(descr);
+      break;
     case STRING:
       k_num_array1(op_int);
       break;
@@ -770,10 +829,12 @@ void op_imul() {
   process.numeric_array_allowed = TRUE;
   arg1 = e_stack - 1;
   GetNum(arg1);
+  DecToFloat(arg1);
 
   process.numeric_array_allowed = TRUE;
   arg2 = e_stack - 2;
   GetNum(arg2);
+  DecToFloat(arg2);
   process.numeric_array_allowed = FALSE; /* 0506 */
 
   /* Multiply values, placing result in arg2 */
@@ -858,10 +919,12 @@ void op_isub() {
   process.numeric_array_allowed = TRUE;
   arg1 = e_stack - 1;
   GetNum(arg1);
+  DecToFloat(arg1);
 
   process.numeric_array_allowed = TRUE;
   arg2 = e_stack - 2;
   GetNum(arg2);
+  DecToFloat(arg2);
   process.numeric_array_allowed = FALSE; /* 0506 */
 
   /* Subtract arg1 from arg2, placing result in arg2 */
@@ -983,9 +1046,11 @@ void op_mod() {
 
   arg_y = e_stack - 1;
   GetNum(arg_y);
+  DecToFloat(arg_y);
 
   arg_x = e_stack - 2;
   GetNum(arg_x);
+  DecToFloat(arg_x);
 
   if ((arg_x->type == INTEGER) && (arg_y->type == INTEGER)) {
     xx = arg_x->data.value;
@@ -1066,10 +1131,8 @@ void op_mul() {
           if ((arg2->data.value != 0) &&
               ((new_int / arg2->data.value) != arg1->data.value)) /* Overflow */
           {
-            /* Convert descriptor to a FLOATNUM */
-            arg2->type = FLOATNUM;
-            arg2->data.float_value =
-                (double)(arg1->data.value) * arg2->data.value;
+            /* Convert descriptor to a DECIMAL */
+            dec_set(arg2, (int64)(arg1->data.value) * arg2->data.value, 0);
           } else /* no overflow */
           {
             arg2->data.value = new_int;
@@ -1080,6 +1143,10 @@ void op_mul() {
           arg2->data.float_value *= arg1->data.value;
           break;
 
+        case DECIMAL: /* Arg1 is integer, arg2 is decimal */
+          dec_mul(arg1, arg2);
+          break;
+
         case STRING: /* Arg1 is integer, arg2 is numeric array */
           k_num_array2(op_mul, 0);
           break;
@@ -1097,12 +1164,23 @@ void op_mul() {
           arg2->data.float_value *= arg1->data.float_value;
           break;
 
+        case DECIMAL: /* Arg1 is float, arg2 is decimal */
+          dec_mul(arg1, arg2);
+          break;
+
         case STRING: /* Arg1 is float, arg2 is numeric array */
           k_num_array2(op_mul, 0);
           break;
       }
       break;
 
+    case DECIMAL:
+      if (arg2->type == STRING) /* Arg2 is numeric array */
+        k_num_array2(op_mul, 0);
+      else
+        dec_mul(arg1, arg2);
+      break;
+
     case STRING: /* Arg1 is numeric array */
       k_num_array2(op_mul, 0);
       break;
@@ -1142,6 +1220,15 @@ void op_neg() {
       descr->data.float_value = -(descr->data.float_value);
       break;
 
+    case DECIMAL:
+      if (descr->data.dec.value == INT64_MIN) {
+        dec_to_float(descr);
+        descr->data.float_value = -(descr->data.float_value);
+      } else {
+        descr->data.dec.value = -(descr->data.dec.value);
+      }
+      break;
+
     case STRING:
       k_num_array1(op_neg);
       break;
@@ -1208,9 +1295,11 @@ void op_quotient() {
 
   arg1 = e_stack - 1;
   GetNum(arg1);
+  DecToFloat(arg1);
 
   arg2 = e_stack - 2;
   GetNum(arg2);
+  DecToFloat(arg2);
 
   /* Divide arg2 by arg1, placing result in arg2 */
 
@@ -1336,10 +1425,12 @@ void op_rem() {
   process.numeric_array_allowed = TRUE;
   arg_y = e_stack - 1;
   GetNum(arg_y);
+  DecToFloat(arg_y);
 
   process.numeric_array_allowed = TRUE;
   arg_x = e_stack - 2;
   GetNum(arg_x);
+  DecToFloat(arg_x);
   process.numeric_array_allowed = FALSE; /* 0506 */
 
   if ((arg_x->type == INTEGER) && (arg_y->type == INTEGER)) {
@@ -1451,6 +1542,7 @@ void op_scale() {
     process.numeric_array_allowed = TRUE;
     descr = e_stack - 2;
     GetNum(descr);
+    DecToFloat(descr);
     process.numeric_array_allowed = FALSE; /* 0506 */
 
     switch (descr->type) {
@@ -1593,10 +1685,8 @@ void op_sub() {
                 overflow of the result.                                       */
               && ((arg2->data.value ^ new_int) < 0)) /* Overflow */
           {
-            /* Convert descriptor to a FLOATNUM */
-            arg2->type = FLOATNUM;
-            arg2->data.float_value =
-                (double)(arg2->data.value) - arg1->data.value;
+            /* Convert descriptor to a DECIMAL */
+            dec_set(arg2, (int64)(arg2->data.value) - arg1->data.value, 0);
           } else /* no overflow */
           {
             arg2->data.value = new_int;
@@ -1607,6 +1697,10 @@ void op_sub() {
           arg2->data.float_value -= arg1->data.value;
           break;
 
+        case DECIMAL: /* Arg1 is integer, arg2 is decimal */
+          dec_add(arg1, arg2, TRUE);
+          break;
+
         case STRING: /* Arg1 is integer, arg2 is numeric array */
           k_num_array2(op_sub, 0);
           break;
@@ -1625,12 +1719,23 @@ void op_sub() {
           arg2->data.float_value -= arg1->data.float_value;
           break;
 
+        case DECIMAL: /* Arg1 is float, arg2 is decimal */
+          dec_add(arg1, arg2, TRUE);
+          break;
+
         case STRING: /* Arg1 is float, arg2 is numeric array */
           k_num_array2(op_sub, 0);
           break;
       }
       break;
 
+    case DECIMAL:
+      if (arg2->type == STRING) /* Arg2 is numeric array */
+        k_num_array2(op_sub, 0);
+      else
+        dec_add(arg1, arg2, TRUE);
+      break;
+
     case STRING: /* Arg1 is numeric array */
       k_num_array2(op_sub, 0);
       break;
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added SEQBUF parameter.
+ *
+ * 18Oct26 gwb Added STRCACHE parameter.
+ *
+ * 18Oct26 gwb Added OPSTATS parameter.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -147,6 +153,8 @@ void op_config() {
     result.data.value = pcfg.objects;
   else if (!strcmp(param, "OBJMEM"))
     result.data.value = pcfg.objmem / 1024;
+  else if (!strcmp(param, "OPSTATS"))
+    result.data.value = pcfg.opstats;
   else if (!strcmp(param, "PDUMP"))
     result.data.value = sysseg->pdump;
   else if (!strcmp(param, "PORTMAP")) {
@@ -163,6 +171,8 @@ void op_config() {
     result.data.value = pcfg.ringwait;
   else if (!strcmp(param, "SAFEDIR"))
     result.data.value = pcfg.safedir;
+  else if (!strcmp(param, "SEQBUF"))
+    result.data.value = pcfg.seqbuf;
   else if (!strcmp(param, "SH"))
     k_put_c_string(pcfg.sh, &result);
   else if (!strcmp(param, "SH1"))
@@ -177,6 +187,8 @@ void op_config() {
     k_put_c_string(pcfg.spooler, &result);
   else if (!strcmp(param, "STARTUP"))
     k_put_c_string((char*)(sysseg->startup), &result);
+  else if (!strcmp(param, "STRCACHE"))
+    result.data.value = pcfg.strcache;
   else if (!strcmp(param, "TEMPDIR"))
     k_put_c_string(pcfg.tempdir, &result);
   else if (!strcmp(param, "TERMINFO"))
@@ -305,6 +317,15 @@ void op_pconfig() {
     if (descr->data.value < 0)
       goto exit_op_pconfig;
     pcfg.objmem = descr->data.value * 1024L;
+  } else if (!strcmp(param, "OPSTATS")) {
+    GetInt(descr);
+    if ((descr->data.value < 0) || (descr->data.value > 1))
+      goto exit_op_pconfig;
+    if (pcfg.opstats && !descr->data.value)
+      opcode_stats_flush();
+    pcfg.opstats = (descr->data.value != 0);
+    if (!k_exit_cause)
+      k_exit_cause = K_TOGGLE_TRACER; /* Reselect dispatch loop */
   } else if (!strcmp(param, "QMCLIENT")) {
     GetInt(descr);
     if ((descr->data.value < pcfg.qmclient_mode) || (descr->data.value > 2))
@@ -326,6 +347,11 @@ void op_pconfig() {
     if ((descr->data.value < 0) || (descr->data.value > 1))
       goto exit_op_pconfig;
     pcfg.safedir = (descr->data.value != 0);
+  } else if (!strcmp(param, "SEQBUF")) {
+    GetInt(descr);
+    if ((descr->data.value < 2) || (descr->data.value > 65536))
+      goto exit_op_pconfig;
+    pcfg.seqbuf = descr->data.value;
   } else if (!strcmp(param, "SH")) {
     k_get_string(descr);
     /* the below if() was missing from this block -gwb 22Feb20 */
@@ -372,6 +398,12 @@ void op_pconfig() {
     if (str->string_len > MAX_PATHNAME_LEN)
       goto exit_op_pconfig;
     k_get_c_string(descr, pcfg.spooler, MAX_PATHNAME_LEN);
+  } else if (!strcmp(param, "STRCACHE")) {
+    GetInt(descr);
+    if ((descr->data.value < 0) || (descr->data.value > 65536))
+      goto exit_op_pconfig;
+    pcfg.strcache = descr->data.value;
+    reset_chunk_pools();
   } else if (!strcmp(param, "TEMPDIR")) {
     k_get_string(descr);
     if ((str = descr->data.str.saddr) == NULL)
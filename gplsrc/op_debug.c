@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Debugger shows DECIMAL variables as floats.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686)
  * 
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -399,6 +401,7 @@ Private void get_var_info(
   int32_t offset;
   STRING_CHUNK* current_chunk;
   int n;
+  char dec_str[32];
 
   while (var_descr->type == ADDR)
     var_descr = var_descr->data.d_addr;
@@ -410,9 +413,9 @@ Private void get_var_info(
     type = var_descr->type;
   }
 
-  /* Copy variable type to result string */
+  /* Copy variable type to result string. Decimals are shown as floats. */
 
-  ts_printf("%d", type);
+  ts_printf("%d", (type == DECIMAL) ? FLOATNUM : type);
   ts_copy_byte(FIELD_MARK);
 
   switch (type) /* ++ALLTYPES++ */
@@ -425,6 +428,12 @@ Private void get_var_info(
       ts_printf("%lf", var_descr->data.float_value);
       break;
 
+    case DECIMAL:
+      dec_to_str(var_descr->data.dec.value, var_descr->data.dec.scale,
+                 DEC_MAX_SCALE, dec_str);
+      ts_copy_c_string(dec_str);
+      break;
+
     case SUBR:
       obj_hdr = (struct OBJECT_HEADER*)(var_descr->data.subr.object);
       ts_copy_c_string(obj_hdr->ext_hdr.prog.program_name);
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  *
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb dio_close() signals lock waiters after releasing REC_LOCK_SEM.
+ *
+ * 18Oct26 gwb DH file cache entries carry a pathname hash.
+ *
+ * 18Oct26 gwb flush_dh_cache() also discards cached TRANS() results.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -73,6 +79,7 @@
 
 #define MAX_DH_CACHE_SIZE 10
 struct DH_CACHE {
+  u_int32_t hash; /* dh_cache_hash(pathname) */
   char* pathname;
   DH_FILE* dh_file;
 };
@@ -80,6 +87,7 @@ Private struct DH_CACHE dh_cache[MAX_DH_CACHE_SIZE];
 Private int16_t dh_cache_size = 0;
 
 Private void open_file(bool map_name);
+Private u_int32_t dh_cache_hash(char* pathname);
 
 /* ======================================================================
    op_close()  -  Close a file                                            */
@@ -431,6 +439,7 @@ void dio_close(FILE_VAR* fvar) {
       fptr->file_lock = 0;
       clear_waiters(-(fvar->file_id));
       EndExclusive(REC_LOCK_SEM);
+      wake_waiters();
     }
 
     unlock_record(fvar, "", 0);
@@ -549,6 +558,7 @@ Private void open_file(bool map_name) /* Map file name via VOC entry */
   char s[MAX_PATHNAME_LEN + 1];
   int16_t i;
   struct DH_CACHE cache_copy;
+  u_int32_t hash;
   AK_CTRL* ak_ctrl;
   u_int32_t ak_map;
   struct stat statbuf;
@@ -666,8 +676,10 @@ Private void open_file(bool map_name) /* Map file name via VOC entry */
 
   /* Is this a cached DH file? */
 
+  hash = dh_cache_hash(pathname);
   for (i = 0; i < dh_cache_size; i++) {
-    if (strcmp(pathname, dh_cache[i].pathname) == 0) {
+    if ((dh_cache[i].hash == hash) &&
+        (strcmp(pathname, dh_cache[i].pathname) == 0)) {
       /* File is available via the DH file cache */
 
       dh_file = dh_cache[i].dh_file;
@@ -780,6 +792,7 @@ Private void open_file(bool map_name) /* Map file name via VOC entry */
       }
 
       strcpy(dh_cache[i].pathname, pathname);
+      dh_cache[i].hash = hash;
       dh_cache[i].dh_file = dh_file;
       dh_file->open_count++;
     }
@@ -876,7 +889,9 @@ void flush_dh_cache() {
 
   dh_cache_size = 0;
 
-  /* Also clear TRANS file cache */
+  /* Also clear TRANS file and result caches */
+
+  trans_cache_flush();
 
   descr = Element(process.syscom, SYSCOM_TRANS_FILES);
   k_release(descr);
@@ -893,4 +908,16 @@ void flush_dh_cache() {
   }
 }
 
+/* ======================================================================
+   dh_cache_hash()  -  Hash pathname for DH cache search                  */
+
+Private u_int32_t dh_cache_hash(char* pathname) {
+  u_int32_t h = 2166136261u; /* FNV-1a */
+
+  while (*pathname != '\0')
+    h = (h ^ (u_char)*(pathname++)) * 16777619u;
+
+  return h;
+}
+
 /* END-CODE */
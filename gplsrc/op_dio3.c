@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb CLEARFILE signals lock waiters after releasing REC_LOCK_SEM.
+ *
+ * 18Oct26 gwb Record lock waits use lock_wait().
+ *
+ * 18Oct26 gwb dir_write() always replaces object code records by rename.
+ *
  * 06Feb22 gwb Initialized a char array in read_record() in order to clear a warning
  *             reported by valgrind.  Reformatted code.
  * 
@@ -119,6 +125,7 @@ Private bool t1_flush(void);
 Private void t1_buffer_free(void);
 Private void read_record(bool matread);
 Private bool valid_id(char *id, int16_t id_len);
+Private bool is_object_code(STRING_CHUNK *str);
 
 /* ======================================================================
    op_clrfile()  -  Clear File                                            */
@@ -265,6 +272,7 @@ void op_clrfile() {
       fptr->file_lock = 0; /* Release special lock */
       clear_waiters(-(fvar->file_id));
       EndExclusive(REC_LOCK_SEM);
+      wake_waiters();
     } else {
       fptr->file_lock = process.user_no; /* Revert to normal lock */
     }
@@ -624,7 +632,7 @@ void op_readv() {
               process.op_flags = op_flags;
               pc = op_pc;
               lock_beep();
-              Sleep(250);
+              lock_wait();
               return;
           }
         }
@@ -1086,7 +1094,7 @@ Private void read_record(bool matread) {
           if (my_uptr->events)
             process_events();
           lock_beep();
-          Sleep(250);
+          lock_wait();
           return;
       }
     }
@@ -1366,6 +1374,29 @@ bool map_t1_id(char *id, int16_t id_len, char *mapped_id) {
   return TRUE;
 }
 
+/* ======================================================================
+   is_object_code()  -  Does record look like compiled object code?
+   The magic number and total size in the header must both match.         */
+
+Private bool is_object_code(STRING_CHUNK *str) {
+  u_int32_t size;
+
+  if ((str == NULL) || (str->bytes < OBJECT_HEADER_SIZE))
+    return FALSE;
+
+  memcpy(&size, str->data + offsetof(OBJECT_HEADER, object_size),
+         sizeof(size));
+
+  if ((u_char)(str->data[0]) == HDR_MAGIC_INVERSE) {
+    size = ((size >> 24) & 0xFF) | ((size >> 8) & 0xFF00) |
+           ((size << 8) & 0xFF0000) | (size << 24);
+  } else if ((u_char)(str->data[0]) != HDR_MAGIC) {
+    return FALSE;
+  }
+
+  return size == (u_int32_t)(str->string_len);
+}
+
 /* ======================================================================
    dir_write()  -  Write record to directory file                         */
 
@@ -1379,10 +1410,16 @@ bool dir_write(FILE_VAR *fvar, char *mapped_id, STRING_CHUNK *str) {
   char *q;
   int16_t n;
   struct stat statbuf;
+  bool careful;
 
   t1_fu = INVALID_FILE_HANDLE;
   process.status = 0;
 
+  /* Object code may be mapped by processes that have it loaded (see
+    load_object()) so must be replaced rather than overwritten.       */
+
+  careful = pcfg.safedir || is_object_code(str);
+
   /* Increment statistics and transactions counters */
 
   StartExclusive(FILE_TABLE_LOCK, 51);
@@ -1403,7 +1440,7 @@ bool dir_write(FILE_VAR *fvar, char *mapped_id, STRING_CHUNK *str) {
     goto exit_dir_write;
   }
 
-  if (pcfg.safedir) {
+  if (careful) {
     /* converted to snprintf() -gwb 22Feb20 */
     if (snprintf(temp_path, MAX_PATHNAME_LEN + 1, "%s%c~~%d", pathname, DS, my_uptr->uid) >= (MAX_PATHNAME_LEN + 1)) {
       /* TODO: this should also be logged with more detail */
@@ -1477,7 +1514,7 @@ bool dir_write(FILE_VAR *fvar, char *mapped_id, STRING_CHUNK *str) {
       goto exit_dir_write;
   }
 
-  if (pcfg.safedir) {
+  if (careful) {
     CloseFile(t1_fu);
     t1_fu = INVALID_FILE_HANDLE;
     remove(record_path);
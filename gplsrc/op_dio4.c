@@ -21,6 +21,14 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb merge_select_lists() no longer clears either source list until
+ *             all memory has been allocated.
+ *
+ * 19Oct26 gwb merge_select_lists() checks its memory allocations.
+ *
+ * 18Oct26 gwb Added merge_select_lists() for native select list union,
+ *             intersection and difference.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -62,6 +70,8 @@
  *  op_sselect         SSELECT
  *  op_slctinfo        SLCTINFO
  *
+ *  merge_select_lists Union, intersection or difference of two lists
+ *
  * END-DESCRIPTION
  *
  * START-CODE
@@ -84,6 +94,22 @@ void op_dcount(void);
 Private void readnext(int16_t mode);
 Private bool dir_select(FILE_VAR* fvar, int16_t list_no);
 
+typedef struct MERGE_ITEM MERGE_ITEM;
+struct MERGE_ITEM {
+  char* id;
+  int32_t id_len;
+  int32_t next; /* Next item on hash chain, -1 at end */
+  bool removed; /* Deleted by DIFFERENCE */
+};
+
+Private char* merge_list_text(int16_t list_no, int32_t* bytes);
+Private void merge_list_clear(int16_t list_no);
+Private int32_t merge_list_items(char* text,
+                                 int32_t bytes,
+                                 MERGE_ITEM* items,
+                                 int32_t n);
+Private u_int32_t merge_hash(char* id, int32_t id_len);
+
 /* ====================================================================== */
 
 bool dio_init() {
@@ -1351,4 +1377,286 @@ void end_select(int16_t list_no) {
   }
 }
 
+/* ======================================================================
+   merge_select_lists()  -  Union, intersection or difference of lists
+
+   Both source lists are read as by READLIST, consuming them, and the
+   result is formed in the target list which may be one of the sources.
+   The result matches the MERGE.LIST command:
+     MERGE_UNION         list1 followed by list2 items not yet present
+     MERGE_INTERSECTION  list2 items present in list1, in list2 order
+     MERGE_DIFFERENCE    list1 less one occurrence per list2 item
+
+   Items are matched through a hash table over list1 so that the cost is
+   linear in the size of the lists rather than the product of the two.
+   Returns the number of items in the target list. Raises an error if
+   memory cannot be allocated.                                            */
+
+int32_t merge_select_lists(int16_t mode,
+                           int16_t list1,
+                           int16_t list2,
+                           int16_t tgt) {
+  char* text1;
+  char* text2;
+  int32_t bytes1;
+  int32_t bytes2;
+  int32_t n1;
+  int32_t n2;
+  int32_t i;
+  int32_t j;
+  MERGE_ITEM* items;
+  int32_t* chain;
+  u_int32_t mask;
+  u_int32_t h;
+  int32_t count = 0;
+  STRING_CHUNK* str = NULL;
+  DESCRIPTOR* descr;
+
+  text1 = merge_list_text(list1, &bytes1);
+  if (text1 == NULL)
+    k_error(sysmsg(1003));
+
+  text2 = merge_list_text(list2, &bytes2);
+  if (text2 == NULL) {
+    k_free(text1);
+    k_error(sysmsg(1003));
+  }
+
+  n1 = merge_list_items(text1, bytes1, NULL, 0);
+  n2 = merge_list_items(text2, bytes2, NULL, 0);
+
+  items = (MERGE_ITEM*)k_alloc(150, (n1 + n2 + 1) * sizeof(MERGE_ITEM));
+  if (items == NULL) {
+    k_free(text1);
+    k_free(text2);
+    k_error(sysmsg(1003));
+  }
+  merge_list_items(text1, bytes1, items, n1);
+  merge_list_items(text2, bytes2, items + n1, n2);
+
+  mask = 16;
+  while (mask < (u_int32_t)(n1 + n2) * 2)
+    mask <<= 1;
+  chain = (int32_t*)k_alloc(151, mask * sizeof(int32_t));
+  if (chain == NULL) {
+    k_free(items);
+    k_free(text1);
+    k_free(text2);
+    k_error(sysmsg(1003));
+  }
+  mask--;
+  for (h = 0; h <= mask; h++)
+    chain[h] = -1;
+
+  /* Only now that nothing more can fail are the source lists consumed */
+
+  merge_list_clear(list1);
+  merge_list_clear(list2);
+
+  /* Chain list1 in reverse so that each chain runs in list order */
+
+  for (i = n1 - 1; i >= 0; i--) {
+    h = merge_hash(items[i].id, items[i].id_len) & mask;
+    items[i].next = chain[h];
+    chain[h] = i;
+  }
+
+  ts_init(&str, 1024);
+
+  if (mode == MERGE_UNION) {
+    for (i = 0; i < n1; i++) {
+      if (count++)
+        ts_copy_byte(FIELD_MARK);
+      ts_copy(items[i].id, items[i].id_len);
+    }
+  }
+
+  for (j = n1; j < n1 + n2; j++) {
+    h = merge_hash(items[j].id, items[j].id_len) & mask;
+    for (i = chain[h]; i >= 0; i = items[i].next) {
+      if (!items[i].removed && (items[i].id_len == items[j].id_len) &&
+          !memcmp(items[i].id, items[j].id, items[j].id_len)) {
+        break;
+      }
+    }
+
+    switch (mode) {
+      case MERGE_UNION:
+        if (i < 0) {
+          items[j].next = chain[h]; /* Only the first occurrence is added */
+          chain[h] = j;
+          if (count++)
+            ts_copy_byte(FIELD_MARK);
+          ts_copy(items[j].id, items[j].id_len);
+        }
+        break;
+
+      case MERGE_INTERSECTION:
+        if (i >= 0) {
+          if (count++)
+            ts_copy_byte(FIELD_MARK);
+          ts_copy(items[j].id, items[j].id_len);
+        }
+        break;
+
+      case MERGE_DIFFERENCE:
+        if (i >= 0)
+          items[i].removed = TRUE;
+        break;
+    }
+  }
+
+  if (mode == MERGE_DIFFERENCE) {
+    for (i = 0; i < n1; i++) {
+      if (!items[i].removed) {
+        if (count++)
+          ts_copy_byte(FIELD_MARK);
+        ts_copy(items[i].id, items[i].id_len);
+      }
+    }
+  }
+
+  (void)ts_terminate();
+
+  k_free(chain);
+  k_free(items);
+  k_free(text1);
+  k_free(text2);
+
+  /* Save the result as FORMLIST would */
+
+  end_select(tgt);
+
+  descr = SelectList(tgt);
+  k_release(descr);
+  InitDescr(descr, STRING);
+  descr->data.str.saddr = str;
+
+  descr = SelectCount(tgt);
+  k_release(descr);
+  InitDescr(descr, INTEGER);
+  descr->data.value = count;
+
+  if (tgt <= HIGH_USER_SELECT) {
+    descr = Element(process.syscom, SYSCOM_SELECTED);
+    k_release(descr);
+    InitDescr(descr, INTEGER);
+    descr->data.value = count;
+  }
+
+  return count;
+}
+
+/* ======================================================================
+   merge_list_text()  -  Copy unprocessed part of a list
+
+   The list is left unchanged. Returns NULL if memory cannot be
+   allocated.                                                             */
+
+Private char* merge_list_text(int16_t list_no, int32_t* bytes) {
+  DESCRIPTOR* descr;
+  STRING_CHUNK* first;
+  STRING_CHUNK* str;
+  int32_t offset = 0;
+  int32_t n;
+  char* text;
+  char* p;
+
+  complete_select(list_no);
+
+  descr = SelectList(list_no);
+
+  /* Find the remove position. It may lie one byte off the end. */
+
+  first = NULL;
+  if (descr->type == STRING) {
+    first = descr->data.str.saddr;
+    if ((first != NULL) && (descr->flags & DF_REMOVE)) {
+      first = descr->data.str.rmv_saddr;
+      offset = min(descr->n1, first->bytes);
+    }
+  }
+
+  for (n = -offset, str = first; str != NULL; str = str->next)
+    n += str->bytes;
+
+  text = (char*)k_alloc(149, n + 1);
+  if (text == NULL)
+    return NULL; /* List left unchanged */
+
+  for (p = text, str = first; str != NULL; str = str->next) {
+    memcpy(p, str->data + offset, str->bytes - offset);
+    p += str->bytes - offset;
+    offset = 0;
+  }
+  *p = '\0';
+  *bytes = n;
+
+  return text;
+}
+
+/* ======================================================================
+   merge_list_clear()  -  Leave a merged source list as READLIST does     */
+
+Private void merge_list_clear(int16_t list_no) {
+  DESCRIPTOR* descr;
+
+  descr = SelectList(list_no);
+  k_release(descr);
+  InitDescr(descr, STRING);
+  descr->data.str.saddr = NULL;
+
+  descr = SelectCount(list_no);
+  k_release(descr);
+  InitDescr(descr, INTEGER);
+  descr->data.value = 0;
+}
+
+/* ======================================================================
+   merge_list_items()  -  Split list text at field marks
+
+   Null items are skipped. With items NULL, just counts the items.        */
+
+Private int32_t merge_list_items(char* text,
+                                 int32_t bytes,
+                                 MERGE_ITEM* items,
+                                 int32_t n) {
+  char* p;
+  char* q;
+  char* end;
+  int32_t count = 0;
+
+  end = text + bytes;
+  for (p = text; p < end; p = q + 1) {
+    q = memchr(p, FIELD_MARK, end - p);
+    if (q == NULL)
+      q = end;
+
+    if (q != p) {
+      if (items != NULL) {
+        if (count == n)
+          break;
+        items[count].id = p;
+        items[count].id_len = q - p;
+        items[count].next = -1;
+        items[count].removed = FALSE;
+      }
+      count++;
+    }
+  }
+
+  return count;
+}
+
+/* ====================================================================== */
+
+Private u_int32_t merge_hash(char* id, int32_t id_len) {
+  u_int32_t h = 2166136261u;
+
+  while (id_len-- > 0)
+    h = (h ^ (u_char) * (id++)) * 16777619u;
+
+  return h;
+}
+
 /* END-CODE */
@@ -21,6 +21,10 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Clear lock wait queue ticket in op_enter().
+ *
+ * 18Oct26 gwb Conditional jumps handle DECIMAL values.
+ *
  * 11Jan22 gwb Fix for Issue #12
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
@@ -398,7 +402,7 @@ void op_enter() {
 
   k_dismiss(); /* Dismiss call name */
 
-  if (my_uptr->lockwait_index)
+  if (my_uptr->lockwait_index || my_uptr->lockwait_ticket)
     clear_lockwait();
 
   /* Cast off all programs down to but not including one with
@@ -483,6 +487,10 @@ again:
       jumping = (descr->data.float_value < 0.0);
       break;
 
+    case DECIMAL:
+      jumping = (descr->data.dec.value < 0);
+      break;
+
     default:
       GetNum(descr);
       goto again;
@@ -519,6 +527,10 @@ again:
       jumping = (descr->data.float_value != 0.0);
       break;
 
+    case DECIMAL:
+      jumping = (descr->data.dec.value != 0);
+      break;
+
     default:
       GetNum(descr);
       goto again;
@@ -555,6 +567,10 @@ again:
       jumping = (descr->data.float_value > 0.0);
       break;
 
+    case DECIMAL:
+      jumping = (descr->data.dec.value > 0);
+      break;
+
     default:
       GetNum(descr);
       goto again;
@@ -591,6 +607,10 @@ again:
       jumping = (descr->data.float_value >= 0.0);
       break;
 
+    case DECIMAL:
+      jumping = (descr->data.dec.value >= 0);
+      break;
+
     default:
       GetNum(descr);
       goto again;
@@ -649,6 +669,10 @@ again:
       jumping = (descr->data.float_value == 0.0);
       break;
 
+    case DECIMAL:
+      jumping = (descr->data.dec.value == 0);
+      break;
+
     default:
       GetNum(descr);
       goto again;
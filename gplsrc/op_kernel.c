@@ -21,6 +21,15 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added K$CONTENTION.
+ *
+ * 18Oct26 gwb Added K$MERGE.LIST.
+ *
+ * 18Oct26 gwb K$DATE.FORMAT and K$DATE.CONV discard compiled OCONV() codes.
+ *
+ * 18Oct26 gwb K$HSM modes 3 and 4 for leaf-only sampling and sample dump.
+ *             K$PRIVATE.CATALOGUE resets the catalogue lookup cache.
+ *
  * 15Jan22 gwb Fixed argument formatting issues (CwE-686), reformmated
  *             entire source file.
  * 
@@ -119,6 +128,7 @@ void op_kernel() {
      K$EXIT.STATUS        Set exit status
      K$AUTOLOGOUT         Set/retrieve autologout period
      K$MAP.DIR.IDS        Enable/disable dir file id mapping
+     K$MERGE.LIST         Merge select lists (mode, list1, list2, target)
  */
 
   DESCRIPTOR *descr;
@@ -132,6 +142,7 @@ void op_kernel() {
   int32_t *q;
   USER_ENTRY *uptr;
   STRING_CHUNK *str;
+  int16_t merge_args[4];
 
   InitDescr(&result, INTEGER);
   result.data.value = 0;
@@ -210,8 +221,10 @@ void op_kernel() {
     case K_DATE_FORMAT:
       GetInt(descr);
       n = descr->data.value;
-      if (n >= 0)
+      if (n >= 0) {
         european_dates = (n != 0);
+        conv_cache_flush();
+      }
       result.data.value = european_dates;
       break;
 
@@ -248,6 +261,7 @@ void op_kernel() {
     case K_DATE_CONV:
       if ((result.data.value = (k_get_c_string(descr, s, 32))) > 0) {
         strcpy(default_date_conversion, s);
+        conv_cache_flush();
       }
       k_put_c_string(default_date_conversion, &result);
       break;
@@ -369,6 +383,7 @@ void op_kernel() {
 
     case K_PRIVATE_CATALOGUE:
       j = k_get_c_string(descr, private_catalogue, MAX_PATHNAME_LEN);
+      invalidate_catalogue_cache();
       break;
 
     case K_CLEANUP:
@@ -400,14 +415,21 @@ void op_kernel() {
       GetInt(descr);
       switch (descr->data.value) {
         case 0: /* Disable */
-          hsm = FALSE;
+          hsm_off();
           break;
-        case 1: /* Enable */
-          hsm_on();
+        case 1: /* Enable, recording call stacks */
+          hsm_on(TRUE);
           break;
-        case 2: /* Return data */
+        case 2: /* Return program data */
           InitDescr(&result, STRING);
-          result.data.str.saddr = hsm_dump();
+          result.data.str.saddr = hsm_dump(HSM_DUMP_PROGRAMS);
+          break;
+        case 3: /* Enable, current program only */
+          hsm_on(FALSE);
+          break;
+        case 4: /* Return sample data */
+          InitDescr(&result, STRING);
+          result.data.str.saddr = hsm_dump(HSM_DUMP_SAMPLES);
           break;
       }
       break;
@@ -512,6 +534,53 @@ void op_kernel() {
       result.data.value = run_exe(s, p);
       break;
 
+    case K_CONTENTION: /* Qualifier: mode */
+      GetInt(descr);
+      switch (descr->data.value) {
+        case CONTENTION_REPORT:
+          InitDescr(&result, STRING);
+          result.data.str.saddr = NULL;
+          contention_report(&(result.data.str.saddr));
+          break;
+
+        case CONTENTION_ON:
+          if (!(sysseg->flags & SSF_CONTENTION)) {
+            contention_reset();
+            sysseg->flags |= SSF_CONTENTION;
+          }
+          break;
+
+        case CONTENTION_OFF:
+          sysseg->flags &= ~SSF_CONTENTION;
+          break;
+
+        case CONTENTION_RESET:
+          contention_reset();
+          break;
+
+        default:
+          k_error("Invalid K$CONTENTION mode");
+      }
+      break;
+
+    case K_MERGE_LIST: /* Qualifier: mode FM list1 FM list2 FM target */
+      k_get_c_string(descr, s, 64);
+      p = s;
+      for (j = 0; j < 4; j++) {
+        merge_args[j] = (int16_t)strtol(p, &p, 10);
+        if (*p == FIELD_MARK)
+          p++;
+        else if (j < 3)
+          k_error("Invalid K$MERGE.LIST qualifier");
+        if ((j > 0) && InvalidSelectListNo(merge_args[j]))
+          k_select_range_error();
+      }
+      if ((merge_args[0] < MERGE_UNION) || (merge_args[0] > MERGE_DIFFERENCE))
+        k_error("Invalid K$MERGE.LIST mode");
+      result.data.value = merge_select_lists(merge_args[0], merge_args[1],
+                                             merge_args[2], merge_args[3]);
+      break;
+
     default:
       k_error("Illegal KERNEL() action key (%d)", action);
   }
@@ -21,6 +21,7 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb CLEAR handles DECIMAL variables.
  * 03Sep25 gwb Fix potential overflow (github issue #79)
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
@@ -986,6 +987,7 @@ Private void set_descr(DESCRIPTOR* p, u_char type) {
     case UNASSIGNED:
     case ADDR:
     case FLOATNUM:
+    case DECIMAL:
     case INTEGER:
       InitDescr(p, type);
       p->data.value = 0;
@@ -21,6 +21,17 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb LOCATE indexes no longer hold a reference to the string,
+ *             which made every later in-place update copy it. The index
+ *             is found by the string address and the SNF_LOCATE flag, and
+ *             is released when the string is freed. Limit their total
+ *             size.
+ *
+ * 18Oct26 gwb Ordered searches of large arrays that are searched repeatedly
+ *             use an index of the items to skip to the insertion point.
+ *
+ * 18Oct26 gwb Use find_delim() when skipping to the end of an item.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -44,6 +55,67 @@
 
 Private void locate(bool numeric_mode);
 
+/* Sorted LOCATE index
+   An ordered LOCATE that is repeated against the same large dynamic array
+   builds an index of the items in the searched field or value. Later
+   searches use it to binary search for the first item that could end the
+   search and continue with the normal linear comparison from there, so
+   the result is exactly as for a full scan.
+   The index does not hold a reference to the string, so the string can
+   still be updated in place. It is keyed on the address of the first
+   chunk and the SNF_LOCATE numeric shadow flag, which is set when the
+   index is built and cleared by any in-place update of the string, as
+   every such update must clear the shadow flags. An index whose string
+   has changed is discarded when next found and s_free() discards the
+   index of a string that is released. An index is only built on the
+   second consecutive search of the same string so that arrays that are
+   updated between searches do not build one each time. The total size of
+   the indexes is limited, discarding the least recently used to make
+   room.                                                                 */
+
+#define LOCATE_INDEX_MIN_LEN 4096 /* Smallest string worth indexing */
+#define LOCATE_INDEX_SLOTS 4
+#define LOCATE_INDEX_MAX_BYTES (16 * 1024 * 1024) /* Total of all indexes */
+
+typedef struct LOCATE_INDEX LOCATE_INDEX;
+struct LOCATE_INDEX {
+  STRING_CHUNK* str; /* Source string (not referenced), NULL if free */
+  int32_t string_len; /* Length of source string when indexed */
+  int32_t field;     /* Search start position */
+  int32_t value;
+  int32_t subvalue;
+  int32_t n;          /* Number of items */
+  int32_t* start;     /* Offset of each item in data. start[n] is end + 1 */
+  char* data;         /* Copy of searched region of source string */
+  int32_t* values;    /* Item values for numeric AR/DR, if all numeric */
+  int16_t sorted[8];  /* By ascending, right, nocase: 0 = unknown, 1 = yes, -1 = no */
+  int16_t numeric[2]; /* Numeric sort state for DR, AR */
+  u_int32_t last_used;
+  int32_t bytes;      /* Memory used by start, data and values */
+};
+
+Private LOCATE_INDEX locate_index[LOCATE_INDEX_SLOTS];
+Private u_int32_t locate_index_clock = 0;
+Private int16_t locate_index_used = 0;  /* Slots in use */
+Private int32_t locate_index_bytes = 0; /* Total of bytes in all slots */
+Private STRING_CHUNK* locate_candidate = NULL; /* Previous search, not referenced */
+Private int32_t locate_candidate_len;
+
+Private void free_locate_index(LOCATE_INDEX* lx);
+Private int32_t locate_index_skip(STRING_CHUNK* str,
+                                  int32_t field,
+                                  int32_t value,
+                                  int32_t subvalue,
+                                  char mark,
+                                  int32_t base,
+                                  STRING_CHUNK* search,
+                                  bool ascending,
+                                  bool right,
+                                  bool nocase,
+                                  bool numeric_compare,
+                                  int32_t search_value,
+                                  int32_t* skip_offset);
+
 /* ======================================================================
    op_locate()  -  Locate item in dynamic array                           */
 
@@ -128,7 +200,7 @@ Private void locate(bool numeric_mode) {
 #define MAX_NUMERIC_STRING 20
   char numeric_string[MAX_NUMERIC_STRING + 1]; /* Search item */
   int16_t numeric_len;
-  int32_t search_value;        /* Search item as a number */
+  int32_t search_value = 0;    /* Search item as a number */
   bool numeric_compare = FALSE; /* Try numeric compare? */
   char item_string[MAX_NUMERIC_STRING + 1];
   int16_t item_len;
@@ -147,6 +219,8 @@ Private void locate(bool numeric_mode) {
   int32_t chunk_offset;
   int32_t new_hint_offset;
   STRING_CHUNK* str;
+  int32_t skip;        /* Items skipped using locate index */
+  int32_t skip_offset; /* Offset of first item not skipped */
 
   nocase = (process.program.flags & HDR_NOCASE) != 0;
 
@@ -334,6 +408,34 @@ Private void locate(bool numeric_mode) {
     goto found;
   }
 
+  /* For a large sorted array, use the locate index to skip over items
+    that must precede the search item.                                  */
+
+  if (ordered && (first_chunk->string_len >= LOCATE_INDEX_MIN_LEN)) {
+    src_len = p - src_hdr->data; /* Offset of first item in string */
+    for (str = first_chunk; str != src_hdr; str = str->next) {
+      src_len += str->bytes;
+    }
+
+    skip = locate_index_skip(first_chunk, field, value, subvalue, mark, src_len,
+                             search_hdr, ascending, right, nocase,
+                             numeric_compare, search_value, &skip_offset);
+    if (skip) {
+      index += skip;
+      new_hint_offset = skip_offset;
+
+      src_hdr = first_chunk;
+      chunk_offset = 0;
+      while (((skip_offset - chunk_offset) >= src_hdr->bytes) &&
+             (src_hdr->next != NULL)) {
+        chunk_offset += src_hdr->bytes;
+        src_hdr = src_hdr->next;
+      }
+      p = src_hdr->data + (skip_offset - chunk_offset);
+      src_bytes_remaining = src_hdr->bytes - (int16_t)(skip_offset - chunk_offset);
+    }
+  }
+
   /* Special case for right justifed search where the search string can be
     treated as a number.                                                  */
 
@@ -526,16 +628,21 @@ Private void locate(bool numeric_mode) {
 
               do {
                 while (src_bytes_remaining > 0) {
-                  c = *p;
-                  if (IsDelim(c)) {
-                    if ((u_char)c >= (u_char)mark) /* Found end of item */
-                    {
-                      if (src_len == search_string_len)
-                        goto compare;
-                      if ((search_string_len < src_len) == ascending)
-                        goto found;
-                      goto skip_item;
-                    }
+                  r = find_delim(p, src_bytes_remaining);
+                  n = (r == NULL) ? src_bytes_remaining : (int16_t)(r - p);
+                  p += n;
+                  src_len += n;
+                  src_bytes_remaining -= n;
+                  if (r == NULL)
+                    break;
+
+                  if ((u_char)*p >= (u_char)mark) /* Found end of item */
+                  {
+                    if (src_len == search_string_len)
+                      goto compare;
+                    if ((search_string_len < src_len) == ascending)
+                      goto found;
+                    goto skip_item;
                   }
                   p++;
                   src_len++;
@@ -588,14 +695,18 @@ Private void locate(bool numeric_mode) {
                 }
               }
             } else {
-              while (src_bytes_remaining-- > 0) {
-                c = *(p++);
-                if (IsDelim(c)) {
-                  if (c == mark)
-                    goto skipped;
-                  if ((u_char)c > (u_char)mark)
-                    goto not_found;
-                }
+              while (src_bytes_remaining > 0) {
+                r = find_delim(p, src_bytes_remaining);
+                if (r == NULL)
+                  break;
+
+                c = *r;
+                src_bytes_remaining -= (r - p) + 1;
+                p = r + 1;
+                if (c == mark)
+                  goto skipped;
+                if ((u_char)c > (u_char)mark)
+                  goto not_found;
               }
             }
 
@@ -688,6 +799,359 @@ exit_locate:
   (e_stack++)->data.value = status;
 }
 
+/* ======================================================================
+   locate_index_skip()  -  Find items that an ordered search can skip
+
+   Returns the number of items that can be skipped and sets skip_offset to
+   the offset within the source string of the first item not skipped.
+   Always leaves at least the final item to be examined by the normal
+   search.                                                                */
+
+Private LOCATE_INDEX* find_locate_index(STRING_CHUNK* str,
+                                        int32_t field,
+                                        int32_t value,
+                                        int32_t subvalue,
+                                        char mark,
+                                        int32_t base);
+Private int16_t locate_index_sorted(LOCATE_INDEX* lx, bool ascending, bool right, bool nocase);
+Private int locate_compare(char* s1, int32_t len1, char* s2, int32_t len2, bool right, bool nocase);
+
+Private int32_t locate_index_skip(STRING_CHUNK* str,
+                                  int32_t field,
+                                  int32_t value,
+                                  int32_t subvalue,
+                                  char mark,
+                                  int32_t base,
+                                  STRING_CHUNK* search,
+                                  bool ascending,
+                                  bool right,
+                                  bool nocase,
+                                  bool numeric_compare,
+                                  int32_t search_value,
+                                  int32_t* skip_offset) {
+  LOCATE_INDEX* lx;
+  int32_t lo;
+  int32_t hi;
+  int32_t mid;
+  int32_t i;
+  int diff;
+  char* s;
+  int32_t s_len;
+  int16_t k;
+
+  if ((search != NULL) && (search->next != NULL))
+    return 0; /* Search string must be contiguous */
+
+  lx = find_locate_index(str, field, value, subvalue, mark, base);
+  if ((lx == NULL) || (lx->n < 2))
+    return 0;
+
+  s = (search == NULL) ? NULL : search->data;
+  s_len = (search == NULL) ? 0 : search->bytes;
+
+  if (numeric_compare) {
+    /* All items must be integers in the required order */
+
+    k = ascending;
+    if (lx->numeric[k] == 0) {
+      if (lx->values == NULL) {
+        lx->values = (int32_t*)k_alloc(130, lx->n * sizeof(int32_t));
+        if (lx->values == NULL)
+          return 0;
+        lx->bytes += lx->n * sizeof(int32_t);
+        locate_index_bytes += lx->n * sizeof(int32_t);
+        for (i = 0; i < lx->n; i++) {
+          if (((lx->start[i + 1] - lx->start[i] - 1) > MAX_NUMERIC_STRING) ||
+              !strnint(lx->data + lx->start[i],
+                       (int16_t)(lx->start[i + 1] - lx->start[i] - 1),
+                       &(lx->values[i]))) {
+            lx->numeric[0] = lx->numeric[1] = -1;
+            break;
+          }
+        }
+      }
+
+      if (lx->numeric[k] == 0) {
+        lx->numeric[k] = 1;
+        for (i = 1; i < lx->n; i++) {
+          if ((ascending) ? (lx->values[i] < lx->values[i - 1])
+                          : (lx->values[i] > lx->values[i - 1])) {
+            lx->numeric[k] = -1;
+            break;
+          }
+        }
+      }
+    }
+
+    if (lx->numeric[k] < 0)
+      return 0;
+
+    /* Items before the first that is not less (AR) or greater (DR) than the
+      search value are always passed over by the linear search.          */
+
+    lo = 0;
+    hi = lx->n;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if ((ascending) ? (lx->values[mid] < search_value)
+                      : (lx->values[mid] > search_value)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+  } else {
+    if (locate_index_sorted(lx, ascending, right, nocase) < 0)
+      return 0;
+
+    lo = 0;
+    hi = lx->n;
+    while (lo < hi) {
+      mid = (lo + hi) / 2;
+      diff = locate_compare(lx->data + lx->start[mid],
+                            lx->start[mid + 1] - lx->start[mid] - 1, s, s_len,
+                            right, nocase);
+      if ((ascending) ? (diff < 0) : (diff > 0)) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+  }
+
+  if (lo >= lx->n)
+    lo = lx->n - 1; /* Leave final item to the linear search */
+
+  *skip_offset = base + lx->start[lo];
+  return lo;
+}
+
+/* ======================================================================
+   find_locate_index()  -  Find or build index for a string               */
+
+Private LOCATE_INDEX* find_locate_index(STRING_CHUNK* str,
+                                        int32_t field,
+                                        int32_t value,
+                                        int32_t subvalue,
+                                        char mark,
+                                        int32_t base) {
+  LOCATE_INDEX* lx;
+  LOCATE_INDEX* oldest;
+  STRING_CHUNK* chunk;
+  int16_t i;
+  int32_t n;
+  int32_t len;
+  int32_t skip;
+  int32_t bytes;
+  char* p;
+  char* q;
+  bool done;
+
+  /* The string has been updated in place since it was last indexed. Its
+    indexes are all out of date.                                         */
+
+  if (locate_index_used && !(str->num_flags & SNF_LOCATE))
+    locate_index_forget(str);
+
+  oldest = locate_index;
+  for (i = 0, lx = locate_index; i < LOCATE_INDEX_SLOTS; i++, lx++) {
+    if ((lx->str == str) && (lx->string_len == str->string_len) &&
+        (lx->field == field) && (lx->value == value) &&
+        (lx->subvalue == subvalue)) {
+      lx->last_used = ++locate_index_clock;
+      return lx;
+    }
+
+    if (lx->last_used < oldest->last_used)
+      oldest = lx;
+  }
+
+  /* Only build an index on the second consecutive search of a string */
+
+  if ((str != locate_candidate) || (str->string_len != locate_candidate_len)) {
+    locate_candidate = str;
+    locate_candidate_len = str->string_len;
+    return NULL;
+  }
+
+  locate_candidate = NULL;
+
+  /* First pass - Count items and find length of searched region. The
+    region ends at a mark higher than the item delimiter.             */
+
+  n = 1;
+  len = 0;
+  done = FALSE;
+  for (chunk = str, skip = base; (chunk != NULL) && !done; chunk = chunk->next) {
+    if (skip >= chunk->bytes) {
+      skip -= chunk->bytes;
+      continue;
+    }
+
+    p = chunk->data + skip;
+    bytes = chunk->bytes - skip;
+    skip = 0;
+
+    while ((q = find_delim(p, bytes)) != NULL) {
+      if ((u_char)*q > (u_char)mark) {
+        bytes = q - p;
+        done = TRUE;
+        break;
+      }
+
+      if (*q == mark)
+        n++;
+      len += (q - p) + 1;
+      bytes -= (q - p) + 1;
+      p = q + 1;
+    }
+
+    len += bytes;
+  }
+
+  /* Discard the least recently used indexes to make room, including the
+    slot that we are going to use.                                       */
+
+  bytes = ((n + 1) * sizeof(int32_t)) + len + 1;
+  if (bytes > LOCATE_INDEX_MAX_BYTES)
+    return NULL;
+
+  lx = oldest;
+  if (lx->str != NULL)
+    free_locate_index(lx);
+
+  while (locate_index_bytes + bytes > LOCATE_INDEX_MAX_BYTES) {
+    for (i = 0, oldest = NULL; i < LOCATE_INDEX_SLOTS; i++) {
+      if ((locate_index[i].str != NULL) &&
+          ((oldest == NULL) || (locate_index[i].last_used < oldest->last_used))) {
+        oldest = locate_index + i;
+      }
+    }
+    free_locate_index(oldest);
+  }
+
+  /* Second pass - Copy the region and record item positions */
+
+  lx->start = (int32_t*)k_alloc(129, (n + 1) * sizeof(int32_t));
+  lx->data = (char*)k_alloc(129, len + 1);
+  if ((lx->start == NULL) || (lx->data == NULL)) {
+    k_free_ptr(lx->start);
+    k_free_ptr(lx->data);
+    return NULL;
+  }
+
+  lx->str = str;
+  lx->string_len = str->string_len;
+  str->num_flags |= SNF_LOCATE;
+  lx->field = field;
+  lx->value = value;
+  lx->subvalue = subvalue;
+  lx->n = n;
+  lx->values = NULL;
+  lx->bytes = bytes;
+  locate_index_used++;
+  locate_index_bytes += bytes;
+  memset(lx->sorted, 0, sizeof(lx->sorted));
+  lx->numeric[0] = lx->numeric[1] = 0;
+  lx->last_used = ++locate_index_clock;
+
+  for (chunk = str, skip = base, q = lx->data; len > (q - lx->data); chunk = chunk->next) {
+    if (skip >= chunk->bytes) {
+      skip -= chunk->bytes;
+      continue;
+    }
+
+    bytes = min(chunk->bytes - skip, len - (q - lx->data));
+    memcpy(q, chunk->data + skip, bytes);
+    q += bytes;
+    skip = 0;
+  }
+  lx->data[len] = mark;
+
+  lx->start[0] = 0;
+  for (p = lx->data, n = 1; n < lx->n; n++) {
+    p = memchr(p, mark, len + 1 - (p - lx->data)) + 1;
+    lx->start[n] = p - lx->data;
+  }
+  lx->start[lx->n] = len + 1;
+
+  return lx;
+}
+
+/* ======================================================================
+   locate_index_forget()  -  Release indexes of a string
+   Called when the string is released or found to have been updated.     */
+
+void locate_index_forget(STRING_CHUNK* str) {
+  int16_t i;
+
+  for (i = 0; i < LOCATE_INDEX_SLOTS; i++) {
+    if (locate_index[i].str == str)
+      free_locate_index(locate_index + i);
+  }
+}
+
+/* ======================================================================
+   free_locate_index()  -  Release an index slot                          */
+
+Private void free_locate_index(LOCATE_INDEX* lx) {
+  k_free(lx->start);
+  k_free(lx->data);
+  k_free_ptr(lx->values);
+  lx->str = NULL;
+  lx->last_used = 0;
+  locate_index_used--;
+  locate_index_bytes -= lx->bytes;
+}
+
+/* ======================================================================
+   locate_index_sorted()  -  Check that indexed items are in order        */
+
+Private int16_t locate_index_sorted(LOCATE_INDEX* lx, bool ascending, bool right, bool nocase) {
+  int16_t k;
+  int32_t i;
+  int diff;
+
+  k = (ascending ? 4 : 0) + (right ? 2 : 0) + (nocase ? 1 : 0);
+  if (lx->sorted[k] == 0) {
+    lx->sorted[k] = 1;
+    for (i = 1; i < lx->n; i++) {
+      diff = locate_compare(lx->data + lx->start[i - 1],
+                            lx->start[i] - lx->start[i - 1] - 1,
+                            lx->data + lx->start[i],
+                            lx->start[i + 1] - lx->start[i] - 1, right, nocase);
+      if ((ascending) ? (diff > 0) : (diff < 0)) {
+        lx->sorted[k] = -1;
+        break;
+      }
+    }
+  }
+
+  return lx->sorted[k];
+}
+
+/* ======================================================================
+   locate_compare()  -  Compare items as the linear search does           */
+
+Private int locate_compare(char* s1, int32_t len1, char* s2, int32_t len2, bool right, bool nocase) {
+  int32_t n;
+  int x;
+
+  if (right && (len1 != len2))
+    return (len1 < len2) ? -1 : 1; /* Longer item is greater */
+
+  for (n = min(len1, len2); n--; s1++, s2++) {
+    if (nocase)
+      x = UpperCase(*s1) - UpperCase(*s2);
+    else
+      x = ((int16_t)*s1) - *s2;
+    if (x)
+      return x;
+  }
+
+  return (len1 == len2) ? 0 : ((len1 < len2) ? -1 : 1);
+}
+
 /* ======================================================================
    op_maximum()  -  MAXIMUM() function                                    */
 
@@ -21,6 +21,24 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Processes woken from a lock wait are signalled by
+ *             wake_waiters() after REC_LOCK_SEM is released. lock_wait()
+ *             clears the wake flag on return. Lock queue scans stop once
+ *             every ticket holder has been seen.
+ *
+ * 19Oct26 gwb lock_record() only gives way to queued waiters if the caller
+ *             will wait for the lock itself.
+ *
+ * 18Oct26 gwb Local lock table is now hashed by file and record id with a
+ *             chain for each file. unlock_txn() removes local lock table
+ *             entries for the locks that it releases.
+ *
+ * 18Oct26 gwb Record lock contention statistics.
+ *
+ * 18Oct26 gwb Lock waits now sleep until woken by release of the lock
+ *             rather than polling. Record lock waiters are served in
+ *             order of arrival. Added lock wait statistics.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -62,6 +80,8 @@
  *
  *    lock_record
  *    unlock_record
+ *    lock_wait
+ *    wake_waiters
  *
  * END-DESCRIPTION
  *
@@ -75,8 +95,29 @@
 #include "tio.h"
 
 #include <time.h>
+#include <signal.h>
+#include <sys/select.h>
+
+#define LOCK_WAIT_INTERVAL 250 /* Longest sleep between attempts (mS) */
+
+Private int64 lockwait_started; /* Time of first attempt for this wait */
+Private int64 contention_started; /* Ditto in uS if collecting contention
+                                     statistics, zero if not             */
+Private int* wake_pids = NULL;    /* Processes to signal when REC_LOCK_SEM */
+Private int16_t wake_count = 0;   /* is released, see wake_waiters()      */
 
 Private bool unlock_id(int16_t file_id, char* raw_id, int16_t id_len);
+Private void llt_add(int16_t file_id, int32_t fvar_index, char* id,
+                     int16_t id_len, int32_t hash_value);
+Private void llt_remove(int16_t file_id, char* id, int16_t id_len,
+                        int32_t hash_value);
+Private void llt_release(void);
+Private void llt_unlock_file(int16_t file_id, FILE_VAR* fvar);
+Private int16_t lock_queue_check(int16_t file_id, int32_t hash_value);
+Private void lock_queue_wake(int16_t file_id, int32_t hash_value);
+Private void lock_queue_leave(bool got_lock);
+Private void wake_later(int pid);
+Private int64 lock_clock(void);
 
 /* ======================================================================
    op_filelock()  -  Set file lock                                        */
@@ -122,6 +163,7 @@ void op_filelock() {
     fptr = FPtr(file_id);
 
     StartExclusive(REC_LOCK_SEM, 36);
+    my_uptr->lockwait_wake = 0;
 
     if ((lock_owner = fptr->file_lock) != 0) {
       if (lock_owner == process.user_no) /* File lock is held by us */
@@ -171,7 +213,7 @@ void op_filelock() {
         process_events();
       pc--; /* Back up to repeat opcode */
       lock_beep();
-      Sleep(250);
+      lock_wait();
       return;
     }
 
@@ -225,6 +267,7 @@ void op_flunlock() {
       fptr->file_lock = 0;
       clear_waiters(-file_id);
       EndExclusive(REC_LOCK_SEM);
+      wake_waiters();
       process.status = 0;
     } else if (lock_owner != 0) {
       process.status = ER_LCK;
@@ -535,7 +578,7 @@ void op_lockrec() {
           process_events();
         pc--;
         lock_beep();
-        Sleep(250);
+        lock_wait();
         return;
       }
       process.status = status;
@@ -877,6 +920,7 @@ void op_unlk() {
   }
 
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
 }
 
 /* ======================================================================
@@ -938,6 +982,7 @@ void op_unlkfl() {
   }
 
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
 }
 
 /* ======================================================================
@@ -1095,7 +1140,6 @@ int16_t lock_record(
   int16_t lwi;
   FILE_ENTRY* d_fptr;
   RLOCK_ENTRY* d_lptr;
-  LLT_ENTRY* llt;
 
   if (fvar->type == NET_FILE) {
     /* All locking for network files is handled at the remote end.
@@ -1114,7 +1158,10 @@ int16_t lock_record(
     id = raw_id;
   }
 
+  hash_value = hash(id, id_len);
+
   StartExclusive(REC_LOCK_SEM, 32);
+  my_uptr->lockwait_wake = 0;
 
   /* Check file lock */
 
@@ -1127,7 +1174,6 @@ int16_t lock_record(
 
   /* Check record lock */
 
-  hash_value = hash(id, id_len);
   idx = (int16_t)RLockHash(file_id, hash_value);
 
   scan_idx = idx;
@@ -1148,8 +1194,11 @@ int16_t lock_record(
         if (lptr->owner == process.user_no) /* Already own this lock */
         {
           if (lptr->lock_type == L_UPDATE) {
-            if (!update)
+            if (!update) {
               lptr->lock_type = L_SHARED;
+              if (lptr->waiters) /* Others may now share it */
+                clear_waiters(scan_idx);
+            }
             lptr->fvar_index = fvar->index; /* Now for this fvar */
             lptr->txn_id = txn_id;
             goto exit_lock_record;
@@ -1230,6 +1279,18 @@ int16_t lock_record(
     lptr = RLPtr(scan_idx);
   }
 
+  /* The lock is available. If it has just been released, processes that
+    were waiting for it will have been woken to retry. Give way to any of
+    these that joined the queue before us unless the caller is not going
+    to wait, in which case it takes the free lock at once.               */
+
+  if (!no_wait && sysseg->rl_queued &&
+      ((u = lock_queue_check(file_id, hash_value)) != 0)) {
+    status = u;
+    blocking_idx = 0;
+    goto exit_lock_record;
+  }
+
   /* We have now scanned all locks for this hash position.  If we are upgrading
     an existing shared lock, we did not find a conflict so do the upgrade. */
 
@@ -1281,24 +1342,20 @@ int16_t lock_record(
 
   /* Create local lock table entry */
 
-  llt = (LLT_ENTRY*)k_alloc(122, sizeof(LLT_ENTRY) + id_len - 1);
-  if (llt != NULL) {
-    llt->fno = file_id;
-    llt->fvar_index = fvar->index;
-    llt->id_len = id_len;
-    memcpy(llt->id, id, id_len);
-    llt->next = llt_head;
-    llt_head = llt;
-  }
+  llt_add(file_id, fvar->index, id, id_len, hash_value);
 
 exit_lock_record:
   switch (status) {
     case 0: /* Got the lock */
       my_uptr->lockwait_index = 0;
+      if (my_uptr->lockwait_ticket)
+        lock_queue_leave(TRUE);
       break;
 
     case -1: /* Lock table full */
       my_uptr->lockwait_index = 0;
+      if (my_uptr->lockwait_ticket)
+        lock_queue_leave(FALSE);
       break;
 
     case -2: /* Deadlock detected */
@@ -1312,15 +1369,40 @@ exit_lock_record:
            already non-zero, it must be for a subsequent attempt to get
            this lock so we must not increment the waiters counter.      */
         if (my_uptr->lockwait_index == 0) {
-          if (blocking_idx >= 0)
+          if (blocking_idx > 0)
             lptr->waiters++; /* 0193 */
           my_uptr->lockwait_index = blocking_idx;
         }
+
+        /* Join the queue for this record on the first attempt. On later
+          attempts, let any process that gave way to us retry now that we
+          are waiting again.                                              */
+
+        if (my_uptr->lockwait_ticket == 0) {
+          if (++(sysseg->rl_ticket) == 0)
+            sysseg->rl_ticket = 1;
+          my_uptr->lockwait_ticket = sysseg->rl_ticket;
+          my_uptr->lockwait_fno = file_id;
+          my_uptr->lockwait_hash = hash_value;
+          (sysseg->rl_queued)++;
+          (sysseg->rl_wait)++;
+          lockwait_started = lock_clock();
+          if (sysseg->flags & SSF_CONTENTION) {
+            contention_record_wait(file_id, hash_value, id, id_len);
+            contention_started = contention_clock();
+          }
+        } else if (blocking_idx != 0) {
+          lock_queue_wake(file_id, hash_value);
+        }
+
+        if (blocking_idx == 0) /* Gave way to an earlier waiter */
+          my_uptr->lockwait_time = (int32_t)lock_clock();
       }
       break;
   }
 
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
 
   /* Now that we have released the semaphore, log a message if the lock
     action failed because the lock table is full.                      */
@@ -1341,8 +1423,6 @@ bool unlock_record(FILE_VAR* fvar, /* NULL if for all files */
   bool status = 0;
   int16_t file_id;
   int16_t i;
-  LLT_ENTRY* llt;
-  LLT_ENTRY* next_llt;
 
   if (fvar != NULL) {
     if (fvar->type == NET_FILE) {
@@ -1356,13 +1436,12 @@ bool unlock_record(FILE_VAR* fvar, /* NULL if for all files */
 
   if (id_len == 0) /* Unlock all records */
   {
-    for (llt = llt_head; llt != NULL; llt = next_llt) {
-      next_llt = llt->next;
-      if ((fvar == NULL)            /* All files or... */
-          || ((llt->fno == file_id) /* ...correct file */
-              && (llt->fvar_index == fvar->index))) {
-        unlock_id(llt->fno, llt->id, llt->id_len);
-        /* Note: on return, the original LLT entry will have been removed */
+    if (llt_files != NULL) {
+      if (fvar == NULL) { /* All files */
+        for (i = 1; i <= sysseg->numfiles; i++)
+          llt_unlock_file(i, NULL);
+      } else {
+        llt_unlock_file(file_id, fvar);
       }
     }
 
@@ -1394,10 +1473,29 @@ bool unlock_record(FILE_VAR* fvar, /* NULL if for all files */
 
 exit_unlock_record:
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
 
   return status;
 }
 
+/* ======================================================================
+   llt_unlock_file()  -  Unlock all records in local lock table for file
+   If fvar is not NULL, only locks taken via that file variable are
+   released. Must be called with REC_LOCK_SEM held.                       */
+
+Private void llt_unlock_file(int16_t file_id, FILE_VAR* fvar) {
+  LLT_ENTRY* llt;
+  LLT_ENTRY* next_llt;
+
+  for (llt = llt_files[file_id]; llt != NULL; llt = next_llt) {
+    next_llt = llt->file_next;
+    if ((fvar == NULL) || (llt->fvar_index == fvar->index)) {
+      unlock_id(llt->fno, llt->id, llt->id_len);
+      /* Note: on return, the original LLT entry will have been removed */
+    }
+  }
+}
+
 /* ======================================================================
    Unlock specific file number / id pair                                  */
 
@@ -1411,8 +1509,6 @@ Private bool unlock_id(int16_t file_id, char* raw_id, int16_t id_len) {
   int16_t idx;
   RLOCK_ENTRY* lptr;
   int16_t active_locks;
-  LLT_ENTRY* llt;
-  LLT_ENTRY* prev_llt;
 
   fptr = FPtr(file_id);
   if (fptr->lock_count != 0) {
@@ -1449,18 +1545,7 @@ Private bool unlock_id(int16_t file_id, char* raw_id, int16_t id_len) {
 
           /* Remove from the local lock table too */
 
-          for (llt = llt_head, prev_llt = NULL; llt != NULL; llt = llt->next) {
-            if ((llt->fno == file_id) && (llt->id_len == id_len) &&
-                (!memcmp(llt->id, id, id_len))) {
-              if (prev_llt == NULL)
-                llt_head = llt->next;
-              else
-                prev_llt->next = llt->next;
-              k_free(llt);
-              break;
-            }
-            prev_llt = llt;
-          }
+          llt_remove(file_id, id, id_len, hash_value);
 
           status = TRUE;
           goto exit_unlock_id;
@@ -1503,6 +1588,7 @@ void unlock_txn(u_int32_t txn) {
       if (lptr->waiters)
         clear_waiters(idx);
       lptr->hash = 0; /* Free this cell */
+      llt_remove(lptr->file_id, lptr->id, lptr->id_len, lptr->id_hash);
     }
   }
 
@@ -1517,6 +1603,7 @@ void unlock_txn(u_int32_t txn) {
   }
 
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
 }
 
 /* ======================================================================
@@ -1553,7 +1640,11 @@ void clear_waiters(int16_t idx) /* Lock cell index */
     3. Some of the waiters are recorded against this lock cell.
        We will clear some of the waiters.  All of them will subsequently
        retry the lock.  Those that we clear will move their waiter count
-       to another lock entry.                                            */
+       to another lock entry.
+
+    Each user that we clear is woken from lock_wait() to retry at once.
+    The signal is sent by wake_waiters() once the caller has released
+    REC_LOCK_SEM so that the woken process does not block on it.         */
 
   if (idx > 0)
     lptr = RLPtr(idx);
@@ -1564,6 +1655,9 @@ void clear_waiters(int16_t idx) /* Lock cell index */
         && (uptr->lockwait_index == idx)) /* This lock */
     {
       uptr->lockwait_index = 0;
+      uptr->lockwait_wake = 1;
+      uptr->lockwait_time = (int32_t)lock_clock();
+      wake_later(uptr->pid);
       if (idx > 0) /* Clearing wait on record lock */
       {
         if (--(lptr->waiters) == 0)
@@ -1588,7 +1682,164 @@ void clear_lockwait() {
 
   my_uptr->lockwait_index = 0;
 
+  if (my_uptr->lockwait_ticket)
+    lock_queue_leave(FALSE);
+
   EndExclusive(REC_LOCK_SEM);
+  wake_waiters();
+}
+
+/* ======================================================================
+   lock_wait()  -  Wait before retrying a lock
+   Sleeps until a process releasing the lock clears our lock wait entry
+   (see clear_waiters()) or for LOCK_WAIT_INTERVAL if this does not
+   happen. SIGUSR1 is blocked while lockwait_wake is tested and only
+   unblocked within pselect() so that a wake cannot be missed. The flag
+   is cleared on return so that every wait, including those for network
+   files where nothing else clears it, starts afresh.                   */
+
+void lock_wait() {
+  sigset_t mask;
+  sigset_t old_mask;
+  struct timespec timeout;
+
+  timeout.tv_sec = 0;
+  timeout.tv_nsec = LOCK_WAIT_INTERVAL * 1000000L;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+  if (!my_uptr->lockwait_wake)
+    (void)pselect(0, NULL, NULL, NULL, &timeout, &old_mask);
+
+  my_uptr->lockwait_wake = 0;
+
+  sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+/* ======================================================================
+   wake_waiters()  -  Signal processes woken while holding REC_LOCK_SEM
+   Must be called after releasing REC_LOCK_SEM by anything that may have
+   called clear_waiters() or woken the record lock wait queue.           */
+
+void wake_waiters() {
+  while (wake_count)
+    kill(wake_pids[--wake_count], SIGUSR1);
+}
+
+/* ======================================================================
+   wake_later()  -  Note process to be signalled by wake_waiters()
+   Must be called with REC_LOCK_SEM held.                                 */
+
+Private void wake_later(int pid) {
+  if (wake_pids == NULL)
+    wake_pids = (int*)k_alloc(163, sysseg->max_users * sizeof(int));
+
+  if ((wake_pids == NULL) || (wake_count >= sysseg->max_users))
+    kill(pid, SIGUSR1); /* Cannot defer */
+  else
+    wake_pids[wake_count++] = pid;
+}
+
+/* ======================================================================
+   lock_queue_check()  -  Find earlier waiter woken to retry a lock
+   Returns the user number of a process that joined the queue for this
+   record before us and was recently woken, else zero. A process that
+   does not retry within LOCK_WAIT_INTERVAL loses its place.
+   Must be called with REC_LOCK_SEM held.                                 */
+
+Private int16_t lock_queue_check(int16_t file_id, int32_t hash_value) {
+  int16_t i;
+  USER_ENTRY* uptr;
+  u_int32_t ticket;
+  u_int32_t queued;
+  int32_t now;
+
+  ticket = my_uptr->lockwait_ticket;
+  now = (int32_t)lock_clock();
+
+  /* Stop once every ticket holder has been seen */
+
+  queued = sysseg->rl_queued;
+  for (i = 1; (i <= sysseg->max_users) && queued; i++) {
+    uptr = UPtr(i);
+    if (uptr->lockwait_ticket == 0)
+      continue;
+    queued--;
+
+    if ((uptr->uid > 0) && (uptr != my_uptr) && (uptr->lockwait_index == 0) &&
+        (uptr->lockwait_fno == file_id) &&
+        (uptr->lockwait_hash == hash_value) &&
+        ((ticket == 0) || ((int32_t)(uptr->lockwait_ticket - ticket) < 0)) &&
+        ((now - uptr->lockwait_time) < LOCK_WAIT_INTERVAL)) {
+      return uptr->uid;
+    }
+  }
+
+  return 0;
+}
+
+/* ======================================================================
+   lock_queue_wake()  -  Wake processes that gave way to us
+   Must be called with REC_LOCK_SEM held.                                 */
+
+Private void lock_queue_wake(int16_t file_id, int32_t hash_value) {
+  int16_t i;
+  USER_ENTRY* uptr;
+  u_int32_t queued;
+
+  queued = sysseg->rl_queued;
+  for (i = 1; (i <= sysseg->max_users) && queued; i++) {
+    uptr = UPtr(i);
+    if (uptr->lockwait_ticket == 0)
+      continue;
+    queued--;
+
+    if ((uptr->uid > 0) && (uptr != my_uptr) && (uptr->lockwait_index == 0) &&
+        (uptr->lockwait_fno == file_id) &&
+        (uptr->lockwait_hash == hash_value)) {
+      uptr->lockwait_wake = 1;
+      uptr->lockwait_time = (int32_t)lock_clock();
+      wake_later(uptr->pid);
+    }
+  }
+}
+
+/* ======================================================================
+   lock_queue_leave()  -  Leave record lock wait queue
+   Must be called with REC_LOCK_SEM held.                                 */
+
+Private void lock_queue_leave(bool got_lock) {
+  int64 wait_time;
+
+  if (got_lock) {
+    wait_time = lock_clock() - lockwait_started;
+    sysseg->rl_wait_time += wait_time;
+    if (wait_time > sysseg->rl_wait_max)
+      sysseg->rl_wait_max = (u_int32_t)wait_time;
+  }
+
+  if (contention_started) {
+    contention_record_time(my_uptr->lockwait_fno, contention_started);
+    contention_started = 0;
+  }
+
+  my_uptr->lockwait_ticket = 0;
+  (sysseg->rl_queued)--;
+
+  if (sysseg->rl_queued)
+    lock_queue_wake(my_uptr->lockwait_fno, my_uptr->lockwait_hash);
+}
+
+/* ======================================================================
+   lock_clock()  -  Monotonic time in milliseconds                        */
+
+Private int64 lock_clock() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((int64)ts.tv_sec) * 1000) + (ts.tv_nsec / 1000000);
 }
 
 /* ======================================================================
@@ -1601,20 +1852,14 @@ void rebuild_llt() {
     lock being released. This event then calls this routine to rebuild
     the local lock table completely.                                    */
 
-  LLT_ENTRY* llt;
-  LLT_ENTRY* next_llt;
   int16_t idx;
   RLOCK_ENTRY* lptr;
 
   /* Give away all existing LLT entries */
 
-  for (llt = llt_head; llt != NULL; llt = next_llt) {
-    next_llt = llt->next;
-    k_free(llt);
-  }
-  llt_head = NULL;
+  llt_release();
 
-  /* Create new LLT chain */
+  /* Create new local lock table */
 
   for (idx = 1; idx <= sysseg->numlocks; idx++) {
     lptr = RLPtr(idx);
@@ -1623,17 +1868,135 @@ void rebuild_llt() {
     {
       /* Create new local lock table entry */
 
-      llt = (LLT_ENTRY*)k_alloc(123, sizeof(LLT_ENTRY) + lptr->id_len - 1);
-      if (llt != NULL) {
-        llt->fno = lptr->file_id;
-        llt->fvar_index = lptr->fvar_index;
-        llt->id_len = lptr->id_len;
-        memcpy(llt->id, lptr->id, lptr->id_len);
-        llt->next = llt_head;
-        llt_head = llt;
+      llt_add(lptr->file_id, lptr->fvar_index, lptr->id, lptr->id_len,
+              lptr->id_hash);
+    }
+  }
+}
+
+/* ======================================================================
+   llt_add()  -  Add local lock table entry                               */
+
+Private void llt_add(int16_t file_id,
+                     int32_t fvar_index,
+                     char* id,
+                     int16_t id_len,
+                     int32_t hash_value) {
+  LLT_ENTRY* llt;
+  LLT_ENTRY* next_llt;
+  LLT_ENTRY** old_hash;
+  int32_t old_size;
+  int32_t i;
+  u_int32_t h;
+
+  if (llt_files == NULL) {
+    llt_files = (LLT_ENTRY**)k_alloc(159, (sysseg->numfiles + 1) * sizeof(LLT_ENTRY*));
+    if (llt_files == NULL)
+      return;
+    memset(llt_files, 0, (sysseg->numfiles + 1) * sizeof(LLT_ENTRY*));
+  }
+
+  /* Create or double the hash table when it becomes fully loaded */
+
+  if (llt_count >= llt_hash_size) {
+    old_hash = llt_hash;
+    old_size = llt_hash_size;
+    i = (old_size) ? (old_size * 2) : 64;
+    llt_hash = (LLT_ENTRY**)k_alloc(158, i * sizeof(LLT_ENTRY*));
+    if (llt_hash == NULL) { /* Carry on with the existing table */
+      llt_hash = old_hash;
+      if (llt_hash == NULL)
+        return;
+    } else {
+      llt_hash_size = i;
+      memset(llt_hash, 0, i * sizeof(LLT_ENTRY*));
+      for (i = 0; i < old_size; i++) {
+        for (llt = old_hash[i]; llt != NULL; llt = next_llt) {
+          next_llt = llt->next;
+          h = LLTHash(llt->fno, llt->id_hash);
+          llt->next = llt_hash[h];
+          llt_hash[h] = llt;
+        }
       }
+      k_free_ptr(old_hash);
+    }
+  }
+
+  llt = (LLT_ENTRY*)k_alloc(122, sizeof(LLT_ENTRY) + id_len - 1);
+  if (llt != NULL) {
+    llt->fno = file_id;
+    llt->fvar_index = fvar_index;
+    llt->id_hash = hash_value;
+    llt->id_len = id_len;
+    memcpy(llt->id, id, id_len);
+
+    h = LLTHash(file_id, hash_value);
+    llt->next = llt_hash[h];
+    llt_hash[h] = llt;
+
+    llt->file_prev = NULL;
+    llt->file_next = llt_files[file_id];
+    if (llt->file_next != NULL)
+      llt->file_next->file_prev = llt;
+    llt_files[file_id] = llt;
+
+    llt_count++;
+  }
+}
+
+/* ======================================================================
+   llt_remove()  -  Remove local lock table entry                         */
+
+Private void llt_remove(int16_t file_id,
+                        char* id,
+                        int16_t id_len,
+                        int32_t hash_value) {
+  LLT_ENTRY* llt;
+  LLT_ENTRY** prev;
+
+  if (llt_hash == NULL)
+    return;
+
+  for (prev = &(llt_hash[LLTHash(file_id, hash_value)]); (llt = *prev) != NULL;
+       prev = &(llt->next)) {
+    if ((llt->fno == file_id) && (llt->id_hash == hash_value) &&
+        (llt->id_len == id_len) && (!memcmp(llt->id, id, id_len))) {
+      *prev = llt->next;
+
+      if (llt->file_prev == NULL)
+        llt_files[file_id] = llt->file_next;
+      else
+        llt->file_prev->file_next = llt->file_next;
+      if (llt->file_next != NULL)
+        llt->file_next->file_prev = llt->file_prev;
+
+      k_free(llt);
+      llt_count--;
+      break;
     }
   }
 }
 
+/* ======================================================================
+   llt_release()  -  Give away all local lock table entries               */
+
+Private void llt_release() {
+  LLT_ENTRY* llt;
+  LLT_ENTRY* next_llt;
+  int32_t i;
+
+  for (i = 0; i < llt_hash_size; i++) {
+    for (llt = llt_hash[i]; llt != NULL; llt = next_llt) {
+      next_llt = llt->next;
+      k_free(llt);
+    }
+    llt_hash[i] = NULL;
+  }
+
+  if (llt_files != NULL)
+    memset(llt_files, 0, (sysseg->numfiles + 1) * sizeof(LLT_ENTRY*));
+
+  llt_count = 0;
+}
+
 /* END-CODE */
@@ -21,6 +21,14 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Numeric strings compare as floats using FLTDIFF, as before
+ *             DECIMAL was added. Only DECIMAL values compare exactly.
+ *
+ * 18Oct26 gwb compare_values() handles DECIMAL values.
+ *
+ * 18Oct26 gwb String equality tests reject strings of different lengths
+ *             without comparing data.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -67,6 +75,7 @@
 #include <math.h>
 
 Private bool compare_values(int16_t mode, bool dismiss);
+Private bool compare_str_to_num(DESCRIPTOR* p);
 #define TEST_EQ 0
 #define TEST_GT 1
 #define TEST_GE 2
@@ -410,7 +419,9 @@ void op_shift() {
 }
 
 /* ======================================================================
-   compare_values()  -  Common comparison function for EQ, NE, LT and GT  */
+   compare_values()  -  Common comparison function for EQ, NE, LT and GT
+   Only values that are already DECIMAL compare exactly. Numeric strings
+   compare as floats using FLTDIFF (see compare_str_to_num()).            */
 
 Private bool compare_values(int16_t mode, bool dismiss) {
   /* Stack:
@@ -468,6 +479,12 @@ recompare:
           }
           break;
 
+        case DECIMAL:
+          diff = dec_compare(arg1, arg2);
+          eq = (diff == 0);
+          gt = (diff > 0);
+          break;
+
         case SUBR:
           k_get_string(arg2);
           /* **** FALL THROUGH **** */
@@ -479,7 +496,7 @@ recompare:
             goto exit_compare_values;
           }
 
-          if (k_str_to_num(arg2))
+          if (compare_str_to_num(arg2))
             goto recompare;
 
           /* Convert arg1 e-stack item to a string and compare as strings */
@@ -508,6 +525,12 @@ recompare:
           }
           break;
 
+        case DECIMAL:
+          diff = dec_compare(arg1, arg2);
+          eq = (diff == 0);
+          gt = (diff > 0);
+          break;
+
         case SUBR:
           k_get_string(arg2);
           /* **** FALL THROUGH **** */
@@ -519,7 +542,41 @@ recompare:
             goto exit_compare_values;
           }
 
-          if (k_str_to_num(arg2))
+          if (compare_str_to_num(arg2))
+            goto recompare;
+
+          /* Convert arg1 to a string and compare as strings */
+
+          k_num_to_str(arg1);
+          goto string_comparison;
+
+        default:
+          k_value_error(arg2);
+      }
+      break;
+
+    case DECIMAL:
+      switch (arg2->type) {
+        case INTEGER:
+        case FLOATNUM:
+        case DECIMAL:
+          diff = dec_compare(arg1, arg2);
+          eq = (diff == 0);
+          gt = (diff > 0);
+          break;
+
+        case SUBR:
+          k_get_string(arg2);
+          /* **** FALL THROUGH **** */
+
+        case STRING:
+          if (arg2->data.str.saddr == NULL) /* Special case, decimal vs null */
+          {
+            gt = TRUE;
+            goto exit_compare_values;
+          }
+
+          if (compare_str_to_num(arg2))
             goto recompare;
 
           /* Convert arg1 to a string and compare as strings */
@@ -540,12 +597,13 @@ recompare:
       switch (arg2->type) {
         case INTEGER:
         case FLOATNUM:
+        case DECIMAL:
           if (arg1->data.str.saddr == NULL) /* Special case, null vs num */
           {
             goto exit_compare_values;
           }
 
-          if (k_str_to_num(arg1))
+          if (compare_str_to_num(arg1))
             goto recompare;
           /* Convert arg2 to a string and compare as strings */
 
@@ -574,8 +632,8 @@ recompare:
               numeric before we do anything else                          */
 
           if (k_is_num(arg1) && k_is_num(arg2)) {
-            k_str_to_num(arg1);
-            k_str_to_num(arg2);
+            compare_str_to_num(arg1);
+            compare_str_to_num(arg2);
             goto recompare;
           }
 
@@ -594,6 +652,10 @@ recompare:
             /* arg2 is a null string. arg1 is not */
             eq = FALSE;
             gt = TRUE;
+          } else if ((mode == TEST_EQ) &&
+                     (str1->string_len != str2->string_len)) {
+            /* Strings of different lengths cannot be equal */
+            eq = FALSE;
           } else /* Neither string is null */
           {
             len1 = str1->string_len;
@@ -686,4 +748,20 @@ exit_compare_values:
   return gt || eq; /* TEST_GE */
 }
 
+/* ======================================================================
+   compare_str_to_num()  -  Convert string for numeric comparison
+   A string that converts to a DECIMAL is compared as a float so that
+   "1.00000000001" = "1" remains true within FLTDIFF as it was before the
+   DECIMAL type was added.                                                */
+
+Private bool compare_str_to_num(DESCRIPTOR* p) {
+  if (!k_str_to_num(p))
+    return FALSE;
+
+  if (p->type == DECIMAL)
+    dec_to_float(p);
+
+  return TRUE;
+}
+
 /* END-CODE */
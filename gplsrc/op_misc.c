@@ -21,6 +21,13 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Moved op_trans() and op_rtrans() to op_trans.c.
+ *
+ * 18Oct26 gwb FOR loops convert DECIMAL values to float. VARTYPE() reports
+ *             decimals as FLOATNUM.
+ *
+ * 18Oct26 gwb In-place string updates clear the cached numeric value.
+ *
  * 03Sep25 gwb Fix potential overflow (github issue #79)
  * 13Oct24 mab Correct format code for op_dtx (BASIC DTX()) 
  *
@@ -91,7 +98,6 @@
  *    op_oserror        OS.ERROR()
  *    op_precision      PRECISION
  *    op_procread       PROCREAD
- *    op_rtrans()       RTRANS()
  *    op_saveaddr                       Save address descriptor
  *    op_sendmail       SENDMAIL()
  *    op_setmode        SETMODE
@@ -101,7 +107,6 @@
  *    op_time()         TIME
  *    op_timedate()     TIMEDATE
  *    op_total()        TOTAL
- *    op_trans()        TRANS()
  *    op_vartype()      VARTYPE         VARTYPE() function
  *
  * Other externally callable functions:
@@ -220,7 +225,7 @@ void op_ascii() {
 
     /* Clear any hint */
 
-    str->field = 0;
+    ClearHints(str);
 
     descr->flags &= ~DF_CHANGE;
 
@@ -363,7 +368,7 @@ void op_ebcdic() {
 
     /* Clear any hint */
 
-    str->field = 0;
+    ClearHints(str);
 
     descr->flags &= ~DF_CHANGE;
 
@@ -502,6 +507,7 @@ Private void forloop(bool store_before_test) {
 
   descr = e_stack - 1;
   GetNum(descr);
+  DecToFloat(descr);
   if (descr->type == INTEGER) {
     step = descr->data.value;
   } else /* Must be FLOATNUM */
@@ -514,6 +520,7 @@ Private void forloop(bool store_before_test) {
 
   descr = e_stack - 2;
   GetNum(descr);
+  DecToFloat(descr);
   if (descr->type == INTEGER) {
     if (is_float)
       flimit = descr->data.value;
@@ -531,6 +538,7 @@ Private void forloop(bool store_before_test) {
   {
     descr = e_stack - 4;
     GetNum(descr);
+    DecToFloat(descr);
     /* Note that we do not release this descriptor until we have determined
       the type rules as a user could write "FOR X = X TO Y"                */
 
@@ -569,6 +577,7 @@ Private void forloop(bool store_before_test) {
   } else /* Not first iteration */
   {
     GetNum(control_descr);
+    DecToFloat(control_descr);
     if (control_descr->type == INTEGER) {
       if (is_float) {
         fcontrol_value = ((double)(control_descr->data.value)) + fstep;
@@ -670,6 +679,7 @@ Private void for1(bool store_before_test) {
 
   descr = e_stack - 1;
   GetNum(descr);
+  DecToFloat(descr);
   if (descr->type == INTEGER) {
     limit = descr->data.value;
   } else /* Must be FLOATNUM */
@@ -682,6 +692,7 @@ Private void for1(bool store_before_test) {
   {
     descr = e_stack - 3;
     GetNum(descr);
+    DecToFloat(descr);
 
     /* Note that we do not release this descriptor until we have determined
       the type rules as a user could write "FOR X = X TO Y"                */
@@ -719,6 +730,7 @@ Private void for1(bool store_before_test) {
   } else /* Not first iteration */
   {
     GetNum(control_descr);
+    DecToFloat(control_descr);
     if (control_descr->type == INTEGER) {
       if (is_float) {
         fcontrol_value = ((double)(control_descr->data.value)) + 1.0;
@@ -1293,34 +1305,6 @@ void op_procread() {
   (e_stack++)->data.value = !is_proc;
 }
 
-/* ======================================================================
-   op_rtrans()  -  RTRANS function (Revelation style, no mark lowering)   */
-
-void op_rtrans() {
-  /* Stack:
-
-     |=============================|=============================|
-     |            BEFORE           |           AFTER             |
-     |=============================|=============================|
- top |  Action code expression     |  Result                     |
-     |-----------------------------|-----------------------------|
-     |  Field number               |                             |
-     |-----------------------------|-----------------------------|
-     |  Record ID                  |                             |
-     |-----------------------------|-----------------------------|
-     |  VOC name of file (may have |                             |
-     |  DICT prefix                |                             |
-     |=============================|=============================|
- */
-
-  /* Push flag controlling lowering of marks */
-
-  InitDescr(e_stack, INTEGER);
-  (e_stack++)->data.value = FALSE;
-
-  k_recurse(pcode_trans, 5); /* Execute recursive code */
-}
-
 /* ======================================================================
    op_setmode()  -  SETMODE  -  Set program flag bits (restricted)        */
 
@@ -1501,34 +1485,6 @@ void op_total() {
   }
 }
 
-/* ======================================================================
-   op_trans()  -  TRANS function                                          */
-
-void op_trans() {
-  /* Stack:
-
-     |=============================|=============================|
-     |            BEFORE           |           AFTER             |
-     |=============================|=============================|
- top |  Action code expression     |  Result                     |
-     |-----------------------------|-----------------------------|
-     |  Field number               |                             |
-     |-----------------------------|-----------------------------|
-     |  Record ID                  |                             |
-     |-----------------------------|-----------------------------|
-     |  VOC name of file (may have |                             |
-     |  DICT prefix                |                             |
-     |=============================|=============================|
- */
-
-  /* Push flag controlling lowering of marks */
-
-  InitDescr(e_stack, INTEGER);
-  (e_stack++)->data.value = TRUE;
-
-  k_recurse(pcode_trans, 5); /* Execute recursive code */
-}
-
 /* ======================================================================
    op_umask()  -  Apply UMASK value                                       */
 
@@ -1581,6 +1537,8 @@ void op_vartype() {
   while (descr->type == ADDR)
     descr = descr->data.d_addr;
   type = descr->type;
+  if (type == DECIMAL)
+    type = FLOATNUM; /* Decimals are not visible to BASIC programs */
   k_dismiss();
 
   InitDescr(e_stack, INTEGER);
@@ -21,6 +21,9 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb MVDS compiles the conversion code once for OCONVS() and
+ *             appends to the result in place.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -53,7 +56,9 @@
 
 extern void (*dispatch[])(void);
 
+void op_append(void);
 void op_cat(void);
+void op_oconv(void);
 
 /* ======================================================================
    op_ifs()  -  IFS opcode                                                */
@@ -625,12 +630,14 @@ void op_mvds() {
 
   DESCRIPTOR op_arg1;
 
+  DESCRIPTOR result;
   STRING_CHUNK* result_str;
   char result_delimiter;
   bool first = TRUE;
 
   register char c;
   int16_t n;
+  CONV_CODE* conv = NULL;
 
   /* Get opcode to execute for each element */
 
@@ -645,14 +652,20 @@ void op_mvds() {
   k_get_string(arg1);
   src1_str = arg1->data.str.saddr;
 
+  /* OCONVS() compiles the conversion code once for all elements */
+
+  if (dispatch[opcode] == op_oconv)
+    conv = conv_compile(arg2);
+
   /* Make descriptors to store substring */
 
   InitDescr(&op_arg1, UNASSIGNED);
 
-  /* Place a null string on the stack to accumulate the result */
+  /* Accumulate the result in a null string. This is extended in place
+     rather than copied for each element.                              */
 
-  InitDescr(e_stack, STRING);
-  (e_stack++)->data.str.saddr = NULL;
+  InitDescr(&result, STRING);
+  result.data.str.saddr = NULL;
 
   do {
     k_release(&op_arg1);
@@ -681,6 +694,9 @@ void op_mvds() {
     /* Insert delimiter */
 
     if (!first) {
+      InitDescr(e_stack, ADDR);
+      (e_stack++)->data.d_addr = &result;
+
       InitDescr(e_stack, STRING);
       result_str = e_stack->data.str.saddr = s_alloc(1, &n);
       result_str->ref_ct = 1;
@@ -689,40 +705,46 @@ void op_mvds() {
       result_str->data[0] = result_delimiter;
       e_stack++;
 
-      op_cat();
+      op_append();
     }
 
     result_delimiter = (char)delimiter;
 
     /* Perform operation */
 
+    InitDescr(e_stack, ADDR); /* Result */
+    (e_stack++)->data.d_addr = &result;
+
     InitDescr(e_stack, ADDR); /* Substring */
     (e_stack++)->data.d_addr = &op_arg1;
 
-    InitDescr(e_stack, ADDR); /* Copy of second argument */
-    (e_stack++)->data.d_addr = arg2;
+    if (conv != NULL) {
+      k_get_value(e_stack - 1);
+      oconv_apply(conv);
+    } else {
+      InitDescr(e_stack, ADDR); /* Copy of second argument */
+      (e_stack++)->data.d_addr = arg2;
 
-    dispatch[opcode]();
+      dispatch[opcode]();
+    }
 
     /* Save result */
 
-    op_cat();
+    op_append();
 
     first = FALSE;
   } while (src1_str != NULL);
 
   k_release(&op_arg1);
+  if (conv != NULL)
+    conv_release(conv);
 
-  /* The stack currently has:
-     Result
-     String 2
-     String 1
-   We need to remove the two source strings */
+  /* Replace the two source strings with the result */
 
   k_release(arg1);
   k_release(arg2);
-  *(e_stack - 3) = *(e_stack - 1);
-  e_stack -= 2;
+  *(e_stack - 2) = result;
+  e_stack--;
 }
 
 /* ======================================================================
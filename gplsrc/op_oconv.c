@@ -21,6 +21,14 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb FMT() with a D code parses the code before calling
+ *             date_conversion().
+ *
+ * 18Oct26 gwb OCONV() caches compiled conversion codes. MD, D and MT codes
+ *             are parsed once rather than on every call.
+ *
+ * 18Oct26 gwb Conversions treat DECIMAL values as floats.
+ *
  * 09Jan22 gwb Fixed some format specifier warnings.
  *
  * 28Feb20 gwb Changed integer declarations to be portable across address
@@ -159,6 +167,94 @@
 #define MAX_CONV_STRING_LEN 256  /* Max length of OCONV() control string */
 #define MAX_DATA_STRING_LEN 4096 /* Max length of data in FMT() */
 
+/* Parsed MD, ML and MR conversion code */
+
+typedef struct {
+  char mode;            /* Conversion mode (D, L or R) */
+  int16_t status;       /* Non-zero if code is invalid */
+  int16_t dp;           /* Decimal places */
+  int16_t scale_factor; /* Scale factor */
+  bool commas;          /* Insert comma thousands separator? */
+  char prefix[32 + 1];
+  char thousands;
+  char decimal;
+  char suffix[32 + 1];
+  int16_t neg; /* Action for negative values */
+#define LEADING_MINUS 0
+#define TRAILING_SIGN 1
+#define TRAILING_MINUS 2
+#define ANGLE_BRACKETS 3
+#define ROUND_BRACKETS 4
+#define TRAILING_CR 5
+#define TRAILING_DB 6
+  bool suppress_decimal_scale;
+  bool null_zero;
+  bool truncate;
+  int16_t width; /* Field width (0 implies not set) */
+  char pad_char; /* Padding character */
+  char* mask;    /* Format mask, points into conversion code */
+} MD_SPEC;
+
+/* Parsed D conversion code */
+
+typedef struct {
+  int16_t status; /* Non-zero if code is invalid */
+  struct {
+    char code; /* D, M, Y, J, A (alpha month), W (Alpha day)
+                  N (Day of week as number), Q, O (ordinal day),
+                  I (ISO week number), y (ISO year number) */
+    int16_t width;
+    bool zero_suppress;
+    char text[20 + 1];
+  } format[5];
+  char separator[2]; /* Double null to allow simple overwrite */
+  bool leading_upper;
+  bool iso;
+} DATE_SPEC;
+
+/* Parsed MT conversion code */
+
+typedef struct {
+  bool am_pm;
+  bool include_seconds;
+  char separator;
+} TIME_SPEC;
+
+/* Compiled conversion code. OCONV() keeps recently used conversion codes
+   in a small cache, split at value marks and with MD, D and MT codes
+   already parsed. The parsed forms depend on the NLS and date format
+   settings so changing these discards the cache.                         */
+
+typedef struct {
+  char type;
+#define CONV_OTHER 0 /* Parsed on each use */
+#define CONV_NULL 1
+#define CONV_MD 2
+#define CONV_DATE 3
+#define CONV_TIME 4
+  char* code; /* Code text with leading spaces removed */
+  union {
+    MD_SPEC md;
+    DATE_SPEC date;
+    TIME_SPEC time;
+  } spec;
+} CONV_STEP;
+
+struct CONV_CODE {
+  u_int32_t hash;
+  int32_t generation; /* Matches conv_generation if still valid */
+  int16_t in_use;     /* Count of active users (U codes may recurse) */
+  bool cached;        /* In conv_cache[]? Others are freed after use */
+  int16_t len;        /* Length of code text */
+  char* text;         /* Code text, each step null terminated */
+  int16_t num_steps;
+  CONV_STEP step[1];
+};
+
+#define CONV_CACHE_SIZE 64 /* Must be a power of two */
+Private CONV_CODE* conv_cache[CONV_CACHE_SIZE] = {NULL};
+Private int32_t conv_generation = 1;
+
 extern char* month_names[];
 extern char* day_names[];
 
@@ -188,13 +284,19 @@ int32_t substring_conversion(char* src_ptr);
 
 Private int32_t base64_conversion(void);
 Private int32_t boolean_conversion(void);
-Private int32_t date_conversion(char* src_ptr);
+Private int32_t date_conversion(DATE_SPEC* ds);
 Private int32_t field_extraction(char* src_ptr);
 Private int32_t float_conversion(char* p);
 Private int32_t radix_conversion(char* src_ptr, int16_t radix);
 Private int32_t integer_conversion(char* src_ptr, int16_t bytes);
-Private int32_t masked_decimal_conversion(char* src_ptr);
-Private int32_t time_conversion(char* src_ptr);
+Private int32_t masked_decimal_conversion(MD_SPEC* md);
+Private int32_t time_conversion(TIME_SPEC* ts);
+Private bool oconv_step(char* p);
+Private CONV_CODE* conv_build(char* code, int16_t len, u_int32_t hash);
+Private void parse_md(char* p, MD_SPEC* md);
+Private int32_t parse_date(char* code, DATE_SPEC* ds);
+Private int32_t format_date(int dt, DATE_SPEC* ds, char* tgt);
+Private void parse_time(char* p, TIME_SPEC* ts);
 Private void insert_commas(char* s, char thousands, char decimal);
 Private void insert_text_breaks(char* s,
                                 int16_t* s_len,
@@ -254,6 +356,7 @@ void op_fmt() {
   char* p;
   char* q;
   int16_t n;
+  DATE_SPEC date_spec;
 
   process.status = 2;
 
@@ -273,7 +376,8 @@ void op_fmt() {
   if (*p == 'D') /* Not really a format at all - It's a date conversion */
   {
     k_get_value(e_stack - 1); /* 0140 */
-    process.status = date_conversion(p + 1);
+    date_spec.status = parse_date(p + 1, &date_spec);
+    process.status = date_conversion(&date_spec);
     goto exit_op_fmt;
   }
 
@@ -437,8 +541,10 @@ end_conversion:
 
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
       /* The source data is a number */
 
+      DecToFloat(src_descr);
       p = s;
 
       is_integer = (src_descr->type == INTEGER);
@@ -650,210 +756,348 @@ void op_oconv() {
      |=============================|=============================|
  */
 
-  DESCRIPTOR* conv_descr; /* Format string */
-  DESCRIPTOR* src_descr;  /* Source string */
-  char conv_string[MAX_CONV_STRING_LEN + 1];
-  bool ok;
-
-  char c;
-  char* p;
-  char* q;
-  bool done = FALSE;
+  CONV_CODE* conv;
 
   /* Get conversion code */
 
-  conv_descr = e_stack - 1;
-  ok = k_get_c_string(conv_descr, conv_string, MAX_CONV_STRING_LEN) >= 0;
+  conv = conv_compile(e_stack - 1);
   k_dismiss();
 
-  if (!ok)
-    goto bad_conv_string;
-
-  process.status = 0;
+  if (conv == NULL) {
+    process.status = 2;
+    return;
+  }
 
   /* Get the value of the item to be converted */
 
-  src_descr = e_stack - 1;
-  k_get_value(src_descr);
+  k_get_value(e_stack - 1);
 
   //0227 if ((src_descr->type == STRING) && (src_descr->data.str.saddr == NULL))
   //0227  {
   //0227   if (UpperCase(conv_string[0]) != 'U') goto exit_op_oconv;
   //0227  }
 
-  /* Process the conversion string */
+  oconv_apply(conv);
+  conv_release(conv);
+}
 
-  p = conv_string;
+/* ======================================================================
+   oconv_apply()  -  Apply compiled conversion to item at top of e-stack  */
 
-  do {
-    q = strchr(p, VALUE_MARK);
-    if (q == NULL)
-      done = TRUE;
-    else
-      *q = '\0';
+void oconv_apply(CONV_CODE* conv) {
+  CONV_STEP* step;
+  int16_t i;
+  char code[MAX_CONV_STRING_LEN + 1];
 
-    while (*p == ' ')
-      p++; /* Skip leading spaces */
+  process.status = 0;
 
-    c = *(p++);
-    switch (UpperCase(c)) {
-      case '\0': /* Null conversion */
+  for (i = 0, step = conv->step; i < conv->num_steps; i++, step++) {
+    switch (step->type) {
+      case CONV_NULL:
         break;
 
-      case 'B': /* Boolean conversion */
-        if (!strcmp(p, "64")) {
-          process.status = base64_conversion();
-        } else {
-          process.status = boolean_conversion();
-        }
+      case CONV_MD:
+        process.status = masked_decimal_conversion(&(step->spec.md));
         break;
 
-      case 'C': /* Concatenation conversion */
-        process.status = concatenation_conversion(p);
+      case CONV_DATE:
+        process.status = date_conversion(&(step->spec.date));
         break;
 
-      case 'D': /* Date conversion */
-        process.status = date_conversion(p);
+      case CONV_TIME:
+        process.status = time_conversion(&(step->spec.time));
         break;
 
-      case 'G': /* Group conversion */
-        process.status = group_conversion(p);
-        break;
+      default:
+        /* Some conversions modify the code text so work on a copy */
 
-      case 'L': /* Length constraints */
-        process.status = length_conversion(p);
+        strcpy(code, step->code);
+        if (!oconv_step(code))
+          process.status = 2;
         break;
+    }
 
-      case 'M':
-        switch (UpperCase(*p)) {
-          case 'D': /* Masked decimal conversion */
-          case 'L':
-          case 'R':
-            process.status = masked_decimal_conversion(p);
-            break;
+    if (process.status != 0)
+      break;
+  }
+}
 
-          case 'T': /* Time conversion */
-            process.status = time_conversion(p);
-            break;
+/* ======================================================================
+   oconv_step()  -  Perform conversions that are not compiled
+   Returns FALSE if the conversion code is not recognised.                */
 
-          case 'B': /* Binary conversion */
-            process.status = radix_conversion(++p, 2);
-            break;
+Private bool oconv_step(char* p) {
+  char c;
 
-          case 'C': /* Case conversion (plus oddments) */
-            c = *(++p);
-            switch (UpperCase(c)) {
-              case 'D': /* Decimal to hex */
-                c = UpperCase(*(++p));
-                if ((c != '\0') && (c != 'X'))
-                  goto bad_conv_string;
-                if (c == 'X')
-                  p++;
-                process.status = conv_dtx(p);
-                break;
-              case 'L':
-                set_case(FALSE);
-                break;
-              case 'U':
-                set_case(TRUE);
-                break;
-              case 'X': /* Hex to decimal */
-                c = UpperCase(*(++p));
-                if ((c != '\0') && (c != 'D'))
-                  goto bad_conv_string;
-                if (c == 'D')
-                  p++;
-                process.status = conv_xtd(p);
-                break;
-              default:
-                mc_conversion(p);
-                break;
-            }
-            break;
+  c = *(p++);
+  switch (UpperCase(c)) {
+    case 'B': /* Boolean conversion */
+      if (!strcmp(p, "64")) {
+        process.status = base64_conversion();
+      } else {
+        process.status = boolean_conversion();
+      }
+      break;
 
-          case 'O': /* Octal conversion */
-            process.status = radix_conversion(++p, 8);
-            break;
+    case 'C': /* Concatenation conversion */
+      process.status = concatenation_conversion(p);
+      break;
 
-          case 'X': /* Hexadecimal conversion */
-            process.status = radix_conversion(++p, 16);
-            break;
+    case 'G': /* Group conversion */
+      process.status = group_conversion(p);
+      break;
 
-          default:
-            goto bad_conv_string;
-        }
-        break;
+    case 'L': /* Length constraints */
+      process.status = length_conversion(p);
+      break;
 
-      case 'I':
-        switch (UpperCase(*(p++))) {
-          case 'F': /* Float conversion */
-            process.status = float_conversion(p);
-            break;
-          case 'L': /* Long integer conversion */
-            process.status = integer_conversion(p, 4);
-            break;
-          case 'S': /* Short integer conversion */
-            process.status = integer_conversion(p, 2);
-            break;
-          default:
-            goto bad_conv_string;
-        }
-        break;
+    case 'M':
+      switch (UpperCase(*p)) {
+        case 'B': /* Binary conversion */
+          process.status = radix_conversion(++p, 2);
+          break;
 
-      case 'P':
-        process.status = pattern_match_conversion(p);
-        break;
+        case 'C': /* Case conversion (plus oddments) */
+          c = *(++p);
+          switch (UpperCase(c)) {
+            case 'D': /* Decimal to hex */
+              c = UpperCase(*(++p));
+              if ((c != '\0') && (c != 'X'))
+                return FALSE;
+              if (c == 'X')
+                p++;
+              process.status = conv_dtx(p);
+              break;
+            case 'L':
+              set_case(FALSE);
+              break;
+            case 'U':
+              set_case(TRUE);
+              break;
+            case 'X': /* Hex to decimal */
+              c = UpperCase(*(++p));
+              if ((c != '\0') && (c != 'D'))
+                return FALSE;
+              if (c == 'D')
+                p++;
+              process.status = conv_xtd(p);
+              break;
+            default:
+              mc_conversion(p);
+              break;
+          }
+          break;
 
-      case 'R':
-        process.status = range_conversion(p);
-        break;
+        case 'O': /* Octal conversion */
+          process.status = radix_conversion(++p, 8);
+          break;
 
-      case 'S':
-        process.status = substitution_conversion(p);
-        break;
+        case 'X': /* Hexadecimal conversion */
+          process.status = radix_conversion(++p, 16);
+          break;
 
-      case 'T':
-        if (strchr(p, ';') != NULL) /* Looks like a Tfile conversion */
-        {
-          /* Push conversion specification onto e-stack */
-          k_put_c_string(p, e_stack++);
+        default:
+          return FALSE;
+      }
+      break;
+
+    case 'I':
+      switch (UpperCase(*(p++))) {
+        case 'F': /* Float conversion */
+          process.status = float_conversion(p);
+          break;
+        case 'L': /* Long integer conversion */
+          process.status = integer_conversion(p, 4);
+          break;
+        case 'S': /* Short integer conversion */
+          process.status = integer_conversion(p, 2);
+          break;
+        default:
+          return FALSE;
+      }
+      break;
 
-          /* Push oconv flag onto stack */
-          InitDescr(e_stack, INTEGER);
-          (e_stack++)->data.value = TRUE;
+    case 'P':
+      process.status = pattern_match_conversion(p);
+      break;
 
-          k_recurse(pcode_tconv, 3); /* Execute recursive code */
-        } else {
-          process.status = substring_conversion(p);
-        }
-        break;
+    case 'R':
+      process.status = range_conversion(p);
+      break;
+
+    case 'S':
+      process.status = substitution_conversion(p);
+      break;
 
-      case 'U': /* User defined */
+    case 'T':
+      if (strchr(p, ';') != NULL) /* Looks like a Tfile conversion */
+      {
         /* Push conversion specification onto e-stack */
         k_put_c_string(p, e_stack++);
-        k_recurse(pcode_oconv, 2); /* Execute recursive code */
+
+        /* Push oconv flag onto stack */
+        InitDescr(e_stack, INTEGER);
+        (e_stack++)->data.value = TRUE;
+
+        k_recurse(pcode_tconv, 3); /* Execute recursive code */
+      } else {
+        process.status = substring_conversion(p);
+      }
+      break;
+
+    case 'U': /* User defined */
+      /* Push conversion specification onto e-stack */
+      k_put_c_string(p, e_stack++);
+      k_recurse(pcode_oconv, 2); /* Execute recursive code */
+      break;
+
+    case '<':
+      process.status = field_extraction(p);
+      break;
+
+    default: /* Not recognised */
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* ======================================================================
+   conv_compile()  -  Find or build compiled form of conversion code
+   Returns NULL if the code is too long or there is no memory.            */
+
+CONV_CODE* conv_compile(DESCRIPTOR* descr) {
+  char code[MAX_CONV_STRING_LEN + 1];
+  int16_t len;
+  u_int32_t hash;
+  char* p;
+  CONV_CODE* conv;
+  CONV_CODE** slot;
+
+  if ((len = k_get_c_string(descr, code, MAX_CONV_STRING_LEN)) < 0)
+    return NULL;
+
+  hash = 2166136261u; /* FNV-1a */
+  for (p = code; *p != '\0'; p++)
+    hash = (hash ^ (u_char)*p) * 16777619u;
+
+  slot = conv_cache + (hash & (CONV_CACHE_SIZE - 1));
+  conv = *slot;
+  if (conv != NULL) {
+    if ((conv->hash == hash) && (conv->len == len) &&
+        (conv->generation == conv_generation) && !memcmp(conv->text, code, len)) {
+      conv->in_use++;
+      return conv;
+    }
+
+    if (conv->in_use) /* Replacing it would pull it from under its user */
+    {
+      if ((conv = conv_build(code, len, hash)) != NULL)
+        conv->in_use = 1;
+      return conv;
+    }
+
+    k_free(conv);
+    *slot = NULL;
+  }
+
+  if ((conv = conv_build(code, len, hash)) != NULL) {
+    conv->cached = TRUE;
+    conv->in_use = 1;
+    *slot = conv;
+  }
+  return conv;
+}
+
+/* ======================================================================
+   conv_release()  -  Finished with compiled conversion code              */
+
+void conv_release(CONV_CODE* conv) {
+  conv->in_use--;
+  if (!conv->cached)
+    k_free(conv);
+}
+
+/* ======================================================================
+   conv_cache_flush()  -  Discard compiled conversion codes
+   Called when a setting that affects parsing of conversion codes is
+   changed. Entries are rebuilt on next use.                              */
+
+void conv_cache_flush() {
+  conv_generation++;
+}
+
+/* ====================================================================== */
+
+Private CONV_CODE* conv_build(char* code, int16_t len, u_int32_t hash) {
+  CONV_CODE* conv;
+  CONV_STEP* step;
+  int16_t num_steps;
+  char* p;
+  char* q;
+
+  num_steps = 1;
+  for (p = code; (p = strchr(p, VALUE_MARK)) != NULL; p++)
+    num_steps++;
+
+  conv = (CONV_CODE*)k_alloc(141, sizeof(CONV_CODE) +
+                                      ((num_steps - 1) * sizeof(CONV_STEP)) +
+                                      len + 1);
+  if (conv == NULL)
+    return NULL;
+
+  conv->hash = hash;
+  conv->generation = conv_generation;
+  conv->in_use = 0;
+  conv->cached = FALSE;
+  conv->len = len;
+  conv->text = (char*)(conv->step + num_steps);
+  memcpy(conv->text, code, len + 1);
+  conv->num_steps = num_steps;
+
+  /* Split at value marks and parse the codes that we can */
+
+  for (p = conv->text, step = conv->step; num_steps--; step++) {
+    q = strchr(p, VALUE_MARK);
+    if (q != NULL)
+      *q = '\0';
+
+    while (*p == ' ')
+      p++; /* Skip leading spaces */
+    step->code = p;
+    step->type = CONV_OTHER;
+
+    switch (UpperCase(*p)) {
+      case '\0':
+        step->type = CONV_NULL;
         break;
 
-      case '<':
-        process.status = field_extraction(p);
+      case 'D':
+        step->type = CONV_DATE;
+        step->spec.date.status = parse_date(p + 1, &(step->spec.date));
         break;
 
-      default: /* Not recognised */
-        goto bad_conv_string;
-    }
+      case 'M':
+        switch (UpperCase(*(p + 1))) {
+          case 'D':
+          case 'L':
+          case 'R':
+            step->type = CONV_MD;
+            parse_md(p + 1, &(step->spec.md));
+            break;
 
-    if (process.status != 0)
-      goto exit_op_oconv;
+          case 'T':
+            step->type = CONV_TIME;
+            parse_time(p + 1, &(step->spec.time));
+            break;
+        }
+        break;
+    }
 
     p = q + 1;
-  } while (!done);
-
-exit_op_oconv:
-  return;
+  }
 
-bad_conv_string:
-  process.status = 2;
-  goto exit_op_oconv;
+  return conv;
 }
 
 /* ======================================================================
@@ -913,7 +1157,7 @@ int32_t concatenation_conversion(char* p) {
 /* ======================================================================
    date_conversion()  -  D conversion                                     */
 
-Private int32_t date_conversion(char* p) {
+Private int32_t date_conversion(DATE_SPEC* ds) {
   int32_t status = 2;
   DESCRIPTOR* src_descr;
   char s[100 + 1];
@@ -929,6 +1173,7 @@ Private int32_t date_conversion(char* p) {
 
   if (src_descr->type == STRING)
     (void)k_str_to_num(src_descr);
+  DecToFloat(src_descr);
   if (src_descr->type != INTEGER) {
     if (src_descr->type != FLOATNUM) {
       status = 1;
@@ -937,7 +1182,10 @@ Private int32_t date_conversion(char* p) {
     GetInt(src_descr); /* 0428 */
   }
 
-  if ((status = oconv_d(src_descr->data.value, p, s)) != 0)
+  if ((status = ds->status) != 0) /* Invalid conversion code */
+    goto exit_date_conversion;
+
+  if ((status = format_date(src_descr->data.value, ds, s)) != 0)
     goto exit_date_conversion;
 
 exit_date_conversion_ok:
@@ -1518,109 +1766,44 @@ Private int32_t integer_conversion(char* src, int16_t bytes) {
 }
 
 /* ======================================================================
-   masked_decimal_conversion()  -  MD, ML and MR conversions              */
+   parse_md()  -  Parse MD, ML and MR conversion code                     */
 
-Private int32_t masked_decimal_conversion(char* p) {
-  int32_t status = 2;
-  DESCRIPTOR* src_descr;
-  double value;
-  int32_t int_value;
-  char mode;            /* Conversion mode (D, L or R) */
-  int16_t dp;           /* Decimal places */
-  int16_t scale_factor; /* Scale factor */
-  bool commas = FALSE;  /* Insert comma thousands separator? */
-  char prefix[32 + 1] = "";
-  char thousands;
-  char decimal;
-  char suffix[32] = "";
-  int16_t neg; /* Action for negative values */
-#define LEADING_MINUS 0
-#define TRAILING_SIGN 1
-#define TRAILING_MINUS 2
-#define ANGLE_BRACKETS 3
-#define ROUND_BRACKETS 4
-#define TRAILING_CR 5
-#define TRAILING_DB 6
-  bool suppress_decimal_scale;
-  bool null_zero;
-  bool dp_present = FALSE;
-  bool truncate = FALSE;
-  int16_t width = 0;   /* Field width (0 implies not set) */
-  int16_t padding = 0; /* Width of padding... */
-  char pad_char = ' '; /* ...and character to use */
-  char s[99 + 1];
-  char z[99 + 1];
-  bool is_negative;
-  bool is_integer;
-  int16_t i;
-  int16_t n;
+Private void parse_md(char* p, MD_SPEC* md) {
   char* q;
-  char* r;
   char delim;
-  char* mask = NULL;
-
-  thousands = national.thousands;
-  decimal = national.decimal;
-
-  mode = *(p++); /* Fetch mode character (D, L, R) */
-  mode = UpperCase(mode);
-
-  src_descr = e_stack - 1;
-
-  /* 0227 Return null string for null data */
-
-  if ((src_descr->type == STRING) && (src_descr->data.str.saddr == NULL)) {
-    if ((mode == 'D') || Option(OptPickNull))
-      return 0;
-  }
-
-rescan:
-  switch (src_descr->type) {
-    case INTEGER:
-      int_value = src_descr->data.value;
-      is_integer = TRUE;
-      break;
-
-    case FLOATNUM:
-      value = src_descr->data.float_value;
-      is_integer = FALSE;
-      dp_present = fabs(value - (int32_t)value) > pcfg.fltdiff;
-      break;
-
-    case STRING:
-      //0227      if (src_descr->data.str.saddr == NULL) goto exit_masked_decimal_ok;
-
-      if (!k_str_to_num(src_descr)) /* Not a number - return unconverted */
-      {
-        status = 1;
-        goto exit_masked_decimal;
-      }
-      dp_present = src_descr->type == FLOATNUM;
-      goto rescan;
+  int16_t n;
 
-    default:
-      k_error(sysmsg(1202));
-  }
+  md->status = 2;
+  md->mode = UpperCase(*p); /* Fetch mode character (D, L, R) */
+  p++;
+  md->commas = FALSE;
+  md->prefix[0] = '\0';
+  md->thousands = national.thousands;
+  md->decimal = national.decimal;
+  md->suffix[0] = '\0';
+  md->width = 0;
+  md->pad_char = ' ';
+  md->mask = NULL;
 
   /* Get decimal places */
 
-  dp = (IsDigit(*p)) ? (*(p++) - '0') : 0;
+  md->dp = (IsDigit(*p)) ? (*(p++) - '0') : 0;
 
   /* Scale factor */
 
   if (IsDigit(*p))
-    scale_factor = *(p++) - '0'; /* Scale factor present */
+    md->scale_factor = *(p++) - '0'; /* Scale factor present */
   else
-    scale_factor = dp;
+    md->scale_factor = md->dp;
 
   while (1) {
     if (*p == ',') /* Comma separator? */
     {
-      commas = TRUE;
+      md->commas = TRUE;
       p++;
     } else if (*p == '$') /* Currency symbol */
     {
-      strcpy(prefix, national.currency);
+      strcpy(md->prefix, national.currency);
       p++;
     } else
       break;
@@ -1632,7 +1815,7 @@ rescan:
       p++;                           /* Skip spaces */
     if ((*p == '"') || (*p == '\'')) /* Prefix */
     {
-      for (delim = *(p++), q = prefix, n = 32; /* Collect prefix string */
+      for (delim = *(p++), q = md->prefix, n = 32; /* Collect prefix string */
            (*p != delim) && (*p != '\0') && n--; *(q++) = *(p++))
         ;
       *q = '\0';
@@ -1643,7 +1826,7 @@ rescan:
       while (*p == ' ')
         p++; /* Skip spaces */
     } else {
-      for (q = prefix, n = 32; /* Collect prefix string */
+      for (q = md->prefix, n = 32; /* Collect prefix string */
            (*p != ']') && (*p != ',') && (*p != '\0') && n--; *(q++) = *(p++))
         ;
       *q = '\0';
@@ -1659,8 +1842,8 @@ rescan:
       {
         delim = *(p++);
         if ((*p) != delim) {
-          thousands = *(p++);
-          commas = TRUE;
+          md->thousands = *(p++);
+          md->commas = TRUE;
         }
         while ((*p != delim) && (*p != '\0'))
           p++; /* Ensure at delimiter */
@@ -1669,8 +1852,8 @@ rescan:
         while (*p == ' ')
           p++; /* Skip spaces */
       } else if ((*p != ']') && (*p != ',') && (*p != '\0')) {
-        thousands = *(p++);
-        commas = TRUE;
+        md->thousands = *(p++);
+        md->commas = TRUE;
         while (*p == ' ')
           p++; /* Skip spaces */
       }
@@ -1684,7 +1867,7 @@ rescan:
       {
         delim = *(p++);
         if ((*p) != delim)
-          decimal = *(p++);
+          md->decimal = *(p++);
         while ((*p != delim) && (*p != '\0'))
           p++; /* Ensure at delimiter */
         if (*p == delim)
@@ -1692,7 +1875,7 @@ rescan:
         while (*p == ' ')
           p++; /* Skip spaces */
       } else if ((*p != ']') && (*p != ',') && (*p != '\0')) {
-        decimal = *(p++);
+        md->decimal = *(p++);
         while (*p == ' ')
           p++; /* Skip spaces */
       }
@@ -1704,7 +1887,7 @@ rescan:
         p++;                           /* Skip spaces */
       if ((*p == '"') || (*p == '\'')) /* Suffix */
       {
-        for (delim = *(p++), q = suffix, n = 32; /* Collect suffix string */
+        for (delim = *(p++), q = md->suffix, n = 32; /* Collect suffix string */
              (*p != delim) && (*p != '\0') && n--; *(q++) = *(p++))
           ;
         *q = '\0';
@@ -1715,7 +1898,7 @@ rescan:
         while (*p == ' ')
           p++; /* Skip spaces */
       } else {
-        for (q = suffix, n = 32; /* Collect suffix string */
+        for (q = md->suffix, n = 32; /* Collect suffix string */
              (*p != ']') && (*p != ',') && (*p != '\0') && n--; *(q++) = *(p++))
           ;
         *q = '\0';
@@ -1725,7 +1908,7 @@ rescan:
     }
 
     if (*p != ']')
-      goto exit_masked_decimal;
+      return;
     p++;
   }
 
@@ -1733,85 +1916,152 @@ rescan:
 
   switch (UpperCase(*p)) {
     case '+':
-      neg = TRAILING_SIGN;
+      md->neg = TRAILING_SIGN;
       p++;
       break;
     case '-':
-      neg = TRAILING_MINUS;
+      md->neg = TRAILING_MINUS;
       p++;
       break;
     case '<':
-      neg = ANGLE_BRACKETS;
+      md->neg = ANGLE_BRACKETS;
       p++;
       break;
     case '(':
-      neg = ROUND_BRACKETS;
+      md->neg = ROUND_BRACKETS;
       p++;
       break;
     case 'C':
-      neg = TRAILING_CR;
+      md->neg = TRAILING_CR;
       p++;
       break;
     case 'D':
-      neg = TRAILING_DB;
+      md->neg = TRAILING_DB;
       p++;
       break;
     default:
-      neg = LEADING_MINUS;
+      md->neg = LEADING_MINUS;
       break;
   }
 
   /* Suppress scaling if decimal point present? */
 
-  if ((suppress_decimal_scale = (UpperCase(*p) == 'P')) != 0)
+  if ((md->suppress_decimal_scale = (UpperCase(*p) == 'P')) != 0)
     p++;
 
   /* Represent zero value by null string? */
 
-  if ((null_zero = (UpperCase(*p) == 'Z')) != 0)
+  if ((md->null_zero = (UpperCase(*p) == 'Z')) != 0)
     p++;
 
   /* Truncate rather than round? */
 
-  if ((truncate = (UpperCase(*p) == 'T')) != 0)
+  if ((md->truncate = (UpperCase(*p) == 'T')) != 0)
     p++;
 
   /* Field width */
 
   if (IsDigit(*p)) /* Field width present (max two digits) */
   {
-    width = *(p++) - '0';
+    md->width = *(p++) - '0';
     if (IsDigit(*p))
-      width = (width * 10) + (*(p++) - '0');
+      md->width = (md->width * 10) + (*(p++) - '0');
     if (*p != '\0')
-      pad_char = *(p++);
+      md->pad_char = *(p++);
   } else if ((*p != '\0') && (strchr("#*%", *p) !=
                               NULL)) { /* Format code style fill specfication */
-    mask = p;
+    md->mask = p;
+  }
+
+  md->status = 0;
+}
+
+/* ======================================================================
+   masked_decimal_conversion()  -  MD, ML and MR conversions              */
+
+Private int32_t masked_decimal_conversion(MD_SPEC* md) {
+  int32_t status = 2;
+  DESCRIPTOR* src_descr;
+  double value;
+  int32_t int_value;
+  bool dp_present = FALSE;
+  int16_t width;       /* Field width */
+  int16_t padding = 0; /* Width of padding */
+  char s[99 + 1];
+  char z[99 + 1];
+  bool is_negative;
+  bool is_integer;
+  int16_t i;
+  int16_t n;
+  char* q;
+  char* r;
+
+  src_descr = e_stack - 1;
+
+  /* 0227 Return null string for null data */
+
+  if ((src_descr->type == STRING) && (src_descr->data.str.saddr == NULL)) {
+    if ((md->mode == 'D') || Option(OptPickNull))
+      return 0;
   }
 
+rescan:
+  switch (src_descr->type) {
+    case INTEGER:
+      int_value = src_descr->data.value;
+      is_integer = TRUE;
+      break;
+
+    case FLOATNUM:
+      value = src_descr->data.float_value;
+      is_integer = FALSE;
+      dp_present = fabs(value - (int32_t)value) > pcfg.fltdiff;
+      break;
+
+    case DECIMAL:
+      dec_to_float(src_descr);
+      goto rescan;
+
+    case STRING:
+      //0227      if (src_descr->data.str.saddr == NULL) goto exit_masked_decimal_ok;
+
+      if (!k_str_to_num(src_descr)) /* Not a number - return unconverted */
+      {
+        status = 1;
+        goto exit_masked_decimal;
+      }
+      dp_present = src_descr->type != INTEGER;
+      goto rescan;
+
+    default:
+      k_error(sysmsg(1202));
+  }
+
+  if (md->status != 0) /* Invalid conversion code */
+    goto exit_masked_decimal;
+
   /* Do the conversion */
 
-  if (is_integer && (dp == scale_factor)) {
+  if (is_integer && (md->dp == md->scale_factor)) {
     if ((is_negative = (int_value < 0)) != 0)
       int_value = -int_value;
 
-    if (null_zero && (int_value == 0)) {
+    if (md->null_zero && (int_value == 0)) {
       z[0] = '\0'; /* 0410 */
       goto apply_formatting;
     }
 
-    if (dp) {
+    if (md->dp) {
       /* Convert as integer then insert decimal point at correct position */
 
       Ltoa(int_value, z, 10);
-      i = strlen(z) - dp; /* Digits to left of decimal point */
+      i = strlen(z) - md->dp; /* Digits to left of decimal point */
       q = z;
       r = s;
       if (i <= 0) /* Must insert leading zeros */
       {
         *(r++) = '0';
-        *(r++) = decimal;
+        *(r++) = md->decimal;
         while (i++ < 0)
           *(r++) = '0';
         strcpy(r, q);
@@ -1819,7 +2069,7 @@ rescan:
         memcpy(r, q, i);
         r += i;
         q += i;
-        *(r++) = decimal;
+        *(r++) = md->decimal;
         strcpy(r, q);
       }
     } else /* No decimal point required */
@@ -1830,11 +2080,11 @@ rescan:
     if (is_integer)
       value = (double)int_value;
 
-    if (scale_factor && !(suppress_decimal_scale && dp_present)) {
-      value /= tens[scale_factor];
+    if (md->scale_factor && !(md->suppress_decimal_scale && dp_present)) {
+      value /= tens[md->scale_factor];
     }
 
-    if (null_zero && (fabs(value) < pcfg.fltdiff)) {
+    if (md->null_zero && (fabs(value) < pcfg.fltdiff)) {
       z[0] = '\0'; /* 0410 */
       goto apply_formatting;
     }
@@ -1844,47 +2094,47 @@ rescan:
 
     /* Convert value to string */
 
-    ftoa(value, dp, truncate, s); /* 0352, 0367 */
+    ftoa(value, md->dp, md->truncate, s); /* 0352, 0367 */
 
-    if (decimal != '.') {
+    if (md->decimal != '.') {
       q = strchr(s, '.');
       if (q != NULL)
-        *q = decimal;
+        *q = md->decimal;
     }
   }
 
   /* Insert thousands delimiters if required */
 
-  if (commas)
-    insert_commas(s, thousands, decimal);
+  if (md->commas)
+    insert_commas(s, md->thousands, md->decimal);
 
   /* Insert prefix and handle negative value indications */
 
   q = z;
-  switch (neg) {
+  switch (md->neg) {
     case LEADING_MINUS:
       if (is_negative)
         *(q++) = '-';
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       break;
 
     case TRAILING_SIGN:
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       strcat(q, (is_negative) ? "-" : "+");
       break;
 
     case TRAILING_MINUS:
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       strcat(q, (is_negative) ? "-" : " ");
@@ -1892,9 +2142,9 @@ rescan:
 
     case ANGLE_BRACKETS:
       *(q++) = (is_negative) ? '<' : ' ';
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       strcat(q, (is_negative) ? ">" : " ");
@@ -1902,18 +2152,18 @@ rescan:
 
     case ROUND_BRACKETS:
       *(q++) = (is_negative) ? '(' : ' ';
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       strcat(q, (is_negative) ? ")" : " ");
       break;
 
     case TRAILING_CR:
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       if (Option(OptCRDBUpcase))
@@ -1923,9 +2173,9 @@ rescan:
       break;
 
     case TRAILING_DB:
-      if (prefix[0] != '\0') {
-        strcpy(q, prefix);
-        q += strlen(prefix);
+      if (md->prefix[0] != '\0') {
+        strcpy(q, md->prefix);
+        q += strlen(md->prefix);
       }
       strcpy(q, s);
       if (Option(OptCRDBUpcase))
@@ -1937,14 +2187,15 @@ rescan:
 
   /* Add suffix */
 
-  if (suffix[0] != '\0')
-    strcat(q, suffix);
+  if (md->suffix[0] != '\0')
+    strcat(q, md->suffix);
 
 apply_formatting:
 
   /* Pad or truncate to field width */
 
   n = strlen(z);
+  width = md->width;
   if (width) {
     if (n > width) /* Truncate if over-long */
     {
@@ -1955,24 +2206,24 @@ apply_formatting:
   } else {
     width = n;
     padding = 0;
-    if (mask != NULL) {
-      n = apply_mask(z, n, z, mask, mode == 'R', ' ');
+    if (md->mask != NULL) {
+      n = apply_mask(z, n, z, md->mask, md->mode == 'R', ' ');
     }
   }
 
   /* Form result string */
 
   q = s;
-  if (mode == 'R')
+  if (md->mode == 'R')
     while (padding-- > 0)
-      *(q++) = pad_char;
+      *(q++) = md->pad_char;
 
   memcpy(q, z, n);
   q += n;
 
-  if (mode == 'L')
+  if (md->mode == 'L')
     while (padding-- > 0)
-      *(q++) = pad_char;
+      *(q++) = md->pad_char;
 
   *q = '\0';
 
@@ -2323,6 +2574,10 @@ int32_t substitution_conversion(char* p) {
       use_value_1 = (src_descr->data.float_value != 0.0);
       break;
 
+    case DECIMAL:
+      use_value_1 = (src_descr->data.dec.value != 0);
+      break;
+
     default:
       status = 1;
       goto exit_substitution_conversion;
@@ -2453,14 +2708,32 @@ exit_substring_conversion:
 }
 
 /* ======================================================================
+   parse_time()  -  Parse MT conversion code
    time_conversion()  -  MT conversion                                    */
 
-Private int32_t time_conversion(char* p) {
-  int32_t status = 2;
+Private void parse_time(char* p, TIME_SPEC* ts) {
+  p++; /* Skip T */
+
+  if ((ts->am_pm = (UpperCase(*p) == 'H')) != 0) /* 12 hour format */
+    p++;
+
+  if ((ts->include_seconds = (UpperCase(*p) == 'S')) != 0) /* Include seconds */
+    p++;
+
+  if (*p != '\0') /* Separator specified */
+  {
+    if (((*p == '"') || (*p == '\'')) && (*(p + 1) != '\0') &&
+        (*(p + 2) == *p)) {
+      ts->separator = *(p + 1); /* Quoted delimiter */
+    } else {
+      ts->separator = *p;
+    }
+  } else
+    ts->separator = ':';
+}
+
+Private int32_t time_conversion(TIME_SPEC* ts) {
   DESCRIPTOR* src_descr;
-  char separator;
-  bool am_pm = FALSE;
-  bool include_seconds = FALSE;
   bool am;
   int16_t hours;
   int16_t mins;
@@ -2479,36 +2752,11 @@ Private int32_t time_conversion(char* p) {
   GetInt(src_descr);
   secs = src_descr->data.value;
 
-  p++; /* Skip T */
-
-  if (UpperCase(*p) == 'H') /* 12 hour format */
-  {
-    p++;
-    am_pm = TRUE;
+  if (ts->am_pm)
     secs = secs % 86400L; /* 0152 */
-  }
-
-  if (UpperCase(*p) == 'S') /* Include seconds */
-  {
-    p++;
-    include_seconds = TRUE;
-  }
-
-  if (*p != '\0') /* Separator specified */
-  {
-    if (((*p == '"') || (*p == '\'')) && (*(p + 1) != '\0') &&
-        (*(p + 2) == *p)) {
-      p++;
-      separator = *(p++); /* Quoted delimiter */
-      p++;
-    } else {
-      separator = *(p++);
-    }
-  } else
-    separator = ':';
 
   hours = (int16_t)(secs / 3600);
-  if (am_pm) {
+  if (ts->am_pm) {
     am = hours < 12;
     hours = hours % 12;
     if (hours == 0)
@@ -2520,9 +2768,9 @@ Private int32_t time_conversion(char* p) {
 
   secs = secs % 60;
 
-  sprintf(s, (include_seconds) ? "%02d%c%02d%c%02d" : "%02d%c%02d", (int)hours,
-          separator, (int)mins, separator, (int)secs);
-  if (am_pm) {
+  sprintf(s, (ts->include_seconds) ? "%02d%c%02d%c%02d" : "%02d%c%02d", (int)hours,
+          ts->separator, (int)mins, ts->separator, (int)secs);
+  if (ts->am_pm) {
     if (Option(OptAMPMUpcase))
       strcat(s, (am) ? "AM" : "PM");
     else
@@ -2533,9 +2781,8 @@ exit_time_conversion_ok:
   k_pop(1);
   k_put_c_string(s, e_stack);
   e_stack++;
-  status = 0;
 
-  return status;
+  return 0;
 }
 
 /* ======================================================================
@@ -2724,6 +2971,8 @@ void op_setnls() {
       break;
   }
 
+  conv_cache_flush(); /* Compiled MD codes hold the old settings */
+
   k_dismiss();
   k_pop(1);
 }
@@ -2895,53 +3144,29 @@ int oconv_d(int dt,     /* Date value to convert */
             char* code, /* Conversion code with leading D removed */
             char* tgt)  /* Buffer to receive result */
 {
-  int32_t status = 2;
+  int32_t status;
+  DATE_SPEC ds;
+
+  tgt[0] = '\0';
+  if ((status = parse_date(code, &ds)) == 0)
+    status = format_date(dt, &ds, tgt);
+  return status;
+}
+
+/* ======================================================================
+   parse_date()  -  Parse date conversion code                            */
+
+Private int32_t parse_date(char* code, /* Conversion code with leading D removed */
+                           DATE_SPEC* ds) {
   bool european_format;
-  int16_t day;
-  int16_t mon;
-  int16_t year;
-  int16_t julian;
-  int16_t dow;
   int16_t year_digits;
-  char separator[2] = "\0"; /* Double null to allow simple overwrite */
-  char space[2] = " ";
-  char* sep;
-  struct FORMAT {
-    char code; /* D, M, Y, J, A (alpha month), W (Alpha day)
-                                 N (Day of week as number), Q, O (ordinal day),
-                                 I (ISO week number), y (ISO year number) */
-    int16_t width;
-    bool zero_suppress;
-    char text[20 + 1];
-  } format[5];
   int16_t i;
-  int16_t j;
   int16_t n;
   bool done;
   char c;
   char* p;
-  char* q;
-  char z[12];
-  bool leading_upper = FALSE;
-  bool iso = FALSE;
-  int iso_wk;
-  int iso_year;
-  int w;
-  int y;
-  int jan1_dow;
-  int leap_year;
-  int prev_leap_year;
-  static char* ordinals[31] = {NULL};
-
-  tgt[0] = '\0';
-  memset(format, 0, sizeof(format));
-
-  /* Convert the date to day, month, year components */
 
-  day_to_dmy(dt, &day, &mon, &year, &julian);
-  dow = ((dt - 1) % 7) + 1;
-  if (dow <= 0)
-    dow += 7; /* 1 = Monday */
+  memset(ds, 0, sizeof(DATE_SPEC));
 
   /* Use system default if converion code is just D */
 
@@ -2956,24 +3181,24 @@ int oconv_d(int dt,     /* Date value to convert */
   if (IsDigit(*code)) {
     year_digits = *(code++) - '0';
     if (year_digits > 4)
-      goto exit_oconv_d;
+      return 2;
   } else
     year_digits = 4;
 
   /* Set up default format, taking E mode into account */
 
   if ((*code == '\0') || (UpperCase(*code) == 'L')) {
-    format[0].code = 'D'; /* Default to dd mmm yyyy */
-    format[0].width = 2;
-    format[0].zero_suppress = FALSE;
-    format[1].code = 'A';
-    format[1].width = 3;
+    ds->format[0].code = 'D'; /* Default to dd mmm yyyy */
+    ds->format[0].width = 2;
+    ds->format[0].zero_suppress = FALSE;
+    ds->format[1].code = 'A';
+    ds->format[1].width = 3;
   } else {
     /* {c}  -  Separator character */
 
     if ((*code != '\0') && !IsAlpha(*code)) /* Separator is specified */
     {
-      separator[0] = *(code++);
+      ds->separator[0] = *(code++);
     }
 
     european_format = european_dates ^ (UpperCase(*code) == 'E'); /* 0407 */
@@ -2981,31 +3206,31 @@ int oconv_d(int dt,     /* Date value to convert */
       code++;
 
     if (european_format) {
-      format[0].code = 'D'; /* Default to dd mm yyyy */
-      format[0].width = 2;
-      format[0].zero_suppress = FALSE;
-      if (european_format && (separator[0] == '\0')) {
-        format[1].code = 'A';
-        format[1].width = 3;
+      ds->format[0].code = 'D'; /* Default to dd mm yyyy */
+      ds->format[0].width = 2;
+      ds->format[0].zero_suppress = FALSE;
+      if (european_format && (ds->separator[0] == '\0')) {
+        ds->format[1].code = 'A';
+        ds->format[1].width = 3;
       } else {
-        format[1].code = 'M';
-        format[1].width = 2;
+        ds->format[1].code = 'M';
+        ds->format[1].width = 2;
       }
-      format[1].zero_suppress = FALSE;
+      ds->format[1].zero_suppress = FALSE;
     } else {
-      format[0].code = 'M'; /* Default to mm dd yyyy */
-      format[0].width = 2;
-      format[0].zero_suppress = FALSE;
-      format[1].code = 'D';
-      format[1].width = 2;
-      format[1].zero_suppress = FALSE;
+      ds->format[0].code = 'M'; /* Default to mm dd yyyy */
+      ds->format[0].width = 2;
+      ds->format[0].zero_suppress = FALSE;
+      ds->format[1].code = 'D';
+      ds->format[1].width = 2;
+      ds->format[1].zero_suppress = FALSE;
     }
   }
-  format[2].code = 'Y';
-  format[2].width = year_digits;
-  format[2].zero_suppress = FALSE;
-  format[3].code = '\0';
-  format[4].code = '\0';
+  ds->format[2].code = 'Y';
+  ds->format[2].width = year_digits;
+  ds->format[2].zero_suppress = FALSE;
+  ds->format[3].code = '\0';
+  ds->format[4].code = '\0';
 
   /* Look for remaining components */
 
@@ -3015,71 +3240,71 @@ int oconv_d(int dt,     /* Date value to convert */
     switch (c) {
       case 'D':
         if (*(code + 1) == 'O') {
-          format[i].code = 'O';
+          ds->format[i].code = 'O';
           code += 2;
           break;
         }
         /* **** Fall through **** */
       case 'J':
-        format[i].code = c;
-        format[i].width = 2;
+        ds->format[i].code = c;
+        ds->format[i].width = 2;
         code++;
         break;
 
       case 'Y':
         code++;
         if (UpperCase(*code) == 'I') {
-          format[i].code = 'y';
-          iso = TRUE;
+          ds->format[i].code = 'y';
+          ds->iso = TRUE;
           code++;
         } else {
-          format[i].code = 'Y';
+          ds->format[i].code = 'Y';
         }
-        format[i].width = (c == 'Y') ? year_digits : 2;
+        ds->format[i].width = (c == 'Y') ? year_digits : 2;
         break;
 
       case 'I':
-        format[i].code = c;
-        format[i].width = 2;
+        ds->format[i].code = c;
+        ds->format[i].width = 2;
         code++;
         break;
 
       case 'Q':
-        format[i].code = c;
-        format[i].width = 1;
+        ds->format[i].code = c;
+        ds->format[i].width = 1;
         code++;
         break;
 
       case 'L':
-        leading_upper = TRUE;
+        ds->leading_upper = TRUE;
         code++;
         goto reparse; /* Yuck!  Process this component level again */
 
       case 'M':
         code++;
         if (UpperCase(*code) == 'A') {
-          format[i].code = 'A';
-          format[i].width = 0; /* Width as necessary */
+          ds->format[i].code = 'A';
+          ds->format[i].width = 0; /* Width as necessary */
           code++;
         } else {
-          format[i].code = 'M';
-          format[i].width = 2;
+          ds->format[i].code = 'M';
+          ds->format[i].width = 2;
         }
         break;
 
       case 'W':
         code++;
         if (UpperCase(*code) == 'A') {
-          format[i].code = 'W';
-          format[i].width = 0; /* Width as necessary */
+          ds->format[i].code = 'W';
+          ds->format[i].width = 0; /* Width as necessary */
           code++;
         } else if (UpperCase(*code) == 'I') {
-          format[i].code = 'I';
-          format[i].width = 0; /* Width as necessary */
+          ds->format[i].code = 'I';
+          ds->format[i].width = 0; /* Width as necessary */
           code++;
         } else {
-          format[i].code = 'N';
-          format[i].width = 1;
+          ds->format[i].code = 'N';
+          ds->format[i].width = 1;
         }
         break;
 
@@ -3088,19 +3313,19 @@ int oconv_d(int dt,     /* Date value to convert */
         break;
     }
 
-    format[i].zero_suppress = FALSE;
+    ds->format[i].zero_suppress = FALSE;
 
     if (done)
       break;
   }
 
   if (i && (i < 5))
-    format[i].code = '\0'; /* Kill off further defaults */
+    ds->format[i].code = '\0'; /* Kill off further defaults */
 
   /* Check for L (day and month names have only leading capital) */
 
   if (UpperCase(*code) == 'L') {
-    leading_upper = TRUE;
+    ds->leading_upper = TRUE;
     code++;
   }
 
@@ -3110,37 +3335,37 @@ int oconv_d(int dt,     /* Date value to convert */
     code++;
     i = 0;
     while (*code != ']') {
-      if (format[i].code == '\0')
-        goto exit_oconv_d;
+      if (ds->format[i].code == '\0')
+        return 2;
       /* Modifier but no code */
 
       c = UpperCase(*code);
       if (c == 'A') /* Alphabetic modifier - Valid for month and day name */
       {
-        if (format[i].code == 'M') {
-          format[i].code = 'A';
-          format[i].width = 0; /* Width to fit */
+        if (ds->format[i].code == 'M') {
+          ds->format[i].code = 'A';
+          ds->format[i].width = 0; /* Width to fit */
           code++;
-        } else if (strchr("NW", format[i].code) != NULL) {
-          format[i].code = 'W';
-          format[i].width = 0; /* Width to fit */
+        } else if (strchr("NW", ds->format[i].code) != NULL) {
+          ds->format[i].code = 'W';
+          ds->format[i].width = 0; /* Width to fit */
           code++;
         } else {
-          goto exit_oconv_d;
+          return 2;
         }
       } else if (c ==
                  'Z') /* Zero suppression - Valid for D, I, M and Y codes */
       {
-        if (strchr("DIMY", format[i].code) != NULL) {
-          format[i].zero_suppress = TRUE;
-          format[i].width = 1;
+        if (strchr("DIMY", ds->format[i].code) != NULL) {
+          ds->format[i].zero_suppress = TRUE;
+          ds->format[i].width = 1;
           code++;
-        } else if (strchr("J", format[i].code) != NULL) {
-          format[i].zero_suppress = TRUE;
-          format[i].width = 2;
+        } else if (strchr("J", ds->format[i].code) != NULL) {
+          ds->format[i].zero_suppress = TRUE;
+          ds->format[i].width = 2;
           code++;
         } else {
-          goto exit_oconv_d;
+          return 2;
         }
       } else if (IsDigit(c)) /* Width modifier */
       {
@@ -3149,19 +3374,19 @@ int oconv_d(int dt,     /* Date value to convert */
           n = (n * 10) + (*(code++) - '0');
         }
         if ((n < 1) || (n > 32))
-          goto exit_oconv_d;
-        format[i].width = n;
+          return 2;
+        ds->format[i].width = n;
       } else if ((c == '"') || (c == '\'') || (c == '\\')) /* Text modifier */
       {
         code++;
         p = strchr(code, c);
         if (p == NULL)
-          goto exit_oconv_d; /* No closing delimiter */
+          return 2; /* No closing delimiter */
         n = p - code;
         if (n > 20)
-          goto exit_oconv_d; /* Too long */
-        memcpy(format[i].text, code, n);
-        format[i].text[n] = '\0';
+          return 2; /* Too long */
+        memcpy(ds->format[i].text, code, n);
+        ds->format[i].text[n] = '\0';
         code = p + 1;
       } else if (c == ',') {
         i++;
@@ -3169,18 +3394,62 @@ int oconv_d(int dt,     /* Date value to convert */
         if (i == 5)
           break;
       } else {
-        goto exit_oconv_d;
+        return 2;
       }
     }
     code++; /* Skip ] */
   }
 
   if (*code != '\0')
-    goto exit_oconv_d;
+    return 2;
+
+  if (ds->separator[0] == '\0')
+    ds->separator[0] = ' ';
+
+  return 0;
+}
+
+/* ======================================================================
+   format_date()  -  Format date using parsed conversion code             */
+
+Private int32_t format_date(int dt,        /* Date value to convert */
+                            DATE_SPEC* ds, /* Parsed conversion code */
+                            char* tgt)     /* Buffer to receive result */
+{
+  int16_t day;
+  int16_t mon;
+  int16_t year;
+  int16_t julian;
+  int16_t dow;
+  char space[2] = " ";
+  char* sep;
+  int16_t i;
+  int16_t j;
+  int16_t n;
+  char* p;
+  char* q;
+  char z[12];
+  int iso_wk;
+  int iso_year;
+  int w;
+  int y;
+  int jan1_dow;
+  int leap_year;
+  int prev_leap_year;
+  static char* ordinals[31] = {NULL};
+
+  tgt[0] = '\0';
+
+  /* Convert the date to day, month, year components */
+
+  day_to_dmy(dt, &day, &mon, &year, &julian);
+  dow = ((dt - 1) % 7) + 1;
+  if (dow <= 0)
+    dow += 7; /* 1 = Monday */
 
   /* Do we need an ISO week conversion? */
 
-  if (iso) {
+  if (ds->iso) {
     iso_year = year;
 
     /* Is this a leap year? */
@@ -3229,13 +3498,11 @@ int oconv_d(int dt,     /* Date value to convert */
 
   /* Do the conversion */
 
-  if (separator[0] == '\0')
-    separator[0] = ' ';
   sep = NULL; /* No separator before first item */
 
   p = tgt;
 
-  for (i = 0; (i < 5) && (format[i].code != '\0'); i++) {
+  for (i = 0; (i < 5) && (ds->format[i].code != '\0'); i++) {
     /* Insert separator */
 
     if (sep != NULL) {
@@ -3243,48 +3510,48 @@ int oconv_d(int dt,     /* Date value to convert */
       p += strlen(sep);
     }
 
-    n = format[i].width;
+    n = ds->format[i].width;
 
-    switch (format[i].code) {
+    switch (ds->format[i].code) {
       case 'A': /* Alphabetic month */
         strcpy(z, month_names[mon - 1]);
-        if (!leading_upper)
+        if (!ds->leading_upper)
           UpperCaseString(z);
         if (n)
           p += sprintf(p, "%-*.*s", (int)n, (int)n, z);
         else
           p += sprintf(p, "%s", z);
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'D': /* Numeric day of month */
-        p += sprintf(p, "%-*.*d", (int)n, (format[i].zero_suppress) ? 1 : 2,
+        p += sprintf(p, "%-*.*d", (int)n, (ds->format[i].zero_suppress) ? 1 : 2,
                      (int)day);
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'I': /* ISO week number */
-        p += sprintf(p, "%-*.*d", (int)n, (format[i].zero_suppress) ? 1 : 2,
+        p += sprintf(p, "%-*.*d", (int)n, (ds->format[i].zero_suppress) ? 1 : 2,
                      (int)iso_wk);
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'J':
         w = sprintf(z, "%d", (int)julian);
         y = n - w;
         while (y-- > 0) {
-          *(p++) = (format[i].zero_suppress) ? ' ' : '0';
+          *(p++) = (ds->format[i].zero_suppress) ? ' ' : '0';
         }
         memcpy(p, z, w);
         p += w;
         *p = '\0'; /* 0564 */
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'M': /* Numeric month */
-        p += sprintf(p, "%-*.*d", (int)n, (format[i].zero_suppress) ? 1 : 2,
+        p += sprintf(p, "%-*.*d", (int)n, (ds->format[i].zero_suppress) ? 1 : 2,
                      (int)mon);
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'N': /* Numeric day of week */
@@ -3305,7 +3572,7 @@ int oconv_d(int dt,     /* Date value to convert */
             ordinals[j] = strtok(NULL, ",");
         }
         p += sprintf(p, "%s", ordinals[day - 1]);
-        sep = separator;
+        sep = ds->separator;
         break;
 
       case 'Q': /* Quarter */
@@ -3315,7 +3582,7 @@ int oconv_d(int dt,     /* Date value to convert */
 
       case 'W': /* Alphabetic day of week */
         strcpy(z, day_names[dow - 1]);
-        if (!leading_upper)
+        if (!ds->leading_upper)
           UpperCaseString(z);
         if (n)
           p += sprintf(p, "%-*.*s", (int)n, (int)n, z);
@@ -3325,40 +3592,37 @@ int oconv_d(int dt,     /* Date value to convert */
         break;
 
       case 'Y':
-        if (format[i].width > 0) {
-          if (format[i].zero_suppress) {
+        if (ds->format[i].width > 0) {
+          if (ds->format[i].zero_suppress) {
             p += sprintf(p, "%d", (int)(year % (int)tens[n]));
           } else {
-            p += sprintf(p, "%.*d", (int)format[i].width,
+            p += sprintf(p, "%.*d", (int)ds->format[i].width,
                          (int)(year % (int)tens[n]));
           }
 
-          sep = separator;
+          sep = ds->separator;
         }
         break;
 
       case 'y':
-        if (format[i].width > 0) {
-          if (format[i].zero_suppress) {
+        if (ds->format[i].width > 0) {
+          if (ds->format[i].zero_suppress) {
             p += sprintf(p, "%d", (int)(iso_year % (int)tens[n]));
           } else {
-            p += sprintf(p, "%.*d", (int)format[i].width,
+            p += sprintf(p, "%.*d", (int)ds->format[i].width,
                          (int)(iso_year % (int)tens[n]));
           }
 
-          sep = separator;
+          sep = ds->separator;
         }
         break;
     }
 
-    if (format[i].text[0] != '\0')
-      sep = format[i].text;
+    if (ds->format[i].text[0] != '\0')
+      sep = ds->format[i].text;
   }
 
-  status = 0;
-
-exit_oconv_d:
-  return status;
+  return 0;
 }
 
 /* END-CODE */
@@ -21,6 +21,15 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb OPENSEQ lock waits use lock_wait().
+ *
+ * 18Oct26 gwb SEEK takes large offsets exactly from DECIMAL values.
+ *
+ * 18Oct26 gwb Buffer size for files is now set by SEQBUF and the kernel is
+ *             asked to read ahead. Large READBLK requests and unbuffered
+ *             reads go straight into the target string. WRITEBLK and
+ *             unbuffered WRITESEQ use one writev() for the whole string.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -73,13 +82,26 @@
 
 #include "qm.h"
 #include "dh_int.h"
+#include "config.h"
 #include <poll.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 
-#define SEQ_BUFFER_SIZE 2048
-#define SEQ_BUFFER_MASK 2047
+/* Files use a buffer of SEQBUF kb, rounded up to a power of two, so that
+   a block address is simply the file position with the low bits masked
+   off. Ports, FIFOs and devices use the minimum size.                   */
+
+#define SEQ_MIN_BUFFER_SIZE 2048
+#define SEQ_WRITE_IOV 64
 
 Private void openseq(bool map_name);
 Private void writeseq(bool flush_to_disk);
+Private int32_t seq_buffer_size(void);
+Private int32_t load_block(SQ_FILE* sq_file, int64 block);
+Private bool write_string(SQ_FILE* sq_file,
+                          STRING_CHUNK* str,
+                          char* tail,
+                          int16_t tail_bytes);
 Private void emit(FILE_VAR* fvar, char* p, int16_t bytes);
 Private int flush_seq(FILE_VAR* fvar, bool force_write);
 Private OSFILE create_seq_record(FILE_VAR* fvar);
@@ -694,7 +716,7 @@ Private void openseq(bool map_name) {
           process_events();
         pc -= 2; /* Two byte opcodes for OPENSEQ and OPENSEQP */
         lock_beep();
-        Sleep(250);
+        lock_wait();
         return;
     }
   }
@@ -714,11 +736,21 @@ Private void openseq(bool map_name) {
   sq_file->line = 1;
   sq_file->record_name = NULL;
   sq_file->pathname = NULL;
-  sq_file->buff = (char*)k_alloc(33, SEQ_BUFFER_SIZE);
+  sq_file->buff_size = (flags & SQ_NOTFL) ? SEQ_MIN_BUFFER_SIZE : seq_buffer_size();
+  sq_file->buff = (char*)k_alloc(33, sq_file->buff_size);
   sq_file->base = -1;
   sq_file->timeout = -1;
   sq_file->flags = flags;
 
+  if (sq_file->buff == NULL) {
+    process.status = -ER_MEM;
+    goto exit_op_openseq;
+  }
+
+  if (!(flags & SQ_NOTFL) && ValidFileHandle(fu)) {
+    posix_fadvise(fu, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
   /* Save full (mapped) pathname of record */
 
   sq_file->pathname = (char*)k_alloc(34, strlen(fullpathname) + 1);
@@ -788,6 +820,8 @@ exit_op_openseq:
     }
 
     if (sq_file != NULL) {
+      if (sq_file->buff != NULL)
+        k_free(sq_file->buff);
       if (sq_file->pathname != NULL)
         k_free(sq_file->pathname);
       k_free(sq_file);
@@ -832,8 +866,8 @@ void op_readblk() {
   OSFILE fu;
   int32_t bytes;
   int64 block;
-  int16_t offset;
-  int16_t n;
+  int32_t offset;
+  int32_t n;
   u_int16_t flags;
   int bytes_in_buffer;
   int bytes_read;
@@ -898,7 +932,7 @@ void op_readblk() {
       {
         sq_file->bytes = 0;
         sq_file->posn = 0;
-        n = min(bytes, SEQ_BUFFER_SIZE);
+        n = min(bytes, sq_file->buff_size);
 
         if (flags & SQ_PORT) /* Port */
         {
@@ -938,40 +972,34 @@ void op_readblk() {
       }
     }
   } else if (sq_file->flags & SQ_NOBUF) {
-    while (bytes > 0) {
-      n = (int16_t)min(bytes, SEQ_BUFFER_SIZE);
-
-      if ((sq_file->bytes = (int16_t)Read(fu, sq_file->buff, n)) <= 0) {
-        sq_file->bytes = 0;
-        break;
-      }
-
-      ts_copy(sq_file->buff, n);
+    if ((n = ts_read(fu, bytes)) > 0)
       sq_file->posn += n;
-      bytes -= n;
-    }
   } else {
     while (bytes > 0) {
-      block = sq_file->posn & ~SEQ_BUFFER_MASK;
+      block = sq_file->posn & ~((int64)sq_file->buff_size - 1);
       if (block != sq_file->base) {
         if (flush_seq(fvar, FALSE))
           goto exit_op_readblk;
 
-        Seek(fu, block, SEEK_SET);
-        if ((sq_file->bytes =
-                 (int16_t)Read(fu, sq_file->buff, SEQ_BUFFER_SIZE)) <= 0) {
-          sq_file->bytes = 0;
+        if (bytes >= sq_file->buff_size) {
+          /* Large request. Read the rest directly into the target. */
+
+          Seek(fu, sq_file->posn, SEEK_SET);
+          if ((n = ts_read(fu, bytes)) > 0)
+            sq_file->posn += n;
           break;
         }
-        sq_file->base = block;
+
+        if (load_block(sq_file, block) <= 0)
+          break;
       }
 
-      offset = (int16_t)(sq_file->posn & SEQ_BUFFER_MASK);
+      offset = (int32_t)(sq_file->posn - block);
       n = sq_file->bytes - offset;
-      if (n == 0)
+      if (n <= 0)
         break; /* End of file */
       if (bytes < n)
-        n = (int16_t)bytes;
+        n = bytes;
       ts_copy(sq_file->buff + offset, n);
       sq_file->posn += n;
       bytes -= n;
@@ -1021,12 +1049,12 @@ void op_readseq() {
   SQ_FILE* sq_file;
   OSFILE fu;
   int64 block;
-  int16_t offset;
-  int16_t bytes;
+  int32_t offset;
+  int32_t bytes;
   /* bool check_lf; variable set but never used */
   char* p;
   u_int16_t op_flags;
-  int16_t n;
+  int32_t n;
   char* q;
   int bytes_read;
   bool lf_found;
@@ -1097,7 +1125,7 @@ void op_readseq() {
 
         if (flags & SQ_PORT) /* Port */
         {
-          bytes_read = readport(fu, sq_file->buff, SEQ_BUFFER_SIZE);
+          bytes_read = readport(fu, sq_file->buff, sq_file->buff_size);
         } else /* FIFO */
         {
           do {
@@ -1122,7 +1150,7 @@ void op_readseq() {
             goto exit_op_readseq; /* Error */
           if (timeout == 0)
             break;
-          bytes_read = read(fu, sq_file->buff, SEQ_BUFFER_SIZE);
+          bytes_read = read(fu, sq_file->buff, sq_file->buff_size);
         }
 
         if (bytes_read < 0)
@@ -1149,22 +1177,17 @@ void op_readseq() {
 
     /* check_lf = FALSE; variable set but never used */
     do {
-      block = sq_file->posn & ~SEQ_BUFFER_MASK;
+      block = sq_file->posn & ~((int64)sq_file->buff_size - 1);
       if (block != sq_file->base) {
         if (flush_seq(fvar, FALSE))
           goto exit_op_readseq;
 
-        Seek(fu, block, SEEK_SET);
-        if ((sq_file->bytes =
-                 (int16_t)Read(fu, sq_file->buff, SEQ_BUFFER_SIZE)) < 0) {
-          sq_file->bytes = 0;
-        }
-        sq_file->base = block;
+        load_block(sq_file, block);
       }
 
-      offset = (int16_t)(sq_file->posn & SEQ_BUFFER_MASK);
+      offset = (int32_t)(sq_file->posn - block);
       bytes = sq_file->bytes - offset;
-      if (bytes == 0) /* End of file */
+      if (bytes <= 0) /* End of file */
       {
         if (tgt_descr->data.str.saddr != NULL)
           break; /* 0915 Found some data */
@@ -1244,6 +1267,8 @@ void op_seek() {
   GetNum(descr);
   if (descr->type == INTEGER)
     offset = descr->data.value;
+  else if (descr->type == DECIMAL)
+    offset = descr->data.dec.value / dec_tens[descr->data.dec.scale];
   else
     offset = (int64)(descr->data.float_value);
 
@@ -1506,16 +1531,10 @@ void op_writeblk() {
 
     Seek(fu, sq_file->posn, SEEK_SET);
 
-    /* Write each string chunk to the file */
-
-    while (src_str != NULL) {
-      if (Write(fu, src_str->data, src_str->bytes) < 0) {
-        process.status = ER_WRITE_ERROR;
-        process.os_error = OSError;
-        goto exit_op_writeblk;
-      }
-      sq_file->posn += src_str->bytes;
-      src_str = src_str->next;
+    if (!write_string(sq_file, src_str, NULL, 0)) {
+      process.status = ER_WRITE_ERROR;
+      process.os_error = OSError;
+      goto exit_op_writeblk;
     }
   }
 
@@ -1621,24 +1640,13 @@ Private void writeseq(bool flush_to_disk) {
     if (!writeport(fu, "\r\n", 1))
       goto exit_op_writeseq;
   } else if (sq_file->flags & SQ_NOBUF) {
-    while (src_str != NULL) {
-      if (Write(fu, src_str->data, src_str->bytes) < 0) {
-        process.status = ER_WRITE_ERROR;
-        process.os_error = OSError;
-        goto exit_op_writeseq;
-      }
-      sq_file->posn += src_str->bytes;
-      src_str = src_str->next;
-    }
+    /* Write the data and newline sequence together */
 
-    /* Write newline sequence */
-
-    if (Write(fu, Newline, NewlineBytes) < 0) {
+    if (!write_string(sq_file, src_str, Newline, NewlineBytes)) {
       process.status = ER_WRITE_ERROR;
       process.os_error = OSError;
       goto exit_op_writeseq;
     }
-    sq_file->posn += NewlineBytes;
   } else {
     while (src_str != NULL) {
       emit(fvar, src_str->data, src_str->bytes);
@@ -1668,33 +1676,105 @@ exit_op_writeseq:
   }
 }
 
+/* ======================================================================
+   seq_buffer_size()  -  Buffer size for a newly opened file              */
+
+Private int32_t seq_buffer_size() {
+  int32_t size = SEQ_MIN_BUFFER_SIZE;
+
+  while (size < pcfg.seqbuf * 1024)
+    size <<= 1;
+
+  return size;
+}
+
+/* ======================================================================
+   load_block()  -  Read the buffer for the block at the given address    */
+
+Private int32_t load_block(SQ_FILE* sq_file, int64 block) {
+  int32_t n;
+
+  /* When moving forwards through the file, ask the kernel to start
+     reading the following block so that it is ready by the time this
+     one has been processed.                                             */
+
+  if (block == sq_file->base + sq_file->buff_size) {
+    posix_fadvise(sq_file->fu, block + sq_file->buff_size, sq_file->buff_size,
+                  POSIX_FADV_WILLNEED);
+  }
+
+  Seek(sq_file->fu, block, SEEK_SET);
+  n = Read(sq_file->fu, sq_file->buff, sq_file->buff_size);
+  sq_file->bytes = (n < 0) ? 0 : n;
+  sq_file->base = block;
+
+  return n;
+}
+
+/* ======================================================================
+   write_string()  -  Write string chunks at the current file position
+   The optional tail is written after the string. Chunks are gathered into
+   a single writev() so each chunk does not cost a system call.          */
+
+Private bool write_string(SQ_FILE* sq_file,
+                          STRING_CHUNK* str,
+                          char* tail,
+                          int16_t tail_bytes) {
+  struct iovec iov[SEQ_WRITE_IOV];
+  int count;
+  ssize_t wanted;
+  ssize_t n;
+
+  while ((str != NULL) || tail_bytes) {
+    count = 0;
+    wanted = 0;
+    while ((str != NULL) && (count < SEQ_WRITE_IOV)) {
+      iov[count].iov_base = str->data;
+      iov[count].iov_len = str->bytes;
+      wanted += str->bytes;
+      count++;
+      str = str->next;
+    }
+
+    if ((str == NULL) && tail_bytes && (count < SEQ_WRITE_IOV)) {
+      iov[count].iov_base = tail;
+      iov[count].iov_len = tail_bytes;
+      wanted += tail_bytes;
+      count++;
+      tail_bytes = 0;
+    }
+
+    n = writev(sq_file->fu, iov, count);
+    if (n > 0)
+      sq_file->posn += n;
+    if (n != wanted)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
 /* ======================================================================
    emit()  -  Write data to sequential file                               */
 
 Private void emit(FILE_VAR* fvar, char* p, int16_t bytes) {
-  int16_t n;
+  int32_t n;
   int64 block;
-  int16_t offset;
+  int32_t offset;
   SQ_FILE* sq_file;
 
   sq_file = fvar->access.seq.sq_file;
 
   while (bytes) {
-    block = sq_file->posn & ~SEQ_BUFFER_MASK;
+    block = sq_file->posn & ~((int64)sq_file->buff_size - 1);
     if (block != sq_file->base) {
       flush_seq(fvar, FALSE);
-
-      Seek(sq_file->fu, block, SEEK_SET);
-      if ((sq_file->bytes = (int16_t)Read(sq_file->fu, sq_file->buff,
-                                            SEQ_BUFFER_SIZE)) < 0) {
-        sq_file->bytes = 0;
-      }
-      sq_file->base = block;
+      load_block(sq_file, block);
     }
 
-    offset = (int16_t)(sq_file->posn & SEQ_BUFFER_MASK);
+    offset = (int32_t)(sq_file->posn - block);
 
-    n = min(bytes, SEQ_BUFFER_SIZE - offset);
+    n = min(bytes, sq_file->buff_size - offset);
     memcpy(sq_file->buff + offset, p, n);
     p += n;
     bytes -= n;
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb In-place string updates clear the cached numeric value.
+ *
+ * 18Oct26 gwb op_remove() uses find_mark() to locate the next delimiter.
+ *
+ * 18Oct26 gwb op_append() keeps strings that fit in one chunk contiguous.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -227,6 +233,7 @@ void op_append() {
       /* Update the total string length while this chunk is mapped */
 
       tgt->string_len = s_len;
+      tgt->num_flags = 0; /* Any cached numeric value is now wrong */
 
       /* Find the final chunk of the string */
 
@@ -252,9 +259,11 @@ void op_append() {
       }
 
       if (tgt->bytes < MAX_STRING_CHUNK_SIZE) {
-        if (tgt->bytes == tgt->alloc_size) {
+        if ((tgt->bytes == tgt->alloc_size) ||
+            ((prev_tgt == NULL) && (s_len <= MAX_STRING_CHUNK_SIZE))) {
           /* Allocate a replacement allowing some slack space for potential
-            future growth.                                                 */
+            future growth. A single chunk string that will still fit in one
+            chunk is always replaced so that it stays contiguous.          */
 
           new_len = src_len + tgt->bytes + (tgt->alloc_size / 2);
           new_str = s_alloc(new_len, &chunk_size);
@@ -510,14 +519,14 @@ void op_remove() {
 
       p = src->data + offset;
 
-      for (q = p; bytes_remaining-- > 0; q++) {
-        if (IsMark(*q)) {
-          delim_descr->data.value = 256 - (u_char)*q;
-          len = q - p;
-          offset += len + 1;
-          done = TRUE;
-          break;
-        }
+      q = find_mark(p, bytes_remaining);
+      if (q != NULL) {
+        delim_descr->data.value = 256 - (u_char)*q;
+        len = q - p;
+        offset += len + 1;
+        done = TRUE;
+      } else {
+        q = p + bytes_remaining;
       }
 
       /* Copy substring */
@@ -1142,7 +1151,7 @@ Private void substra(bool pick_style) {
 
   /* Clear any hint */
 
-  tgt_hdr->field = 0;
+  ClearHints(tgt_hdr);
 
   tgt_descr->flags &= ~DF_CHANGE;
 
@@ -1328,7 +1337,7 @@ void op_psubstrb() {
       (src_str->ref_ct == 1)) {
     /* Easy - Do the substitution in-situ */
 
-    src_hdr->field = 0; /* Clear any hint */
+    ClearHints(src_hdr); /* Clear any hint */
     src_descr->flags &= ~DF_CHANGE;
 
     /* Find position for replacement */
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb In-place string updates clear the cached numeric value.
+ *
+ * 18Oct26 gwb INS inserts into an unshared string in place where it can.
+ *
+ * 18Oct26 gwb find_item() uses find_delim() to scan values and subvalues.
+ *
  * 06Feb20 gwb Initialized a variable in rdi() that was triggering a warning in valigrind.
  *             Reformatted code.
  * 
@@ -68,6 +74,7 @@ Private void insert(bool compatible);
 Private void rep(bool compatible);
 Private void replace(bool compatible);
 Private void rdi(DESCRIPTOR *src_descr, int32_t field, int32_t value, int32_t subvalue, int16_t mode, DESCRIPTOR *new_descr, DESCRIPTOR *result_descr, bool compatible);
+Private bool ins_in_place(DESCRIPTOR *tgt_descr, int32_t field, int32_t value, int32_t subvalue, DESCRIPTOR *new_descr);
 
 /* ======================================================================
    op_col1()  -  Fetch COL1 value                                         */
@@ -509,14 +516,133 @@ Private void ins(bool compatible) {
   new_descr = e_stack - 1;
   k_get_string(new_descr);
 
-  rdi(tgt_descr, field, value, subvalue, DYN_INSERT, new_descr, &result_descr, compatible);
+  if (!ins_in_place(tgt_descr, field, value, subvalue, new_descr)) {
+    rdi(tgt_descr, field, value, subvalue, DYN_INSERT, new_descr, &result_descr, compatible);
 
-  k_release(tgt_descr);
-  *tgt_descr = result_descr;
+    k_release(tgt_descr);
+    *tgt_descr = result_descr;
+  }
 
   k_dismiss();
 }
 
+/* ======================================================================
+   ins_in_place()  -  Insert into an unshared string without copying it
+
+   Handles the common case of inserting before an existing item, typically
+   at a position returned by an ordered LOCATE. The new item is inserted
+   into the chunk holding the insertion point, moving only the remainder
+   of that chunk. Returns FALSE if the general rdi() path must be used.   */
+
+Private bool ins_in_place(DESCRIPTOR *tgt_descr, int32_t field, int32_t value, int32_t subvalue, DESCRIPTOR *new_descr) {
+  STRING_CHUNK *str;
+  STRING_CHUNK *chunk;
+  STRING_CHUNK *new_chunk;
+  STRING_CHUNK *ins_str;
+  int16_t offset;
+  int16_t tail;
+  int32_t ins_len;
+  int16_t actual_size;
+  char mark;
+  char c;
+  char *p;
+
+  str = tgt_descr->data.str.saddr;
+  if ((str == NULL) || (str->ref_ct != 1))
+    return FALSE;
+
+  if ((field < 1) || (value < 0) || (subvalue < 0))
+    return FALSE; /* Appending or creating missing items */
+
+  ins_str = new_descr->data.str.saddr;
+  if ((ins_str != NULL) && (ins_str->string_len >= MAX_STRING_CHUNK_SIZE))
+    return FALSE;
+
+  if (value == 0) {
+    mark = FIELD_MARK;
+    value = 1;
+    subvalue = 1;
+  } else if (subvalue == 0) {
+    mark = VALUE_MARK;
+    subvalue = 1;
+  } else {
+    mark = SUBVALUE_MARK;
+  }
+
+  if (!find_item(str, field, value, subvalue, &chunk, &offset) || (chunk == NULL))
+    return FALSE;
+
+  /* As in rdi(), the new item needs a following mark unless it is going at
+    the end of the string or before a higher level mark.                 */
+
+  ins_len = (ins_str == NULL) ? 0 : ins_str->string_len;
+  if (offset < chunk->bytes)
+    c = chunk->data[offset];
+  else if (chunk->next != NULL)
+    c = chunk->next->data[0];
+  else
+    c = '\0';
+
+  if (((offset < chunk->bytes) || (chunk->next != NULL)) && (!IsDelim(c) || (c <= mark))) {
+    ins_len++;
+  } else {
+    mark = '\0'; /* No mark required */
+  }
+
+  tail = chunk->bytes - offset;
+
+  if ((chunk->alloc_size - chunk->bytes) >= ins_len) {
+    /* Room in this chunk */
+
+    p = chunk->data + offset;
+    memmove(p + ins_len, p, tail);
+    chunk->bytes += (int16_t)ins_len;
+  } else if ((chunk == str) && (chunk->next == NULL) && ((str->string_len + ins_len) <= MAX_STRING_CHUNK_SIZE)) {
+    /* Replace single chunk string with a larger chunk to keep the string
+      contiguous, allowing some slack for further inserts.               */
+
+    new_chunk = s_alloc(str->string_len + ins_len + (str->alloc_size / 2), &actual_size);
+    memcpy(new_chunk->data, str->data, offset);
+    memcpy(new_chunk->data + offset + ins_len, str->data + offset, tail);
+    new_chunk->bytes = (int16_t)(str->bytes + ins_len);
+    new_chunk->string_len = str->string_len;
+    new_chunk->ref_ct = 1;
+    s_free(str);
+    str = new_chunk;
+    chunk = new_chunk;
+    tgt_descr->data.str.saddr = str;
+    p = chunk->data + offset;
+  } else if ((offset > 0) && ((tail + ins_len) <= MAX_STRING_CHUNK_SIZE)) {
+    /* Split the chunk at the insertion point */
+
+    new_chunk = s_alloc(tail + ins_len, &actual_size);
+    memcpy(new_chunk->data + ins_len, chunk->data + offset, tail);
+    new_chunk->bytes = (int16_t)(tail + ins_len);
+    new_chunk->next = chunk->next;
+    chunk->next = new_chunk;
+    chunk->bytes = offset;
+    p = new_chunk->data;
+  } else {
+    return FALSE;
+  }
+
+  /* Copy in the new item */
+
+  for (; ins_str != NULL; ins_str = ins_str->next) {
+    memcpy(p, ins_str->data, ins_str->bytes);
+    p += ins_str->bytes;
+  }
+
+  if (mark != '\0')
+    *p = mark;
+
+  str->string_len += ins_len;
+  ClearHints(str); /* Clear hint */
+  tgt_descr->flags &= ~DF_REMOVE;
+
+  return TRUE;
+}
+
 /* ======================================================================
    op_insert()  -  Insert item in a string leaving result on stack        */
 
@@ -719,6 +845,7 @@ Private void rep(bool compatible) {
 
       s_len = str_first_chunk->string_len + rep_len;
       str_first_chunk->string_len = s_len;
+      str_first_chunk->num_flags = 0; /* Any cached numeric value is now wrong */
 
       if (str_hdr->alloc_size >= s_len) {
         /* The entire result will fit in the allocated size of the target
@@ -1169,28 +1296,33 @@ field_found:
   /* Scan for value / subvalue */
 
   while (1) {
-    while (bytes_remaining-- > 0) {
-      c = *(p++);
-      if (IsDelim(c)) {
-        switch (c) {
-          case FIELD_MARK:
-            return FALSE; /* No such value or subvalue */
-
-          case VALUE_MARK:
-            if (++v > value)
-              return FALSE; /* No such subvalue */
-            sv = 1;
-            break;
-
-          case SUBVALUE_MARK:
-            sv++;
-            break;
-        }
+    while (bytes_remaining > 0) {
+      q = find_delim(p, bytes_remaining);
+      if (q == NULL)
+        break; /* No mark in this chunk */
+
+      c = *q;
+      bytes_remaining -= (q - p) + 1;
+      p = q + 1; /* Position after mark */
+
+      switch (c) {
+        case FIELD_MARK:
+          return FALSE; /* No such value or subvalue */
+
+        case VALUE_MARK:
+          if (++v > value)
+            return FALSE; /* No such subvalue */
+          sv = 1;
+          break;
 
-        if ((v == value) && (sv == subvalue)) /* At start position */
-        {
-          goto exit_find_item;
-        }
+        case SUBVALUE_MARK:
+          sv++;
+          break;
+      }
+
+      if ((v == value) && (sv == subvalue)) /* At start position */
+      {
+        goto exit_find_item;
       }
     }
 
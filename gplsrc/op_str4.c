@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb NUM() accepts DECIMAL values.
+ *
+ * 18Oct26 gwb count() uses count_byte() for single character delimiters.
+ *
+ * 18Oct26 gwb op_index() has a fast path for contiguous strings.
+ *
  * 06Feb20 gwb Fixed a variable that was being used in an uninitialized state
  *             as reported by valgrind.
  * 
@@ -211,6 +217,35 @@ void op_index() {
   k_get_string(descr);
   src_str = descr->data.str.saddr;
 
+  if ((src_str != NULL) && (src_str->next == NULL) && !nocase) {
+    /* Contiguous string - no chunk boundaries to handle */
+
+    src = src_str->data;
+    src_bytes_remaining = src_str->bytes - substring_len;
+    while (src_bytes_remaining > 0) {
+      p = (char *)memchr(src, substring[0], src_bytes_remaining);
+      if (p == NULL)
+        break;
+
+      if (substring_len && memcmp(p + 1, substring + 1, substring_len)) {
+        src_bytes_remaining -= (p - src) + 1;
+        src = p + 1;
+        continue;
+      }
+
+      if (--occurrence == 0) {
+        offset = (p - src_str->data) + 1;
+        goto exit_op_index;
+      }
+
+      src_bytes_remaining -= (p - src) + substring_len + 1;
+      src = p + substring_len + 1;
+    }
+
+    offset = 0;
+    goto exit_op_index;
+  }
+
   /* Outer loop - Scan source string for initial character of substring */
 
   while (src_str != NULL) {
@@ -759,7 +794,8 @@ void op_num() {
 
   descr = e_stack - 1;
   k_get_value(descr);
-  if ((descr->type == INTEGER) || (descr->type == FLOATNUM)) {
+  if ((descr->type == INTEGER) || (descr->type == FLOATNUM) ||
+      (descr->type == DECIMAL)) {
     is_num = TRUE;
     k_pop(1);
   } else {
@@ -1336,6 +1372,14 @@ Private void count(bool dcount) /* Doing DCOUNT? */
 
   /* Count occurrences of substring in source */
 
+  if (!substring_len && !nocase) { /* Single character, e.g. DCOUNT */
+    do {
+      ct += count_byte(src_str->data, src_str->bytes, substring[0]);
+    } while ((src_str = src_str->next) != NULL);
+
+    goto exit_count_found;
+  }
+
   /* Outer loop - Scan source string for initial character of substring */
 
   while (src_str != NULL) {
@@ -1406,6 +1450,7 @@ Private void count(bool dcount) /* Doing DCOUNT? */
     src_str = src_str->next;
   }
 
+exit_count_found:
   if (dcount)
     ct++;
 
@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb In-place string updates clear the cached numeric value.
+ *
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -894,6 +896,7 @@ void op_getrem() {
 
     case INTEGER:
     case FLOATNUM:
+    case DECIMAL:
     case UNASSIGNED:
       break;
 
@@ -1445,7 +1448,7 @@ void op_swapcase() {
 
     /* Clear any hint */
 
-    str->field = 0;
+    ClearHints(str);
 
     descr->flags &= ~DF_CHANGE;
 
@@ -21,6 +21,9 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Add SYSTEM(1052) string chunk cache statistics
+ *
+ * 18Oct26 gwb Add SYSTEM(1051) opcode statistics
  * 13Feb23 njs Add SYSTEM(1050) is administrator
  * 28Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
@@ -480,6 +483,18 @@ void op_system() {
       descr->data.value = (my_uptr->flags & USR_ADMIN) != 0;
       break;   
 
+    case 1051: /* Opcode statistics (see OPSTATS) */
+      str = opcode_stats();
+      InitDescr(descr, STRING);
+      descr->data.str.saddr = str;
+      break;
+
+    case 1052: /* String chunk cache statistics (see STRCACHE) */
+      str = chunk_pool_stats();
+      InitDescr(descr, STRING);
+      descr->data.str.saddr = str;
+      break;
+
     default:
       k_recurse(pcode_system, 1); /* Execute recursive code */
       break;
@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb KEYIN() timeouts accept DECIMAL values.
+ *
  * 15Jan22 gwb Fixed formatting argument issue (CWE-686) and reformatted
  *             the whole file.
  * 
@@ -1154,6 +1156,7 @@ void op_keyint() {
 
   descr = e_stack - 1;
   GetNum(descr);
+  DecToFloat(descr);
   if (descr->type == INTEGER)
     timeout = descr->data.value * 1000;
   else
@@ -1170,6 +1173,7 @@ void op_keyinct() {
 
   descr = e_stack - 1;
   GetNum(descr);
+  DecToFloat(descr);
   if (descr->type == INTEGER)
     timeout = descr->data.value * 1000;
   else
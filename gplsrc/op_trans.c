@@ -0,0 +1,528 @@
+/* OP_TRANS.C
+ * TRANS() and RTRANS() opcodes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * ScarletDME Wiki: https://scarlet.deltasoft.com
+ *
+ * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Cached results taken before falling back to _TRANS are
+ *             released.
+ * 19Oct26 gwb Cache entries take the file's upd_ct from before the read.
+ * 18Oct26 gwb New module. op_trans() and op_rtrans() moved from op_misc.c.
+ *
+ * END-HISTORY
+ *
+ * START-DESCRIPTION:
+ *
+ * TRANS() is handled by the _TRANS recursive which opens the file, keeps
+ * it in the TRANS file cache in SYSCOM, reads each record and extracts
+ * the required field or evaluates an I-type.
+ *
+ * Once the file is in the SYSCOM cache, field extraction from a dynamic
+ * file is done here without entering the recursive:
+ *
+ *   - Results are kept in a small per-process cache keyed by file, record
+ *     id, field number and mark lowering. An entry is only used while the
+ *     file's upd_ct is unchanged so any write or delete to the file, by
+ *     any process, invalidates it.
+ *
+ *   - A multivalued id list is read with dh_read_multi() so that each
+ *     group is read once however many of the ids hash to it.
+ *
+ * Everything else goes to _TRANS as before: I-types, the V action code,
+ * files not yet in the SYSCOM cache, other file types, files with read
+ * triggers and reads inside a transaction.
+ *
+ * END-DESCRIPTION
+ *
+ * START-CODE
+ */
+
+#include "qm.h"
+#include "dh_int.h"
+#include "syscom.h"
+
+void op_extract(void);
+void op_lower(void);
+
+#define TRANS_CACHE_SIZE 256 /* Must be a power of two */
+
+typedef struct {
+  int16_t file_no; /* File table index */
+  u_int32_t device;
+  u_int32_t inode;
+  u_int32_t upd_ct; /* File's upd_ct value when cached */
+  int32_t field_no;
+  bool lower;
+  bool found;         /* Record exists */
+  STRING_CHUNK* data; /* Result, NULL if null string */
+  int16_t id_len;
+  char id[MAX_ID_LEN];
+} TRANS_CACHE_ENTRY;
+
+Private TRANS_CACHE_ENTRY* trans_cache[TRANS_CACHE_SIZE] = {NULL};
+
+/* Element of the id list */
+
+typedef struct {
+  char* id;
+  int16_t id_len;
+  char delimiter;       /* Mark following this id, zero at end */
+  int16_t req;          /* Index into read requests, -1 if none */
+  bool found;           /* Record exists */
+  STRING_CHUNK* result; /* Extracted data */
+} TRANS_ITEM;
+
+Private void trans(bool lower);
+Private FILE_VAR* trans_file(DESCRIPTOR* descr);
+Private TRANS_CACHE_ENTRY** trans_slot(int16_t fno, int32_t field_no, char* id, int16_t id_len);
+Private bool trans_cache_find(FILE_ENTRY* fptr,
+                              int16_t fno,
+                              int32_t field_no,
+                              bool lower,
+                              TRANS_ITEM* item);
+Private void trans_cache_add(FILE_ENTRY* fptr,
+                             int16_t fno,
+                             int32_t field_no,
+                             bool lower,
+                             TRANS_ITEM* item,
+                             u_int32_t upd_ct);
+Private STRING_CHUNK* trans_extract(STRING_CHUNK* rec, int32_t field_no, bool lower);
+
+/* ======================================================================
+   op_trans()  -  TRANS function                                          */
+
+void op_trans() {
+  /* Stack:
+
+     |=============================|=============================|
+     |            BEFORE           |           AFTER             |
+     |=============================|=============================|
+ top |  Action code expression     |  Result                     |
+     |-----------------------------|-----------------------------|
+     |  Field number               |                             |
+     |-----------------------------|-----------------------------|
+     |  Record ID                  |                             |
+     |-----------------------------|-----------------------------|
+     |  VOC name of file (may have |                             |
+     |  DICT prefix                |                             |
+     |=============================|=============================|
+ */
+
+  trans(TRUE);
+}
+
+/* ======================================================================
+   op_rtrans()  -  RTRANS function (Revelation style, no mark lowering)   */
+
+void op_rtrans() {
+  /* Stack: As op_trans() */
+
+  trans(FALSE);
+}
+
+/* ======================================================================
+   trans_cache_flush()  -  Discard cached TRANS() results                 */
+
+void trans_cache_flush() {
+  int16_t i;
+  TRANS_CACHE_ENTRY* p;
+
+  for (i = 0; i < TRANS_CACHE_SIZE; i++) {
+    if ((p = trans_cache[i]) != NULL) {
+      if ((p->data != NULL) && (--(p->data->ref_ct) == 0))
+        s_free(p->data);
+      k_free(p);
+      trans_cache[i] = NULL;
+    }
+  }
+}
+
+/* ====================================================================== */
+
+Private void trans(bool lower) {
+  DESCRIPTOR* code_descr;
+  DESCRIPTOR* field_descr;
+  DESCRIPTOR* ids_descr;
+  char code[1 + 1];
+  bool use_id;
+  int32_t field_no;
+  FILE_VAR* fvar;
+  FILE_ENTRY* fptr;
+  int16_t fno;
+  STRING_CHUNK* str;
+  char* ids = NULL;
+  int32_t ids_len;
+  TRANS_ITEM* items = NULL;
+  DH_MULTI_READ* reqs = NULL;
+  int16_t num_items;
+  int16_t num_reqs;
+  int16_t i;
+  u_int32_t upd_ct;
+  char* p;
+  char* q;
+  DESCRIPTOR result;
+
+  /* Action code. Only C and V mean anything and V displays a message
+     for each missing record so leave that to _TRANS.                   */
+
+  code_descr = e_stack - 1;
+  k_get_value(code_descr);
+  if (k_get_c_string(code_descr, code, 1) < 0)
+    code[0] = '\0';
+  if (!strcmp(code, "V"))
+    goto recurse;
+  use_id = !strcmp(code, "C");
+
+  /* Field number. Anything that is not an integer is I-type object code */
+
+  field_descr = e_stack - 2;
+  k_get_value(field_descr);
+  if ((field_descr->type == STRING) && (field_descr->data.str.saddr != NULL))
+    (void)k_str_to_num(field_descr);
+  if (field_descr->type != INTEGER)
+    goto recurse;
+  field_no = field_descr->data.value;
+
+  /* File must already be open to TRANS() */
+
+  if ((fvar = trans_file(e_stack - 4)) == NULL)
+    goto recurse;
+
+  if ((fvar->type != DYNAMIC_FILE) ||
+      (fvar->access.dh.dh_file->trigger_modes & TRG_READ) ||
+      (process.txn_id && !(fvar->flags & FV_NON_TXN))) {
+    goto recurse;
+  }
+
+  fno = fvar->file_id;
+  fptr = FPtr(fno);
+
+  /* Copy the id list and split it at marks */
+
+  ids_descr = e_stack - 3;
+  k_get_string(ids_descr);
+  str = ids_descr->data.str.saddr;
+  ids_len = (str == NULL) ? 0 : str->string_len;
+
+  ids = (char*)k_alloc(143, ids_len + 1);
+  for (p = ids; str != NULL; str = str->next) {
+    memcpy(p, str->data, str->bytes);
+    p += str->bytes;
+  }
+  *p = '\0';
+
+  num_items = 1;
+  for (p = ids; (p = find_mark(p, ids_len - (p - ids))) != NULL; p++) {
+    if (++num_items == 0x7FFF) /* Too many for one batch */
+      goto recurse;
+  }
+
+  items = (TRANS_ITEM*)k_alloc(144, num_items * sizeof(TRANS_ITEM));
+  if (items == NULL)
+    goto recurse;
+
+  /* Clear all results so that recurse can release those already taken
+     from the cache however far we got.                                 */
+
+  for (i = 0; i < num_items; i++)
+    items[i].result = NULL;
+
+  reqs = (DH_MULTI_READ*)k_alloc(145, num_items * sizeof(DH_MULTI_READ));
+  if (reqs == NULL)
+    goto recurse;
+
+  num_reqs = 0;
+  for (i = 0, p = ids; i < num_items; i++) {
+    q = find_mark(p, ids_len - (p - ids));
+    if (q == NULL)
+      q = ids + ids_len;
+
+    items[i].id = p;
+    items[i].id_len = (int16_t)min(q - p, 0x7FFF);
+    items[i].delimiter = (q < ids + ids_len) ? *q : '\0';
+    items[i].req = -1;
+    items[i].found = TRUE;
+    items[i].result = NULL;
+
+    /* Leave READ to report an invalid id */
+
+    if (items[i].id_len > sysseg->maxidlen)
+      goto recurse;
+
+    /* A null id is not read. Others may already be cached. */
+
+    if ((items[i].id_len > 0) &&
+        !trans_cache_find(fptr, fno, field_no, lower, items + i)) {
+      reqs[num_reqs].id = items[i].id;
+      reqs[num_reqs].id_len = items[i].id_len;
+      items[i].req = num_reqs++;
+    }
+
+    p = q + 1;
+  }
+
+  if (num_reqs) {
+    /* Take upd_ct before reading. A write that lands during the read
+       then leaves the new entries stale rather than looking current.   */
+
+    upd_ct = fptr->upd_ct;
+    if (!dh_read_multi(fvar->access.dh.dh_file, reqs, num_reqs)) {
+      goto recurse; /* Let READ report the error */
+    }
+
+    for (i = 0; i < num_items; i++) {
+      if (items[i].req >= 0) {
+        str = reqs[items[i].req].data;
+        if ((items[i].found = reqs[items[i].req].found) != FALSE) {
+          if (field_no == 0)
+            k_put_string(items[i].id, items[i].id_len, &result);
+          else {
+            InitDescr(&result, STRING);
+            result.data.str.saddr = trans_extract(str, field_no, lower);
+            str = NULL; /* Now owned by trans_extract() */
+          }
+          items[i].result = result.data.str.saddr;
+        }
+
+        if (str != NULL)
+          s_free(str);
+
+        trans_cache_add(fptr, fno, field_no, lower, items + i, upd_ct);
+      }
+    }
+  }
+
+  /* Assemble the result. As with READ in _TRANS, a missing record sets
+     STATUS() but a successful read leaves it unchanged.                 */
+
+  InitDescr(&result, STRING);
+  result.data.str.saddr = NULL;
+  ts_init(&result.data.str.saddr, 64);
+  for (i = 0; i < num_items; i++) {
+    if (!items[i].found)
+      process.status = ER_RNF;
+
+    if ((str = items[i].result) != NULL) {
+      do {
+        ts_copy(str->data, str->bytes);
+      } while ((str = str->next) != NULL);
+
+      if (--(items[i].result->ref_ct) == 0)
+        s_free(items[i].result);
+    } else if (use_id) {
+      ts_copy(items[i].id, items[i].id_len);
+    }
+
+    if (items[i].delimiter)
+      ts_copy_byte(items[i].delimiter);
+  }
+  (void)ts_terminate();
+
+  k_free(ids);
+  k_free(items);
+  k_free(reqs);
+
+  k_dismiss();
+  k_dismiss();
+  k_dismiss();
+  k_dismiss();
+  *(e_stack++) = result;
+  return;
+
+recurse:
+  if (ids != NULL)
+    k_free(ids);
+  if (items != NULL) {
+    for (i = 0; i < num_items; i++) {
+      if ((items[i].result != NULL) && (--(items[i].result->ref_ct) == 0))
+        s_free(items[i].result);
+    }
+    k_free(items);
+  }
+  if (reqs != NULL)
+    k_free(reqs);
+
+  /* Push flag controlling lowering of marks */
+
+  InitDescr(e_stack, INTEGER);
+  (e_stack++)->data.value = lower;
+
+  k_recurse(pcode_trans, 5); /* Execute recursive code */
+}
+
+/* ======================================================================
+   trans_file()  -  Find file variable in the TRANS file cache            */
+
+Private FILE_VAR* trans_file(DESCRIPTOR* descr) {
+  char name[MAX_PATHNAME_LEN + 1];
+  int16_t name_len;
+  STRING_CHUNK* str;
+  int32_t pos = 1;
+  int16_t matched = 0;
+  int16_t n;
+  char* p;
+  char c;
+  ARRAY_HEADER* ahdr;
+
+  name_len = k_get_c_string(descr, name, MAX_PATHNAME_LEN);
+  if (name_len <= 0)
+    return NULL;
+
+  /* Locate name in the field mark delimited list of names */
+
+  descr = Element(process.syscom, SYSCOM_TRANS_FILES);
+  if (descr->type != STRING)
+    return NULL;
+
+  for (str = descr->data.str.saddr; str != NULL; str = str->next) {
+    for (p = str->data, n = str->bytes; n--; p++) {
+      if ((c = *p) == FIELD_MARK) {
+        if (matched == name_len)
+          goto found;
+        pos++;
+        matched = 0;
+      } else if ((matched >= 0) && (matched < name_len) && (c == name[matched])) {
+        matched++;
+      } else {
+        matched = -1;
+      }
+    }
+  }
+
+  if (matched != name_len)
+    return NULL;
+
+found:
+  descr = Element(process.syscom, SYSCOM_TRANS_FVARS);
+  if (descr->type != ARRAY)
+    return NULL;
+
+  ahdr = descr->data.ahdr_addr;
+  if (pos >= ahdr->used_elements)
+    return NULL;
+
+  descr = Element(ahdr, pos);
+  if (descr->type != FILE_REF)
+    return NULL;
+
+  return descr->data.fvar;
+}
+
+/* ====================================================================== */
+
+Private TRANS_CACHE_ENTRY** trans_slot(int16_t fno, int32_t field_no, char* id, int16_t id_len) {
+  u_int32_t h;
+
+  h = 2166136261u ^ (u_int32_t)fno; /* FNV-1a */
+  h = (h ^ (u_int32_t)field_no) * 16777619u;
+  while (id_len--)
+    h = (h ^ (u_char)*(id++)) * 16777619u;
+
+  return trans_cache + (h & (TRANS_CACHE_SIZE - 1));
+}
+
+/* ======================================================================
+   trans_cache_find()  -  Look for cached result
+   Sets item->result, incrementing its reference count.                   */
+
+Private bool trans_cache_find(FILE_ENTRY* fptr,
+                              int16_t fno,
+                              int32_t field_no,
+                              bool lower,
+                              TRANS_ITEM* item) {
+  TRANS_CACHE_ENTRY* p;
+
+  p = *trans_slot(fno, field_no, item->id, item->id_len);
+  if ((p == NULL) || (p->file_no != fno) || (p->upd_ct != fptr->upd_ct) ||
+      (p->inode != fptr->inode) || (p->device != fptr->device) ||
+      (p->field_no != field_no) || (p->lower != lower) ||
+      (p->id_len != item->id_len) || memcmp(p->id, item->id, item->id_len)) {
+    return FALSE;
+  }
+
+  item->found = p->found;
+  if ((item->result = p->data) != NULL)
+    p->data->ref_ct++;
+
+  return TRUE;
+}
+
+/* ====================================================================== */
+
+Private void trans_cache_add(FILE_ENTRY* fptr,
+                             int16_t fno,
+                             int32_t field_no,
+                             bool lower,
+                             TRANS_ITEM* item,
+                             u_int32_t upd_ct) {
+  TRANS_CACHE_ENTRY** slot;
+  TRANS_CACHE_ENTRY* p;
+
+  slot = trans_slot(fno, field_no, item->id, item->id_len);
+  if ((p = *slot) == NULL) {
+    if ((p = (TRANS_CACHE_ENTRY*)k_alloc(146, sizeof(TRANS_CACHE_ENTRY))) == NULL)
+      return;
+    *slot = p;
+  } else if ((p->data != NULL) && (--(p->data->ref_ct) == 0)) {
+    s_free(p->data);
+  }
+
+  p->file_no = fno;
+  p->device = fptr->device;
+  p->inode = fptr->inode;
+  p->upd_ct = upd_ct;
+  p->field_no = field_no;
+  p->lower = lower;
+  p->found = item->found;
+  if ((p->data = item->result) != NULL)
+    p->data->ref_ct++;
+  p->id_len = item->id_len;
+  memcpy(p->id, item->id, item->id_len);
+}
+
+/* ======================================================================
+   trans_extract()  -  Extract field from record, lowering marks
+   Takes ownership of the record string.                                  */
+
+Private STRING_CHUNK* trans_extract(STRING_CHUNK* rec, int32_t field_no, bool lower) {
+  STRING_CHUNK* str;
+
+  InitDescr(e_stack, STRING);
+  (e_stack++)->data.str.saddr = rec;
+
+  if (field_no > 0) {
+    InitDescr(e_stack, INTEGER);
+    (e_stack++)->data.value = field_no;
+    InitDescr(e_stack, INTEGER);
+    (e_stack++)->data.value = 0;
+    InitDescr(e_stack, INTEGER);
+    (e_stack++)->data.value = 0;
+    op_extract();
+  }
+
+  if (lower)
+    op_lower();
+
+  /* Take the result string from the stack */
+
+  k_get_string(e_stack - 1);
+  str = (--e_stack)->data.str.saddr;
+
+  return str;
+}
+
+/* END-CODE */
@@ -21,6 +21,7 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added DECIMAL variables to process dumps.
  * 03Sep25 gwb Fix potential overflow (github issue #79)
  * 02Jan22 gwb Cleaned up a number of warnings related to using the wrong
  *             format specifier vs the variable type being formatted.
@@ -441,6 +442,7 @@ Private void dump_variable(DESCRIPTOR* descr, /* Descriptor to dump */
   char* p;
   char* q;
   int32_t base;
+  char dec_str[32];
 
   while (descr->type == ADDR)
     descr = descr->data.d_addr;
@@ -464,6 +466,12 @@ Private void dump_variable(DESCRIPTOR* descr, /* Descriptor to dump */
       fprintf(fu, "%s: Flt: %lf\n", s, descr->data.float_value);
       break;
 
+    case DECIMAL:
+      dec_to_str(descr->data.dec.value, descr->data.dec.scale, DEC_MAX_SCALE,
+                 dec_str);
+      fprintf(fu, "%s: Dec: %s\n", s, dec_str);
+      break;
+
     case SUBR:
       fprintf(fu, "%s: Subr: %.*s\n", s,
               descr->data.subr.saddr->bytes, /* Always continguous */
@@ -21,6 +21,24 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Added locate_index_forget().
+ *
+ * 19Oct26 gwb Added object_name_index().
+ *
+ * 18Oct26 gwb Added lock_wait().
+ *
+ * 18Oct26 gwb Added dh_aggregate().
+ *
+ * 18Oct26 gwb Added merge_select_lists().
+ *
+ * 18Oct26 gwb Added ts_read().
+ *
+ * 18Oct26 gwb Added mark scanning functions.
+ *
+ * 18Oct26 gwb Added string chunk cache functions.
+ *
+ * 18Oct26 gwb Added opcode statistics functions.
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -189,6 +207,20 @@ int StringCompLenNoCase(char * p, char * q, int16_t len);
 void UpperCaseMem(char * str, int16_t len);
 char * UpperCaseString(char * s);
 
+/* DECIMAL.C */
+extern int64 dec_tens[];
+void dec_set(DESCRIPTOR * p, int64 value, int16_t scale);
+void dec_to_float(DESCRIPTOR * p);
+int16_t dec_to_str(int64 value, int16_t scale, int16_t precision, char * s);
+void dec_add(DESCRIPTOR * arg1, DESCRIPTOR * arg2, bool subtract);
+void dec_mul(DESCRIPTOR * arg1, DESCRIPTOR * arg2);
+void dec_div(DESCRIPTOR * arg1, DESCRIPTOR * arg2);
+int dec_compare(DESCRIPTOR * arg1, DESCRIPTOR * arg2);
+void dec_int(DESCRIPTOR * p);
+
+/* DH_AGGR.C */
+bool dh_aggregate(DH_FILE * dh_file, char * spec, int32_t spec_len, DESCRIPTOR * result);
+
 /* DH_FILE.C */
 OSFILE dio_open(char * fn, int mode);
    #define DIO_NEW       1 /* Create new file, fail if exists */
@@ -211,6 +243,9 @@ void k_recurse_object(u_char * code_ptr, int num_args, OBJDATA * objdata);
 void k_call(char * name, int num_args, u_char * code_ptr, int16_t stack_adj);
 void k_return(void);
 void k_run_program(void);
+extern char * opcode_name[];
+void opcode_stats_flush(void);
+STRING_CHUNK * opcode_stats(void);
 bool raise_event(int16_t event, int16_t user);
 void process_events(void);
 void show_stack(void);
@@ -288,6 +323,12 @@ u_int32_t GetUnsignedInt(DESCRIPTOR * descr);
 bool load_language(char * language_prefix);
 char * sysmsg(int msg_no);
 
+/* MSCAN.C */
+char * find_delim(char * p, int32_t len);
+char * find_mark(char * p, int32_t len);
+int32_t count_byte(char * p, int32_t len, char c);
+char * find_byte2(char * p, int32_t len, char a, char b);
+
 /* NETFILES.C */
 int net_clearfile(FILE_VAR * fvar);
 void net_close(FILE_VAR * fvar);
@@ -319,11 +360,16 @@ void * load_object(char * name, bool abort_on_error);
 void unload_object(void * obj_hdr);
 void unload_all(void);
 bool is_global(void * obj_hdr);
+void ** object_name_index(void * obj_hdr);
 void invalidate_object(void);
+void invalidate_catalogue_cache(void);
 void * find_object(int32_t id);
-STRING_CHUNK * hsm_dump(void);
+STRING_CHUNK * hsm_dump(int mode);
 void hsm_enter(void);
-void hsm_on(void);
+void hsm_on(bool stacks);
+void hsm_off(void);
+#define HSM_DUMP_PROGRAMS 0 /* Per-program calls and processor time */
+#define HSM_DUMP_SAMPLES  1 /* Folded stack samples */
 
 /* OBJPROG.C */
 OBJDATA * create_objdata(u_char * obj);
@@ -362,6 +408,10 @@ bool dio_init(void);
 void clear_select(int16_t list_no);
 void complete_select(int16_t list_no);
 void end_select(int16_t list_no);
+int32_t merge_select_lists(int16_t mode,
+                           int16_t list1,
+                           int16_t list2,
+                           int16_t tgt);
 
 /* OP_ICONV.C */
 int32_t iconv_time_conversion(void);
@@ -369,12 +419,16 @@ int32_t iconv_time_conversion(void);
 /* OP_JUMPS.C */
 bool valid_call_name(char * call_name);
 
+/* OP_LOCAT.C */
+void locate_index_forget(STRING_CHUNK * str);
+
 /* OP_LOCK.C */
 bool check_lock(FILE_VAR * fvar, char * id, int16_t id_len);
 int16_t lock_record(FILE_VAR *, char * id, int16_t id_len, bool update,
                       u_int32_t txn_id, bool no_wait);
 bool unlock_record(FILE_VAR *, char * id, int16_t id_len);
 void unlock_txn(u_int32_t txn);
+void lock_wait(void);
 void clear_lock_wait(void);
 void rebuild_llt(void);
 
@@ -384,8 +438,16 @@ void day_to_dmy(int32_t day_no, int16_t * day, int16_t * mon,
 char * day_to_ddmmmyyyy(int32_t day_no);
 
 /* OP_OCONV.C */
+typedef struct CONV_CODE CONV_CODE;
 int32_t length_conversion(char * p);
 int oconv_d(int dt, char * code, char * tgt);
+CONV_CODE * conv_compile(DESCRIPTOR * descr);
+void oconv_apply(CONV_CODE * conv);
+void conv_release(CONV_CODE * conv);
+void conv_cache_flush(void);
+
+/* OP_TRANS.C */
+void trans_cache_flush(void);
 
 /* OP_SEQIO.C */
 void close_seq(FILE_VAR * fvar);
@@ -457,6 +519,8 @@ STRING_CHUNK * s_alloc(int32_t size, int16_t * actual_size);
 STRING_CHUNK * s_make_contiguous(STRING_CHUNK * str_addr, int16_t * errnum);
 void s_free(STRING_CHUNK * p);
 void s_free_all(void);
+void reset_chunk_pools(void);
+STRING_CHUNK * chunk_pool_stats(void);
 void setqmstring(char ** strptr, DESCRIPTOR * descr);
 void setstring(char ** strptr, char * string);
 void ts_fill(char c, int32_t len);
@@ -466,6 +530,7 @@ void ts_copy_byte(char c);
 void ts_copy(char * src, int len);
 void ts_copy_c_string(char * str);
 int ts_printf(char * tmpl, ...);
+int32_t ts_read(OSFILE fu, int32_t len);
 int32_t ts_terminate(void);
 void ts_stack(void);
 void ts_unstack(void);
@@ -21,6 +21,8 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added NUM_OPCODES and PREFIX_OPCODE.
+ *
  * 03Sep25 gwb Don't redeclare 'bool' if we're using a C23-compliant compiler.
  * 11Jan22 gwb Created a couple of new defines to eliminate some magic number use
  *             in the k_error() function.
@@ -123,6 +125,8 @@ extern char **environ;
 #define MAX_CALL_NAME_LEN 63    /* Cannot exceed MAX_ID_LEN */
 #define MAX_TRIGGER_NAME_LEN 32 /* Increasing would alter file header */
 #define MAX_PROGRAM_NAME_LEN 128
+#define NUM_OPCODES 512         /* Primary and prefixed secondary opcodes */
+#define PREFIX_OPCODE 0xCF      /* Secondary opcode prefix (opcodes.h) */
 #define MAX_USERNAME_LEN 32
 #define MAX_MATCH_TEMPLATE_LEN 256
 #define MAX_MATCHED_STRING_LEN 8192
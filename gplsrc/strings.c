@@ -21,6 +21,21 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 19Oct26 gwb Chunk free list limits no longer exceed the STRCACHE budget.
+ *
+ * 19Oct26 gwb s_free() releases any LOCATE index of the string.
+ *
+ * 18Oct26 gwb New chunks start with no numeric shadow.
+ *
+ * 18Oct26 gwb Added ts_read().
+ *
+ * 18Oct26 gwb ts_new_chunk() now grows the first chunk in place of chaining
+ *             until it reaches MAX_STRING_CHUNK_SIZE.
+ *
+ * 18Oct26 gwb Replaced the three small block pools with size classed free
+ *             lists covering all chunk sizes, limited by STRCACHE, and
+ *             made the pool statistics available at all times.
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  *
@@ -39,6 +54,8 @@
  * dupstring()           Duplicate a possibly null C string
  * s_alloc()             Allocate string chunk in virtual memory
  * s_free()              Free string chunk chain
+ * reset_chunk_pools()   Apply new STRCACHE setting
+ * chunk_pool_stats()    Return string chunk cache statistics
  * s_make_contiguous()   Make a string contiguous
  * setstring()           Copy a string to a dynamically allocated area
  * ts_copy()             Copy string of given length to target
@@ -48,6 +65,7 @@
  * ts_init()             Initialise target string chain control
  * ts_new_chunk()        Allocate new target chunk
  * ts_printf()           Target string version of printf
+ * ts_read()             Read file data directly into target
  * ts_terminate()        Terminate target string
  *
  * END-DESCRIPTION
@@ -56,27 +74,32 @@
  */
 
 #include "qm.h"
+#include "config.h"
 #include <stdarg.h>
-
-/* #define MEMDIAG */
-
-/* Small memory block allocation cache */
-
-Private STRING_CHUNK* pool[3] = {NULL, NULL, NULL}; /* Chain heads */
-Private int32_t pool_bytes[3] = {2, 8, 32};        /* Largest block on chain */
-Private int32_t pool_count[3] = {0, 0, 0};         /* No of blocks on chain */
-Private int32_t pool_max[3] = {20, 20, 64};        /* Max blocks on chain */
-#define SMALL_BLOCK_SIZE 32                         /* Largest "small" block */
-#define POOL_RANGES (sizeof(pool_bytes) / sizeof(int32_t))
-
-#ifdef MEMDIAG
-Private int32_t pool_alloc_hit[3] = {0, 0, 0};  /* Allocated from pool */
-Private int32_t pool_alloc_miss[3] = {0, 0, 0}; /* No block in pool */
-Private int32_t pool_free_hit[3] = {0, 0, 0};   /* Freed to pool */
-Private int32_t pool_free_miss[3] = {0, 0, 0};  /* Freed but pool full */
-Private int32_t cts[18] = {0, 0, 0, 0, 0, 0, 0, 0, 0,
-                            0, 0, 0, 0, 0, 0, 0, 0, 0}; /* Allocation sizes */
-#endif
+#include <sys/uio.h>
+
+/* String chunk cache
+   Freed chunks are kept on per-process free lists, one for each size
+   class, and reused by s_alloc(). Requests are rounded up to the class
+   size: 2 and 8 bytes, multiples of 16 up to 128 bytes and then four
+   classes per doubling up to MAX_STRING_CHUNK_SIZE. Each class may hold
+   an equal share of the STRCACHE configuration parameter. Chunks are
+   still individually allocated so anything not on a free list is simply
+   a k_alloc() block.                                                     */
+
+#define NUM_CHUNK_CLASSES 38
+Private STRING_CHUNK* pool[NUM_CHUNK_CLASSES];     /* Chain heads */
+Private int32_t pool_bytes[NUM_CHUNK_CLASSES];     /* Class size */
+Private int32_t pool_count[NUM_CHUNK_CLASSES];     /* No of blocks on chain */
+Private int32_t pool_max[NUM_CHUNK_CLASSES];       /* Max blocks on chain */
+Private u_int32_t pool_alloc_hit[NUM_CHUNK_CLASSES];  /* Allocated from pool */
+Private u_int32_t pool_alloc_miss[NUM_CHUNK_CLASSES]; /* No block in pool */
+Private u_int32_t pool_free_hit[NUM_CHUNK_CLASSES];   /* Freed to pool */
+Private u_int32_t pool_free_miss[NUM_CHUNK_CLASSES];  /* Freed but pool full */
+Private bool pool_initialised = FALSE;
+
+Private int16_t chunk_class(int32_t size);
+Private void init_chunk_pools(void);
 
 /* Data for ts_init(), ts_new_chunk(), ts_terminate() */
 Private STRING_CHUNK** ts_tgt_head; /* Ptr to chain head ptr */
@@ -145,58 +168,29 @@ STRING_CHUNK* s_alloc(
   STRING_CHUNK* p;
   int16_t i;
 
-#ifdef MEMDIAG
-  {
-    /* Record allocation size histogram data */
-
-    int32_t hi;
-    int16_t x;
-    for (x = 0, hi = 1; x < 18; x++, hi = hi << 1) {
-      if (size <= hi) {
-        cts[x]++;
-        break;
-      }
-    }
-  }
-#endif
-
-  if (size <= SMALL_BLOCK_SIZE) {
-    /* May be able to use small block cache */
-
-    for (i = 0; i < POOL_RANGES; i++) {
-      if (size <= pool_bytes[i]) {
-        size = pool_bytes[i]; /* Round up to cached size for small strings */
-        if (pool_count[i]) {
-          p = pool[i];
-          pool[i] = p->next;
-          pool_count[i]--;
-
-#ifdef MEMDIAG
-          pool_alloc_hit[i]++;
-#endif
-          goto allocated_from_cache;
-        }
+  if (!pool_initialised)
+    init_chunk_pools();
 
-#ifdef MEMDIAG
-        pool_alloc_miss[i]++;
-#endif
-        break;
-      }
-    }
-  } else if (size > MAX_STRING_CHUNK_SIZE) {
+  if (size > MAX_STRING_CHUNK_SIZE)
     size = MAX_STRING_CHUNK_SIZE;
-  }
 
-  reqd_size = ((u_int16_t)size) + sizeof(struct STRING_CHUNK) - 1;
-
-  p = (STRING_CHUNK*)k_alloc(2, reqd_size);
-
-allocated_from_cache:
+  i = chunk_class(size);
+  size = pool_bytes[i]; /* Round up to class size */
+  if (pool_count[i]) {
+    p = pool[i];
+    pool[i] = p->next;
+    pool_count[i]--;
+    pool_alloc_hit[i]++;
+  } else {
+    pool_alloc_miss[i]++;
+    reqd_size = ((u_int16_t)size) + sizeof(struct STRING_CHUNK) - 1;
+    p = (STRING_CHUNK*)k_alloc(2, reqd_size);
+  }
 
   p->next = NULL;
   p->alloc_size = (int16_t)size;
   p->bytes = 0;
-  p->field = 0; /* No active hint */
+  ClearHints(p); /* No active hint */
 
   *actual_size = (int16_t)size;
 
@@ -211,31 +205,28 @@ void s_free(STRING_CHUNK* str) {
   int16_t bytes;
   int16_t i;
 
+  if ((str != NULL) && (str->num_flags & SNF_LOCATE))
+    locate_index_forget(str);
+
   while (str != NULL) {
     next_str = str->next;
 
-    if ((bytes = str->alloc_size) <= SMALL_BLOCK_SIZE) {
-      /* May be able to cache this block for the future */
-
-      for (i = 0; i < POOL_RANGES; i++) {
-        if (bytes == pool_bytes[i]) /* 0365 was <= */
-        {
-          if (pool_count[i] < pool_max[i]) {
-            str->next = pool[i];
-            pool[i] = str;
-            pool_count[i]++;
-#ifdef MEMDIAG
-            pool_free_hit[i]++;
-#endif
-            goto added_to_pool;
-          }
-
-#ifdef MEMDIAG
-          pool_free_miss[i]++;
-#endif
-          break;
-        }
+    /* Only chunks of exactly a class size can be cached. Others come from
+      s_make_contiguous() and are released.                              */
+
+    bytes = str->alloc_size;
+    i = chunk_class(bytes);
+    if (pool_bytes[i] == bytes) /* 0365 was <= */
+    {
+      if (pool_count[i] < pool_max[i]) {
+        str->next = pool[i];
+        pool[i] = str;
+        pool_count[i]++;
+        pool_free_hit[i]++;
+        goto added_to_pool;
       }
+
+      pool_free_miss[i]++;
     }
 
     /* We did not manage to put this block in a pool */
@@ -247,6 +238,106 @@ void s_free(STRING_CHUNK* str) {
   }
 }
 
+/* ======================================================================
+   chunk_class()  -  Find size class for chunk of given size              */
+
+Private int16_t chunk_class(int32_t size) {
+  int16_t g;
+  int32_t lo;
+  int32_t step;
+
+  if (size <= 2)
+    return 0;
+  if (size <= 8)
+    return 1;
+  if (size <= 128)
+    return 1 + (int16_t)((size + 15) >> 4);
+
+  /* Four classes in each doubling from 128 bytes */
+
+  for (g = 0, lo = 128; size > (lo << 1); g++, lo <<= 1) {
+  }
+  step = lo >> 2;
+  return 10 + (g * 4) + (int16_t)((size - lo + step - 1) / step) - 1;
+}
+
+/* ======================================================================
+   init_chunk_pools()  -  Set up size classes and free list limits        */
+
+Private void init_chunk_pools() {
+  int16_t i;
+  int32_t n;
+  int32_t share;
+
+  pool_bytes[0] = 2;
+  pool_bytes[1] = 8;
+  for (i = 2; i < 10; i++)
+    pool_bytes[i] = (i - 1) * 16;
+  for (i = 10; i < NUM_CHUNK_CLASSES; i++) {
+    n = 128 << ((i - 10) / 4);
+    pool_bytes[i] = n + (n >> 2) * (((i - 10) % 4) + 1);
+  }
+  pool_bytes[NUM_CHUNK_CLASSES - 1] = MAX_STRING_CHUNK_SIZE;
+
+  /* Each class gets an equal share of the STRCACHE budget. Classes with
+     blocks larger than their share are not cached at all so that the
+     total can never exceed the configured size.                          */
+
+  share = (pcfg.strcache * 1024) / NUM_CHUNK_CLASSES;
+  for (i = 0; i < NUM_CHUNK_CLASSES; i++) {
+    pool_max[i] = share / pool_bytes[i];
+  }
+
+  pool_initialised = TRUE;
+}
+
+/* ======================================================================
+   reset_chunk_pools()  -  Apply changed STRCACHE setting                 */
+
+void reset_chunk_pools() {
+  int16_t i;
+  STRING_CHUNK* str;
+
+  if (pool_initialised) {
+    for (i = 0; i < NUM_CHUNK_CLASSES; i++) {
+      while ((str = pool[i]) != NULL) {
+        pool[i] = str->next;
+        k_free(str);
+      }
+      pool_count[i] = 0;
+    }
+  }
+
+  init_chunk_pools();
+}
+
+/* ======================================================================
+   chunk_pool_stats()  -  Return string chunk cache statistics
+   One field per size class:
+     size VM cached VM alloc hits VM alloc misses VM free hits VM free misses */
+
+STRING_CHUNK* chunk_pool_stats() {
+  STRING_CHUNK* str;
+  int16_t i;
+
+  if (!pool_initialised)
+    init_chunk_pools();
+
+  str = NULL;
+  ts_init(&str, 1024);
+  for (i = 0; i < NUM_CHUNK_CLASSES; i++) {
+    if (i)
+      ts_copy_byte(FIELD_MARK);
+    ts_printf("%d%c%d%c%u%c%u%c%u%c%u", pool_bytes[i], VALUE_MARK,
+              pool_count[i], VALUE_MARK, pool_alloc_hit[i], VALUE_MARK,
+              pool_alloc_miss[i], VALUE_MARK, pool_free_hit[i], VALUE_MARK,
+              pool_free_miss[i]);
+  }
+  ts_terminate();
+
+  return str;
+}
+
 /* ======================================================================
    s_make_continguous()  -  Make string contiguous                        */
 
@@ -273,7 +364,7 @@ STRING_CHUNK* s_make_contiguous(STRING_CHUNK* old_str, int16_t* errnum) {
 
   new_str = (STRING_CHUNK*)k_alloc(2, reqd_size);
   new_str->next = NULL;
-  new_str->field = 0; /* No active hint */
+  ClearHints(new_str); /* No active hint */
   new_str->alloc_size = (int16_t)(old_str->string_len);
   new_str->string_len = old_str->string_len;
   new_str->bytes = (int16_t)(old_str->string_len);
@@ -414,6 +505,94 @@ int ts_printf(char* template_string, ...) {
   return n;
 }
 
+/* ======================================================================
+   ts_read()  -  Read file data directly into target string
+   Chunks are filled by readv() so that large reads need neither an
+   intermediate buffer nor a system call per chunk. Returns the number of
+   bytes read, which is less than len only at end of file, or -1 on error. */
+
+#define TS_READ_IOV 64
+
+int32_t ts_read(OSFILE fu, int32_t len) {
+  struct iovec iov[TS_READ_IOV];
+  STRING_CHUNK* chunk[TS_READ_IOV];
+  int16_t chunk_size[TS_READ_IOV];
+  int32_t total = 0;
+  int32_t wanted;
+  ssize_t n;
+  int16_t first;
+  int16_t count;
+  int16_t i;
+  int16_t k;
+  bool short_read;
+
+  while (len > 0) {
+    /* Use any space left in the current chunk, then new chunks */
+
+    count = 0;
+    wanted = 0;
+    if (ts_tgt_bytes_remaining) {
+      chunk[0] = NULL;
+      iov[0].iov_base = ts_tgt;
+      iov[0].iov_len = min(ts_tgt_bytes_remaining, len);
+      wanted = iov[0].iov_len;
+      count = 1;
+    }
+    first = count;
+
+    while ((wanted < len) && (count < TS_READ_IOV)) {
+      chunk[count] = s_alloc(min(len - wanted, MAX_STRING_CHUNK_SIZE), &chunk_size[count]);
+      iov[count].iov_base = chunk[count]->data;
+      iov[count].iov_len = min(chunk_size[count], len - wanted);
+      wanted += iov[count].iov_len;
+      count++;
+    }
+
+    n = readv(fu, iov, count);
+    if (n < 0) {
+      for (i = first; i < count; i++)
+        s_free(chunk[i]);
+      return -1;
+    }
+
+    total += n;
+    len -= n;
+    short_read = (n < wanted);
+
+    /* Account for the data and link in the chunks that received some */
+
+    for (i = 0; i < count; i++) {
+      k = (int16_t)min(n, (ssize_t)iov[i].iov_len);
+
+      if (i < first) {
+        ts_tgt += k;
+        ts_tgt_bytes_remaining -= k;
+      } else if (k == 0) {
+        s_free(chunk[i]);
+      } else {
+        if (ts_tgt_str == NULL) {
+          *ts_tgt_head = chunk[i];
+        } else {
+          ts_tgt_str->bytes = ts_tgt - ts_tgt_str->data;
+          ts_tgt_bytes += ts_tgt_str->bytes;
+          ts_tgt_str->next = chunk[i];
+        }
+
+        ts_tgt_str = chunk[i];
+        ts_tgt = ts_tgt_str->data + k;
+        ts_tgt_bytes_remaining = chunk_size[i] - k;
+      }
+
+      n -= k;
+    }
+
+    if (short_read)
+      break; /* End of file */
+  }
+
+  return total;
+}
+
 /* ======================================================================
    ts_init()  -  Initialise target string chain control                   */
 
@@ -432,6 +611,25 @@ void ts_init(STRING_CHUNK** head,
 
 void ts_new_chunk() {
   STRING_CHUNK* tgt;
+  int16_t used;
+
+  if ((ts_tgt_str != NULL) && (ts_tgt_str == *ts_tgt_head) &&
+      (ts_tgt_str->alloc_size < MAX_STRING_CHUNK_SIZE)) {
+    /* Keep the string contiguous until it reaches the maximum chunk size
+      by moving the data to a larger replacement for the first chunk.   */
+
+    used = ts_tgt - ts_tgt_str->data;
+    tgt = s_alloc(((int32_t)ts_tgt_str->alloc_size) * 2, &ts_tgt_bytes_remaining);
+    memcpy(tgt->data, ts_tgt_str->data, used);
+    s_free(ts_tgt_str);
+
+    *ts_tgt_head = tgt;
+    ts_tgt_str = tgt;
+    ts_tgt = tgt->data + used;
+    ts_tgt_bytes_remaining -= used;
+    ts_tgt_alloc_len = MAX_STRING_CHUNK_SIZE;
+    return;
+  }
 
   tgt = s_alloc(ts_tgt_alloc_len, &ts_tgt_bytes_remaining);
   ts_tgt_alloc_len = ts_tgt_bytes_remaining * 2;
@@ -483,7 +681,7 @@ void s_free_all() {
   /* Free all pool memory. This is primarilly for the memory leak check
     of MEMTRACE.                                                        */
 
-  for (i = 0; i < POOL_RANGES; i++) {
+  for (i = 0; i < NUM_CHUNK_CLASSES; i++) {
     while (pool[i] != NULL) {
       p = pool[i];
       pool[i] = p->next;
@@ -491,25 +689,6 @@ void s_free_all() {
       k_free(p);
     }
   }
-
-#ifdef MEMDIAG
-
-  tio_printf("Size   A-Hit  A-Miss   F-Hit  F-Miss\n");
-  for (i = 0; i < POOL_RANGES; i++) {
-    tio_printf("%4ld  %6ld  %6ld  %6ld  %6ld\n", pool_bytes[i],
-               pool_alloc_hit[i], pool_alloc_miss[i], pool_free_hit[i],
-               pool_free_miss[i]);
-  }
-
-  {
-    int32_t hi;
-
-    tio_printf("  Size  Allocations\n");
-    for (i = 0; i < 18; i++) {
-      tio_printf("%6ld  %ld\n", 1L << i, cts[i]);
-    }
-  }
-#endif
 }
 
 void ts_stack() {
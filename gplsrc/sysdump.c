@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Report lock contention statistics.
+ *
+ * 18Oct26 gwb Report record lock wait statistics.
+ *
+ * 18Oct26 gwb Added opcode statistics.
+ * 
  * 09Jan22 gwb Cleaned up a number of warnings generated by format specifiers
  *             that didn't match the variable type passed in.
  * 
@@ -47,6 +53,8 @@
 
 #include <sys/utsname.h>
 
+Private int compare_opcode_cycles(const void* a, const void* b);
+
 /* ====================================================================== */
 
 void dump_config(void) {
@@ -76,11 +84,16 @@ void dump_sysseg(bool dump_cfg) {
   FILE_ENTRY* fptr;
   RLOCK_ENTRY* rlptr;
   GLOCK_ENTRY* glptr;
+  CONTENTION_ENTRY* cptr;
   SEMAPHORE_ENTRY* semptr;
   USER_ENTRY* uptr;
   int i;
   int16_t j;
   char* p;
+  int16_t opcodes[NUM_OPCODES];
+  int16_t n;
+  u_int64 total_count;
+  u_int64 total_cycles;
 
   if (!attach_shared_memory()) {
     printf("QM is not active\n");
@@ -209,6 +222,9 @@ Fno Ref FLk  Fvar RLk      Mod MinMod ModVal     FlkTxn       Load Inh FreeOflw
   printf("=== RECORD LOCK TABLE ===\n");
   printf("NUMLOCKS = %d, Current = %d, Peak = %d\n", (int)(sysseg->numlocks),
          (int)(sysseg->rl_count), (int)(sysseg->rl_peak));
+  printf("Waits = %u, Queued = %u, Wait time = %llu mS, Longest = %u mS\n",
+         sysseg->rl_wait, sysseg->rl_queued,
+         (unsigned long long)(sysseg->rl_wait_time), sysseg->rl_wait_max);
 
   printf("RLid  Ct Hash User Fno    Txn Tp Hash     Id\n");
   for (i = 1; i <= sysseg->numlocks; i++) {
@@ -261,7 +277,91 @@ GLid  Ct Hash User Fno Tp Group    GrpCt
   }
   printf("\n");
 
+  /* Lock contention statistics */
+
+  if ((sysseg->flags & SSF_CONTENTION) || sysseg->contention_reset) {
+    printf("=== LOCK CONTENTION ===\n");
+    printf("Collecting = %s\n",
+           (sysseg->flags & SSF_CONTENTION) ? "Yes" : "No");
+    /*
+Times in uS. Percentiles are upper bounds of a power of two histogram.
+Fno GLWait GLRetry  GLLongest     GLp90 RLWait  RLLongest     RLp50     RLp90     RLp99
+123 123456 1234567 1234567890 123456789 123456 1234567890 123456789 123456789 123456789
+*/
+    printf("Fno GLWait GLRetry  GLLongest     GLp90 RLWait  RLLongest"
+           "     RLp50     RLp90     RLp99\n");
+    for (i = 1; i <= sysseg->used_files; i++) {
+      cptr = CPtr(i);
+      if ((cptr->gl_waits == 0) && (cptr->rl_waits == 0))
+        continue;
+
+      printf("%3d %6u %7u %10u %9u %6u %10u %9u %9u %9u\n", i,
+             cptr->gl_waits, cptr->gl_retries, cptr->gl_wait_max,
+             contention_percentile(cptr->gl_hist, 90), cptr->rl_waits,
+             cptr->rl_wait_max, contention_percentile(cptr->rl_hist, 50),
+             contention_percentile(cptr->rl_hist, 90),
+             contention_percentile(cptr->rl_hist, 99));
+      printf("    %s\n", (char*)(FPtr(i)->pathname));
+      for (j = 0; j < CONTENTION_HOT; j++) {
+        if (cptr->hot[j].id_len == 0)
+          break;
+        printf("    %8u %.*s\n", cptr->hot[j].waits,
+               (int)(cptr->hot[j].id_len), cptr->hot[j].id);
+      }
+    }
+    printf("\n");
+  }
+
+  /* Opcode statistics, most expensive first */
+
+  n = 0;
+  total_count = 0;
+  total_cycles = 0;
+  for (i = 0; i < NUM_OPCODES; i++) {
+    if (sysseg->opcode_count[i]) {
+      opcodes[n++] = i;
+      total_count += sysseg->opcode_count[i];
+      total_cycles += sysseg->opcode_cycles[i];
+    }
+  }
+
+  if (n) {
+    qsort(opcodes, n, sizeof(int16_t), compare_opcode_cycles);
+
+    printf("=== OPCODE STATISTICS ===\n");
+    printf("Executions = %llu, Cycles = %llu\n",
+           (unsigned long long)total_count, (unsigned long long)total_cycles);
+    /*
+Opcode...... Executions.......... Cycles.................. Avg..... Pct..
+xxxxxxxxxxxx 12345678901234567890 123456789012345678901234 12345678 100.0
+*/
+    printf("Opcode...... Executions.......... Cycles.................. "
+           "Avg..... Pct..\n");
+    for (j = 0; j < n; j++) {
+      i = opcodes[j];
+      printf("%-12s %20llu %24llu %8llu %5.1f\n", opcode_name[i],
+             (unsigned long long)(sysseg->opcode_count[i]),
+             (unsigned long long)(sysseg->opcode_cycles[i]),
+             (unsigned long long)(sysseg->opcode_cycles[i] /
+                                  sysseg->opcode_count[i]),
+             (total_cycles) ? ((sysseg->opcode_cycles[i] * 100.0) / total_cycles)
+                            : 0.0);
+    }
+    printf("\n");
+  }
+
   unbind_sysseg();
 }
 
+/* ====================================================================== */
+
+Private int compare_opcode_cycles(const void* a, const void* b) {
+  u_int64 ca;
+  u_int64 cb;
+
+  ca = sysseg->opcode_cycles[*((int16_t*)a)];
+  cb = sysseg->opcode_cycles[*((int16_t*)b)];
+  return (ca < cb) ? 1 : ((ca > cb) ? -1 : 0);
+}
+
 /* END-CODE */
@@ -21,6 +21,12 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Allocate lock contention table.
+ *
+ * 18Oct26 gwb Allocate file table hash index.
+ *
+ * 18Oct26 gwb Apply STRCACHE to the string chunk cache after copying pcfg.
+ *
  * 13Jan22 gwb Changed bind_sysseg() so that it returns a full error message if 
  *             the pcode load fails.  A numeric error doesn't help anyone.
  * 
@@ -110,6 +116,7 @@ bool bind_sysseg(bool create, char* errmsg) {
   int16_t rlock_entry_size;
   int16_t hi_user_no;
   int user_map_size;
+  int32_t file_hash_size;
   char path[MAX_PATHNAME_LEN + 1];
   int pcode_fd;
   struct stat statBuf;
@@ -151,6 +158,7 @@ bool bind_sysseg(bool create, char* errmsg) {
     /* Copy the template pcfg structure to our private version */
 
     memcpy(&pcfg, ((char*)sysseg) + sysseg->pcfg_offset, sizeof(struct PCFG));
+    reset_chunk_pools(); /* Apply STRCACHE */
     status = TRUE;
     goto exit_bind_sysseg;
   }
@@ -174,6 +182,14 @@ bool bind_sysseg(bool create, char* errmsg) {
 
   sharedMemSize = sizeof(SYSSEG);
   sharedMemSize += cfg->numfiles * sizeof(struct FILE_ENTRY);
+  sharedMemSize += cfg->numfiles * sizeof(struct CONTENTION_ENTRY);
+
+  /* File table hash index. At least two chains per file table entry. */
+
+  file_hash_size = 16;
+  while (file_hash_size < cfg->numfiles * 2)
+    file_hash_size <<= 1;
+  sharedMemSize += file_hash_size * sizeof(int16_t);
 
   rlock_entry_size = (offsetof(RLOCK_ENTRY, id) + MAX_ID_LEN + 3) & ~3;
   sharedMemSize += cfg->numlocks * rlock_entry_size;
@@ -261,6 +277,13 @@ bool bind_sysseg(bool create, char* errmsg) {
   sysseg->file_table = offset;
   offset += (cfg->numfiles * sizeof(struct FILE_ENTRY));
 
+  sysseg->contention_table = offset;
+  offset += (cfg->numfiles * sizeof(struct CONTENTION_ENTRY));
+
+  sysseg->file_hash = offset;
+  sysseg->file_hash_size = file_hash_size;
+  offset += file_hash_size * sizeof(int16_t);
+
   sysseg->numlocks = cfg->numlocks;
   sysseg->rlock_table = offset;
   sysseg->rlock_entry_size = rlock_entry_size;
@@ -21,6 +21,14 @@
  * ScarletDME Wiki: https://scarlet.deltasoft.com
  * 
  * START-HISTORY (ScarletDME):
+ * 18Oct26 gwb Added lock contention table.
+ *
+ * 18Oct26 gwb Added lock wait queue and statistics.
+ *
+ * 18Oct26 gwb Added file table hash index.
+ *
+ * 18Oct26 gwb Added system wide opcode statistics.
+ *
  * 27Feb20 gwb Changed integer declarations to be portable across address
  *             space sizes (32 vs 64 bit)
  * 
@@ -76,6 +84,7 @@ struct SYSSEG {
    u_int32_t flags;
      #define SSF_SECURE     0x00000001   /* Secure mode? */
      #define SSF_SUSPEND    0x00000020   /* Suspend writes */
+     #define SSF_CONTENTION 0x00000040   /* Collect lock contention stats */
 // MS 16 bits from from DEBUG configuration parameter
      #define SSF_PRTDEBUG   0x00010000   /* Debug printer actions */
      #define SSF_QMFIX      0x00020000   /* Allow QMFix in interactive mode */
@@ -100,10 +109,19 @@ struct SYSSEG {
    /* Record lock counters (Protected by REC_LOCK_SEM) */
    u_int32_t rl_count;   /* Current number of record locks */
    u_int32_t rl_peak;    /* Peak number of record locks */
+   u_int32_t rl_ticket;  /* Last lock wait queue ticket issued */
+   u_int32_t rl_queued;  /* Users holding a lock wait queue ticket */
+   u_int32_t rl_wait;    /* Number of record lock waits */
+   u_int32_t rl_wait_max; /* Longest record lock wait (mS) */
+   u_int64 rl_wait_time; /* Total record lock wait time (mS) */
+   int32_t contention_reset;    /* qmtime() when contention stats cleared */
    int32_t file_table;          /* Offset of file table */
+   int32_t file_hash;           /* Offset of file table hash index... */
+   int32_t file_hash_size;      /* ...and number of chains (power of two) */
    int32_t rlock_table;         /* Offset of record lock table... */
    int16_t rlock_entry_size;   /* ...and size of each entry */
    int32_t glock_table;         /* Offset of group lock table */
+   int32_t contention_table;    /* Offset of lock contention table */
    int32_t semaphore_table;     /* Offset of semaphore owner table */
    int32_t user_table;          /* Offset of user table */
    int16_t user_entry_size;    /* Size of user table entry */
@@ -112,6 +130,10 @@ struct SYSSEG {
    int32_t pcfg_offset;         /* Offset to template pcfg structure */
    int pcode_len;
    char pid_file_path[MAX_PATHNAME_LEN+1]; /* PIDFILE:  Replace the default file path containing qnlnxd process id, used by systemctl to check whether ScarletDME is started or not */
+   /* Opcode statistics merged from processes running with OPSTATS
+      (Protected by SHORT_CODE) */
+   u_int64 opcode_count[NUM_OPCODES];  /* Executions */
+   u_int64 opcode_cycles[NUM_OPCODES]; /* Cumulative cycles */
 };
 
 Public SYSSEG * sysseg init(NULL);   /* 0234 */
@@ -191,6 +213,11 @@ struct USER_ENTRY
    int16_t lockwait_index;       /* 0 = not waiting,
                                       +ve = rec lock table index (record lock),
                                       -ve = file table index (file lock) */
+   int16_t lockwait_wake;        /* Set when the lock waited for is released */
+   int16_t lockwait_fno;         /* File and id hash of record lock being... */
+   int32_t lockwait_hash;        /* ...waited for while lockwait_ticket set */
+   u_int32_t lockwait_ticket;    /* Record lock wait queue position, 0 = none */
+   int32_t lockwait_time;        /* Time (mS) woken to retry lock */
    u_int16_t file_map[1];          /* Count of opens by file.
                                                Protected by FILE_TABLE_LOCK */
  };